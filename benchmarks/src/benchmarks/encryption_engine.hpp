@@ -8,6 +8,8 @@
 #define _EFC_BENCH_BENCHMARKS_ENCRYPTION_ENGINE_HPP_
 #include <benchmark/benchmark.h>
 #include <efc/encryption_engine.hpp>
+#include <efc/encryption_engine_pool.hpp>
+#include <memory>
 
 namespace mjx {
     namespace bench {
@@ -67,8 +69,101 @@ namespace mjx {
             }
         }
 
+        inline bool _Seal_message(encryption_engine& _Engine, byte_t* const _Buf, const size_t _Size) noexcept {
+            authentication_tag _Msg_tag; // not shared, the pooled benchmark runs on many threads
+            return _Engine.setup_encryption(_Key, _Iv) && _Engine.encrypt(_Buf, _Size, _Buf)
+                && _Engine.complete(_Msg_tag);
+        }
+
+        void bm_seal_new_engine(::benchmark::State& _State) { // allocates the context and sets the key every time
+            const size_t _Size = static_cast<size_t>(_State.range(0));
+            ::std::unique_ptr<byte_t[]> _Buf(new byte_t[_Size]());
+            for (const auto& _Step : _State) {
+                encryption_engine _Engine;
+                ::benchmark::DoNotOptimize(_Seal_message(_Engine, _Buf.get(), _Size));
+            }
+
+            _State.SetBytesProcessed(static_cast<int64_t>(_State.iterations() * _Size));
+        }
+
+        void bm_seal_reused_engine(::benchmark::State& _State) { // sets only a new IV every time
+            const size_t _Size = static_cast<size_t>(_State.range(0));
+            ::std::unique_ptr<byte_t[]> _Buf(new byte_t[_Size]());
+            encryption_engine _Engine;
+            for (const auto& _Step : _State) {
+                ::benchmark::DoNotOptimize(_Seal_message(_Engine, _Buf.get(), _Size));
+            }
+
+            _State.SetBytesProcessed(static_cast<int64_t>(_State.iterations() * _Size));
+        }
+
+        void bm_seal_pooled_engine(::benchmark::State& _State) { // acquires an engine shared by the threads
+            static encryption_engine_pool _Pool;
+            const size_t _Size = static_cast<size_t>(_State.range(0));
+            ::std::unique_ptr<byte_t[]> _Buf(new byte_t[_Size]());
+            for (const auto& _Step : _State) {
+                pooled_encryption_engine _Engine = _Pool.acquire();
+                ::benchmark::DoNotOptimize(_Seal_message(_Engine.get(), _Buf.get(), _Size));
+            }
+
+            _State.SetBytesProcessed(static_cast<int64_t>(_State.iterations() * _Size));
+        }
+
+        constexpr size_t _Batch_record_count = 4096; // the number of records of a batch
+
+        inline ::std::unique_ptr<batch_record[]> _Make_batch(byte_t* const _Buf, const size_t _Size) {
+            ::std::unique_ptr<batch_record[]> _Records(new batch_record[_Batch_record_count]);
+            for (size_t _Idx = 0; _Idx < _Batch_record_count; ++_Idx) {
+                _Records[_Idx].iv     = _Iv;
+                _Records[_Idx].input  = _Buf + _Idx * _Size;
+                _Records[_Idx].size   = _Size;
+                _Records[_Idx].output = _Buf + _Idx * _Size;
+            }
+
+            return _Records;
+        }
+
+        void bm_seal_records(::benchmark::State& _State) { // seals the records of a batch one by one
+            const size_t _Size = static_cast<size_t>(_State.range(0));
+            ::std::unique_ptr<byte_t[]> _Buf(new byte_t[_Batch_record_count * _Size]());
+            ::std::unique_ptr<batch_record[]> _Records = _Make_batch(_Buf.get(), _Size);
+            encryption_engine _Engine;
+            for (const auto& _Step : _State) {
+                for (size_t _Idx = 0; _Idx < _Batch_record_count; ++_Idx) {
+                    batch_record& _Record = _Records[_Idx];
+                    ::benchmark::DoNotOptimize(_Engine.setup_encryption(_Key, _Record.iv)
+                        && _Engine.encrypt(_Record.input, _Size, _Record.output) && _Engine.complete(_Record.tag));
+                }
+            }
+
+            _State.SetItemsProcessed(static_cast<int64_t>(_State.iterations() * _Batch_record_count));
+            _State.SetBytesProcessed(static_cast<int64_t>(_State.iterations() * _Batch_record_count * _Size));
+        }
+
+        void bm_seal_batch(::benchmark::State& _State) { // the second argument is the number of threads
+            const size_t _Size = static_cast<size_t>(_State.range(0));
+            ::std::unique_ptr<byte_t[]> _Buf(new byte_t[_Batch_record_count * _Size]());
+            ::std::unique_ptr<batch_record[]> _Records = _Make_batch(_Buf.get(), _Size);
+            encryption_engine _Engine;
+            for (const auto& _Step : _State) {
+                ::benchmark::DoNotOptimize(_Engine.seal_batch(
+                    &_Key, 1, _Records.get(), _Batch_record_count, static_cast<size_t>(_State.range(1))));
+            }
+
+            _State.SetItemsProcessed(static_cast<int64_t>(_State.iterations() * _Batch_record_count));
+            _State.SetBytesProcessed(static_cast<int64_t>(_State.iterations() * _Batch_record_count * _Size));
+        }
+
         BENCHMARK(bm_encrypt)->DenseRange(0, 10)->Unit(::benchmark::TimeUnit::kNanosecond);
         BENCHMARK(bm_decrypt)->DenseRange(0, 10)->Unit(::benchmark::TimeUnit::kNanosecond);
+        BENCHMARK(bm_seal_new_engine)->RangeMultiplier(4)->Range(64, 64 << 10)->Unit(
+            ::benchmark::TimeUnit::kNanosecond);
+        BENCHMARK(bm_seal_reused_engine)->RangeMultiplier(4)->Range(64, 64 << 10)->Unit(
+            ::benchmark::TimeUnit::kNanosecond);
+        BENCHMARK(bm_seal_pooled_engine)->RangeMultiplier(4)->Range(64, 64 << 10)->ThreadRange(1, 8)->Unit(
+            ::benchmark::TimeUnit::kNanosecond);
+        BENCHMARK(bm_seal_records)->Arg(100)->Arg(1024)->Arg(4096)->Unit(::benchmark::TimeUnit::kMicrosecond);
+        BENCHMARK(bm_seal_batch)->ArgsProduct({{100, 1024, 4096}, {1, 0}})->Unit(::benchmark::TimeUnit::kMicrosecond);
     } // namespace bench
 } // namespace mjx
 
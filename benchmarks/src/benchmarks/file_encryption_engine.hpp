@@ -0,0 +1,143 @@
+// file_encryption_engine.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_BENCH_BENCHMARKS_FILE_ENCRYPTION_ENGINE_HPP_
+#define _EFC_BENCH_BENCHMARKS_FILE_ENCRYPTION_ENGINE_HPP_
+#include <benchmark/benchmark.h>
+#include <benchmarks/encryption_engine.hpp>
+#include <cstdint>
+#include <efc/file_encryption_engine.hpp>
+#include <efc/impl/tinywin.hpp>
+#include <memory>
+#include <mjfs/file.hpp>
+#include <mjfs/file_stream.hpp>
+#include <mjfs/path.hpp>
+#include <new>
+
+namespace mjx {
+    namespace bench {
+        constexpr size_t _Bench_file_size = 67108864; // 64 MiB
+        constexpr double _Gigabyte        = 1073741824.0;
+
+        inline bool _Fill_bench_file(file_stream& _Stream) noexcept {
+            constexpr size_t _Block_size = 1048576;
+            ::std::unique_ptr<byte_t[]> _Block(new (::std::nothrow) byte_t[_Block_size]);
+            if (!_Block) {
+                return false;
+            }
+
+            for (size_t _Idx = 0; _Idx < _Block_size; ++_Idx) {
+                _Block[_Idx] = static_cast<byte_t>(_Idx * 31);
+            }
+
+            for (size_t _Written = 0; _Written < _Bench_file_size; _Written += _Block_size) {
+                if (!_Stream.write(_Block.get(), _Block_size)) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        inline bool _Create_bench_file(const path& _Path) {
+            ::mjx::delete_file(_Path); // may be left over from an interrupted run
+            file _File;
+            if (!::mjx::create_file(_Path, &_File)) {
+                return false;
+            }
+
+            file_stream _Stream(_File);
+            return _Fill_bench_file(_Stream);
+        }
+
+        // returns the number of reads and writes issued by the process so far, or zero if it cannot be queried
+        inline uint64_t _Io_operation_count() noexcept {
+            IO_COUNTERS _Counters;
+            if (!::GetProcessIoCounters(::GetCurrentProcess(), &_Counters)) {
+                return 0;
+            }
+
+            return _Counters.ReadOperationCount + _Counters.WriteOperationCount;
+        }
+
+        inline void _Bench_file_encryption(::benchmark::State& _State, const file_encryption_options& _Options) {
+            const path _Src_path  = L"efc_bench_src.tmp";
+            const path _Dest_path = L"efc_bench_dest.tmp";
+            if (!_Create_bench_file(_Src_path) || !::mjx::create_file(_Dest_path)) {
+                _State.SkipWithError("Failed to create the benchmark files.");
+                return;
+            }
+
+            {
+                const file_flag _Flags =
+                    _Options.io_mode == file_io_mode::overlapped ? file_flag::overlapped : file_flag::none;
+                file _Src_file(_Src_path, file_access::read, file_share::read, _Flags);
+                file _Dest_file(_Dest_path, file_access::read | file_access::write, file_share::none, _Flags);
+                file_stream _Src_stream(_Src_file);
+                file_stream _Dest_stream(_Dest_file);
+                authentication_tag _Tag;
+                uint64_t _Io_count = 0;
+                for (const auto& _Step : _State) {
+                    _Src_stream.seek(0);
+                    _Dest_stream.seek(0);
+                    encryption_engine _Engine;
+                    file_encryption_engine _File_engine(_Src_file, _Dest_file, _Engine, _Options);
+                    const uint64_t _Io_before = _Io_operation_count();
+                    ::benchmark::DoNotOptimize(_File_engine.encrypt(_Key, _Iv, _Tag));
+                    _Io_count += _Io_operation_count() - _Io_before;
+                }
+
+                // Note: The counters include the reads and writes of every thread of the process, but not
+                //       the page faults, so the mapped mode reports only the I/O it issues explicitly.
+                _State.counters["io_per_GB"] = ::benchmark::Counter(static_cast<double>(_Io_count)
+                    * (_Gigabyte / _Bench_file_size), ::benchmark::Counter::kAvgIterations);
+            }
+
+            ::mjx::delete_file(_Src_path);
+            ::mjx::delete_file(_Dest_path);
+            _State.SetBytesProcessed(static_cast<int64_t>(_State.iterations() * _Bench_file_size));
+        }
+
+        void bm_encrypt_file(::benchmark::State& _State) {
+            file_encryption_options _Options;
+            _Options.chunk_size = static_cast<size_t>(_State.range(0));
+            _Bench_file_encryption(_State, _Options);
+        }
+
+        void bm_encrypt_file_pipelined(::benchmark::State& _State) {
+            file_encryption_options _Options;
+            _Options.chunk_size = static_cast<size_t>(_State.range(0));
+            _Options.pipelined  = true;
+            _Bench_file_encryption(_State, _Options);
+        }
+
+        void bm_encrypt_file_overlapped(::benchmark::State& _State) {
+            file_encryption_options _Options;
+            _Options.chunk_size = static_cast<size_t>(_State.range(0));
+            _Options.io_mode    = file_io_mode::overlapped;
+            _Bench_file_encryption(_State, _Options);
+        }
+
+        void bm_encrypt_file_mapped(::benchmark::State& _State) {
+            file_encryption_options _Options;
+            _Options.chunk_size = static_cast<size_t>(_State.range(0));
+            _Options.io_mode    = file_io_mode::mapped;
+            _Bench_file_encryption(_State, _Options);
+        }
+
+        // chunk sizes from 64 KiB to 16 MiB
+        BENCHMARK(bm_encrypt_file)->RangeMultiplier(2)->Range(65536, 16777216)
+            ->Unit(::benchmark::TimeUnit::kMillisecond);
+        BENCHMARK(bm_encrypt_file_pipelined)->RangeMultiplier(2)->Range(65536, 16777216)
+            ->Unit(::benchmark::TimeUnit::kMillisecond);
+        BENCHMARK(bm_encrypt_file_overlapped)->RangeMultiplier(2)->Range(65536, 16777216)
+            ->Unit(::benchmark::TimeUnit::kMillisecond);
+        BENCHMARK(bm_encrypt_file_mapped)->RangeMultiplier(2)->Range(65536, 16777216)
+            ->Unit(::benchmark::TimeUnit::kMillisecond);
+    } // namespace bench
+} // namespace mjx
+
+#endif // _EFC_BENCH_BENCHMARKS_FILE_ENCRYPTION_ENGINE_HPP_
\ No newline at end of file
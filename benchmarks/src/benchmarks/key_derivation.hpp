@@ -7,7 +7,9 @@
 #ifndef _EFC_BENCH_BENCHMARKS_KEY_DERIVATION_HPP_
 #define _EFC_BENCH_BENCHMARKS_KEY_DERIVATION_HPP_
 #include <benchmark/benchmark.h>
+#include <efc/impl/argon2.hpp>
 #include <efc/key_derivation.hpp>
+#include <efc/key_derivation_scheduler.hpp>
 
 namespace mjx {
     namespace bench {
@@ -20,6 +22,76 @@ namespace mjx {
         }
 
         BENCHMARK(bm_derive_key)->DenseRange(0, 10)->Unit(::benchmark::TimeUnit::kMillisecond);
+
+        void bm_derive_key_context(::benchmark::State& _State) { // the memory is allocated once
+            key_derivation_context _Context(1, legacy_key_derivation_params, _State.range(0) != 0);
+            for (const auto& _Step : _State) {
+                ::benchmark::DoNotOptimize(_Context.derive_key(L"ZD43MB$q|.iyUg4A", _Salt));
+            }
+        }
+
+        BENCHMARK(bm_derive_key_context)->DenseRange(0, 1)->Unit(::benchmark::TimeUnit::kMillisecond);
+
+        void bm_derive_key_batch(::benchmark::State& _State) { // 64 keys, each with its own salt
+            secure_password _Password;
+            _Password.assign(L"ZD43MB$q|.iyUg4A");
+            for (const auto& _Step : _State) {
+                key_derivation_scheduler _Kdf(static_cast<size_t>(_State.range(0)));
+                for (size_t _Idx = 0; _Idx < 64; ++_Idx) {
+                    _Kdf.submit(_Password, _Salt, legacy_key_derivation_params,
+                        [](const key& _Key) { ::benchmark::DoNotOptimize(_Key); });
+                }
+
+                _Kdf.wait();
+            }
+
+            _State.SetItemsProcessed(_State.iterations() * 64);
+        }
+
+        BENCHMARK(bm_derive_key_batch)->RangeMultiplier(2)->Range(1, 16)->Unit(::benchmark::TimeUnit::kMillisecond);
+
+        // the argument selects the compression kernel, from generic (0) to AVX-512 (3)
+        void bm_argon2_compress(::benchmark::State& _State) {
+            const efc_impl::_Argon2_kernel _Kernel = static_cast<efc_impl::_Argon2_kernel>(_State.range(0));
+            if (!efc_impl::_Is_argon2_kernel_supported(_Kernel)) {
+                _State.SkipWithError("Kernel not supported by the CPU.");
+                return;
+            }
+
+            const efc_impl::_Argon2_compress_fn _Compress = efc_impl::_Get_argon2_compress(_Kernel);
+            efc_impl::_Argon2_block _Prev                 = {};
+            efc_impl::_Argon2_block _Ref                  = {};
+            efc_impl::_Argon2_block _Dest                 = {};
+            for (const auto& _Step : _State) {
+                _Compress(_Dest, _Prev, _Ref, true);
+                ::benchmark::DoNotOptimize(_Dest);
+            }
+
+            _State.SetBytesProcessed(_State.iterations() * sizeof(efc_impl::_Argon2_block));
+        }
+
+        BENCHMARK(bm_argon2_compress)->DenseRange(0, 3);
+
+        void bm_argon2id(::benchmark::State& _State) { // the legacy parameters, 16 MiB and 8 passes
+            const efc_impl::_Argon2_kernel _Kernel = static_cast<efc_impl::_Argon2_kernel>(_State.range(0));
+            if (!efc_impl::_Is_argon2_kernel_supported(_Kernel)) {
+                _State.SkipWithError("Kernel not supported by the CPU.");
+                return;
+            }
+
+            efc_impl::_Argon2_input _Input;
+            _Input._Salt       = _Salt.data();
+            _Input._Salt_size  = salt::size;
+            _Input._Memory     = legacy_key_derivation_params.memory;
+            _Input._Iterations = legacy_key_derivation_params.iterations;
+            _Input._Lanes      = legacy_key_derivation_params.lanes;
+            byte_t _Tag[key::size];
+            for (const auto& _Step : _State) {
+                ::benchmark::DoNotOptimize(efc_impl::_Argon2id(_Tag, sizeof(_Tag), _Input, 1, _Kernel));
+            }
+        }
+
+        BENCHMARK(bm_argon2id)->DenseRange(0, 3)->Unit(::benchmark::TimeUnit::kMillisecond);
     } // namespace bench
 } // namespace mjx
 
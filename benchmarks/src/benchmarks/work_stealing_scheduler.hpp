@@ -0,0 +1,79 @@
+// work_stealing_scheduler.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_BENCH_BENCHMARKS_WORK_STEALING_SCHEDULER_HPP_
+#define _EFC_BENCH_BENCHMARKS_WORK_STEALING_SCHEDULER_HPP_
+#include <benchmark/benchmark.h>
+#include <benchmarks/encryption_engine.hpp>
+#include <cstdint>
+#include <efc/encryption_engine.hpp>
+#include <efc/work_stealing_scheduler.hpp>
+#include <memory>
+#include <new>
+
+namespace mjx {
+    namespace bench {
+        // a batch of few large and many small files, kept in memory to measure the scheduling only
+        constexpr size_t _Large_file_count = 4;
+        constexpr size_t _Large_file_size  = 33554432; // 32 MiB
+        constexpr size_t _Small_file_count = 8192;
+        constexpr size_t _Small_file_size  = 4096; // 4 KiB
+        constexpr size_t _Batch_chunk_size = 1048576; // 1 MiB
+        constexpr size_t _Batch_size       =
+            _Large_file_count * _Large_file_size + _Small_file_count * _Small_file_size;
+
+        inline void _Encrypt_in_memory(const size_t _Size) noexcept {
+            ::std::unique_ptr<byte_t[]> _Buf(new (::std::nothrow) byte_t[_Size]());
+            if (!_Buf) {
+                return;
+            }
+
+            encryption_engine _Engine;
+            authentication_tag _Tag;
+            ::benchmark::DoNotOptimize(_Engine.setup_encryption(_Key, _Iv)
+                && _Engine.encrypt(_Buf.get(), _Size, _Buf.get()) && _Engine.complete(_Tag));
+        }
+
+        void bm_schedule_mixed_batch(::benchmark::State& _State) {
+            uint64_t _Executed      = 0;
+            uint64_t _Stolen        = 0;
+            uint64_t _Failed_steals = 0;
+            for (const auto& _Step : _State) {
+                work_stealing_scheduler _Scheduler(static_cast<size_t>(_State.range(0)));
+                for (size_t _Idx = 0; _Idx < _Large_file_count; ++_Idx) { // large files split into chunks
+                    _Scheduler.submit([&_Scheduler] {
+                        for (size_t _Off = 0; _Off < _Large_file_size; _Off += _Batch_chunk_size) {
+                            _Scheduler.submit([] { _Encrypt_in_memory(_Batch_chunk_size); });
+                        }
+                    });
+                }
+
+                for (size_t _Idx = 0; _Idx < _Small_file_count; ++_Idx) {
+                    _Scheduler.submit([] { _Encrypt_in_memory(_Small_file_size); });
+                }
+
+                _Scheduler.wait();
+                for (size_t _Idx = 0; _Idx < _Scheduler.worker_count(); ++_Idx) {
+                    const worker_stats& _Stats = _Scheduler.stats(_Idx);
+                    _Executed                 += _Stats.executed;
+                    _Stolen                   += _Stats.stolen;
+                    _Failed_steals            += _Stats.failed_steals;
+                }
+            }
+
+            _State.SetBytesProcessed(static_cast<int64_t>(_State.iterations() * _Batch_size));
+            _State.counters["stolen_ratio"]  = _Executed != 0 ? static_cast<double>(_Stolen) / _Executed : 0.0;
+            _State.counters["failed_steals"] =
+                ::benchmark::Counter(static_cast<double>(_Failed_steals), ::benchmark::Counter::kAvgIterations);
+        }
+
+        // from 1 to 32 workers, the throughput should grow almost linearly up to the number of cores
+        BENCHMARK(bm_schedule_mixed_batch)->RangeMultiplier(2)->Range(1, 32)->UseRealTime()
+            ->Unit(::benchmark::TimeUnit::kMillisecond);
+    } // namespace bench
+} // namespace mjx
+
+#endif // _EFC_BENCH_BENCHMARKS_WORK_STEALING_SCHEDULER_HPP_
\ No newline at end of file
@@ -5,6 +5,8 @@
 
 #define BENCHMARK_STATIC_DEFINE
 #include <benchmarks/encryption_engine.hpp>
+#include <benchmarks/file_encryption_engine.hpp>
 #include <benchmarks/key_derivation.hpp>
+#include <benchmarks/work_stealing_scheduler.hpp>
 
 BENCHMARK_MAIN();
\ No newline at end of file
@@ -0,0 +1,128 @@
+// chunk_cache.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <cstring>
+#include <efc/chunk_cache.hpp>
+#include <efc/impl/secure_memory.hpp>
+#include <new>
+
+namespace mjx {
+    chunk_cache::_Entry::~_Entry() noexcept {
+        if (_Data) {
+            efc_impl::_Wipe_memory(_Data.get(), _Size);
+        }
+    }
+
+    chunk_cache::chunk_cache(const size_t _Capacity, const size_t _Readahead) noexcept
+        : _Mymtx(), _Mylist(), _Mymap(), _Mycapacity(_Capacity), _Mysize(0), _Myreadahead(_Readahead),
+        _Myhits(0), _Mymisses(0), _Myprefetches(0) {}
+
+    chunk_cache::~chunk_cache() noexcept {}
+
+    size_t chunk_cache::capacity() const noexcept {
+        return _Mycapacity;
+    }
+
+    size_t chunk_cache::size() const noexcept {
+        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+        return _Mysize;
+    }
+
+    size_t chunk_cache::readahead() const noexcept {
+        return _Myreadahead;
+    }
+
+    uint64_t chunk_cache::hits() const noexcept {
+        return _Myhits.load(::std::memory_order_relaxed);
+    }
+
+    uint64_t chunk_cache::misses() const noexcept {
+        return _Mymisses.load(::std::memory_order_relaxed);
+    }
+
+    uint64_t chunk_cache::prefetches() const noexcept {
+        return _Myprefetches.load(::std::memory_order_relaxed);
+    }
+
+    void chunk_cache::clear() noexcept {
+        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+        _Evict(0);
+    }
+
+    bool chunk_cache::_Copy(
+        const _Entry_key& _Key, const size_t _Off, byte_t* const _Buf, const size_t _Count) noexcept {
+        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+        const auto _Found = _Mymap.find(_Key);
+        if (_Found == _Mymap.end()) {
+            _Mymisses.fetch_add(1, ::std::memory_order_relaxed);
+            return false;
+        }
+
+        _Mylist.splice(_Mylist.begin(), _Mylist, _Found->second); // mark as the most recently used
+        ::memcpy(_Buf, _Found->second->_Data.get() + _Off, _Count);
+        _Myhits.fetch_add(1, ::std::memory_order_relaxed);
+        return true;
+    }
+
+    bool chunk_cache::_Contains(const _Entry_key& _Key) noexcept {
+        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+        return _Mymap.find(_Key) != _Mymap.end();
+    }
+
+    void chunk_cache::_Insert(const _Entry_key& _Key, const byte_t* const _Data, const size_t _Size) noexcept {
+        if (_Size > _Mycapacity) { // would evict everything and still not fit
+            return;
+        }
+
+        // Note: The copy is made before taking the lock, so that other readers are not blocked.
+        ::std::unique_ptr<byte_t[]> _Copy(new (::std::nothrow) byte_t[_Size]);
+        if (!_Copy) {
+            return;
+        }
+
+        ::memcpy(_Copy.get(), _Data, _Size);
+        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+        if (_Mymap.find(_Key) != _Mymap.end()) { // already cached by another thread
+            efc_impl::_Wipe_memory(_Copy.get(), _Size);
+            return;
+        }
+
+        _Evict(_Mycapacity - _Size);
+        bool _Listed = false;
+        try {
+            _Mylist.emplace_front();
+            _Listed              = true;
+            _Mylist.front()._Key = _Key;
+            _Mymap.emplace(_Key, _Mylist.begin());
+        } catch (...) { // not cached, not an error
+            if (_Listed) { // the entry is not reachable from the map, remove it
+                _Mylist.pop_front();
+            }
+
+            efc_impl::_Wipe_memory(_Copy.get(), _Size);
+            return;
+        }
+
+        // Note: The entry takes the plaintext only once it is reachable from the map,
+        //       so that a failed insertion never leaves an entry that is counted in the size.
+        _Entry& _New_entry = _Mylist.front();
+        _New_entry._Size   = _Size;
+        _New_entry._Data   = ::std::move(_Copy);
+        _Mysize           += _Size;
+    }
+
+    void chunk_cache::_Count_prefetch() noexcept {
+        _Myprefetches.fetch_add(1, ::std::memory_order_relaxed);
+    }
+
+    void chunk_cache::_Evict(const size_t _Size) noexcept {
+        while (_Mysize > _Size && !_Mylist.empty()) {
+            _Entry& _Last = _Mylist.back();
+            _Mysize      -= _Last._Size;
+            _Mymap.erase(_Last._Key);
+            _Mylist.pop_back(); // wipes the plaintext
+        }
+    }
+} // namespace mjx
\ No newline at end of file
@@ -0,0 +1,123 @@
+// chunk_cache.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_CHUNK_CACHE_HPP_
+#define _EFC_CHUNK_CACHE_HPP_
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <efc/encryption_engine.hpp>
+#include <efc/key_derivation.hpp>
+#include <list>
+#include <memory>
+#include <mjstr/char_traits.hpp>
+#include <mutex>
+#include <unordered_map>
+
+namespace mjx {
+    namespace efc_impl {
+        class _Chunk_prefetcher;
+    } // namespace efc_impl
+
+    class encrypted_file_reader;
+
+    class chunk_cache { // bounded LRU cache of verified plaintext chunks, shared by many readers
+    public:
+        static constexpr size_t default_readahead = 2; // the number of chunks loaded ahead of sequential readers
+
+        // Note: The chunks are identified by the IV of the file and the check value of the key, so readers
+        //       of the same file that use the same key share them, while different keys never do.
+        //       The chunks outlive their readers until evicted or cleared, and are wiped before
+        //       their memory is released.
+        explicit chunk_cache(const size_t _Capacity, const size_t _Readahead = default_readahead) noexcept;
+        ~chunk_cache() noexcept;
+
+        chunk_cache(const chunk_cache&)            = delete;
+        chunk_cache& operator=(const chunk_cache&) = delete;
+
+        // returns the maximum number of bytes the cached chunks may take
+        size_t capacity() const noexcept;
+
+        // returns the number of bytes the cached chunks take
+        size_t size() const noexcept;
+
+        // returns the number of chunks loaded ahead of sequential readers
+        size_t readahead() const noexcept;
+
+        // returns the number of chunk accesses served from the cache
+        uint64_t hits() const noexcept;
+
+        // returns the number of chunk accesses that had to decrypt the chunk
+        uint64_t misses() const noexcept;
+
+        // returns the number of chunks loaded ahead of sequential readers
+        uint64_t prefetches() const noexcept;
+
+        // wipes and removes all the cached chunks
+        void clear() noexcept;
+
+    private:
+        friend encrypted_file_reader;
+        friend efc_impl::_Chunk_prefetcher;
+
+        struct _Entry_key {
+            iv _Iv; // the IV of the file the chunk belongs to
+            key_check _Check; // the check value of the key the chunk was decrypted with
+            uint64_t _Index;
+
+            bool operator==(const _Entry_key& _Other) const noexcept {
+                return _Index == _Other._Index && ::memcmp(_Iv.data(), _Other._Iv.data(), iv::size) == 0
+                    && ::memcmp(_Check.data(), _Other._Check.data(), key_check::size) == 0;
+            }
+        };
+
+        struct _Entry_key_hash {
+            size_t operator()(const _Entry_key& _Key) const noexcept {
+                uint64_t _File; // the IV is random, its leading bytes are enough to tell the files apart
+                ::memcpy(&_File, _Key._Iv.data(), sizeof(_File));
+                return static_cast<size_t>(_File * 0x9E37'79B9'7F4A'7C15ULL ^ _Key._Index);
+            }
+        };
+
+        struct _Entry {
+            _Entry_key _Key                = {};
+            size_t _Size                   = 0;
+            ::std::unique_ptr<byte_t[]> _Data;
+
+            ~_Entry() noexcept; // wipes the plaintext
+        };
+
+        // copies a part of the cached chunk, returns false if the chunk is not cached
+        bool _Copy(const _Entry_key& _Key, const size_t _Off, byte_t* const _Buf, const size_t _Count) noexcept;
+
+        // checks if the chunk is cached without touching the counters
+        bool _Contains(const _Entry_key& _Key) noexcept;
+
+        // caches a copy of the chunk, evicts the least recently used chunks if necessary
+        void _Insert(const _Entry_key& _Key, const byte_t* const _Data, const size_t _Size) noexcept;
+
+        // counts the chunk loaded ahead of a sequential reader
+        void _Count_prefetch() noexcept;
+
+        // evicts the least recently used chunks until the cache takes at most _Size bytes
+        void _Evict(const size_t _Size) noexcept;
+
+        using _Entry_list = ::std::list<_Entry>;
+
+        mutable ::std::mutex _Mymtx;
+        _Entry_list _Mylist; // the most recently used chunk first
+        ::std::unordered_map<_Entry_key, _Entry_list::iterator, _Entry_key_hash> _Mymap;
+        size_t _Mycapacity;
+        size_t _Mysize;
+        size_t _Myreadahead;
+        ::std::atomic<uint64_t> _Myhits;
+        ::std::atomic<uint64_t> _Mymisses;
+        ::std::atomic<uint64_t> _Myprefetches;
+    };
+} // namespace mjx
+
+#endif // _EFC_CHUNK_CACHE_HPP_
\ No newline at end of file
@@ -0,0 +1,333 @@
+// chunked_file_encryption_engine.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <efc/chunked_file_encryption_engine.hpp>
+#include <efc/encryption_engine_pool.hpp>
+#include <efc/impl/buffer_pool.hpp>
+#include <efc/impl/chunked_file_encryption_engine.hpp>
+#include <efc/impl/file_io.hpp>
+#include <efc/impl/parallel.hpp>
+#include <memory>
+#include <mutex>
+
+namespace mjx {
+    namespace efc_impl {
+        inline encryption_engine_pool& _Chunk_engines() noexcept {
+            // Note: The workers of every file share the engines, so the contexts are allocated only once.
+            //       A worker that gets the engine of the previous worker on the same file keeps its key schedule.
+            static encryption_engine_pool _Pool;
+            return _Pool;
+        }
+
+        inline void _Encrypt_chunks(_Chunk_job& _Job) noexcept {
+            // Note: The buffer holds the chunk followed by its tag, the padding up to the sector size
+            //       is zeroed before every write in aligned mode.
+            const size_t _Buf_size = static_cast<size_t>(_Job._Layout._Chunk_size) + _Job._Layout._Tag_space;
+            _Buffer_pool _Pool;
+            if (!_Pool._Init(1, _Job._Io_size(_Buf_size))) {
+                _Job._Failed = true;
+                return;
+            }
+
+            byte_t* const _Buf = _Pool._Get(0);
+            pooled_encryption_engine _Pooled = _Chunk_engines().acquire();
+            if (!_Pooled.valid()) {
+                _Job._Failed = true;
+                return;
+            }
+
+            encryption_engine& _Engine = _Pooled.get();
+            authentication_tag _Tag;
+            uint64_t _Index;
+            while (_Job._Claim(_Index)) {
+                const size_t _Size = _Job._Layout._Plaintext_size_of(_Index);
+                const iv& _Iv      = make_chunk_iv(_Job._Iv, _Index, _Index == _Job._Layout._Count - 1);
+                if (!_Read_at_least(_Job._Src, _Job._Src_off + _Job._Layout._Plaintext_offset_of(_Index),
+                    _Buf, _Job._Io_size(_Size), _Size) || !_Engine.setup_encryption(_Job._Key, _Iv)
+                    || !_Engine.encrypt(_Buf, _Size, _Buf) || !_Engine.complete(_Tag)) {
+                    _Job._Failed = true;
+                    return;
+                }
+
+                ::memcpy(_Buf + _Size, _Tag.data(), authentication_tag::size); // append the tag
+                const size_t _Stored_size = _Size + authentication_tag::size;
+                const size_t _Write_size  = _Job._Io_size(_Stored_size);
+                ::memset(_Buf + _Stored_size, 0, _Write_size - _Stored_size);
+                if (!_Write_at(_Job._Dest, _Job._Dest_off + _Job._Layout._Encrypted_offset_of(_Index),
+                    _Buf, _Write_size)) {
+                    _Job._Failed = true;
+                    return;
+                }
+            }
+        }
+
+        inline void _Decrypt_chunks(_Chunk_job& _Job) noexcept {
+            const size_t _Buf_size = static_cast<size_t>(_Job._Layout._Chunk_size) + _Job._Layout._Tag_space;
+            _Buffer_pool _Pool;
+            if (!_Pool._Init(1, _Job._Io_size(_Buf_size))) {
+                _Job._Failed = true;
+                return;
+            }
+
+            byte_t* const _Buf = _Pool._Get(0);
+            pooled_encryption_engine _Pooled = _Chunk_engines().acquire();
+            if (!_Pooled.valid()) {
+                _Job._Failed = true;
+                return;
+            }
+
+            encryption_engine& _Engine = _Pooled.get();
+            uint64_t _Index;
+            while (_Job._Claim(_Index)) {
+                if (!_Read_chunk(_Job._Src, _Job._Src_off, _Job._Layout, _Index, _Job._Aligned, _Buf)) {
+                    _Job._Failed = true;
+                    return;
+                }
+
+                if (!_Open_chunk(_Engine, _Job._Key, _Job._Iv, _Job._Layout, _Index, _Buf)) {
+                    _Job._Failed = true; // the chunk has been modified or the key is invalid
+                    return;
+                }
+
+                const size_t _Size       = _Job._Layout._Plaintext_size_of(_Index);
+                const size_t _Write_size = _Job._Io_size(_Size);
+                ::memset(_Buf + _Size, 0, _Write_size - _Size);
+                if (!_Write_at(_Job._Dest, _Job._Dest_off + _Job._Layout._Plaintext_offset_of(_Index),
+                    _Buf, _Write_size)) {
+                    _Job._Failed = true;
+                    return;
+                }
+            }
+        }
+
+        inline bool _Run_chunk_job(
+            _Chunk_job& _Job, void (*const _Worker)(_Chunk_job&) noexcept, const size_t _Threads) noexcept {
+            auto _Func = [&_Job, _Worker](size_t) noexcept {
+                _Worker(_Job);
+            };
+            if (!_Run_in_parallel(static_cast<size_t>(
+                (::std::min)(static_cast<uint64_t>(_Threads), _Job._Layout._Count)), _Func)) {
+                _Job._Failed = true;
+            }
+
+            return !_Job._Failed;
+        }
+
+        struct _Chunk_helpers { // shared with the helper tasks, which may start after the job is over
+            ::std::mutex _Mtx;
+            ::std::condition_variable _Cv; // signaled when the last active helper leaves a closed job
+            size_t _Active = 0;
+            bool _Closed   = false;
+        };
+
+        inline bool _Run_chunk_job(_Chunk_job& _Job, void (*const _Worker)(_Chunk_job&) noexcept,
+            work_stealing_scheduler& _Scheduler) noexcept {
+            ::std::shared_ptr<_Chunk_helpers> _Helpers;
+            try {
+                _Helpers = ::std::make_shared<_Chunk_helpers>();
+            } catch (...) {
+                return false;
+            }
+
+            // Note: A helper either sees the job closed and leaves it untouched, or it is counted
+            //       as active before the job is closed, in which case the job waits for it.
+            const size_t _Count = static_cast<size_t>(
+                (::std::min)(static_cast<uint64_t>(_Scheduler.worker_count()), _Job._Layout._Count));
+            for (size_t _Idx = 1; _Idx < _Count; ++_Idx) {
+                if (!_Scheduler.submit([_Helpers, &_Job, _Worker]() noexcept {
+                    {
+                        ::std::lock_guard<::std::mutex> _Guard(_Helpers->_Mtx);
+                        if (_Helpers->_Closed) { // the job may no longer exist
+                            return;
+                        }
+
+                        ++_Helpers->_Active;
+                    }
+
+                    if (_Job._Has_work()) {
+                        _Worker(_Job);
+                    }
+
+                    ::std::lock_guard<::std::mutex> _Guard(_Helpers->_Mtx);
+                    if (--_Helpers->_Active == 0 && _Helpers->_Closed) {
+                        _Helpers->_Cv.notify_one();
+                    }
+                })) {
+                    break; // not an error, fewer helpers will do
+                }
+            }
+
+            _Worker(_Job); // the calling thread takes part as well
+            {
+                // Note: The helpers still processing their last chunks are waited for without spinning,
+                //       so that the core is left to the other tasks of the scheduler.
+                ::std::unique_lock<::std::mutex> _Lock(_Helpers->_Mtx);
+                _Helpers->_Closed = true;
+                _Helpers->_Cv.wait(_Lock, [&_Helpers] { return _Helpers->_Active == 0; });
+            }
+
+            return !_Job._Failed;
+        }
+
+        inline bool _Run_chunk_job(_Chunk_job& _Job, void (*const _Worker)(_Chunk_job&) noexcept,
+            const size_t _Threads, work_stealing_scheduler* const _Scheduler) noexcept {
+            return _Scheduler ? _Run_chunk_job(_Job, _Worker, *_Scheduler) : _Run_chunk_job(_Job, _Worker, _Threads);
+        }
+
+        // the amount of the source file loaded into the system cache by the preparation (8 MiB)
+        inline constexpr uint64_t _Warm_up_size = 8388608;
+
+        inline void _Warm_up_source(const file& _File, const uint64_t _Off, const uint64_t _Size) noexcept {
+            // Note: The data is read and discarded, so that the first chunks are served from the system cache
+            //       once the key is known. It is only a hint, the errors are reported by the actual reads.
+            const size_t _Buf_size = chunked_file_encryption_engine::default_chunk_size;
+            _Buffer_pool _Pool;
+            if (!_Pool._Init(1, _Buf_size)) {
+                return;
+            }
+
+            byte_t* const _Buf  = _Pool._Get(0);
+            const uint64_t _End = _Off + (::std::min)(_Size, _Warm_up_size);
+            for (uint64_t _Pos = _Off; _Pos < _End; _Pos += _Buf_size) {
+                const size_t _Count = static_cast<size_t>((::std::min)(uint64_t{_Buf_size}, _End - _Pos));
+                if (!_Read_at_least(_File, _Pos, _Buf, _Count, _Count)) {
+                    break;
+                }
+            }
+        }
+    } // namespace efc_impl
+
+    iv make_chunk_iv(const iv& _Iv, const uint64_t _Index, const bool _Final) noexcept {
+        iv _Chunk_iv   = _Iv;
+        byte_t* _Bytes = _Chunk_iv.data();
+        for (size_t _Idx = 0; _Idx < sizeof(uint64_t); ++_Idx) { // XOR the big-endian index into the IV
+            _Bytes[efc_impl::_Chunk_index_offset + _Idx] ^= static_cast<byte_t>(_Index >> (56 - 8 * _Idx));
+        }
+
+        if (_Final) {
+            _Bytes[efc_impl::_Final_flag_offset] ^= 0x01;
+        }
+
+        return _Chunk_iv;
+    }
+
+    chunked_file_encryption_engine::chunked_file_encryption_engine(
+        file& _Src_file, file& _Dest_file, const size_t _Threads) noexcept
+        : _Mysrc(_Src_file), _Mydest(_Dest_file),
+        _Mythreads(_Threads != 0 ? _Threads : efc_impl::_Default_thread_count()), _Myscheduler(nullptr) {}
+
+    chunked_file_encryption_engine::chunked_file_encryption_engine(
+        file& _Src_file, file& _Dest_file, work_stealing_scheduler& _Scheduler) noexcept
+        : _Mysrc(_Src_file), _Mydest(_Dest_file), _Mythreads(_Scheduler.worker_count()), _Myscheduler(&_Scheduler) {}
+
+    chunked_file_encryption_engine::~chunked_file_encryption_engine() noexcept {}
+
+    bool chunked_file_encryption_engine::is_valid_chunk_size(const uint32_t _Size, const uint32_t _Features) noexcept {
+        if ((_Features & file_feature::aligned) != 0 && _Size % efc_impl::_Sector_size != 0) {
+            return false; // the chunks would not be aligned
+        }
+
+        return _Size >= min_chunk_size && _Size <= max_chunk_size;
+    }
+
+    bool chunked_file_encryption_engine::prepare_encryption(const file_metadata& _Meta) noexcept {
+        if (_Meta.signature.format() != file_format::chunked
+            || !is_valid_chunk_size(_Meta.chunk_size, _Meta.features)) {
+            return false;
+        }
+
+        const efc_impl::_Chunk_layout _Layout =
+            efc_impl::_Layout_from_plaintext(_Mysrc.size(), _Meta.chunk_size, _Meta.features);
+        if (!_Mydest.resize(metadata_size(_Meta) + _Layout._Encrypted_size())) {
+            return false;
+        }
+
+        if ((_Meta.features & file_feature::aligned) == 0) { // unbuffered reads bypass the system cache
+            efc_impl::_Warm_up_source(_Mysrc, 0, _Layout._Plaintext_size);
+        }
+
+        return true;
+    }
+
+    bool chunked_file_encryption_engine::prepare_decryption(const file_metadata& _Meta) noexcept {
+        if (_Meta.signature.format() != file_format::chunked
+            || !is_valid_chunk_size(_Meta.chunk_size, _Meta.features)) {
+            return false;
+        }
+
+        const uint64_t _Header_size = metadata_size(_Meta);
+        const uint64_t _Src_size    = _Mysrc.size();
+        efc_impl::_Chunk_layout _Layout;
+        if (_Src_size < _Header_size
+            || !efc_impl::_Layout_from_encrypted(
+                _Src_size - _Header_size, _Meta.chunk_size, _Meta.features, _Layout)) {
+            return false;
+        }
+
+        if (!_Mydest.resize(_Layout._Plaintext_size)) {
+            return false;
+        }
+
+        if ((_Meta.features & file_feature::aligned) == 0) { // unbuffered reads bypass the system cache
+            efc_impl::_Warm_up_source(_Mysrc, _Header_size, _Src_size - _Header_size);
+        }
+
+        return true;
+    }
+
+    bool chunked_file_encryption_engine::encrypt(const key& _Key, const file_metadata& _Meta) noexcept {
+        if (_Meta.signature.format() != file_format::chunked
+            || !is_valid_chunk_size(_Meta.chunk_size, _Meta.features)) {
+            return false;
+        }
+
+        const uint64_t _Header_size           = metadata_size(_Meta);
+        const efc_impl::_Chunk_layout _Layout =
+            efc_impl::_Layout_from_plaintext(_Mysrc.size(), _Meta.chunk_size, _Meta.features);
+        const uint64_t _Dest_size             = _Header_size + _Layout._Encrypted_size();
+        if (!_Mydest.resize(_Dest_size)) { // preallocate the destination file
+            return false;
+        }
+
+        const bool _Aligned = (_Meta.features & file_feature::aligned) != 0;
+        efc_impl::_Chunk_job _Job(_Mysrc, _Mydest, _Key, _Meta.iv, _Layout, 0, _Header_size, _Aligned);
+        if (!efc_impl::_Run_chunk_job(_Job, &efc_impl::_Encrypt_chunks, _Mythreads, _Myscheduler)) {
+            return false;
+        }
+
+        return !_Aligned || _Mydest.resize(_Dest_size); // cut the padding of the last chunk
+    }
+
+    bool chunked_file_encryption_engine::decrypt(const key& _Key, const file_metadata& _Meta) noexcept {
+        if (_Meta.signature.format() != file_format::chunked
+            || !is_valid_chunk_size(_Meta.chunk_size, _Meta.features)) {
+            return false;
+        }
+
+        const uint64_t _Header_size = metadata_size(_Meta);
+        const uint64_t _Src_size    = _Mysrc.size();
+        efc_impl::_Chunk_layout _Layout;
+        if (_Src_size < _Header_size
+            || !efc_impl::_Layout_from_encrypted(
+                _Src_size - _Header_size, _Meta.chunk_size, _Meta.features, _Layout)) {
+            return false;
+        }
+
+        if (!_Mydest.resize(_Layout._Plaintext_size)) { // preallocate the destination file
+            return false;
+        }
+
+        const bool _Aligned = (_Meta.features & file_feature::aligned) != 0;
+        efc_impl::_Chunk_job _Job(_Mysrc, _Mydest, _Key, _Meta.iv, _Layout, _Header_size, 0, _Aligned);
+        if (!efc_impl::_Run_chunk_job(_Job, &efc_impl::_Decrypt_chunks, _Mythreads, _Myscheduler)) {
+            return false;
+        }
+
+        return !_Aligned || _Mydest.resize(_Layout._Plaintext_size); // cut the padding of the last chunk
+    }
+} // namespace mjx
\ No newline at end of file
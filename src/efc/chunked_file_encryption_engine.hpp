@@ -0,0 +1,64 @@
+// chunked_file_encryption_engine.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_CHUNKED_FILE_ENCRYPTION_ENGINE_HPP_
+#define _EFC_CHUNKED_FILE_ENCRYPTION_ENGINE_HPP_
+#include <cstdint>
+#include <efc/encryption_engine.hpp>
+#include <efc/file_encryption_engine.hpp>
+#include <efc/work_stealing_scheduler.hpp>
+#include <mjfs/file.hpp>
+
+namespace mjx {
+    // Note: The chunked format splits the plaintext into fixed-size chunks, each sealed on its own
+    //       with AES-256-GCM. The nonce of each chunk is derived from the file IV, the chunk index
+    //       and a final-chunk flag, so chunks cannot be reordered, dropped or truncated unnoticed.
+    //       Every stored chunk is followed by its authentication tag. In the aligned format,
+    //       the header and every tag but the last one are zero-padded to the sector size.
+    iv make_chunk_iv(const iv& _Iv, const uint64_t _Index, const bool _Final) noexcept;
+
+    class chunked_file_encryption_engine { // multi-threaded engine for the chunked format
+    public:
+        // uses as many threads as there are hardware threads if _Threads is 0
+        chunked_file_encryption_engine(file& _Src_file, file& _Dest_file, const size_t _Threads = 0) noexcept;
+
+        // Note: The chunks are processed by the calling thread and the idle workers of the scheduler,
+        //       which steal them as subtasks, so one large file does not hold up the other tasks.
+        chunked_file_encryption_engine(file& _Src_file, file& _Dest_file, work_stealing_scheduler& _Scheduler) noexcept;
+        ~chunked_file_encryption_engine() noexcept;
+
+        chunked_file_encryption_engine(const chunked_file_encryption_engine&)            = delete;
+        chunked_file_encryption_engine& operator=(const chunked_file_encryption_engine&) = delete;
+
+        static constexpr uint32_t min_chunk_size     = 4096; // 4 KiB
+        static constexpr uint32_t max_chunk_size     = 67108864; // 64 MiB
+        static constexpr uint32_t default_chunk_size = 1048576; // 1 MiB
+
+        // checks if the chunk size is supported, the aligned format requires a multiple of the sector size
+        static bool is_valid_chunk_size(const uint32_t _Size, const uint32_t _Features = 0) noexcept;
+
+        // Note: Preallocates the destination file and loads the first chunks of the source file
+        //       into the system cache. Neither needs the key, so the preparation can run while
+        //       the key is being derived. It is optional, the encryption and the decryption
+        //       preallocate the destination file anyway.
+        bool prepare_encryption(const file_metadata& _Meta) noexcept;
+        bool prepare_decryption(const file_metadata& _Meta) noexcept;
+
+        // encrypts the file, the encrypted data is written right after the metadata
+        bool encrypt(const key& _Key, const file_metadata& _Meta) noexcept;
+
+        // decrypts the file, the encrypted data is read right after the metadata
+        bool decrypt(const key& _Key, const file_metadata& _Meta) noexcept;
+
+    private:
+        file& _Mysrc;
+        file& _Mydest;
+        size_t _Mythreads;
+        work_stealing_scheduler* _Myscheduler; // null when the engine uses its own threads
+    };
+} // namespace mjx
+
+#endif // _EFC_CHUNKED_FILE_ENCRYPTION_ENGINE_HPP_
\ No newline at end of file
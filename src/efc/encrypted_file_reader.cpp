@@ -0,0 +1,164 @@
+// encrypted_file_reader.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <algorithm>
+#include <cstring>
+#include <efc/chunked_file_encryption_engine.hpp>
+#include <efc/encrypted_file_reader.hpp>
+#include <efc/impl/buffer_pool.hpp>
+#include <efc/impl/chunk_prefetcher.hpp>
+#include <efc/impl/chunked_file_encryption_engine.hpp>
+#include <new>
+
+namespace mjx {
+    namespace efc_impl {
+        inline bool _Is_aligned_format(const file_metadata& _Meta) noexcept {
+            return (_Meta.features & file_feature::aligned) != 0;
+        }
+
+        inline _Chunk_layout _Reader_layout(
+            const file_metadata& _Meta, const uint64_t _Count, const uint64_t _Size) noexcept {
+            return _Chunk_layout{_Count, _Size, _Meta.chunk_size, _Tag_space_of(_Meta.features)};
+        }
+    } // namespace efc_impl
+
+    encrypted_file_reader::encrypted_file_reader(
+        file& _File, const key& _Key, const file_metadata& _Meta, chunk_cache* const _Cache) noexcept
+        : _Myfile(_File), _Mykey(_Key), _Mymeta(_Meta), _Myheader_size(0), _Mychunk_count(0), _Mysize(0),
+        _Myengine(), _Mybuf(), _Mycache(_Cache), _Mycheck(),
+        _Mylast_index(static_cast<uint64_t>(-1)), _Myprefetcher() {
+        if (_Meta.signature.format() != file_format::chunked
+            || !chunked_file_encryption_engine::is_valid_chunk_size(_Meta.chunk_size, _Meta.features)) {
+            return;
+        }
+
+        if ((_Meta.features & file_feature::key_check) != 0 && !verify_key_check(_Key, _Meta.key_check)) {
+            return; // wrong key, no chunk would be verified
+        }
+
+        _Myheader_size            = metadata_size(_Meta);
+        const uint64_t _File_size = _File.size();
+        efc_impl::_Chunk_layout _Layout;
+        if (_File_size < _Myheader_size || !efc_impl::_Layout_from_encrypted(
+            _File_size - _Myheader_size, _Meta.chunk_size, _Meta.features, _Layout)) {
+            return; // the file has been truncated
+        }
+
+        _Mybuf.reset(new (::std::nothrow) efc_impl::_Buffer_pool);
+        if (!_Mybuf || !_Mybuf->_Init(1, efc_impl::_Io_size_of(static_cast<size_t>(_Layout._Chunk_size)
+            + _Layout._Tag_space, efc_impl::_Is_aligned_format(_Meta)))) {
+            _Mybuf.reset();
+            return;
+        }
+
+        if (_Cache) {
+            _Mycheck = compute_key_check(_Key);
+            if (!_Mycheck.valid()) { // not an error, the chunks will not be cached
+                _Mycache = nullptr;
+            }
+        }
+
+        _Mychunk_count = _Layout._Count;
+        _Mysize        = _Layout._Plaintext_size;
+    }
+
+    encrypted_file_reader::~encrypted_file_reader() noexcept {
+        _Myprefetcher.reset(); // stop the background thread before the file is closed
+    }
+
+    bool encrypted_file_reader::is_open() const noexcept {
+        return _Mybuf != nullptr;
+    }
+
+    uint64_t encrypted_file_reader::size() const noexcept {
+        return _Mysize;
+    }
+
+    const byte_t* encrypted_file_reader::_Load_chunk(const uint64_t _Index) noexcept {
+        const efc_impl::_Chunk_layout& _Layout = efc_impl::_Reader_layout(_Mymeta, _Mychunk_count, _Mysize);
+        byte_t* const _Buf                     = _Mybuf->_Get(0);
+        if (!efc_impl::_Read_chunk(
+            _Myfile, _Myheader_size, _Layout, _Index, efc_impl::_Is_aligned_format(_Mymeta), _Buf)) {
+            return nullptr;
+        }
+
+        if (!efc_impl::_Open_chunk(_Myengine, _Mykey, _Mymeta.iv, _Layout, _Index, _Buf)) {
+            return nullptr; // the chunk has been modified or the key is invalid
+        }
+
+        return _Buf;
+    }
+
+    bool encrypted_file_reader::_Copy_chunk(
+        const uint64_t _Index, const size_t _Off, byte_t* const _Buf, const size_t _Count) noexcept {
+        if (_Mycache) {
+            _Read_ahead(_Index);
+            if (_Mycache->_Copy(chunk_cache::_Entry_key{_Mymeta.iv, _Mycheck, _Index}, _Off, _Buf, _Count)) {
+                return true;
+            }
+        }
+
+        const byte_t* const _Plaintext = _Load_chunk(_Index);
+        if (!_Plaintext) {
+            return false;
+        }
+
+        ::memcpy(_Buf, _Plaintext + _Off, _Count);
+        if (_Mycache) {
+            _Mycache->_Insert(chunk_cache::_Entry_key{_Mymeta.iv, _Mycheck, _Index}, _Plaintext,
+                efc_impl::_Reader_layout(_Mymeta, _Mychunk_count, _Mysize)._Plaintext_size_of(_Index));
+        }
+
+        return true;
+    }
+
+    void encrypted_file_reader::_Read_ahead(const uint64_t _Index) noexcept {
+        // Note: Moving to the next chunk is considered a sequential access, staying within the same chunk
+        //       or jumping elsewhere is not. Reading the first chunk counts as a sequential access.
+        const bool _Sequential = _Index == _Mylast_index + 1;
+        _Mylast_index          = _Index;
+        if (!_Sequential || _Mycache->readahead() == 0 || _Index + 1 >= _Mychunk_count) {
+            return;
+        }
+
+        if (!_Myprefetcher) {
+            _Myprefetcher.reset(new (::std::nothrow) efc_impl::_Chunk_prefetcher(*_Mycache, _Mycheck, _Myfile,
+                _Mykey, _Mymeta.iv, efc_impl::_Reader_layout(_Mymeta, _Mychunk_count, _Mysize), _Myheader_size,
+                efc_impl::_Is_aligned_format(_Mymeta)));
+            if (_Myprefetcher && !_Myprefetcher->_Start()) {
+                _Myprefetcher.reset();
+            }
+
+            if (!_Myprefetcher) { // not an error, the chunks will be loaded on demand
+                return;
+            }
+        }
+
+        _Myprefetcher->_Request(_Index + 1, _Mycache->readahead());
+    }
+
+    bool encrypted_file_reader::read_at(const uint64_t _Off, byte_t* const _Buf, const size_t _Count) noexcept {
+        if (!is_open() || _Off > _Mysize || _Count > _Mysize - _Off) { // the range exceeds the plaintext
+            return false;
+        }
+
+        const uint64_t _Chunk_size = _Mymeta.chunk_size;
+        size_t _Copied             = 0;
+        while (_Copied < _Count) {
+            const uint64_t _Pos            = _Off + _Copied;
+            const uint64_t _Index          = _Pos / _Chunk_size;
+            const size_t _Chunk_off        = static_cast<size_t>(_Pos % _Chunk_size);
+            const size_t _Part             =
+                (::std::min)(static_cast<size_t>(_Chunk_size) - _Chunk_off, _Count - _Copied);
+            if (!_Copy_chunk(_Index, _Chunk_off, _Buf + _Copied, _Part)) {
+                return false;
+            }
+
+            _Copied += _Part;
+        }
+
+        return true;
+    }
+} // namespace mjx
\ No newline at end of file
@@ -0,0 +1,69 @@
+// encrypted_file_reader.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_ENCRYPTED_FILE_READER_HPP_
+#define _EFC_ENCRYPTED_FILE_READER_HPP_
+#include <cstdint>
+#include <efc/chunk_cache.hpp>
+#include <efc/encryption_engine.hpp>
+#include <efc/file_encryption_engine.hpp>
+#include <memory>
+#include <mjfs/file.hpp>
+
+namespace mjx {
+    namespace efc_impl {
+        class _Buffer_pool;
+        class _Chunk_prefetcher;
+    } // namespace efc_impl
+
+    class encrypted_file_reader { // random-access reader of files in the chunked format
+    public:
+        // Note: The metadata must have been loaded from the file. Only the chunks that overlap
+        //       the requested range are read, decrypted and verified. The reader is not thread-safe.
+        //       If a cache is specified, the verified chunks are kept there and sequential reads load
+        //       the following chunks on a background thread. The cache must outlive the reader.
+        encrypted_file_reader(file& _File, const key& _Key, const file_metadata& _Meta,
+            chunk_cache* const _Cache = nullptr) noexcept;
+        ~encrypted_file_reader() noexcept;
+
+        encrypted_file_reader(const encrypted_file_reader&)            = delete;
+        encrypted_file_reader& operator=(const encrypted_file_reader&) = delete;
+
+        // checks if the file is in the chunked format, the key matches it and its size matches the layout
+        bool is_open() const noexcept;
+
+        // returns the size of the plaintext
+        uint64_t size() const noexcept;
+
+        // decrypts _Count bytes starting at _Off, fails if the range exceeds the plaintext or has been modified
+        bool read_at(const uint64_t _Off, byte_t* const _Buf, const size_t _Count) noexcept;
+
+    private:
+        // reads, decrypts and verifies the specified chunk, returns its plaintext
+        const byte_t* _Load_chunk(const uint64_t _Index) noexcept;
+
+        // copies a part of the specified chunk, preferably from the cache
+        bool _Copy_chunk(const uint64_t _Index, const size_t _Off, byte_t* const _Buf, const size_t _Count) noexcept;
+
+        // starts loading the chunks that follow the specified one if the access is sequential
+        void _Read_ahead(const uint64_t _Index) noexcept;
+
+        file& _Myfile;
+        key _Mykey;
+        file_metadata _Mymeta;
+        uint64_t _Myheader_size;
+        uint64_t _Mychunk_count;
+        uint64_t _Mysize;
+        encryption_engine _Myengine;
+        ::std::unique_ptr<efc_impl::_Buffer_pool> _Mybuf; // holds one chunk followed by its tag
+        chunk_cache* _Mycache;
+        key_check _Mycheck; // identifies the key within the cache
+        uint64_t _Mylast_index; // the most recently accessed chunk
+        ::std::unique_ptr<efc_impl::_Chunk_prefetcher> _Myprefetcher;
+    };
+} // namespace mjx
+
+#endif // _EFC_ENCRYPTED_FILE_READER_HPP_
\ No newline at end of file
@@ -3,19 +3,78 @@
 // Copyright (c) Mateusz Jandura. All rights reserved.
 // SPDX-License-Identifier: Apache-2.0
 
+#include <algorithm>
+#include <atomic>
+#include <climits>
 #include <efc/encryption_engine.hpp>
+#include <efc/encryption_engine_pool.hpp>
+#include <efc/impl/parallel.hpp>
 #include <efc/impl/random.hpp>
+#include <efc/impl/secure_memory.hpp>
+#include <memory>
+#include <new>
+#include <numeric>
 #include <openssl/evp.h>
 #include <openssl/ossl_typ.h>
+#include <vector>
 
 namespace mjx {
+    namespace efc_impl {
+        inline const EVP_CIPHER* _Fetch_aes_256_gcm() noexcept {
+            EVP_CIPHER* const _Cipher = ::EVP_CIPHER_fetch(nullptr, "AES-256-GCM", nullptr);
+            return _Cipher ? _Cipher : ::EVP_aes_256_gcm();
+        }
+
+        inline const EVP_CIPHER* _Aes_256_gcm() noexcept {
+            // Note: EVP_aes_256_gcm() makes every initialization look the implementation up in the provider,
+            //       so it is fetched once and kept until the process exits.
+            static const EVP_CIPHER* const _Cipher = _Fetch_aes_256_gcm();
+            return _Cipher;
+        }
+
+        inline constexpr size_t _Min_batch_part_size = 256 * 1024; // the smallest part worth another thread
+
+        inline encryption_engine_pool& _Batch_engines() noexcept {
+            static encryption_engine_pool _Pool; // used by the threads that help the calling engine
+            return _Pool;
+        }
+
+        inline void _Make_batch_order(
+            const batch_record* const _Records, const size_t _Count, ::std::vector<size_t>& _Order) noexcept {
+            // Note: Records that are already grouped by their keys are processed as they are,
+            //       the others are sorted by the key, and the records of the same key keep their order.
+            bool _Sorted = true;
+            for (size_t _Idx = 1; _Idx < _Count; ++_Idx) {
+                if (_Records[_Idx].key_id < _Records[_Idx - 1].key_id) {
+                    _Sorted = false;
+                    break;
+                }
+            }
+
+            if (_Sorted) {
+                return;
+            }
+
+            try {
+                _Order.resize(_Count);
+                ::std::iota(_Order.begin(), _Order.end(), size_t{0});
+                ::std::stable_sort(_Order.begin(), _Order.end(),
+                    [_Records](const size_t _Left, const size_t _Right) noexcept {
+                        return _Records[_Left].key_id < _Records[_Right].key_id;
+                    });
+            } catch (...) { // failed to allocate the order, process the records as they are
+                _Order.clear();
+            }
+        }
+    } // namespace efc_impl
+
     iv generate_iv() noexcept {
         iv _Iv;
         return efc_impl::_Random_bytes(_Iv.data(), iv::size) ? _Iv : iv{};
     }
 
     encryption_engine::encryption_engine() noexcept
-        : _Mystate(_Uninitialized), _Myctx(::EVP_CIPHER_CTX_new()) {}
+        : _Mystate(_Uninitialized), _Mykeyed(false), _Mykey(), _Myctx(::EVP_CIPHER_CTX_new()) {}
 
     encryption_engine::~encryption_engine() noexcept {
         if (_Myctx) {
@@ -52,13 +111,32 @@ namespace mjx {
         }
     }
 
+    bool encryption_engine::_Setup(const key& _Key, const iv& _Iv, const int _Enc) noexcept {
+        // Note: GCM keeps the key schedule when only the IV is set, so a new message with the same key
+        //       skips the key expansion. The direction may change as well.
+        EVP_CIPHER_CTX* const _Ctx = static_cast<EVP_CIPHER_CTX*>(_Myctx);
+        if (_Mykeyed && efc_impl::_Compare_sensitive_data(_Mykey.data(), _Key.data(), key::size)) {
+            if (::EVP_CipherInit_ex(_Ctx, nullptr, nullptr, nullptr, _Iv.data(), _Enc) != 0) {
+                return true;
+            }
+        }
+
+        _Mykeyed = false; // set the key again, either it has changed or the context failed to reuse it
+        if (::EVP_CipherInit_ex(_Ctx, efc_impl::_Aes_256_gcm(), nullptr, _Key.data(), _Iv.data(), _Enc) == 0) {
+            return false;
+        }
+
+        _Mykey   = _Key;
+        _Mykeyed = true;
+        return true;
+    }
+
     bool encryption_engine::setup_encryption(const key& _Key, const iv& _Iv) noexcept {
         if (_Mystate != _Uninitialized) { // engine already initialized, break
             return false;
         }
 
-        if (::EVP_EncryptInit_ex(
-            static_cast<EVP_CIPHER_CTX*>(_Myctx), ::EVP_aes_256_gcm(), nullptr, _Key.data(), _Iv.data()) == 0) {
+        if (!_Setup(_Key, _Iv, 1)) {
             return false;
         }
 
@@ -71,8 +149,7 @@ namespace mjx {
             return false;
         }
 
-        if (::EVP_DecryptInit_ex(
-            static_cast<EVP_CIPHER_CTX*>(_Myctx), ::EVP_aes_256_gcm(), nullptr, _Key.data(), _Iv.data()) == 0) {
+        if (!_Setup(_Key, _Iv, 0)) {
             return false;
         }
 
@@ -105,12 +182,132 @@ namespace mjx {
             return false;
         }
 
-        if (!_Complete(_Tag)) { // failed to complete encryption/decryption
+        // Note: The context is not reset, so that the next setup with the same key keeps its schedule.
+        //       The engine is ready for the next setup even if the tag has not been verified.
+        const bool _Completed = _Complete(_Tag);
+        _Mystate              = _Uninitialized; // reset engine state
+        return _Completed;
+    }
+
+    void encryption_engine::cancel() noexcept {
+        _Mystate = _Uninitialized; // the next setup sets a new IV, which discards the current state
+    }
+
+    void encryption_engine::clear_key() noexcept {
+        _Mystate = _Uninitialized;
+        _Mykeyed = false;
+        _Mykey.reset();
+        if (_Myctx) { // wipes the key schedule, the next setup sets the cipher and the key again
+            ::EVP_CIPHER_CTX_reset(static_cast<EVP_CIPHER_CTX*>(_Myctx));
+        }
+    }
+
+    bool encryption_engine::_Seal_record(const key& _Key, batch_record& _Record) noexcept {
+        EVP_CIPHER_CTX* const _Ctx = static_cast<EVP_CIPHER_CTX*>(_Myctx);
+        int _Unused                = 0; // number of encrypted bytes (unused)
+        return _Setup(_Key, _Record.iv, 1) && ::EVP_EncryptUpdate(_Ctx, _Record.output, &_Unused,
+            _Record.input, static_cast<int>(_Record.size)) != 0 && ::EVP_EncryptFinal_ex(_Ctx, nullptr, &_Unused) != 0
+            && _Get_tag(_Record.tag);
+    }
+
+    bool encryption_engine::_Open_record(const key& _Key, batch_record& _Record) noexcept {
+        EVP_CIPHER_CTX* const _Ctx = static_cast<EVP_CIPHER_CTX*>(_Myctx);
+        int _Unused                = 0; // number of decrypted bytes (unused)
+        return _Setup(_Key, _Record.iv, 0) && ::EVP_DecryptUpdate(_Ctx, _Record.output, &_Unused,
+            _Record.input, static_cast<int>(_Record.size)) != 0 && _Set_tag(_Record.tag)
+            && ::EVP_DecryptFinal_ex(_Ctx, nullptr, &_Unused) != 0;
+    }
+
+    bool encryption_engine::_Process_batch_part(const key* const _Keys, const size_t _Key_count,
+        batch_record* const _Records, const size_t* const _Order, const size_t _First, const size_t _Last,
+        const bool _Seal) noexcept {
+        bool _Succeeded = true;
+        for (size_t _Idx = _First; _Idx < _Last; ++_Idx) {
+            batch_record& _Record = _Records[_Order ? _Order[_Idx] : _Idx];
+            if (_Record.key_id >= _Key_count || _Record.size > static_cast<size_t>(INT_MAX)) {
+                _Record.failed = true;
+            } else if (_Seal) {
+                _Record.failed = !_Seal_record(_Keys[_Record.key_id], _Record);
+            } else {
+                _Record.failed = !_Open_record(_Keys[_Record.key_id], _Record);
+            }
+
+            if (_Record.failed) {
+                if (!_Seal && _Record.output) { // the output may hold unverified plaintext
+                    efc_impl::_Wipe_memory(_Record.output, _Record.size);
+                }
+
+                _Succeeded = false;
+            }
+        }
+
+        return _Succeeded;
+    }
+
+    bool encryption_engine::_Process_batch(const key* const _Keys, const size_t _Key_count,
+        batch_record* const _Records, const size_t _Count, const size_t _Threads, const bool _Seal) noexcept {
+        if (_Mystate != _Uninitialized) { // engine in the middle of an encryption or decryption, break
             return false;
         }
 
-        ::EVP_CIPHER_CTX_reset(static_cast<EVP_CIPHER_CTX*>(_Myctx)); // reset engine context
-        _Mystate = _Uninitialized; // reset engine state
-        return true;
+        ::std::vector<size_t> _Order;
+        efc_impl::_Make_batch_order(_Records, _Count, _Order);
+        const size_t* const _Order_ptr = !_Order.empty() ? _Order.data() : nullptr;
+        size_t _Total_size             = 0;
+        for (size_t _Idx = 0; _Idx < _Count; ++_Idx) {
+            _Total_size += _Records[_Idx].size;
+        }
+
+        // Note: Every part is a contiguous range of the ordered records, so each engine sets only a few keys.
+        const size_t _Max_parts = (::std::min)(
+            _Threads != 0 ? _Threads : efc_impl::_Default_thread_count(), _Total_size / efc_impl::_Min_batch_part_size);
+        const size_t _Parts = (::std::max)((::std::min)(_Max_parts, _Count), size_t{1});
+        if (_Parts == 1) {
+            return _Process_batch_part(_Keys, _Key_count, _Records, _Order_ptr, 0, _Count, _Seal);
+        }
+
+        ::std::unique_ptr<bool[]> _Done(new (::std::nothrow) bool[_Parts]());
+        if (!_Done) { // failed to allocate the flags, process the batch on the calling thread
+            return _Process_batch_part(_Keys, _Key_count, _Records, _Order_ptr, 0, _Count, _Seal);
+        }
+
+        ::std::atomic<bool> _Succeeded(true);
+        auto _Process_part = [&](const size_t _Part, encryption_engine& _Engine) noexcept {
+            if (!_Engine._Process_batch_part(_Keys, _Key_count, _Records, _Order_ptr,
+                _Count * _Part / _Parts, _Count * (_Part + 1) / _Parts, _Seal)) {
+                _Succeeded.store(false, ::std::memory_order_relaxed);
+            }
+
+            _Done[_Part] = true;
+        };
+        auto _Func = [&](const size_t _Part) noexcept {
+            if (_Part == 0) { // the calling engine processes the first part
+                _Process_part(0, *this);
+                return;
+            }
+
+            pooled_encryption_engine _Engine = efc_impl::_Batch_engines().acquire();
+            if (_Engine.valid()) {
+                _Process_part(_Part, _Engine.get());
+            }
+        };
+        efc_impl::_Run_in_parallel(_Parts, _Func);
+        for (size_t _Part = 0; _Part < _Parts; ++_Part) { // process the parts no thread has processed
+            if (!_Done[_Part]) {
+                _Process_part(_Part, *this);
+            }
+        }
+
+        return _Succeeded.load(::std::memory_order_relaxed);
+    }
+
+    bool encryption_engine::seal_batch(const key* const _Keys, const size_t _Key_count,
+        batch_record* const _Records, const size_t _Count, const size_t _Threads) noexcept {
+        return _Process_batch(_Keys, _Key_count, _Records, _Count, _Threads, true);
+    }
+
+    bool encryption_engine::open_batch(const key* const _Keys, const size_t _Key_count,
+        batch_record* const _Records, const size_t _Count, const size_t _Threads) noexcept {
+        return _Process_batch(_Keys, _Key_count, _Records, _Count, _Threads, false);
     }
 } // namespace mjx
\ No newline at end of file
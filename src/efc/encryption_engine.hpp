@@ -16,6 +16,16 @@ namespace mjx {
 
     iv generate_iv() noexcept;
 
+    struct batch_record { // a single message of a batch
+        size_t key_id = 0; // the index of the key in the keys of the batch
+        iv iv;
+        const byte_t* input = nullptr;
+        size_t size         = 0;
+        byte_t* output      = nullptr; // may be the same as input
+        authentication_tag tag; // written by seal_batch(), verified by open_batch()
+        bool failed = false; // set by the batch
+    };
+
     class encryption_engine { // default encryption engine
     public:
         encryption_engine() noexcept;
@@ -39,6 +49,25 @@ namespace mjx {
         // completes encryption or decryption
         bool complete(authentication_tag& _Tag) noexcept;
 
+        // abandons the current encryption or decryption, the key is kept for the next one
+        void cancel() noexcept;
+
+        // abandons the current encryption or decryption, wipes the key and its schedule
+        void clear_key() noexcept;
+
+        // Note: The batches process the records grouped by their keys, so that every key is set only once.
+        //       A large batch is split among _Threads engines, 0 means one per processor core.
+        //       The engine must not be in the middle of an encryption or decryption.
+
+        // encrypts every record and writes its tag, returns false if any record has failed
+        bool seal_batch(const key* const _Keys, const size_t _Key_count, batch_record* const _Records,
+            const size_t _Count, const size_t _Threads = 1) noexcept;
+
+        // decrypts and verifies every record, returns false if any record has failed
+        // Note: The output of a record that has failed is wiped, so that no unverified plaintext is left.
+        bool open_batch(const key* const _Keys, const size_t _Key_count, batch_record* const _Records,
+            const size_t _Count, const size_t _Threads = 1) noexcept;
+
     private:
         enum _Internal_state : unsigned char {
             _Uninitialized,
@@ -54,7 +83,25 @@ namespace mjx {
 
         bool _Complete(authentication_tag& _Tag) noexcept;
 
+        // setups the context for the specified direction, the key is set only if it has changed
+        bool _Setup(const key& _Key, const iv& _Iv, const int _Enc) noexcept;
+
+        // encrypts a single record, the state of the engine is not changed
+        bool _Seal_record(const key& _Key, batch_record& _Record) noexcept;
+
+        // decrypts and verifies a single record, the state of the engine is not changed
+        bool _Open_record(const key& _Key, batch_record& _Record) noexcept;
+
+        // processes the records from _First to _Last in the specified order, or as they are if there is none
+        bool _Process_batch_part(const key* const _Keys, const size_t _Key_count, batch_record* const _Records,
+            const size_t* const _Order, const size_t _First, const size_t _Last, const bool _Seal) noexcept;
+
+        bool _Process_batch(const key* const _Keys, const size_t _Key_count, batch_record* const _Records,
+            const size_t _Count, const size_t _Threads, const bool _Seal) noexcept;
+
         _Internal_state _Mystate;
+        bool _Mykeyed; // true if the context holds the key schedule of _Mykey
+        key _Mykey;
         void* _Myctx;
     };
 } // namespace mjx
@@ -0,0 +1,91 @@
+// encryption_engine_pool.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <efc/encryption_engine_pool.hpp>
+#include <new>
+
+namespace mjx {
+    pooled_encryption_engine::pooled_encryption_engine() noexcept : _Mypool(nullptr), _Myengine() {}
+
+    pooled_encryption_engine::pooled_encryption_engine(pooled_encryption_engine&& _Other) noexcept
+        : _Mypool(_Other._Mypool), _Myengine(::std::move(_Other._Myengine)) {
+        _Other._Mypool = nullptr;
+    }
+
+    pooled_encryption_engine::pooled_encryption_engine(
+        encryption_engine_pool* const _Pool, ::std::unique_ptr<encryption_engine>&& _Engine) noexcept
+        : _Mypool(_Pool), _Myengine(::std::move(_Engine)) {}
+
+    pooled_encryption_engine::~pooled_encryption_engine() noexcept {
+        release();
+    }
+
+    pooled_encryption_engine& pooled_encryption_engine::operator=(pooled_encryption_engine&& _Other) noexcept {
+        if (this != &_Other) {
+            release();
+            _Mypool        = _Other._Mypool;
+            _Myengine      = ::std::move(_Other._Myengine);
+            _Other._Mypool = nullptr;
+        }
+
+        return *this;
+    }
+
+    bool pooled_encryption_engine::valid() const noexcept {
+        return _Myengine != nullptr;
+    }
+
+    encryption_engine& pooled_encryption_engine::get() const noexcept {
+        return *_Myengine;
+    }
+
+    encryption_engine* pooled_encryption_engine::operator->() const noexcept {
+        return _Myengine.get();
+    }
+
+    void pooled_encryption_engine::release() noexcept {
+        if (_Myengine) {
+            _Mypool->_Release(::std::move(_Myengine));
+        }
+
+        _Mypool = nullptr;
+    }
+
+    encryption_engine_pool::encryption_engine_pool(const size_t _Max_idle) noexcept
+        : _Mymtx(), _Myidle(), _Mymax_idle(_Max_idle) {}
+
+    encryption_engine_pool::~encryption_engine_pool() noexcept {}
+
+    size_t encryption_engine_pool::idle_count() const noexcept {
+        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+        return _Myidle.size();
+    }
+
+    pooled_encryption_engine encryption_engine_pool::acquire() noexcept {
+        {
+            ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+            if (!_Myidle.empty()) { // reuse the most recently released engine
+                ::std::unique_ptr<encryption_engine> _Engine = ::std::move(_Myidle.back());
+                _Myidle.pop_back();
+                return pooled_encryption_engine(this, ::std::move(_Engine));
+            }
+        }
+
+        // Note: The engine is created without the lock, so that other threads can acquire the idle ones.
+        ::std::unique_ptr<encryption_engine> _Engine(new (::std::nothrow) encryption_engine());
+        return pooled_encryption_engine(this, ::std::move(_Engine));
+    }
+
+    void encryption_engine_pool::_Release(::std::unique_ptr<encryption_engine>&& _Engine) noexcept {
+        _Engine->clear_key(); // the next owner must not inherit the key
+        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+        if (_Myidle.size() < _Mymax_idle) {
+            try {
+                _Myidle.push_back(::std::move(_Engine));
+            } catch (...) { // failed to keep the engine, destroy it
+            }
+        }
+    }
+} // namespace mjx
\ No newline at end of file
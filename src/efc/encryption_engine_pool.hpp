@@ -0,0 +1,82 @@
+// encryption_engine_pool.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_ENCRYPTION_ENGINE_POOL_HPP_
+#define _EFC_ENCRYPTION_ENGINE_POOL_HPP_
+#include <cstddef>
+#include <efc/encryption_engine.hpp>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace mjx {
+    class encryption_engine_pool;
+
+    class pooled_encryption_engine { // an engine that goes back to its pool once destroyed
+    public:
+        pooled_encryption_engine() noexcept;
+        pooled_encryption_engine(pooled_encryption_engine&& _Other) noexcept;
+        ~pooled_encryption_engine() noexcept;
+
+        pooled_encryption_engine& operator=(pooled_encryption_engine&& _Other) noexcept;
+
+        pooled_encryption_engine(const pooled_encryption_engine&)            = delete;
+        pooled_encryption_engine& operator=(const pooled_encryption_engine&) = delete;
+
+        // checks if an engine is held
+        bool valid() const noexcept;
+
+        // returns the held engine
+        encryption_engine& get() const noexcept;
+        encryption_engine* operator->() const noexcept;
+
+        // returns the engine to its pool
+        void release() noexcept;
+
+    private:
+        friend encryption_engine_pool;
+
+        pooled_encryption_engine(
+            encryption_engine_pool* const _Pool, ::std::unique_ptr<encryption_engine>&& _Engine) noexcept;
+
+        encryption_engine_pool* _Mypool;
+        ::std::unique_ptr<encryption_engine> _Myengine;
+    };
+
+    // Note: Creating an engine allocates its context, which the pool keeps. The key and its schedule
+    //       are wiped once an engine is released, so the schedule is reused only while it is held.
+    //       The last released engine is acquired first, since its memory is the most likely to be cached.
+    class encryption_engine_pool { // engines shared by many threads
+    public:
+        static constexpr size_t default_max_idle = 64;
+
+        // _Max_idle is the number of released engines that are kept, the others are destroyed
+        explicit encryption_engine_pool(const size_t _Max_idle = default_max_idle) noexcept;
+        ~encryption_engine_pool() noexcept;
+
+        encryption_engine_pool(const encryption_engine_pool&)            = delete;
+        encryption_engine_pool& operator=(const encryption_engine_pool&) = delete;
+
+        // returns the number of engines that are waiting to be acquired
+        size_t idle_count() const noexcept;
+
+        // takes an idle engine or creates a new one, the result is invalid if no engine could be created
+        // Note: The pool must outlive the acquired engine.
+        pooled_encryption_engine acquire() noexcept;
+
+    private:
+        friend pooled_encryption_engine;
+
+        // keeps the engine for the next acquire() or destroys it if the pool is full
+        void _Release(::std::unique_ptr<encryption_engine>&& _Engine) noexcept;
+
+        mutable ::std::mutex _Mymtx;
+        ::std::vector<::std::unique_ptr<encryption_engine>> _Myidle;
+        size_t _Mymax_idle;
+    };
+} // namespace mjx
+
+#endif // _EFC_ENCRYPTION_ENGINE_POOL_HPP_
\ No newline at end of file
@@ -3,75 +3,225 @@
 // Copyright (c) Mateusz Jandura. All rights reserved.
 // SPDX-License-Identifier: Apache-2.0
 
+#include <algorithm>
 #include <cstring>
+#include <efc/chunked_file_encryption_engine.hpp>
 #include <efc/file_encryption_engine.hpp>
+#include <efc/impl/buffer_pool.hpp>
 #include <efc/impl/file_encryption_engine.hpp>
+#include <efc/impl/mapped_file.hpp>
+#include <efc/impl/overlapped_io.hpp>
+#include <efc/impl/pipeline.hpp>
 
 namespace mjx {
     bool file_signature::is_recognized() const noexcept {
-        return ::memcmp(data, efc_impl::_Well_known_signature, size) == 0;
+        return ::memcmp(data, efc_impl::_Well_known_signature, efc_impl::_Signature_prefix_size) == 0
+            && data[efc_impl::_Signature_prefix_size] <= static_cast<byte_t>(efc_impl::_Latest_file_format);
     }
 
-    file_metadata construct_metadata() noexcept {
+    file_format file_signature::format() const noexcept {
+        return static_cast<file_format>(data[efc_impl::_Signature_prefix_size]);
+    }
+
+    file_metadata construct_metadata(const file_format _Format, const uint32_t _Features) noexcept {
         file_metadata _Meta;
-        ::memcpy(_Meta.signature.data, efc_impl::_Well_known_signature, file_signature::size);
+        ::memcpy(_Meta.signature.data, efc_impl::_Well_known_signature, efc_impl::_Signature_prefix_size);
+        _Meta.signature.data[efc_impl::_Signature_prefix_size] = static_cast<byte_t>(_Format);
         _Meta.salt = generate_salt();
         _Meta.iv   = generate_iv();
+        if (_Format == file_format::chunked) {
+            _Meta.features   = _Features;
+            _Meta.chunk_size = chunked_file_encryption_engine::default_chunk_size;
+            if ((_Features & file_feature::subkey) != 0) {
+                _Meta.key_nonce = generate_key_nonce();
+            }
+
+            if ((_Features & file_feature::kdf_params) != 0) {
+                _Meta.kdf_params = default_key_derivation_params;
+            }
+        }
+
         return _Meta;
     }
     
     file_metadata load_metadata(file_stream& _Stream) noexcept {
-        static constexpr size_t _Raw_size = sizeof(file_metadata);
-        byte_t _Raw[_Raw_size];
-        if (_Stream.read(_Raw, _Raw_size) != _Raw_size) { // incomplete section, break
+        file_metadata _Meta;
+        if (_Stream.read(_Meta.signature.data, file_signature::size) != file_signature::size
+            || !_Meta.signature.is_recognized()) { // incomplete or unknown signature, break
             return file_metadata{};
         }
 
-        file_metadata _Meta;
+        byte_t _Raw[(::std::max)(efc_impl::_Legacy_metadata_size, efc_impl::_Chunked_metadata_size)];
         efc_impl::_Metadata_parser _Parser(_Raw);
-        _Parser._Parse(_Meta.signature.data, file_signature::size);
-        _Parser._Parse(_Meta.tag.data(), authentication_tag::size);
-        _Parser._Parse(_Meta.salt.data(), salt::size);
-        _Parser._Parse(_Meta.iv.data(), iv::size);
+        if (_Meta.signature.format() == file_format::legacy) {
+            if (_Stream.read(_Raw, efc_impl::_Legacy_metadata_size) != efc_impl::_Legacy_metadata_size) {
+                return file_metadata{}; // incomplete section, break
+            }
+
+            _Parser._Parse(_Meta.tag.data(), authentication_tag::size);
+            _Parser._Parse(_Meta.salt.data(), salt::size);
+            _Parser._Parse(_Meta.iv.data(), iv::size);
+        } else {
+            if (_Stream.read(_Raw, efc_impl::_Chunked_metadata_size) != efc_impl::_Chunked_metadata_size) {
+                return file_metadata{}; // incomplete section, break
+            }
+
+            _Parser._Parse_integer(_Meta.features);
+            _Parser._Parse_integer(_Meta.chunk_size);
+            _Parser._Parse(_Meta.salt.data(), salt::size);
+            _Parser._Parse(_Meta.iv.data(), iv::size);
+            if ((_Meta.features & ~efc_impl::_Supported_features) != 0
+                || !chunked_file_encryption_engine::is_valid_chunk_size(_Meta.chunk_size, _Meta.features)) {
+                return file_metadata{}; // unsupported features or invalid chunk size, break
+            }
+
+            if ((_Meta.features & file_feature::subkey) != 0) {
+                if (_Stream.read(_Meta.key_nonce.data(), key_nonce::size) != key_nonce::size) {
+                    return file_metadata{}; // incomplete key nonce, break
+                }
+            }
+
+            if ((_Meta.features & file_feature::kdf_params) != 0) {
+                byte_t _Raw_params[efc_impl::_Kdf_params_size];
+                if (_Stream.read(_Raw_params, efc_impl::_Kdf_params_size) != efc_impl::_Kdf_params_size) {
+                    return file_metadata{}; // incomplete parameters, break
+                }
+
+                efc_impl::_Metadata_parser _Params_parser(_Raw_params);
+                uint32_t _Kdf = 0;
+                _Params_parser._Parse_integer(_Kdf);
+                _Params_parser._Parse_integer(_Meta.kdf_params.memory);
+                _Params_parser._Parse_integer(_Meta.kdf_params.iterations);
+                _Params_parser._Parse_integer(_Meta.kdf_params.lanes);
+                if (_Kdf == efc_impl::_No_kdf) {
+                    if (_Meta.kdf_params.memory != 0 || _Meta.kdf_params.iterations != 0
+                        || _Meta.kdf_params.lanes != 0) {
+                        return file_metadata{}; // unexpected parameters, break
+                    }
+
+                    _Meta.kdf = key_derivation_function::none;
+                } else if (_Kdf != efc_impl::_Argon2id_v13_kdf || !is_valid_key_derivation_params(_Meta.kdf_params)) {
+                    return file_metadata{}; // unknown algorithm or unsupported parameters, break
+                }
+            }
+
+            if ((_Meta.features & file_feature::key_check) != 0) {
+                if (_Stream.read(_Meta.key_check.data(), key_check::size) != key_check::size) {
+                    return file_metadata{}; // incomplete check value, break
+                }
+            }
+
+            if ((_Meta.features & file_feature::aligned) != 0) { // skip the padding
+                // Note: The padding is read rather than skipped, so that the metadata can be loaded
+                //       from non-seekable streams, such as pipes.
+                const size_t _Padding_size = efc_impl::_Aligned_metadata_size
+                    - efc_impl::_Packed_chunked_metadata_size(_Meta.features);
+                byte_t _Padding[efc_impl::_Aligned_metadata_size];
+                if (_Stream.read(_Padding, _Padding_size) != _Padding_size) {
+                    return file_metadata{};
+                }
+            }
+        }
+
         return _Meta;
     }
 
     bool store_metadata(file_stream& _Stream, const file_metadata& _Meta) noexcept {
-        static constexpr size_t _Raw_size = sizeof(file_metadata);
-        byte_t _Raw[_Raw_size];
+        // Note: The aligned header is written at once from an aligned buffer, so that it can be
+        //       written to a file opened for unbuffered I/O.
+        alignas(efc_impl::_Aligned_metadata_size) byte_t _Raw[efc_impl::_Aligned_metadata_size] = {0};
         efc_impl::_Metadata_serializer _Serializer(_Raw);
         _Serializer._Serialize(_Meta.signature.data, file_signature::size);
-        _Serializer._Serialize(_Meta.tag.data(), authentication_tag::size);
+        if (_Meta.signature.format() == file_format::legacy) {
+            _Serializer._Serialize(_Meta.tag.data(), authentication_tag::size);
+        } else {
+            _Serializer._Serialize_integer(_Meta.features);
+            _Serializer._Serialize_integer(_Meta.chunk_size);
+        }
+
         _Serializer._Serialize(_Meta.salt.data(), salt::size);
         _Serializer._Serialize(_Meta.iv.data(), iv::size);
-        return _Stream.write(_Serializer._Begin(), _Raw_size);
+        if (_Meta.signature.format() == file_format::chunked && (_Meta.features & file_feature::subkey) != 0) {
+            _Serializer._Serialize(_Meta.key_nonce.data(), key_nonce::size);
+        }
+
+        if (_Meta.signature.format() == file_format::chunked && (_Meta.features & file_feature::kdf_params) != 0) {
+            const bool _No_kdf = _Meta.kdf == key_derivation_function::none;
+            _Serializer._Serialize_integer(_No_kdf ? efc_impl::_No_kdf : efc_impl::_Argon2id_v13_kdf);
+            _Serializer._Serialize_integer(_No_kdf ? 0 : _Meta.kdf_params.memory);
+            _Serializer._Serialize_integer(_No_kdf ? 0 : _Meta.kdf_params.iterations);
+            _Serializer._Serialize_integer(_No_kdf ? 0 : _Meta.kdf_params.lanes);
+        }
+
+        if (_Meta.signature.format() == file_format::chunked && (_Meta.features & file_feature::key_check) != 0) {
+            _Serializer._Serialize(_Meta.key_check.data(), key_check::size);
+        }
+
+        return _Stream.write(_Serializer._Begin(), metadata_size(_Meta));
+    }
+
+    size_t metadata_size(const file_metadata& _Meta) noexcept {
+        if (_Meta.signature.format() == file_format::chunked && (_Meta.features & file_feature::aligned) != 0) {
+            return efc_impl::_Aligned_metadata_size;
+        }
+
+        return _Meta.signature.format() == file_format::legacy
+            ? file_signature::size + efc_impl::_Legacy_metadata_size
+            : efc_impl::_Packed_chunked_metadata_size(_Meta.features);
     }
 
     file_encryption_engine::file_encryption_engine(file_stream& _Src_stream, file_stream& _Dest_stream,
-        encryption_engine& _Engine) noexcept : _Mysrc(_Src_stream), _Mydest(_Dest_stream), _Myengine(_Engine) {}
+        encryption_engine& _Engine, const file_encryption_options& _Options) noexcept
+        : _Mysrc_owner(), _Mydest_owner(), _Mysrc(_Src_stream), _Mydest(_Dest_stream), _Mysrc_file(nullptr),
+        _Mydest_file(nullptr), _Myengine(_Engine), _Myoptions(_Options) {
+        _Myoptions.chunk_size = ::std::clamp(_Myoptions.chunk_size,
+            file_encryption_options::min_chunk_size, file_encryption_options::max_chunk_size);
+    }
+
+    file_encryption_engine::file_encryption_engine(file& _Src_file, file& _Dest_file, encryption_engine& _Engine,
+        const file_encryption_options& _Options) noexcept : _Mysrc_owner(_Src_file), _Mydest_owner(_Dest_file),
+        _Mysrc(_Mysrc_owner), _Mydest(_Mydest_owner), _Mysrc_file(&_Src_file), _Mydest_file(&_Dest_file),
+        _Myengine(_Engine), _Myoptions(_Options) {
+        _Myoptions.chunk_size = ::std::clamp(_Myoptions.chunk_size,
+            file_encryption_options::min_chunk_size, file_encryption_options::max_chunk_size);
+    }
 
     file_encryption_engine::~file_encryption_engine() noexcept {}
 
-    bool file_encryption_engine::encrypt(const key& _Key, const iv& _Iv, authentication_tag& _Tag) noexcept {
-        if (!_Myengine.setup_encryption(_Key, _Iv)) {
+    template <class _Fn>
+    bool file_encryption_engine::_Process(_Fn& _Func) noexcept {
+        if (_Myoptions.io_mode == file_io_mode::overlapped && _Mysrc_file && _Mydest_file) {
+            return _Run_overlapped(_Func);
+        } else if (_Myoptions.io_mode == file_io_mode::mapped && _Mysrc_file && _Mydest_file) {
+            return _Run_mapped(_Func);
+        } else if (_Myoptions.pipelined) {
+            return _Run_pipeline(_Func);
+        } else {
+            return _Run_sequential(_Func);
+        }
+    }
+
+    template <class _Fn>
+    bool file_encryption_engine::_Run_sequential(_Fn& _Func) noexcept {
+        efc_impl::_Buffer_pool _Pool;
+        if (!_Pool._Init(1, _Myoptions.chunk_size)) {
             return false;
         }
 
-        static constexpr size_t _Buf_size = 4096;
-        byte_t _Rdbuf[_Buf_size];
-        byte_t _Wrbuf[_Buf_size];
+        const size_t _Buf_size = _Pool._Size();
+        byte_t* const _Buf     = _Pool._Get(0); // transformed in place
         size_t _Read;
         for (;;) {
-            _Read = _Mysrc.read(_Rdbuf, _Buf_size);
+            _Read = _Mysrc.read(_Buf, _Buf_size);
             if (_Read == 0) { // no more data, break
                 break;
             }
 
-            if (!_Myengine.encrypt(_Rdbuf, _Read, _Wrbuf)) {
+            if (!_Func(_Buf, _Read, _Buf)) {
                 return false;
             }
 
-            if (!_Mydest.write(_Wrbuf, _Read)) {
+            if (!_Mydest.write(_Buf, _Read)) {
                 return false;
             }
 
@@ -80,37 +230,123 @@ namespace mjx {
             }
         }
 
-        return _Myengine.complete(_Tag);
+        return true;
     }
 
-    bool file_encryption_engine::decrypt(const key& _Key, const iv& _Iv, authentication_tag& _Tag) noexcept {
-        if (!_Myengine.setup_decryption(_Key, _Iv)) {
+    template <class _Fn>
+    bool file_encryption_engine::_Run_pipeline(_Fn& _Func) noexcept {
+        // Note: the buffers are allocated once and recycled, at least two are needed to overlap anything
+        efc_impl::_Buffer_pool _Pool;
+        efc_impl::_Pipeline _Pipe(_Mysrc, _Mydest);
+        if (!_Pool._Init((::std::max)(_Myoptions.pipeline_depth, size_t{2}), _Myoptions.chunk_size)
+            || !_Pipe._Init(_Pool)) {
             return false;
         }
 
-        static constexpr size_t _Buf_size = 4096;
-        byte_t _Rdbuf[_Buf_size];
-        byte_t _Wrbuf[_Buf_size];
-        size_t _Read;
-        for (;;) {
-            _Read = _Mysrc.read(_Rdbuf, _Buf_size);
-            if (_Read == 0) { // no more data, break
-                break;
-            }
+        return _Pipe._Run(_Func);
+    }
+
+    template <class _Fn>
+    bool file_encryption_engine::_Run_overlapped(_Fn& _Func) noexcept {
+        // Note: The data is processed from the current stream positions, just like in the other modes.
+        //       Once done, both positions are moved past the processed data.
+        const uint64_t _Src_off  = _Mysrc.tell();
+        const uint64_t _Dest_off = _Mydest.tell();
+        const uint64_t _Src_size = _Mysrc_file->size();
+        const uint64_t _Size     = _Src_size > _Src_off ? _Src_size - _Src_off : 0;
+        efc_impl::_Buffer_pool _Pool;
+        if (!_Pool._Init((::std::max)(_Myoptions.pipeline_depth, size_t{2}), _Myoptions.chunk_size)) {
+            return false;
+        }
 
-            if (!_Myengine.decrypt(_Rdbuf, _Read, _Wrbuf)) {
+        {
+            efc_impl::_Overlapped_pipeline _Pipe(*_Mysrc_file, _Src_off, _Size, *_Mydest_file, _Dest_off);
+            if (!_Pipe._Init(_Pool) || !_Pipe._Run(_Func)) {
                 return false;
             }
+        }
+
+        return _Mysrc.seek(_Src_off + _Size) && _Mydest.seek(_Dest_off + _Size);
+    }
+
+    template <class _Fn>
+    bool file_encryption_engine::_Run_mapped(_Fn& _Func) noexcept {
+        const uint64_t _Src_off  = _Mysrc.tell();
+        const uint64_t _Dest_off = _Mydest.tell();
+        const uint64_t _Src_size = _Mysrc_file->size();
+        const uint64_t _Size     = _Src_size > _Src_off ? _Src_size - _Src_off : 0;
+        if (_Size == 0) { // nothing to map
+            return true;
+        }
+
+        efc_impl::_Mapped_file _Src_view;
+        efc_impl::_Mapped_file _Dest_view;
+        if (!_Src_view._Map(*_Mysrc_file, _Src_size, false)) {
+            return _Run_sequential(_Func);
+        }
+
+        // Note: The destination must be preallocated, a view cannot extend the file.
+        if (!_Mydest_file->resize(_Dest_off + _Size)) {
+            return false;
+        }
+
+        if (!_Dest_view._Map(*_Mydest_file, _Dest_off + _Size, true)) {
+            return _Mydest.seek(_Dest_off) && _Run_sequential(_Func);
+        }
+
+        // Note: Every chunk is prefetched while the previous one is transformed and flushed
+        //       once it is transformed, so the reads and the writes overlap with the encryption.
+        const size_t _Src_base  = static_cast<size_t>(_Src_off);
+        const size_t _Dest_base = static_cast<size_t>(_Dest_off);
+        const size_t _Total     = static_cast<size_t>(_Size);
+        const size_t _Chunk     = _Myoptions.chunk_size;
+        _Src_view._Prefetch(_Src_base, (::std::min)(_Chunk, _Total));
+        for (size_t _Off = 0; _Off < _Total; _Off += _Chunk) {
+            const size_t _Count = (::std::min)(_Chunk, _Total - _Off);
+            const size_t _Next  = _Off + _Count;
+            if (_Next < _Total) {
+                _Src_view._Prefetch(_Src_base + _Next, (::std::min)(_Chunk, _Total - _Next));
+            }
 
-            if (!_Mydest.write(_Wrbuf, _Read)) {
+            if (!_Func(_Src_view._Data() + _Src_base + _Off, _Count, _Dest_view._Data() + _Dest_base + _Off)) {
                 return false;
             }
 
-            if (_Read < _Buf_size) { // no more data, break
-                break;
+            if (!_Dest_view._Flush(_Dest_base + _Off, _Count)) {
+                return false;
             }
         }
 
+        return _Mysrc.seek(_Src_off + _Size) && _Mydest.seek(_Dest_off + _Size);
+    }
+
+    bool file_encryption_engine::encrypt(const key& _Key, const iv& _Iv, authentication_tag& _Tag) noexcept {
+        if (!_Myengine.setup_encryption(_Key, _Iv)) {
+            return false;
+        }
+
+        auto _Func = [this](const byte_t* const _Data, const size_t _Size, byte_t* const _Buf) noexcept {
+            return _Myengine.encrypt(_Data, _Size, _Buf);
+        };
+        if (!_Process(_Func)) {
+            return false;
+        }
+
+        return _Myengine.complete(_Tag);
+    }
+
+    bool file_encryption_engine::decrypt(const key& _Key, const iv& _Iv, authentication_tag& _Tag) noexcept {
+        if (!_Myengine.setup_decryption(_Key, _Iv)) {
+            return false;
+        }
+
+        auto _Func = [this](const byte_t* const _Data, const size_t _Size, byte_t* const _Buf) noexcept {
+            return _Myengine.decrypt(_Data, _Size, _Buf);
+        };
+        if (!_Process(_Func)) {
+            return false;
+        }
+
         return _Myengine.complete(_Tag);
     }
 } // namespace mjx
\ No newline at end of file
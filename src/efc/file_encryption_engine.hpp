@@ -6,34 +6,98 @@
 #pragma once
 #ifndef _EFC_FILE_ENCRYPTION_ENGINE_HPP_
 #define _EFC_FILE_ENCRYPTION_ENGINE_HPP_
+#include <cstdint>
 #include <efc/encryption_engine.hpp>
 #include <efc/key_derivation.hpp>
+#include <mjfs/file.hpp>
 #include <mjfs/file_stream.hpp>
 
 namespace mjx {
+    enum class file_format : unsigned char {
+        legacy  = 0, // single AES-256-GCM stream, the tag is stored in the metadata
+        chunked = 1 // independently authenticated fixed-size chunks
+    };
+
+    namespace file_feature { // optional features of the chunked format, combined in file_metadata::features
+        // the header and the chunks are aligned to the sector size, required for unbuffered I/O
+        inline constexpr uint32_t aligned = 0x0000'0001;
+
+        // the key is derived from a master key and the nonce stored in the header, see derive_subkey()
+        inline constexpr uint32_t subkey = 0x0000'0002;
+
+        // the parameters of the key derivation are stored in the header, see key_derivation_params
+        inline constexpr uint32_t kdf_params = 0x0000'0004;
+
+        // the check value of the key is stored in the header, see compute_key_check()
+        inline constexpr uint32_t key_check = 0x0000'0008;
+    } // namespace file_feature
+
     struct file_signature {
         static constexpr size_t size = 4;
         byte_t data[size]            = {0};
 
         // checks if the signature is well-known
         bool is_recognized() const noexcept;
+
+        // returns the file format encoded in the signature
+        file_format format() const noexcept;
     };
 
     struct file_metadata {
         file_signature signature;
-        authentication_tag tag;
+        authentication_tag tag; // used only by the legacy format
         salt salt;
         iv iv;
+        uint32_t features   = 0; // used only by the chunked format, see file_feature
+        uint32_t chunk_size = 0; // used only by the chunked format
+        key_nonce key_nonce; // used only by the chunked format with file_feature::subkey
+
+        // used only by the chunked format with file_feature::kdf_params, other files use the legacy parameters
+        key_derivation_function kdf      = key_derivation_function::argon2id;
+        key_derivation_params kdf_params = legacy_key_derivation_params;
+        key_check key_check; // used only by the chunked format with file_feature::key_check
     };
 
-    file_metadata construct_metadata() noexcept;
+    file_metadata construct_metadata(
+        const file_format _Format = file_format::legacy, const uint32_t _Features = 0) noexcept;
     file_metadata load_metadata(file_stream& _Stream) noexcept;
     bool store_metadata(file_stream& _Stream, const file_metadata& _Meta) noexcept;
 
+    // returns the number of bytes the metadata occupies in the file
+    size_t metadata_size(const file_metadata& _Meta) noexcept;
+
+    enum class file_io_mode : unsigned char {
+        stream, // blocking reads and writes through the file streams
+        overlapped, // several asynchronous reads and writes in flight, issued from a single thread
+        mapped // both files mapped into memory, transformed straight from one view into the other
+    };
+
+    struct file_encryption_options {
+        static constexpr size_t min_chunk_size     = 65536; // 64 KiB
+        static constexpr size_t max_chunk_size     = 16777216; // 16 MiB
+        static constexpr size_t default_chunk_size = 1048576; // 1 MiB
+
+        size_t chunk_size     = default_chunk_size; // clamped to <min_chunk_size, max_chunk_size>
+        bool pipelined        = false; // overlap reading, encryption and writing on separate threads
+        size_t pipeline_depth = 4; // the number of chunks in flight, used when pipelined or overlapped
+
+        // Note: The overlapped mode requires the engine to be constructed from files, the streams are used
+        //       otherwise. The files should be opened with file_flag::overlapped, the flag is not checked.
+        //       Without it, every read and write completes before the next one is issued, so the result
+        //       is the same, but nothing overlaps. The pipelined option has no effect on this mode.
+        //
+        //       The mapped mode requires the engine to be constructed from files, the destination
+        //       file must be opened with read and write access. If the files cannot be mapped,
+        //       for example because they do not fit in the address space, the streams are used instead.
+        file_io_mode io_mode = file_io_mode::stream;
+    };
+
     class file_encryption_engine {
     public:
-        file_encryption_engine(
-            file_stream& _Src_stream, file_stream& _Dest_stream, encryption_engine& _Engine) noexcept;
+        file_encryption_engine(file_stream& _Src_stream, file_stream& _Dest_stream, encryption_engine& _Engine,
+            const file_encryption_options& _Options = file_encryption_options{}) noexcept;
+        file_encryption_engine(file& _Src_file, file& _Dest_file, encryption_engine& _Engine,
+            const file_encryption_options& _Options = file_encryption_options{}) noexcept;
         ~file_encryption_engine() noexcept;
 
         file_encryption_engine(const file_encryption_engine&)            = delete;
@@ -46,9 +110,34 @@ namespace mjx {
         bool decrypt(const key& _Key, const iv& _Iv, authentication_tag& _Tag) noexcept;
 
     private:
+        // transforms the data using the configured I/O strategy
+        template <class _Fn>
+        bool _Process(_Fn& _Func) noexcept;
+
+        // reads, transforms and writes the data one chunk at a time
+        template <class _Fn>
+        bool _Run_sequential(_Fn& _Func) noexcept;
+
+        // reads, transforms and writes the data on separate threads
+        template <class _Fn>
+        bool _Run_pipeline(_Fn& _Func) noexcept;
+
+        // keeps several asynchronous reads and writes in flight while transforming the data
+        template <class _Fn>
+        bool _Run_overlapped(_Fn& _Func) noexcept;
+
+        // transforms the data straight from the source view into the destination view
+        template <class _Fn>
+        bool _Run_mapped(_Fn& _Func) noexcept;
+
+        file_stream _Mysrc_owner; // used only when constructed from files
+        file_stream _Mydest_owner; // used only when constructed from files
         file_stream& _Mysrc;
         file_stream& _Mydest;
+        file* _Mysrc_file; // null when constructed from streams
+        file* _Mydest_file; // null when constructed from streams
         encryption_engine& _Myengine;
+        file_encryption_options _Myoptions;
     };
 } // namespace mjx
 
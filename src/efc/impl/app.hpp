@@ -0,0 +1,1000 @@
+// app.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_IMPL_APP_HPP_
+#define _EFC_IMPL_APP_HPP_
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <efc/chunked_file_encryption_engine.hpp>
+#include <efc/encrypted_file_reader.hpp>
+#include <efc/file_encryption_engine.hpp>
+#include <efc/impl/background_key.hpp>
+#include <efc/impl/file_io.hpp>
+#include <efc/job_server.hpp>
+#include <efc/key_agent.hpp>
+#include <efc/key_derivation_scheduler.hpp>
+#include <efc/parallel_file_encryption_engine.hpp>
+#include <efc/program.hpp>
+#include <efc/stream_encryption_engine.hpp>
+#include <efc/work_stealing_scheduler.hpp>
+#include <future>
+#include <mjfs/directory.hpp>
+#include <mjfs/status.hpp>
+#include <mjfs/temporary_file.hpp>
+#include <mutex>
+#include <vector>
+
+namespace mjx {
+    // Note: The values are the exit codes of the program, so new errors are appended at the end.
+    enum class _App_error : unsigned char {
+        _Success,
+        _Operation_not_specified,
+        _Password_not_specified,
+        _Path_not_specified,
+        _Signature_not_recognized,
+        _Key_derivation_failed,
+        _File_already_exists,
+        _Invalid_file,
+        _File_creation_failed,
+        _Metadata_load_failed,
+        _Metadata_store_failed,
+        _Encryption_failed,
+        _Decryption_failed,
+        _Unknown_error,
+        _Wrong_password,
+        _Wrong_key_type,
+        _Raw_key_not_supported,
+        _Output_not_specified,
+        _Streaming_not_supported,
+        _Batch_failed,
+        _Agent_failed,
+        _Server_failed,
+        _Verification_not_supported
+    };
+
+    inline const char* _Translate_app_error(const _App_error _Error) noexcept {
+        switch (_Error) {
+        case _App_error::_Operation_not_specified:
+            return "No operation specified.";
+        case _App_error::_Password_not_specified:
+            return "No password or key specified.";
+        case _App_error::_Path_not_specified:
+            return "File path not specified.";
+        case _App_error::_Signature_not_recognized:
+            return "Signature not recognized.";
+        case _App_error::_Key_derivation_failed:
+            return "Failed to derive the key.";
+        case _App_error::_Wrong_password:
+            return "The password is incorrect.";
+        case _App_error::_Wrong_key_type:
+            return "The file has been encrypted with a raw key rather than a password, or vice versa.";
+        case _App_error::_Raw_key_not_supported:
+            return "The legacy format cannot be encrypted with a raw key.";
+        case _App_error::_File_already_exists:
+            return "Failed to create the file because it already exists.";
+        case _App_error::_Invalid_file:
+            return "Failed to open the file.";
+        case _App_error::_File_creation_failed:
+            return "Failed to create the file.";
+        case _App_error::_Metadata_load_failed:
+            return "Failed to load the metadata.";
+        case _App_error::_Metadata_store_failed:
+            return "Failed to store the metadata.";
+        case _App_error::_Encryption_failed:
+            return "Failed to encrypt the file.";
+        case _App_error::_Decryption_failed:
+            return "Failed to decrypt the file.";
+        case _App_error::_Output_not_specified:
+            return "The standard input can be used only together with the standard output.";
+        case _App_error::_Streaming_not_supported:
+            return "The legacy format cannot be streamed.";
+        case _App_error::_Batch_failed:
+            return "Failed to process some of the files.";
+        case _App_error::_Agent_failed:
+            return "Failed to start the key agent, another one may be running already.";
+        case _App_error::_Server_failed:
+            return "Failed to start the job server, another one may be running already.";
+        case _App_error::_Verification_not_supported:
+            return "Only the chunked format can be verified without decrypting the file.";
+        default:
+            return "An unknown error occured.";
+        }
+    }
+
+    inline void _Report_error(const _App_error _Error) noexcept {
+        // Note: Errors are reported to the standard error, so that they never mix with
+        //       the data written to the standard output.
+        ::fprintf(stderr, "[ERROR]: %s\n", _Translate_app_error(_Error));
+    }
+
+    inline void _Report_file_error(const path& _Path, const _App_error _Error) noexcept {
+        ::fwprintf(stderr, L"[ERROR]: %hs (%s)\n", _Translate_app_error(_Error), _Path.c_str());
+    }
+
+    inline path _Add_internal_extension(const path& _Path) {
+        return path{_Path.native() + L".efc"};
+    }
+
+    inline path _Remove_internal_extension(const path& _Path) {
+        const path::string_type& _Str = _Path.native();
+        return path{_Str.substr(0, _Str.size() - 4)}; // assumes that _Path ends with ".efc"
+    }
+
+    inline bool _Create_destination_file(const path& _Path, const bool _Direct_io, temporary_file& _File) {
+        if (!_Direct_io) {
+            return ::mjx::create_temporary_file(_Path, _File);
+        }
+
+        return ::mjx::create_temporary_file(
+            _Path, file_share::none, file_attribute::normal, efc_impl::_No_buffering_flag, file_perms::all, _File);
+    }
+
+    inline void _Show_help() noexcept {
+        ::puts(
+            "EFC (Easy File Crypt) usage:\n"
+            "\n"
+            "efc.exe <operation> --path=\"<absolute-path>\" --password=\"<password>\" [options]\n"
+            "\n"
+            "Operations:\n"
+            "  --help       Show this help message end exit\n"
+            "  --encrypt    Encrypt the specified file using the specified password\n"
+            "  --decrypt    Decrypt the specified file using the specified password\n"
+            "  --calibrate  Find the key derivation parameters that take the target time on this machine\n"
+            "  --agent      Hold the derived keys for the other EFC processes until Ctrl+C is pressed\n"
+            "  --serve      Run the jobs of the other processes with the specified password or key\n"
+            "\n"
+            "Options:\n"
+            "  --legacy     Encrypt the file using the legacy single-stream format\n"
+            "  --direct     Bypass the system cache, the file is encrypted using the aligned chunked format\n"
+            "  --stdin      Read the input from the standard input instead of the file, requires --stdout\n"
+            "  --stdout     Write the output to the standard output instead of a new file\n"
+            "  --recursive  Process every file in the specified directory and its subdirectories\n"
+            "  --kdf=<memory>,<iterations>,<lanes>\n"
+            "               Derive the key using Argon2id with the specified parameters, the memory is in KiB\n"
+            "  --target-time=<ms>\n"
+            "               The duration of the key derivation chosen by --calibrate, 1000 ms by default\n"
+            "  --key-file=<path>\n"
+            "               Use the raw 32-byte key stored in the file instead of the password\n"
+            "  --key-fd=<handle>\n"
+            "               Read the raw 32-byte key from an inherited handle, 0 for the standard input\n"
+            "  --no-agent   Derive the keys in this process even if the key agent is running\n"
+            "  --ttl=<s>    The number of seconds the key agent holds a key for, 300 by default\n"
+            "\n"
+            "Notes:\n"
+            "  When you encrypt the file, the program automatically creates a new file\n"
+            "  called <absolute-path>.efc. If there is already a file with this name, an error occurs.\n"
+            "\n"
+            "  When you decrypt the file, the program expects that the file ends with .EFC extension,\n"
+            "  otherwise an error occurs. The program automatically creates a new file named as\n"
+            "  the file but without .EFC extension. If such file already exists, an error occurs.\n"
+            "\n"
+            "  All required data is stored within the file metadata, except for the password, which is required.\n"
+            "  You can specify any password that is at most 63 characters long.\n"
+            "  A wrong password is detected right after the key derivation, before any data is decrypted,\n"
+            "  unless the file has been encrypted by an older version.\n"
+            "\n"
+            "  By default, the file is split into chunks that are encrypted in parallel.\n"
+            "  The legacy format is readable by older versions, it is processed in parallel as well.\n"
+            "  The format is detected automatically during decryption.\n"
+            "\n"
+            "  The --direct option does not affect the legacy format. When you decrypt the file,\n"
+            "  it is used only if the file has been encrypted with the --direct option.\n"
+            "\n"
+            "  With --recursive, the path must refer to a directory. Every file is encrypted into\n"
+            "  <file>.efc next to it, or every .efc file is decrypted, by a pool of workers that share\n"
+            "  the chunks of large files.\n"
+            "  A failure of one file is reported and does not stop the others.\n"
+            "\n"
+            "  The parameters of the key derivation are stored in the file, so the decryption needs\n"
+            "  neither --kdf nor the machine that encrypted the file. By default, 16 MiB of memory\n"
+            "  and 8 passes are split into 4 lanes. Run --calibrate to find stronger parameters\n"
+            "  that still fit in the target time, and pass them to --kdf when encrypting.\n"
+            "\n"
+            "  With --key-file or --key-fd, the key is used as it is, without the key derivation,\n"
+            "  and the file records that no password is needed. Such files must be decrypted\n"
+            "  with the same key. The legacy format cannot be encrypted with a raw key.\n"
+            "\n"
+            "  While the key agent runs, the other EFC processes of the same user ask it for the keys.\n"
+            "  It derives a key only once and holds it in locked memory until the key expires,\n"
+            "  so encrypting or decrypting several files one by one costs a single key derivation.\n"
+            "\n"
+            "  With --serve, the program runs until Ctrl+C is pressed and accepts encryption, decryption\n"
+            "  and verification jobs on a named pipe, so that the workers and the keys are set up only once.\n"
+            "  Every job reports its own timing, and the median and 99th percentile latencies are printed\n"
+            "  when the server stops.\n"
+            "\n"
+            "  The --stdin and --stdout options process the data in a single pass, without seeking,\n"
+            "  so they can be used in pipelines. Only the chunked format can be streamed.\n"
+            "  Every chunk is verified before it is written, but if the decryption fails,\n"
+            "  the chunks written so far have already been passed on.\n"
+            "\n"
+            "Examples:\n"
+            "  efc.exe --encrypt --path=\"C:\\Users\\Dir\\File.txt\" --password=\"My password\"\n"
+            "  efc.exe --decrypt --path=\"C:\\Users\\Dir\\File.txt.efc\" --password=\"My password\"\n"
+            "  efc.exe --encrypt --recursive --path=\"C:\\Users\\Dir\" --password=\"My password\"\n"
+            "  efc.exe --calibrate --target-time=3000\n"
+            "  efc.exe --encrypt --path=\"C:\\Users\\Dir\\File.txt\" --password=\"My password\" --kdf=262144,3,4\n"
+            "  tar -c Dir | efc.exe --encrypt --stdin --stdout --password=\"My password\" > Dir.tar.efc\n"
+            "  efc.exe --encrypt --path=\"C:\\Users\\Dir\\File.txt\" --key-file=\"C:\\Keys\\File.key\"\n"
+            "  efc.exe --agent --ttl=600\n"
+            "  efc.exe --serve --password=\"My password\"\n"
+        );
+    }
+
+    // Note: Without a scheduler, the file is processed by as many threads as there are hardware threads.
+    //       With a scheduler, the chunks are shared with its idle workers and the legacy format
+    //       is processed on the calling thread only.
+    inline chunked_file_encryption_engine _Make_chunked_engine(
+        file& _Src_file, file& _Dest_file, work_stealing_scheduler* const _Scheduler) noexcept {
+        if (_Scheduler) {
+            return chunked_file_encryption_engine(_Src_file, _Dest_file, *_Scheduler);
+        }
+
+        return chunked_file_encryption_engine(_Src_file, _Dest_file);
+    }
+
+    inline size_t _Legacy_thread_count(work_stealing_scheduler* const _Scheduler) noexcept {
+        return _Scheduler ? 1 : 0;
+    }
+
+    // returns the raw key if specified, otherwise asks the key agent or derives the key from the password
+    inline key _Make_master_key(
+        const program_options& _Options, const salt& _Salt, const key_derivation_params& _Params) noexcept {
+        if (_Options.raw_key.valid()) {
+            return _Options.raw_key;
+        }
+
+        key _Key;
+        if (_Options.use_agent && request_agent_key(_Options.password, _Salt, _Params, _Key)) {
+            return _Key;
+        }
+
+        return derive_key(_Options.password.as_view(), _Salt, _Params);
+    }
+
+    inline key_derivation_function _Key_derivation_function(const program_options& _Options) noexcept {
+        return _Options.raw_key.valid() ? key_derivation_function::none : key_derivation_function::argon2id;
+    }
+
+    // Note: The files of a batch share a single password-based key, called the master key, which is derived
+    //       only once. The key of every file is derived from the master key and the nonce stored
+    //       in its header, which is cheap compared to the password-based derivation.
+    class _Batch_keys {
+    public:
+        explicit _Batch_keys(const program_options& _Options) noexcept
+            : _Myoptions(_Options), _Mysalt(), _Mymaster(), _Mymutex(), _Mycache() {}
+
+        _Batch_keys(const _Batch_keys&)            = delete;
+        _Batch_keys& operator=(const _Batch_keys&) = delete;
+
+        // reuses the master key held by the key agent, fails if it is not running
+        bool _Prepare_agent_encryption() noexcept {
+            return _Myoptions.use_agent && !_Myoptions.raw_key.valid()
+                && request_agent_batch_key(_Myoptions.password, _Myoptions.kdf_params, _Mysalt, _Mymaster);
+        }
+
+        bool _Prepare_encryption() noexcept {
+            if (_Prepare_agent_encryption()) {
+                return true;
+            }
+
+            _Mysalt   = generate_salt();
+            _Mymaster = _Make_master_key(_Myoptions, _Mysalt, _Myoptions.kdf_params);
+            return _Mymaster.valid();
+        }
+
+        const salt& _Salt() const noexcept {
+            return _Mysalt;
+        }
+
+        const key& _Master_key() const noexcept {
+            return _Mymaster;
+        }
+
+        key _Find_master_key(const salt& _Salt, const key_derivation_params& _Params) {
+            if (_Myoptions.raw_key.valid()) { // nothing to derive
+                return _Myoptions.raw_key;
+            }
+
+            // Note: The first worker that needs a master key publishes its entry and derives the key
+            //       without the mutex, so that only the workers that need the same key wait for it.
+            ::std::promise<key> _Promise;
+            ::std::shared_future<key> _Master;
+            bool _Derive = false; // true if this worker derives the key
+            {
+                ::std::lock_guard<::std::mutex> _Guard(_Mymutex);
+                const auto _Found = _Find_cached_key(_Salt, _Params);
+                if (_Found != _Mycache.end()) {
+                    _Master = _Found->_Master;
+                } else {
+                    _Mycache.push_back(_Cached_key{_Salt, _Params, _Promise.get_future().share()});
+                    _Derive = true;
+                }
+            }
+
+            if (!_Derive) { // derived or being derived by another worker
+                return _Master.get();
+            }
+
+            const key& _Key = _Make_master_key(_Myoptions, _Salt, _Params);
+            _Promise.set_value(_Key);
+            if (!_Key.valid()) { // cache only valid keys, the waiting workers fail as well
+                ::std::lock_guard<::std::mutex> _Guard(_Mymutex);
+                const auto _Found = _Find_cached_key(_Salt, _Params);
+                if (_Found != _Mycache.end()) {
+                    _Mycache.erase(_Found);
+                }
+            }
+
+            return _Key;
+        }
+
+    private:
+        struct _Cached_key {
+            salt _Salt;
+            key_derivation_params _Params;
+            ::std::shared_future<key> _Master;
+        };
+
+        // returns the entry of the master key, the mutex must be held
+        ::std::vector<_Cached_key>::iterator _Find_cached_key(
+            const salt& _Salt, const key_derivation_params& _Params) noexcept {
+            return ::std::find_if(_Mycache.begin(), _Mycache.end(), [&](const _Cached_key& _Cached) {
+                return ::memcmp(_Cached._Salt.data(), _Salt.data(), salt::size) == 0
+                    && _Cached._Params.memory == _Params.memory && _Cached._Params.iterations == _Params.iterations
+                    && _Cached._Params.lanes == _Params.lanes;
+            });
+        }
+
+        const program_options& _Myoptions;
+        salt _Mysalt; // used only by the encryption
+        key _Mymaster; // used only by the encryption
+        ::std::mutex _Mymutex;
+        ::std::vector<_Cached_key> _Mycache; // used only by the decryption, the files usually share one salt
+    };
+
+    inline key _Derive_file_key(const program_options& _Options, const file_metadata& _Meta, _Batch_keys* const _Keys) {
+        if ((_Meta.features & file_feature::subkey) == 0) { // the key is derived from the password only
+            return _Make_master_key(_Options, _Meta.salt, _Meta.kdf_params);
+        }
+
+        const key& _Master = _Keys ? _Keys->_Find_master_key(_Meta.salt, _Meta.kdf_params)
+                                   : _Make_master_key(_Options, _Meta.salt, _Meta.kdf_params);
+        return _Master.valid() ? derive_subkey(_Master, _Meta.key_nonce) : key{};
+    }
+
+    inline bool _Is_matching_key_type(const program_options& _Options, const file_metadata& _Meta) noexcept {
+        return (_Meta.kdf == key_derivation_function::none) == _Options.raw_key.valid();
+    }
+
+    inline _App_error _Check_file_key(const file_metadata& _Meta, const key& _Key) noexcept {
+        if (!_Key.valid()) {
+            return _App_error::_Key_derivation_failed;
+        }
+
+        // Note: Files without the check value are verified only by the authentication tags,
+        //       once all of the data has been decrypted.
+        if ((_Meta.features & file_feature::key_check) != 0 && !verify_key_check(_Key, _Meta.key_check)) {
+            return _App_error::_Wrong_password;
+        }
+
+        return _App_error::_Success;
+    }
+
+    // returns true if the key must be derived from the password, which is worth a separate thread
+    inline bool _Is_key_derivation_slow(const program_options& _Options, _Batch_keys* const _Keys) noexcept {
+        return _Keys == nullptr && !_Options.raw_key.valid();
+    }
+
+    inline _App_error _Encrypt_file(const path& _Path, const program_options& _Options,
+        work_stealing_scheduler* const _Scheduler, _Batch_keys* const _Keys) {
+        const path& _Dest_path = _Add_internal_extension(_Path);
+        if (::mjx::exists(_Dest_path)) { // must not exists
+            return _App_error::_File_already_exists;
+        }
+
+        // Note: Only the chunked format can store the key nonce and the parameters of the key derivation,
+        //       so the files of the legacy format are not part of the batch and use the legacy parameters.
+        const bool _Direct_io = _Options.direct_io && _Options.format == file_format::chunked;
+        const bool _Subkey    = _Keys && _Options.format == file_format::chunked;
+        file_metadata _Meta   = construct_metadata(_Options.format, file_feature::kdf_params | file_feature::key_check
+            | (_Direct_io ? file_feature::aligned : 0) | (_Subkey ? file_feature::subkey : 0));
+        if (_Meta.signature.format() == file_format::chunked) { // the legacy format uses the legacy parameters
+            _Meta.kdf        = _Key_derivation_function(_Options);
+            _Meta.kdf_params = _Options.kdf_params;
+        }
+
+        if (_Subkey) {
+            _Meta.salt = _Keys->_Salt();
+        }
+
+        // Note: The salt is known, so the key is derived on a separate thread while the files are
+        //       being created, opened and preallocated, and the first chunks are being read.
+        efc_impl::_Background_key _Key;
+        _Key._Start([&_Options, _Keys, _Subkey, _Salt = _Meta.salt, _Params = _Meta.kdf_params,
+            _Nonce = _Meta.key_nonce]() noexcept {
+            return _Subkey ? derive_subkey(_Keys->_Master_key(), _Nonce) : _Make_master_key(_Options, _Salt, _Params);
+        }, _Is_key_derivation_slow(_Options, _Keys));
+
+        // Note: The newly created file is initially set as temporary to handle potential issues.
+        //       Upon successful operation, it will be converted to a regular file.
+        temporary_file _Dest_file;
+        if (!_Create_destination_file(_Dest_path, _Direct_io, _Dest_file)) {
+            return _App_error::_File_creation_failed;
+        }
+        
+        file _Src_file(
+            _Path, file_access::read, file_share::read, _Direct_io ? efc_impl::_No_buffering_flag : file_flag::none);
+        file_stream _Src_stream(_Src_file);
+        file_stream _Dest_stream(_Dest_file);
+        if (!_Src_stream.is_open() || !_Dest_stream.is_open()) { // both streams must be valid
+            return _App_error::_Invalid_file;
+        }
+
+        if (_Meta.signature.format() == file_format::chunked) { // the metadata is written before the chunks
+            chunked_file_encryption_engine _FEng = _Make_chunked_engine(_Src_file, _Dest_file, _Scheduler);
+            if (!_FEng.prepare_encryption(_Meta)) {
+                return _App_error::_Encryption_failed;
+            }
+
+            const key& _File_key = _Key._Wait();
+            if (!_File_key.valid()) {
+                return _App_error::_Key_derivation_failed;
+            }
+
+            _Meta.key_check = compute_key_check(_File_key);
+            // Note: The preallocation may have moved the file pointer, the metadata must be written first.
+            if (!_Meta.key_check.valid() || !_Dest_stream.seek(0) || !store_metadata(_Dest_stream, _Meta)) {
+                return _App_error::_Metadata_store_failed;
+            }
+
+            if (!_FEng.encrypt(_File_key, _Meta)) {
+                return _App_error::_Encryption_failed;
+            }
+        } else {
+            const key& _File_key = _Key._Wait();
+            if (!_File_key.valid()) {
+                return _App_error::_Key_derivation_failed;
+            }
+
+            parallel_file_encryption_engine _FEng(_Src_file, _Dest_file, _Legacy_thread_count(_Scheduler));
+            if (!_FEng.encrypt(_File_key, _Meta)) { // the encrypted data is written after the meta-data
+                return _App_error::_Encryption_failed;
+            }
+
+            if (!_Dest_stream.seek(0) || !store_metadata(_Dest_stream, _Meta)) {
+                return _App_error::_Metadata_store_failed;
+            }
+        }
+        
+        return _Dest_file.make_regular() ? _App_error::_Success : _App_error::_File_creation_failed;
+    }
+
+    // Note: The key is derived from the password and the metadata, unless it has already been derived.
+    inline _App_error _Decrypt_file(const path& _Path, const program_options& _Options,
+        work_stealing_scheduler* const _Scheduler, _Batch_keys* const _Keys, const key* const _Derived_key) {
+        if (!_Path.native().ends_with(L".efc")) { // must end with .EFC extension
+            return _App_error::_Invalid_file;
+        }
+
+        const path& _Dest_path = _Remove_internal_extension(_Path);
+        if (::mjx::exists(_Dest_path)) { // must not exists
+            return _App_error::_File_already_exists;
+        }
+
+        file _Src_file(_Path, file_access::read, file_share::read);
+        file_stream _Src_stream(_Src_file);
+        if (!_Src_stream.is_open()) {
+            return _App_error::_Invalid_file;
+        }
+
+        file_metadata _Meta = load_metadata(_Src_stream);
+        if (!_Meta.signature.is_recognized()) { // signature not recognized, break
+            return _App_error::_Signature_not_recognized;
+        }
+
+        if (!_Is_matching_key_type(_Options, _Meta)) {
+            return _App_error::_Wrong_key_type;
+        }
+
+        // Note: The key is derived on a separate thread while the destination file is being created
+        //       and preallocated, and the first chunks are being read. It is checked before any data
+        //       is decrypted, a wrong password only leaves the empty temporary file, which is deleted.
+        efc_impl::_Background_key _Key;
+        _Key._Start([&_Options, _Keys, _Derived_key, _Meta]() {
+            return _Derived_key ? *_Derived_key : _Derive_file_key(_Options, _Meta, _Keys);
+        }, _Derived_key == nullptr && _Is_key_derivation_slow(_Options, _Keys));
+
+        // Note: Only the aligned chunked format can be read and written without buffering.
+        //       The metadata has already been loaded, so the file is reopened for the rest.
+        const bool _Direct_io = _Options.direct_io && _Meta.signature.format() == file_format::chunked
+            && (_Meta.features & file_feature::aligned) != 0;
+        if (_Direct_io) {
+            _Src_file = file(_Path, file_access::read, file_share::read, efc_impl::_No_buffering_flag);
+            if (!_Src_file.is_open()) {
+                return _App_error::_Invalid_file;
+            }
+        }
+
+        // Note: The newly created file is initially set as temporary to handle potential issues.
+        //       Upon successful operation, it will be converted to a regular file.
+        temporary_file _Dest_file;
+        if (!_Create_destination_file(_Dest_path, _Direct_io, _Dest_file)) {
+            return _App_error::_File_creation_failed;
+        }
+
+        if (_Meta.signature.format() == file_format::chunked) {
+            chunked_file_encryption_engine _FEng = _Make_chunked_engine(_Src_file, _Dest_file, _Scheduler);
+            if (!_FEng.prepare_decryption(_Meta)) {
+                return _App_error::_Decryption_failed;
+            }
+
+            const key& _File_key    = _Key._Wait();
+            const _App_error _Error = _Check_file_key(_Meta, _File_key);
+            if (_Error != _App_error::_Success) {
+                return _Error;
+            }
+
+            if (!_FEng.decrypt(_File_key, _Meta)) {
+                return _App_error::_Decryption_failed;
+            }
+        } else {
+            const key& _File_key    = _Key._Wait();
+            const _App_error _Error = _Check_file_key(_Meta, _File_key);
+            if (_Error != _App_error::_Success) {
+                return _Error;
+            }
+
+            parallel_file_encryption_engine _FEng(_Src_file, _Dest_file, _Legacy_thread_count(_Scheduler));
+            if (!_FEng.decrypt(_File_key, _Meta)) {
+                return _App_error::_Decryption_failed;
+            }
+        }
+
+        return _Dest_file.make_regular() ? _App_error::_Success : _App_error::_File_creation_failed;
+    }
+
+    // decrypts and verifies every chunk of the file without writing the plaintext
+    inline _App_error _Verify_file(const path& _Path, const program_options& _Options, _Batch_keys* const _Keys) {
+        file _File(_Path, file_access::read, file_share::read);
+        file_stream _Stream(_File);
+        if (!_Stream.is_open()) {
+            return _App_error::_Invalid_file;
+        }
+
+        const file_metadata& _Meta = load_metadata(_Stream);
+        if (!_Meta.signature.is_recognized()) { // signature not recognized, break
+            return _App_error::_Signature_not_recognized;
+        }
+
+        if (_Meta.signature.format() != file_format::chunked) { // the legacy format has a single tag
+            return _App_error::_Verification_not_supported;
+        }
+
+        if (!_Is_matching_key_type(_Options, _Meta)) {
+            return _App_error::_Wrong_key_type;
+        }
+
+        const key& _Key         = _Derive_file_key(_Options, _Meta, _Keys);
+        const _App_error _Error = _Check_file_key(_Meta, _Key);
+        if (_Error != _App_error::_Success) {
+            return _Error;
+        }
+
+        encrypted_file_reader _Reader(_File, _Key, _Meta);
+        if (!_Reader.is_open()) {
+            return _App_error::_Decryption_failed;
+        }
+
+        ::std::vector<byte_t> _Buf(_Meta.chunk_size);
+        for (uint64_t _Off = 0; _Off < _Reader.size(); _Off += _Buf.size()) {
+            const size_t _Count = static_cast<size_t>((::std::min)(_Reader.size() - _Off, uint64_t{_Buf.size()}));
+            if (!_Reader.read_at(_Off, _Buf.data(), _Count)) { // modified or truncated
+                return _App_error::_Decryption_failed;
+            }
+        }
+
+        return _App_error::_Success;
+    }
+
+    inline _App_error _Perform_encryption(program_options& _Options) {
+        // Note: If the key agent is running, the file is encrypted with a subkey of the master key it holds,
+        //       so that encrypting several files one by one derives the master key only once.
+        _Batch_keys _Keys(_Options);
+        const bool _Use_agent = _Options.format == file_format::chunked && _Keys._Prepare_agent_encryption();
+        return _Encrypt_file(_Options.path_to_file, _Options, nullptr, _Use_agent ? &_Keys : nullptr);
+    }
+
+    inline _App_error _Perform_decryption(program_options& _Options) {
+        return _Decrypt_file(_Options.path_to_file, _Options, nullptr, nullptr, nullptr);
+    }
+
+    inline void _Count_file_error(
+        const path& _Path, const _App_error _Error, ::std::atomic<size_t>& _Failed) noexcept {
+        _Report_file_error(_Path, _Error);
+        _Failed.fetch_add(1, ::std::memory_order_relaxed);
+    }
+
+    // queues the file on the workers, the key is derived by the worker unless it is specified
+    inline void _Submit_file(const path& _Path, const program_options& _Options, work_stealing_scheduler& _Scheduler,
+        _Batch_keys& _Keys, ::std::atomic<size_t>& _Failed, const key* const _Derived_key) {
+        const bool _Encrypt = _Options.operation == operation::encryption;
+        const bool _Has_key = _Derived_key != nullptr;
+        const key& _Key     = _Has_key ? *_Derived_key : key{};
+        const bool _Queued  = _Scheduler.submit(
+            [&_Options, &_Scheduler, &_Keys, &_Failed, _Encrypt, _Path, _Has_key, _Key]() noexcept {
+                _App_error _Error;
+                try {
+                    _Error = _Encrypt ? _Encrypt_file(_Path, _Options, &_Scheduler, &_Keys)
+                        : _Decrypt_file(_Path, _Options, &_Scheduler, &_Keys, _Has_key ? &_Key : nullptr);
+                } catch (...) {
+                    _Error = _App_error::_Unknown_error;
+                }
+
+                if (_Error != _App_error::_Success) { // report the error and continue with the other files
+                    _Count_file_error(_Path, _Error, _Failed);
+                }
+            });
+        if (!_Queued) {
+            _Count_file_error(_Path, _App_error::_Unknown_error, _Failed);
+        }
+    }
+
+    // queues the derivation of the key of the file, which is queued on the workers once its key is ready
+    inline bool _Submit_key_derivation(const path& _Path, const program_options& _Options,
+        key_derivation_scheduler& _Kdf, work_stealing_scheduler& _Scheduler, _Batch_keys& _Keys,
+        ::std::atomic<size_t>& _Failed) {
+        // Note: Only the files whose keys are derived from the password alone need their own derivation,
+        //       the keys of the other files are derived from the master keys, see _Batch_keys.
+        if (_Options.raw_key.valid()) { // nothing to derive
+            return false;
+        }
+
+        file _File(_Path, file_access::read, file_share::read);
+        file_stream _Stream(_File);
+        if (!_Stream.is_open()) {
+            return false;
+        }
+
+        const file_metadata& _Meta = load_metadata(_Stream);
+        if (!_Meta.signature.is_recognized() || (_Meta.features & file_feature::subkey) != 0) {
+            return false;
+        }
+
+        if (!_Is_matching_key_type(_Options, _Meta)) { // reported by _Decrypt_file(), no key to derive
+            return false;
+        }
+
+        return _Kdf.submit(_Options.password, _Meta.salt, _Meta.kdf_params,
+            [&_Options, &_Scheduler, &_Keys, &_Failed, _Path](const key& _Key) {
+                if (_Key.valid()) {
+                    _Submit_file(_Path, _Options, _Scheduler, _Keys, _Failed, &_Key);
+                } else {
+                    _Count_file_error(_Path, _App_error::_Key_derivation_failed, _Failed);
+                }
+            });
+    }
+
+    inline _App_error _Perform_recursive(program_options& _Options) {
+        // Note: Every file is a task of the work-stealing scheduler. Small files are processed by a single
+        //       worker each, while the chunks of large files are split into subtasks that idle workers
+        //       steal, so a mix of few large and many small files keeps all the cores busy.
+        //       The directory is traversed on the calling thread, which waits whenever too many files
+        //       are queued, so the traversal stays only slightly ahead of the workers.
+        //       The password-based key is derived once for the whole batch, see _Batch_keys.
+        //       Files that derive their keys from their own salts, such as the legacy ones, are decrypted
+        //       in two stages. The traversal queues the derivation of the key, which runs on the key
+        //       derivation scheduler, and the file is queued on the workers once its key is ready.
+        //       The derivations of the next files run while the workers process the previous ones.
+        const bool _Encrypt = _Options.operation == operation::encryption;
+        _Batch_keys _Keys(_Options); // must outlive the scheduler, like the counter below
+        if (_Encrypt && _Options.format == file_format::chunked && !_Keys._Prepare_encryption()) {
+            return _App_error::_Key_derivation_failed;
+        }
+
+        ::std::atomic<size_t> _Failed(0); // must outlive the scheduler, which waits for the tasks
+        work_stealing_scheduler _Scheduler;
+        if (!_Scheduler.is_running()) {
+            return _App_error::_Unknown_error;
+        }
+
+        // Note: The key agent derives every key only once, so the workers ask it directly.
+        key_derivation_scheduler _Kdf; // must not outlive the scheduler, its callbacks queue the files
+        const bool _Use_kdf           = _Kdf.is_running() && !(_Options.use_agent && is_key_agent_running());
+        const size_t _Max_pending     = _Scheduler.worker_count() * 4;
+        const size_t _Max_derivations = _Kdf.thread_count() * 4;
+        size_t _Submitted             = 0;
+        for (const directory_entry& _Entry :
+            recursive_directory_iterator(_Options.path_to_file, directory_options::skip_permission_denied)) {
+            if (!_Entry.is_regular_file()) {
+                continue;
+            }
+
+            // Note: The encrypted files end with .EFC extension, which also makes the encryption
+            //       skip the files it creates itself, and the decryption skip the decrypted ones.
+            const path& _Path = _Entry.absolute_path();
+            if (_Path.native().ends_with(L".efc") == _Encrypt) {
+                continue;
+            }
+
+            if (_Encrypt || !_Use_kdf
+                || !_Submit_key_derivation(_Path, _Options, _Kdf, _Scheduler, _Keys, _Failed)) {
+                _Submit_file(_Path, _Options, _Scheduler, _Keys, _Failed, nullptr);
+            }
+
+            ++_Submitted;
+            _Kdf.wait(_Max_derivations);
+            _Scheduler.wait(_Max_pending);
+        }
+
+        _Kdf.wait(); // the remaining files are queued on the workers by now
+        _Scheduler.wait();
+        const size_t _Failed_count = _Failed.load(::std::memory_order_relaxed);
+        ::printf("Processed %zu files, %zu failed.\n", _Submitted, _Failed_count);
+        return _Failed_count == 0 ? _App_error::_Success : _App_error::_Batch_failed;
+    }
+
+    inline bool _Open_stream_source(const program_options& _Options, file& _File) {
+        if (_Options.use_stdin) {
+            return efc_impl::_Open_standard_stream(STD_INPUT_HANDLE, _File);
+        }
+
+        return _File.open(_Options.path_to_file, file_access::read, file_share::read);
+    }
+
+    inline _App_error _Perform_stream_encryption(program_options& _Options) {
+        if (_Options.format != file_format::chunked) { // the legacy format stores the tag before the data
+            return _App_error::_Streaming_not_supported;
+        }
+
+        file _Src_file;
+        file _Dest_file;
+        if (!_Open_stream_source(_Options, _Src_file)
+            || !efc_impl::_Open_standard_stream(STD_OUTPUT_HANDLE, _Dest_file)) {
+            return _App_error::_Invalid_file;
+        }
+
+        file_stream _Src_stream(_Src_file);
+        file_stream _Dest_stream(_Dest_file);
+        file_metadata _Meta =
+            construct_metadata(file_format::chunked, file_feature::kdf_params | file_feature::key_check);
+        _Meta.kdf        = _Key_derivation_function(_Options);
+        _Meta.kdf_params = _Options.kdf_params;
+        const key& _Key  = _Make_master_key(_Options, _Meta.salt, _Meta.kdf_params);
+        if (!_Key.valid()) {
+            return _App_error::_Key_derivation_failed;
+        }
+
+        _Meta.key_check = compute_key_check(_Key);
+        if (!_Meta.key_check.valid()) {
+            return _App_error::_Key_derivation_failed;
+        }
+
+        if (!store_metadata(_Dest_stream, _Meta)) {
+            return _App_error::_Metadata_store_failed;
+        }
+
+        stream_encryption_engine _SEng(_Src_stream, _Dest_stream);
+        return _SEng.encrypt(_Key, _Meta) ? _App_error::_Success : _App_error::_Encryption_failed;
+    }
+
+    inline _App_error _Perform_stream_decryption(program_options& _Options) {
+        file _Src_file;
+        file _Dest_file;
+        if (!_Open_stream_source(_Options, _Src_file)
+            || !efc_impl::_Open_standard_stream(STD_OUTPUT_HANDLE, _Dest_file)) {
+            return _App_error::_Invalid_file;
+        }
+
+        file_stream _Src_stream(_Src_file);
+        file_stream _Dest_stream(_Dest_file);
+        const file_metadata& _Meta = load_metadata(_Src_stream);
+        if (!_Meta.signature.is_recognized()) { // signature not recognized, break
+            return _App_error::_Signature_not_recognized;
+        }
+
+        if (_Meta.signature.format() != file_format::chunked) {
+            return _App_error::_Streaming_not_supported;
+        }
+
+        if (!_Is_matching_key_type(_Options, _Meta)) {
+            return _App_error::_Wrong_key_type;
+        }
+
+        const key& _Key         = _Derive_file_key(_Options, _Meta, nullptr);
+        const _App_error _Error = _Check_file_key(_Meta, _Key);
+        if (_Error != _App_error::_Success) { // nothing has been written yet
+            return _Error;
+        }
+
+        stream_encryption_engine _SEng(_Src_stream, _Dest_stream);
+        return _SEng.decrypt(_Key, _Meta) ? _App_error::_Success : _App_error::_Decryption_failed;
+    }
+
+    inline _App_error _Perform_calibration(const program_options& _Options) {
+        ::printf("Calibrating the key derivation for %u ms...\n", _Options.target_time);
+        const key_derivation_params& _Params = calibrate_key_derivation(_Options.target_time);
+        using _Clock                         = ::std::chrono::steady_clock;
+        const _Clock::time_point _Start      = _Clock::now();
+        const key& _Key                      = derive_key(unicode_string_view{}, generate_salt(), _Params);
+        const long long _Elapsed =
+            ::std::chrono::duration_cast<::std::chrono::milliseconds>(_Clock::now() - _Start).count();
+        if (!_Key.valid()) {
+            return _App_error::_Key_derivation_failed;
+        }
+
+        ::printf("Argon2id with %u MiB, %u passes and %u lanes takes %lld ms on this machine.\n"
+            "Encrypt with --kdf=%u,%u,%u to use these parameters.\n", _Params.memory / 1024, _Params.iterations,
+            _Params.lanes, _Elapsed, _Params.memory, _Params.iterations, _Params.lanes);
+        return _App_error::_Success;
+    }
+
+    inline ::std::atomic<key_agent*> _Running_agent(nullptr); // stopped by _Stop_service()
+    inline ::std::atomic<job_server*> _Running_server(nullptr); // stopped by _Stop_service()
+
+    inline BOOL WINAPI _Stop_service(const DWORD) noexcept {
+        key_agent* const _Agent = _Running_agent.load();
+        if (_Agent) {
+            _Agent->stop();
+        }
+
+        job_server* const _Server = _Running_server.load();
+        if (_Server) {
+            _Server->stop();
+        }
+
+        return TRUE; // handled, run() returns and the process exits normally
+    }
+
+    inline _App_error _Perform_agent(const program_options& _Options) {
+        key_agent _Agent(_Options.agent_ttl);
+        if (!_Agent.is_valid()) {
+            return _App_error::_Agent_failed;
+        }
+
+        _Running_agent.store(&_Agent);
+        ::SetConsoleCtrlHandler(&_Stop_service, TRUE);
+        ::printf("The key agent is running, the keys are held for %u seconds. Press Ctrl+C to stop it.\n",
+            _Agent.ttl());
+        const bool _Succeeded = _Agent.run();
+        ::SetConsoleCtrlHandler(&_Stop_service, FALSE);
+        _Running_agent.store(nullptr);
+        return _Succeeded ? _App_error::_Success : _App_error::_Agent_failed;
+    }
+
+    inline _App_error _Run_job(const job_type _Type, const path& _Path, const program_options& _Options,
+        work_stealing_scheduler& _Scheduler, _Batch_keys& _Keys) {
+        switch (_Type) {
+        case job_type::encryption:
+            return _Encrypt_file(_Path, _Options, &_Scheduler, &_Keys);
+        case job_type::decryption:
+            return _Decrypt_file(_Path, _Options, &_Scheduler, &_Keys, nullptr);
+        case job_type::verification:
+            return _Verify_file(_Path, _Options, &_Keys);
+        default:
+            return _App_error::_Operation_not_specified;
+        }
+    }
+
+    inline _App_error _Perform_service(const program_options& _Options) {
+        // Note: The jobs share the keys like the files of a recursive run. The master key of the encryption
+        //       is derived once, at startup, and the master keys found by the decryption are cached.
+        _Batch_keys _Keys(_Options); // must outlive the scheduler
+        if (_Options.format == file_format::chunked && !_Keys._Prepare_encryption()) {
+            return _App_error::_Key_derivation_failed;
+        }
+
+        work_stealing_scheduler _Scheduler; // must outlive the server, which queues the jobs
+        if (!_Scheduler.is_running()) {
+            return _App_error::_Unknown_error;
+        }
+
+        job_server _Server(_Scheduler,
+            [&_Options, &_Scheduler, &_Keys](const job_type _Type, const path& _Path, uint64_t& _Bytes) {
+                _Bytes = file(_Path, file_access::read, file_share::read).size();
+                return static_cast<uint32_t>(_Run_job(_Type, _Path, _Options, _Scheduler, _Keys));
+            });
+        if (!_Server.is_valid()) {
+            return _App_error::_Server_failed;
+        }
+
+        _Running_server.store(&_Server);
+        ::SetConsoleCtrlHandler(&_Stop_service, TRUE);
+        ::printf("The job server is running on %zu workers. Press Ctrl+C to stop it.\n", _Scheduler.worker_count());
+        const bool _Succeeded = _Server.run();
+        ::SetConsoleCtrlHandler(&_Stop_service, FALSE);
+        _Running_server.store(nullptr);
+        const job_server_stats& _Stats = _Server.stats();
+        ::printf("Completed %llu jobs, %llu failed. Latency: p50 %llu us, p99 %llu us, max %llu us.\n",
+            static_cast<unsigned long long>(_Stats.completed), static_cast<unsigned long long>(_Stats.failed),
+            static_cast<unsigned long long>(_Stats.p50), static_cast<unsigned long long>(_Stats.p99),
+            static_cast<unsigned long long>(_Stats.max));
+        return _Succeeded ? _App_error::_Success : _App_error::_Server_failed;
+    }
+
+    inline _App_error _Unsafe_entry_point(program_options& _Options) {
+        if (_Options.operation == operation::help) { // neither path nor key is required
+            _Show_help();
+            return _App_error::_Success;
+        }
+
+        if (_Options.operation == operation::calibration) { // neither path nor key is required
+            return _Perform_calibration(_Options);
+        }
+
+        if (_Options.operation == operation::agent) { // the keys are requested by the other processes
+            return _Perform_agent(_Options);
+        }
+
+        if (_Options.use_stdin && !_Options.use_stdout) { // there is no file to write to
+            return _App_error::_Output_not_specified;
+        }
+
+        // Note: The server receives the paths with the jobs.
+        if (_Options.path_to_file.empty() && !_Options.use_stdin && _Options.operation != operation::service) {
+            return _App_error::_Path_not_specified;
+        }
+
+        if (_Options.password.empty() && !_Options.raw_key.valid()) { // the raw key replaces the password
+            return _App_error::_Password_not_specified;
+        }
+
+        if (_Options.raw_key.valid()
+            && (_Options.operation == operation::encryption || _Options.operation == operation::service)
+            && _Options.format == file_format::legacy) { // only the chunked format records that no KDF is used
+            return _App_error::_Raw_key_not_supported;
+        }
+
+        if (_Options.operation == operation::service) { // the jobs run until the server is stopped
+            return _Perform_service(_Options);
+        }
+
+        if (_Options.use_stdout) { // the data is streamed, no file is created
+            switch (_Options.operation) {
+            case operation::encryption:
+                return _Perform_stream_encryption(_Options);
+            case operation::decryption:
+                return _Perform_stream_decryption(_Options);
+            default:
+                return _App_error::_Operation_not_specified;
+            }
+        }
+
+        if (_Options.recursive && ::mjx::is_directory(_Options.path_to_file)) {
+            return _Options.operation == operation::encryption || _Options.operation == operation::decryption
+                ? _Perform_recursive(_Options) : _App_error::_Operation_not_specified;
+        }
+
+        switch (_Options.operation) {
+        case operation::encryption:
+            return _Perform_encryption(_Options);
+        case operation::decryption:
+            return _Perform_decryption(_Options);
+        default:
+            return _App_error::_Operation_not_specified;
+        }
+    }
+
+    inline int _Entry_point(program_options& _Options) noexcept {
+        _App_error _Error;
+        try {
+            _Error = _Unsafe_entry_point(_Options);
+        } catch (...) {
+            _Error = _App_error::_Unknown_error;
+        }
+
+        if (_Error != _App_error::_Success) { // report an error
+            _Report_error(_Error);
+        }
+
+        return static_cast<int>(_Error);
+    }
+} // namespace mjx
+
+#endif // _EFC_IMPL_APP_HPP_
\ No newline at end of file
@@ -0,0 +1,384 @@
+// argon2.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_IMPL_ARGON2_HPP_
+#define _EFC_IMPL_ARGON2_HPP_
+#include <algorithm>
+#include <botan/blake2b.h>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <efc/impl/argon2_compress.hpp>
+#include <efc/impl/parallel.hpp>
+#include <efc/impl/secure_memory.hpp>
+#include <memory>
+#include <mjstr/char_traits.hpp>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace mjx {
+    namespace efc_impl {
+        // Note: Argon2id version 1.3, as specified in RFC 9106. The lanes of every slice are computed
+        //       at once by separate threads, which synchronize after each slice.
+        inline constexpr size_t _Argon2_sync_points  = 4; // the number of slices in a pass
+        inline constexpr uint32_t _Argon2_version    = 0x13;
+        inline constexpr uint32_t _Argon2id_type     = 2;
+        inline constexpr size_t _Argon2_prehash_size = 64;
+
+        struct _Argon2_input {
+            const byte_t* _Password = nullptr;
+            size_t _Password_size   = 0;
+            const byte_t* _Salt     = nullptr;
+            size_t _Salt_size       = 0;
+            const byte_t* _Secret   = nullptr; // optional
+            size_t _Secret_size     = 0;
+            const byte_t* _Data     = nullptr; // optional associated data
+            size_t _Data_size       = 0;
+            uint32_t _Memory        = 0; // memory amount in KiB
+            uint32_t _Iterations    = 0;
+            uint32_t _Lanes         = 0;
+        };
+
+        inline void _Store_le32(byte_t* const _Bytes, const uint32_t _Value) noexcept {
+            for (size_t _Idx = 0; _Idx < sizeof(uint32_t); ++_Idx) {
+                _Bytes[_Idx] = static_cast<byte_t>(_Value >> (_Idx * 8));
+            }
+        }
+
+        inline void _Load_block(_Argon2_block& _Block, const byte_t* const _Bytes) noexcept {
+            for (size_t _Idx = 0; _Idx < _Argon2_block_words; ++_Idx) { // words are stored in little-endian order
+                uint64_t _Word = 0;
+                for (size_t _Byte = 0; _Byte < sizeof(uint64_t); ++_Byte) {
+                    _Word |= static_cast<uint64_t>(_Bytes[_Idx * 8 + _Byte]) << (_Byte * 8);
+                }
+
+                _Block._Words[_Idx] = _Word;
+            }
+        }
+
+        inline void _Store_block(byte_t* const _Bytes, const _Argon2_block& _Block) noexcept {
+            for (size_t _Idx = 0; _Idx < _Argon2_block_words; ++_Idx) {
+                for (size_t _Byte = 0; _Byte < sizeof(uint64_t); ++_Byte) {
+                    _Bytes[_Idx * 8 + _Byte] = static_cast<byte_t>(_Block._Words[_Idx] >> (_Byte * 8));
+                }
+            }
+        }
+
+        inline void _Hash_long(byte_t* const _Out, const uint32_t _Out_size,
+            const byte_t* const _In, const size_t _In_size, const byte_t* const _In2 = nullptr,
+            const size_t _In2_size = 0) { // H' from RFC 9106, may throw
+            byte_t _Size_bytes[sizeof(uint32_t)];
+            _Store_le32(_Size_bytes, _Out_size);
+            if (_Out_size <= 64) {
+                ::Botan::BLAKE2b _Hash(_Out_size * 8);
+                _Hash.update(_Size_bytes, sizeof(_Size_bytes));
+                _Hash.update(_In, _In_size);
+                _Hash.update(_In2, _In2_size);
+                _Hash.final(_Out);
+                return;
+            }
+
+            ::Botan::BLAKE2b _Hash(512);
+            byte_t _Block[64];
+            _Hash.update(_Size_bytes, sizeof(_Size_bytes));
+            _Hash.update(_In, _In_size);
+            _Hash.update(_In2, _In2_size);
+            _Hash.final(_Block);
+            size_t _Off = 0;
+            for (;;) { // the first half of each intermediate hash is used
+                ::memcpy(_Out + _Off, _Block, 32);
+                _Off += 32;
+                if (_Out_size - _Off <= 64) {
+                    break;
+                }
+
+                _Hash.update(_Block, sizeof(_Block));
+                _Hash.final(_Block);
+            }
+
+            // Note: The last hash has the remaining size, which may differ from the intermediate ones.
+            ::Botan::BLAKE2b _Last_hash(static_cast<size_t>(_Out_size - _Off) * 8);
+            _Last_hash.update(_Block, sizeof(_Block));
+            _Last_hash.final(_Out + _Off);
+            _Wipe_memory(_Block, sizeof(_Block));
+        }
+
+        class _Argon2_barrier { // synchronizes the threads after each slice
+        public:
+            _Argon2_barrier() noexcept : _Mymtx(), _Mycv(), _Mycount(0), _Myarrived(0), _Mygeneration(0) {}
+
+            void _Start(const size_t _Count) noexcept {
+                ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+                _Mycount = _Count;
+                _Mycv.notify_all();
+            }
+
+            size_t _Wait_for_start() noexcept { // returns the number of threads
+                ::std::unique_lock<::std::mutex> _Lock(_Mymtx);
+                _Mycv.wait(_Lock, [this] { return _Mycount != 0; });
+                return _Mycount;
+            }
+
+            void _Arrive_and_wait() noexcept {
+                ::std::unique_lock<::std::mutex> _Lock(_Mymtx);
+                const size_t _Generation = _Mygeneration;
+                if (++_Myarrived == _Mycount) {
+                    _Myarrived = 0;
+                    ++_Mygeneration;
+                    _Mycv.notify_all();
+                } else {
+                    _Mycv.wait(_Lock, [this, _Generation] { return _Mygeneration != _Generation; });
+                }
+            }
+
+        private:
+            ::std::mutex _Mymtx;
+            ::std::condition_variable _Mycv;
+            size_t _Mycount;
+            size_t _Myarrived;
+            size_t _Mygeneration;
+        };
+
+        class _Argon2_context {
+        public:
+            _Argon2_context(_Argon2_block* const _Memory, const _Argon2_input& _Input,
+                const _Argon2_kernel _Kernel = _Best_argon2_kernel()) noexcept
+                : _Mymemory(_Memory), _Mycompress(_Get_argon2_compress(_Kernel)), _Mylanes(_Input._Lanes),
+                _Mypasses(_Input._Iterations),
+                _Mysegment_size(_Block_count(_Input) / (_Argon2_sync_points * _Input._Lanes)),
+                _Mylane_size(_Mysegment_size * _Argon2_sync_points), _Mytotal_blocks(_Mylane_size * _Input._Lanes) {}
+
+            // returns the number of blocks, the memory amount rounded down to a multiple of 4 lanes
+            static size_t _Block_count(const _Argon2_input& _Input) noexcept {
+                const size_t _Blocks = (::std::max)(_Input._Memory, 8 * _Input._Lanes);
+                return _Blocks - _Blocks % (_Argon2_sync_points * _Input._Lanes);
+            }
+
+            void _Fill_first_blocks(const byte_t* const _Prehash) {
+                byte_t _Suffix[sizeof(uint32_t) * 2];
+                byte_t _Bytes[sizeof(_Argon2_block)];
+                for (uint32_t _Lane = 0; _Lane < _Mylanes; ++_Lane) {
+                    for (uint32_t _Column = 0; _Column < 2; ++_Column) {
+                        _Store_le32(_Suffix, _Column);
+                        _Store_le32(_Suffix + sizeof(uint32_t), _Lane);
+                        _Hash_long(_Bytes, sizeof(_Bytes), _Prehash, _Argon2_prehash_size, _Suffix, sizeof(_Suffix));
+                        _Load_block(_Mymemory[_Lane * _Mylane_size + _Column], _Bytes);
+                    }
+                }
+
+                _Wipe_memory(_Bytes, sizeof(_Bytes));
+            }
+
+            void _Fill_segment(const uint32_t _Pass, const uint32_t _Lane, const uint32_t _Slice) noexcept {
+                const bool _Independent = _Pass == 0 && _Slice < _Argon2_sync_points / 2;
+                _Argon2_block _Input_block = {};
+                _Argon2_block _Addresses   = {};
+                const _Argon2_block _Zero  = {};
+                if (_Independent) {
+                    _Input_block._Words[0] = _Pass;
+                    _Input_block._Words[1] = _Lane;
+                    _Input_block._Words[2] = _Slice;
+                    _Input_block._Words[3] = _Mytotal_blocks;
+                    _Input_block._Words[4] = _Mypasses;
+                    _Input_block._Words[5] = _Argon2id_type;
+                }
+
+                const size_t _First = _Pass == 0 && _Slice == 0 ? 2 : 0; // the first two blocks are already filled
+                if (_Independent && _First != 0) {
+                    _Next_addresses(_Addresses, _Input_block, _Zero);
+                }
+
+                size_t _Offset = _Lane * _Mylane_size + _Slice * _Mysegment_size + _First;
+                for (size_t _Idx = _First; _Idx < _Mysegment_size; ++_Idx, ++_Offset) {
+                    const size_t _Prev = _Offset % _Mylane_size == 0 ? _Offset + _Mylane_size - 1 : _Offset - 1;
+                    uint64_t _Pseudo_random;
+                    if (_Independent) {
+                        if (_Idx % _Argon2_block_words == 0) {
+                            _Next_addresses(_Addresses, _Input_block, _Zero);
+                        }
+
+                        _Pseudo_random = _Addresses._Words[_Idx % _Argon2_block_words];
+                    } else {
+                        _Pseudo_random = _Mymemory[_Prev]._Words[0];
+                    }
+
+                    const size_t _Ref_lane = _Pass == 0 && _Slice == 0 ? _Lane : (_Pseudo_random >> 32) % _Mylanes;
+                    const size_t _Ref_idx  = _Reference_index(_Pass, _Slice, _Idx, _Ref_lane == _Lane,
+                        static_cast<uint32_t>(_Pseudo_random));
+                    _Mycompress(_Mymemory[_Offset], _Mymemory[_Prev], _Mymemory[_Ref_lane * _Mylane_size + _Ref_idx],
+                        _Pass != 0); // version 1.3 XORs the new block into the old one
+                }
+            }
+
+            void _Finalize(byte_t* const _Out, const uint32_t _Out_size) {
+                _Argon2_block _Final = _Mymemory[_Mylane_size - 1];
+                for (size_t _Lane = 1; _Lane < _Mylanes; ++_Lane) {
+                    const _Argon2_block& _Last = _Mymemory[_Lane * _Mylane_size + _Mylane_size - 1];
+                    for (size_t _Idx = 0; _Idx < _Argon2_block_words; ++_Idx) {
+                        _Final._Words[_Idx] ^= _Last._Words[_Idx];
+                    }
+                }
+
+                byte_t _Bytes[sizeof(_Argon2_block)];
+                _Store_block(_Bytes, _Final);
+                _Hash_long(_Out, _Out_size, _Bytes, sizeof(_Bytes));
+                _Wipe_memory(_Bytes, sizeof(_Bytes));
+                _Wipe_memory(&_Final, sizeof(_Final));
+            }
+
+            uint32_t _Lanes() const noexcept {
+                return _Mylanes;
+            }
+
+            uint32_t _Passes() const noexcept {
+                return _Mypasses;
+            }
+
+        private:
+            void _Next_addresses(_Argon2_block& _Addresses, _Argon2_block& _Input_block,
+                const _Argon2_block& _Zero) const noexcept {
+                ++_Input_block._Words[6];
+                _Mycompress(_Addresses, _Zero, _Input_block, false);
+                _Mycompress(_Addresses, _Zero, _Addresses, false);
+            }
+
+            size_t _Reference_index(const uint32_t _Pass, const uint32_t _Slice, const size_t _Idx,
+                const bool _Same_lane, const uint32_t _Pseudo_random) const noexcept {
+                // Note: The reference area contains the finished segments, and the blocks of the current
+                //       segment filled so far if the lane is the same. The previous block is never referenced.
+                size_t _Area;
+                if (_Pass == 0) {
+                    _Area = _Slice * _Mysegment_size;
+                } else {
+                    _Area = _Mylane_size - _Mysegment_size;
+                }
+
+                if (_Same_lane) {
+                    _Area += _Idx - 1;
+                } else if (_Idx == 0) {
+                    --_Area;
+                }
+
+                uint64_t _Relative = static_cast<uint64_t>(_Pseudo_random) * _Pseudo_random >> 32;
+                _Relative          = _Area - 1 - (_Area * _Relative >> 32);
+                const size_t _Start =
+                    _Pass != 0 && _Slice != _Argon2_sync_points - 1 ? (_Slice + 1) * _Mysegment_size : 0;
+                return (_Start + _Relative) % _Mylane_size;
+            }
+
+            _Argon2_block* _Mymemory;
+            _Argon2_compress_fn _Mycompress;
+            uint32_t _Mylanes;
+            uint32_t _Mypasses;
+            size_t _Mysegment_size;
+            size_t _Mylane_size;
+            size_t _Mytotal_blocks;
+        };
+
+        inline void _Argon2_prehash(byte_t* const _Prehash, const _Argon2_input& _Input, const uint32_t _Out_size) {
+            byte_t _Bytes[sizeof(uint32_t)];
+            ::Botan::BLAKE2b _Hash(_Argon2_prehash_size * 8);
+            const uint32_t _Params[] = {
+                _Input._Lanes, _Out_size, _Input._Memory, _Input._Iterations, _Argon2_version, _Argon2id_type};
+            for (const uint32_t _Param : _Params) {
+                _Store_le32(_Bytes, _Param);
+                _Hash.update(_Bytes, sizeof(_Bytes));
+            }
+
+            const ::std::pair<const byte_t*, size_t> _Fields[] = {{_Input._Password, _Input._Password_size},
+                {_Input._Salt, _Input._Salt_size}, {_Input._Secret, _Input._Secret_size},
+                {_Input._Data, _Input._Data_size}};
+            for (const auto& _Field : _Fields) { // every field is preceded by its length
+                _Store_le32(_Bytes, static_cast<uint32_t>(_Field.second));
+                _Hash.update(_Bytes, sizeof(_Bytes));
+                _Hash.update(_Field.first, _Field.second);
+            }
+
+            _Hash.final(_Prehash);
+        }
+
+        inline void _Argon2_fill(_Argon2_context& _Context, const size_t _Threads) noexcept {
+            // Note: Every thread computes the lanes congruent to its index, so that fewer threads
+            //       than lanes still produce the same result.
+            _Argon2_barrier _Barrier;
+            const auto _Work = [&_Context, &_Barrier](const size_t _Thread) noexcept {
+                const size_t _Count = _Barrier._Wait_for_start();
+                for (uint32_t _Pass = 0; _Pass < _Context._Passes(); ++_Pass) {
+                    for (uint32_t _Slice = 0; _Slice < _Argon2_sync_points; ++_Slice) {
+                        for (size_t _Lane = _Thread; _Lane < _Context._Lanes(); _Lane += _Count) {
+                            _Context._Fill_segment(_Pass, static_cast<uint32_t>(_Lane), _Slice);
+                        }
+
+                        _Barrier._Arrive_and_wait();
+                    }
+                }
+            };
+
+            ::std::vector<::std::thread> _Workers;
+            try {
+                _Workers.reserve(_Threads - 1);
+                for (size_t _Idx = 1; _Idx < _Threads; ++_Idx) {
+                    _Workers.emplace_back(_Work, _Idx);
+                }
+            } catch (...) { // continue with the threads started so far
+            }
+
+            _Barrier._Start(_Workers.size() + 1);
+            _Work(0);
+            for (::std::thread& _Worker : _Workers) {
+                _Worker.join();
+            }
+        }
+
+        inline bool _Argon2id_with_memory(byte_t* const _Out, const uint32_t _Out_size, const _Argon2_input& _Input,
+            _Argon2_block* const _Memory, const size_t _Max_threads = 0,
+            const _Argon2_kernel _Kernel = _Best_argon2_kernel()) noexcept {
+            // Note: _Memory must hold _Argon2_context::_Block_count() blocks, they are wiped before returning.
+            if (_Out_size < 4 || _Input._Lanes == 0 || _Input._Iterations == 0
+                || !_Is_argon2_kernel_supported(_Kernel)) {
+                return false;
+            }
+
+            bool _Succeeded = true;
+            try {
+                byte_t _Prehash[_Argon2_prehash_size];
+                _Argon2_prehash(_Prehash, _Input, _Out_size);
+                _Argon2_context _Context(_Memory, _Input, _Kernel);
+                _Context._Fill_first_blocks(_Prehash);
+                _Wipe_memory(_Prehash, sizeof(_Prehash));
+                const size_t _Threads = (::std::min)(static_cast<size_t>(_Input._Lanes),
+                    _Max_threads != 0 ? _Max_threads : _Default_thread_count());
+                _Argon2_fill(_Context, _Threads);
+                _Context._Finalize(_Out, _Out_size);
+            } catch (...) {
+                _Succeeded = false;
+            }
+
+            _Wipe_memory(_Memory, _Argon2_context::_Block_count(_Input) * sizeof(_Argon2_block));
+            return _Succeeded;
+        }
+
+        inline bool _Argon2id(byte_t* const _Out, const uint32_t _Out_size, const _Argon2_input& _Input,
+            const size_t _Max_threads = 0, const _Argon2_kernel _Kernel = _Best_argon2_kernel()) noexcept {
+            if (_Input._Lanes == 0) { // the number of blocks depends on the lanes
+                return false;
+            }
+
+            ::std::unique_ptr<_Argon2_block[]> _Memory(
+                new (::std::nothrow) _Argon2_block[_Argon2_context::_Block_count(_Input)]);
+            if (!_Memory) {
+                return false;
+            }
+
+            return _Argon2id_with_memory(_Out, _Out_size, _Input, _Memory.get(), _Max_threads, _Kernel);
+        }
+    } // namespace efc_impl
+} // namespace mjx
+
+#endif // _EFC_IMPL_ARGON2_HPP_
\ No newline at end of file
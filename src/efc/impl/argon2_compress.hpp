@@ -0,0 +1,466 @@
+// argon2_compress.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_IMPL_ARGON2_COMPRESS_HPP_
+#define _EFC_IMPL_ARGON2_COMPRESS_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <efc/impl/cpu_features.hpp>
+#include <immintrin.h>
+#include <utility>
+
+namespace mjx {
+    namespace efc_impl {
+        inline constexpr size_t _Argon2_block_words = 128; // 1 KiB
+
+        struct alignas(64) _Argon2_block {
+            uint64_t _Words[_Argon2_block_words];
+        };
+
+        enum class _Argon2_kernel : unsigned char { // compression kernels, from the slowest to the fastest
+            _Generic,
+            _Ssse3,
+            _Avx2,
+            _Avx512
+        };
+
+        // the compression function G, XORs the result into the destination block if requested
+        using _Argon2_compress_fn = void (*)(
+            _Argon2_block&, const _Argon2_block&, const _Argon2_block&, const bool) noexcept;
+
+        inline uint64_t _Rotate_right(const uint64_t _Value, const int _Shift) noexcept {
+            return (_Value >> _Shift) | (_Value << (64 - _Shift));
+        }
+
+        inline uint64_t _Blamka(const uint64_t _Left, const uint64_t _Right) noexcept {
+            return _Left + _Right + 2 * (_Left & 0xFFFF'FFFF) * (_Right & 0xFFFF'FFFF);
+        }
+
+        inline void _Mix(uint64_t& _Av, uint64_t& _Bv, uint64_t& _Cv, uint64_t& _Dv) noexcept {
+            _Av = _Blamka(_Av, _Bv);
+            _Dv = _Rotate_right(_Dv ^ _Av, 32);
+            _Cv = _Blamka(_Cv, _Dv);
+            _Bv = _Rotate_right(_Bv ^ _Cv, 24);
+            _Av = _Blamka(_Av, _Bv);
+            _Dv = _Rotate_right(_Dv ^ _Av, 16);
+            _Cv = _Blamka(_Cv, _Dv);
+            _Bv = _Rotate_right(_Bv ^ _Cv, 63);
+        }
+
+        inline void _Permute(uint64_t* const _Words, const size_t _Stride) noexcept {
+            // applies the permutation P to 8 pairs of words, the pairs are _Stride words apart
+            uint64_t* _Vx[16];
+            for (size_t _Idx = 0; _Idx < 8; ++_Idx) {
+                _Vx[_Idx * 2]     = _Words + _Idx * _Stride;
+                _Vx[_Idx * 2 + 1] = _Words + _Idx * _Stride + 1;
+            }
+
+            _Mix(*_Vx[0], *_Vx[4], *_Vx[8], *_Vx[12]);
+            _Mix(*_Vx[1], *_Vx[5], *_Vx[9], *_Vx[13]);
+            _Mix(*_Vx[2], *_Vx[6], *_Vx[10], *_Vx[14]);
+            _Mix(*_Vx[3], *_Vx[7], *_Vx[11], *_Vx[15]);
+            _Mix(*_Vx[0], *_Vx[5], *_Vx[10], *_Vx[15]);
+            _Mix(*_Vx[1], *_Vx[6], *_Vx[11], *_Vx[12]);
+            _Mix(*_Vx[2], *_Vx[7], *_Vx[8], *_Vx[13]);
+            _Mix(*_Vx[3], *_Vx[4], *_Vx[9], *_Vx[14]);
+        }
+
+        inline void _Compress_generic(_Argon2_block& _Dest, const _Argon2_block& _Prev, const _Argon2_block& _Ref,
+            const bool _Xor_dest) noexcept {
+            _Argon2_block _Rx;
+            _Argon2_block _Zx;
+            for (size_t _Idx = 0; _Idx < _Argon2_block_words; ++_Idx) {
+                _Rx._Words[_Idx] = _Prev._Words[_Idx] ^ _Ref._Words[_Idx];
+            }
+
+            _Zx = _Rx;
+            for (size_t _Row = 0; _Row < 8; ++_Row) { // 8 rows of 16 consecutive words
+                _Permute(_Zx._Words + _Row * 16, 2);
+            }
+
+            for (size_t _Column = 0; _Column < 8; ++_Column) { // 8 columns of 8 pairs, 16 words apart
+                _Permute(_Zx._Words + _Column * 2, 16);
+            }
+
+            for (size_t _Idx = 0; _Idx < _Argon2_block_words; ++_Idx) {
+                const uint64_t _Word = _Zx._Words[_Idx] ^ _Rx._Words[_Idx];
+                _Dest._Words[_Idx]   = _Xor_dest ? _Dest._Words[_Idx] ^ _Word : _Word;
+            }
+        }
+
+        // Note: The vectorized kernels compute the same rounds as _Compress_generic(). Each function of
+        //       a round mixes A with B, C and D, where A, B, C and D hold 4 words of one row or column.
+        //       The SSSE3 kernel keeps 2 words per register, so A0 and A1 hold the first and second half of A.
+        inline __m128i _Blamka_ssse3(const __m128i _Left, const __m128i _Right) noexcept {
+            const __m128i _Product = _mm_mul_epu32(_Left, _Right);
+            return _mm_add_epi64(_mm_add_epi64(_Left, _Right), _mm_add_epi64(_Product, _Product));
+        }
+
+        template <int _Shift>
+        inline __m128i _Rotate_right_ssse3(const __m128i _Value) noexcept {
+            if constexpr (_Shift == 32) {
+                return _mm_shuffle_epi32(_Value, _MM_SHUFFLE(2, 3, 0, 1));
+            } else if constexpr (_Shift == 24) {
+                return _mm_shuffle_epi8(
+                    _Value, _mm_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10));
+            } else if constexpr (_Shift == 16) {
+                return _mm_shuffle_epi8(
+                    _Value, _mm_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9));
+            } else { // rotating right by 63 bits is the same as rotating left by 1 bit
+                return _mm_xor_si128(_mm_srli_epi64(_Value, 63), _mm_add_epi64(_Value, _Value));
+            }
+        }
+
+        template <int _Shift0, int _Shift1>
+        inline void _Half_mix_ssse3(__m128i& _A0, __m128i& _A1, __m128i& _B0, __m128i& _B1, __m128i& _C0,
+            __m128i& _C1, __m128i& _D0, __m128i& _D1) noexcept {
+            _A0 = _Blamka_ssse3(_A0, _B0);
+            _A1 = _Blamka_ssse3(_A1, _B1);
+            _D0 = _Rotate_right_ssse3<_Shift0>(_mm_xor_si128(_D0, _A0));
+            _D1 = _Rotate_right_ssse3<_Shift0>(_mm_xor_si128(_D1, _A1));
+            _C0 = _Blamka_ssse3(_C0, _D0);
+            _C1 = _Blamka_ssse3(_C1, _D1);
+            _B0 = _Rotate_right_ssse3<_Shift1>(_mm_xor_si128(_B0, _C0));
+            _B1 = _Rotate_right_ssse3<_Shift1>(_mm_xor_si128(_B1, _C1));
+        }
+
+        inline void _Round_ssse3(__m128i& _A0, __m128i& _A1, __m128i& _B0, __m128i& _B1, __m128i& _C0,
+            __m128i& _C1, __m128i& _D0, __m128i& _D1) noexcept {
+            _Half_mix_ssse3<32, 24>(_A0, _A1, _B0, _B1, _C0, _C1, _D0, _D1);
+            _Half_mix_ssse3<16, 63>(_A0, _A1, _B0, _B1, _C0, _C1, _D0, _D1);
+
+            // rotate B, C and D by 1, 2 and 3 words to mix the diagonals
+            __m128i _Temp0 = _mm_alignr_epi8(_B1, _B0, 8);
+            __m128i _Temp1 = _mm_alignr_epi8(_B0, _B1, 8);
+            _B0            = _Temp0;
+            _B1            = _Temp1;
+            ::std::swap(_C0, _C1);
+            _Temp0 = _mm_alignr_epi8(_D1, _D0, 8);
+            _Temp1 = _mm_alignr_epi8(_D0, _D1, 8);
+            _D0    = _Temp1;
+            _D1    = _Temp0;
+            _Half_mix_ssse3<32, 24>(_A0, _A1, _B0, _B1, _C0, _C1, _D0, _D1);
+            _Half_mix_ssse3<16, 63>(_A0, _A1, _B0, _B1, _C0, _C1, _D0, _D1);
+
+            // restore the original order
+            _Temp0 = _mm_alignr_epi8(_B0, _B1, 8);
+            _Temp1 = _mm_alignr_epi8(_B1, _B0, 8);
+            _B0    = _Temp0;
+            _B1    = _Temp1;
+            ::std::swap(_C0, _C1);
+            _Temp0 = _mm_alignr_epi8(_D0, _D1, 8);
+            _Temp1 = _mm_alignr_epi8(_D1, _D0, 8);
+            _D0    = _Temp1;
+            _D1    = _Temp0;
+        }
+
+        inline void _Compress_ssse3(_Argon2_block& _Dest, const _Argon2_block& _Prev, const _Argon2_block& _Ref,
+            const bool _Xor_dest) noexcept {
+            __m128i _Rx[64];
+            __m128i _Zx[64];
+            for (size_t _Idx = 0; _Idx < 64; ++_Idx) {
+                _Rx[_Idx] = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_Prev._Words) + _Idx),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(_Ref._Words) + _Idx));
+                _Zx[_Idx] = _Rx[_Idx];
+            }
+
+            for (size_t _Row = 0; _Row < 8; ++_Row) { // a row fills 8 consecutive registers
+                __m128i* const _Vx = _Zx + _Row * 8;
+                _Round_ssse3(_Vx[0], _Vx[1], _Vx[2], _Vx[3], _Vx[4], _Vx[5], _Vx[6], _Vx[7]);
+            }
+
+            for (size_t _Column = 0; _Column < 8; ++_Column) { // a column takes every 8th register
+                __m128i* const _Vx = _Zx + _Column;
+                _Round_ssse3(_Vx[0], _Vx[8], _Vx[16], _Vx[24], _Vx[32], _Vx[40], _Vx[48], _Vx[56]);
+            }
+
+            __m128i* const _Out = reinterpret_cast<__m128i*>(_Dest._Words);
+            for (size_t _Idx = 0; _Idx < 64; ++_Idx) {
+                __m128i _Value = _mm_xor_si128(_Zx[_Idx], _Rx[_Idx]);
+                if (_Xor_dest) {
+                    _Value = _mm_xor_si128(_Value, _mm_loadu_si128(_Out + _Idx));
+                }
+
+                _mm_storeu_si128(_Out + _Idx, _Value);
+            }
+        }
+
+        // Note: The AVX2 kernel keeps 4 words per register, so one round mixes two rows or two columns
+        //       at once. Registers with index 0 hold the first row or column, and those with index 1
+        //       hold the second one. Columns are interleaved instead, so they are shuffled between rounds.
+        inline __m256i _Blamka_avx2(const __m256i _Left, const __m256i _Right) noexcept {
+            const __m256i _Product = _mm256_mul_epu32(_Left, _Right);
+            return _mm256_add_epi64(_mm256_add_epi64(_Left, _Right), _mm256_add_epi64(_Product, _Product));
+        }
+
+        template <int _Shift>
+        inline __m256i _Rotate_right_avx2(const __m256i _Value) noexcept {
+            if constexpr (_Shift == 32) {
+                return _mm256_shuffle_epi32(_Value, _MM_SHUFFLE(2, 3, 0, 1));
+            } else if constexpr (_Shift == 24) {
+                return _mm256_shuffle_epi8(_Value, _mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15,
+                    8, 9, 10, 3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10));
+            } else if constexpr (_Shift == 16) {
+                return _mm256_shuffle_epi8(_Value, _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14,
+                    15, 8, 9, 2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9));
+            } else {
+                return _mm256_xor_si256(_mm256_srli_epi64(_Value, 63), _mm256_add_epi64(_Value, _Value));
+            }
+        }
+
+        template <int _Shift0, int _Shift1>
+        inline void _Half_mix_avx2(__m256i& _A0, __m256i& _A1, __m256i& _B0, __m256i& _B1, __m256i& _C0,
+            __m256i& _C1, __m256i& _D0, __m256i& _D1) noexcept {
+            _A0 = _Blamka_avx2(_A0, _B0);
+            _A1 = _Blamka_avx2(_A1, _B1);
+            _D0 = _Rotate_right_avx2<_Shift0>(_mm256_xor_si256(_D0, _A0));
+            _D1 = _Rotate_right_avx2<_Shift0>(_mm256_xor_si256(_D1, _A1));
+            _C0 = _Blamka_avx2(_C0, _D0);
+            _C1 = _Blamka_avx2(_C1, _D1);
+            _B0 = _Rotate_right_avx2<_Shift1>(_mm256_xor_si256(_B0, _C0));
+            _B1 = _Rotate_right_avx2<_Shift1>(_mm256_xor_si256(_B1, _C1));
+        }
+
+        inline void _Mix_avx2(__m256i& _A0, __m256i& _A1, __m256i& _B0, __m256i& _B1, __m256i& _C0,
+            __m256i& _C1, __m256i& _D0, __m256i& _D1) noexcept {
+            _Half_mix_avx2<32, 24>(_A0, _A1, _B0, _B1, _C0, _C1, _D0, _D1);
+            _Half_mix_avx2<16, 63>(_A0, _A1, _B0, _B1, _C0, _C1, _D0, _D1);
+        }
+
+        inline void _Row_round_avx2(__m256i& _A0, __m256i& _A1, __m256i& _B0, __m256i& _B1, __m256i& _C0,
+            __m256i& _C1, __m256i& _D0, __m256i& _D1) noexcept {
+            _Mix_avx2(_A0, _A1, _B0, _B1, _C0, _C1, _D0, _D1);
+            _B0 = _mm256_permute4x64_epi64(_B0, _MM_SHUFFLE(0, 3, 2, 1));
+            _B1 = _mm256_permute4x64_epi64(_B1, _MM_SHUFFLE(0, 3, 2, 1));
+            _C0 = _mm256_permute4x64_epi64(_C0, _MM_SHUFFLE(1, 0, 3, 2));
+            _C1 = _mm256_permute4x64_epi64(_C1, _MM_SHUFFLE(1, 0, 3, 2));
+            _D0 = _mm256_permute4x64_epi64(_D0, _MM_SHUFFLE(2, 1, 0, 3));
+            _D1 = _mm256_permute4x64_epi64(_D1, _MM_SHUFFLE(2, 1, 0, 3));
+            _Mix_avx2(_A0, _A1, _B0, _B1, _C0, _C1, _D0, _D1);
+            _B0 = _mm256_permute4x64_epi64(_B0, _MM_SHUFFLE(2, 1, 0, 3));
+            _B1 = _mm256_permute4x64_epi64(_B1, _MM_SHUFFLE(2, 1, 0, 3));
+            _C0 = _mm256_permute4x64_epi64(_C0, _MM_SHUFFLE(1, 0, 3, 2));
+            _C1 = _mm256_permute4x64_epi64(_C1, _MM_SHUFFLE(1, 0, 3, 2));
+            _D0 = _mm256_permute4x64_epi64(_D0, _MM_SHUFFLE(0, 3, 2, 1));
+            _D1 = _mm256_permute4x64_epi64(_D1, _MM_SHUFFLE(0, 3, 2, 1));
+        }
+
+        inline void _Column_round_avx2(__m256i& _A0, __m256i& _A1, __m256i& _B0, __m256i& _B1, __m256i& _C0,
+            __m256i& _C1, __m256i& _D0, __m256i& _D1) noexcept {
+            // each register holds 2 words of both columns, the diagonals are gathered from both halves
+            _Mix_avx2(_A0, _A1, _B0, _B1, _C0, _C1, _D0, _D1);
+            __m256i _Temp0 = _mm256_blend_epi32(_B0, _B1, 0xCC);
+            __m256i _Temp1 = _mm256_blend_epi32(_B0, _B1, 0x33);
+            _B1            = _mm256_permute4x64_epi64(_Temp0, _MM_SHUFFLE(2, 3, 0, 1));
+            _B0            = _mm256_permute4x64_epi64(_Temp1, _MM_SHUFFLE(2, 3, 0, 1));
+            ::std::swap(_C0, _C1);
+            _Temp0 = _mm256_blend_epi32(_D0, _D1, 0xCC);
+            _Temp1 = _mm256_blend_epi32(_D0, _D1, 0x33);
+            _D0    = _mm256_permute4x64_epi64(_Temp0, _MM_SHUFFLE(2, 3, 0, 1));
+            _D1    = _mm256_permute4x64_epi64(_Temp1, _MM_SHUFFLE(2, 3, 0, 1));
+            _Mix_avx2(_A0, _A1, _B0, _B1, _C0, _C1, _D0, _D1);
+            _Temp0 = _mm256_blend_epi32(_B0, _B1, 0xCC);
+            _Temp1 = _mm256_blend_epi32(_B0, _B1, 0x33);
+            _B0    = _mm256_permute4x64_epi64(_Temp0, _MM_SHUFFLE(2, 3, 0, 1));
+            _B1    = _mm256_permute4x64_epi64(_Temp1, _MM_SHUFFLE(2, 3, 0, 1));
+            ::std::swap(_C0, _C1);
+            _Temp0 = _mm256_blend_epi32(_D0, _D1, 0x33);
+            _Temp1 = _mm256_blend_epi32(_D0, _D1, 0xCC);
+            _D0    = _mm256_permute4x64_epi64(_Temp0, _MM_SHUFFLE(2, 3, 0, 1));
+            _D1    = _mm256_permute4x64_epi64(_Temp1, _MM_SHUFFLE(2, 3, 0, 1));
+        }
+
+        inline void _Compress_avx2(_Argon2_block& _Dest, const _Argon2_block& _Prev, const _Argon2_block& _Ref,
+            const bool _Xor_dest) noexcept {
+            __m256i _Rx[32];
+            __m256i _Zx[32];
+            for (size_t _Idx = 0; _Idx < 32; ++_Idx) {
+                _Rx[_Idx] = _mm256_xor_si256(
+                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_Prev._Words) + _Idx),
+                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_Ref._Words) + _Idx));
+                _Zx[_Idx] = _Rx[_Idx];
+            }
+
+            for (size_t _Row = 0; _Row < 4; ++_Row) { // two rows fill 8 consecutive registers
+                __m256i* const _Vx = _Zx + _Row * 8;
+                _Row_round_avx2(_Vx[0], _Vx[4], _Vx[1], _Vx[5], _Vx[2], _Vx[6], _Vx[3], _Vx[7]);
+            }
+
+            for (size_t _Column = 0; _Column < 4; ++_Column) { // two columns take every 4th register
+                __m256i* const _Vx = _Zx + _Column;
+                _Column_round_avx2(_Vx[0], _Vx[4], _Vx[8], _Vx[12], _Vx[16], _Vx[20], _Vx[24], _Vx[28]);
+            }
+
+            __m256i* const _Out = reinterpret_cast<__m256i*>(_Dest._Words);
+            for (size_t _Idx = 0; _Idx < 32; ++_Idx) {
+                __m256i _Value = _mm256_xor_si256(_Zx[_Idx], _Rx[_Idx]);
+                if (_Xor_dest) {
+                    _Value = _mm256_xor_si256(_Value, _mm256_loadu_si256(_Out + _Idx));
+                }
+
+                _mm256_storeu_si256(_Out + _Idx, _Value);
+            }
+        }
+
+        // Note: The AVX-512 kernel keeps 8 words per register, that is the same words of two rows or columns
+        //       in both 256-bit halves. The words are shuffled into this layout before each round.
+        inline __m512i _Blamka_avx512(const __m512i _Left, const __m512i _Right) noexcept {
+            const __m512i _Product = _mm512_mul_epu32(_Left, _Right);
+            return _mm512_add_epi64(_mm512_add_epi64(_Left, _Right), _mm512_add_epi64(_Product, _Product));
+        }
+
+        template <int _Shift0, int _Shift1>
+        inline void _Half_mix_avx512(__m512i& _A0, __m512i& _A1, __m512i& _B0, __m512i& _B1, __m512i& _C0,
+            __m512i& _C1, __m512i& _D0, __m512i& _D1) noexcept {
+            _A0 = _Blamka_avx512(_A0, _B0);
+            _A1 = _Blamka_avx512(_A1, _B1);
+            _D0 = _mm512_ror_epi64(_mm512_xor_si512(_D0, _A0), _Shift0);
+            _D1 = _mm512_ror_epi64(_mm512_xor_si512(_D1, _A1), _Shift0);
+            _C0 = _Blamka_avx512(_C0, _D0);
+            _C1 = _Blamka_avx512(_C1, _D1);
+            _B0 = _mm512_ror_epi64(_mm512_xor_si512(_B0, _C0), _Shift1);
+            _B1 = _mm512_ror_epi64(_mm512_xor_si512(_B1, _C1), _Shift1);
+        }
+
+        inline void _Round_avx512(__m512i& _A0, __m512i& _A1, __m512i& _B0, __m512i& _B1, __m512i& _C0,
+            __m512i& _C1, __m512i& _D0, __m512i& _D1) noexcept {
+            _Half_mix_avx512<32, 24>(_A0, _A1, _B0, _B1, _C0, _C1, _D0, _D1);
+            _Half_mix_avx512<16, 63>(_A0, _A1, _B0, _B1, _C0, _C1, _D0, _D1);
+            _B0 = _mm512_permutex_epi64(_B0, _MM_SHUFFLE(0, 3, 2, 1));
+            _B1 = _mm512_permutex_epi64(_B1, _MM_SHUFFLE(0, 3, 2, 1));
+            _C0 = _mm512_permutex_epi64(_C0, _MM_SHUFFLE(1, 0, 3, 2));
+            _C1 = _mm512_permutex_epi64(_C1, _MM_SHUFFLE(1, 0, 3, 2));
+            _D0 = _mm512_permutex_epi64(_D0, _MM_SHUFFLE(2, 1, 0, 3));
+            _D1 = _mm512_permutex_epi64(_D1, _MM_SHUFFLE(2, 1, 0, 3));
+            _Half_mix_avx512<32, 24>(_A0, _A1, _B0, _B1, _C0, _C1, _D0, _D1);
+            _Half_mix_avx512<16, 63>(_A0, _A1, _B0, _B1, _C0, _C1, _D0, _D1);
+            _B0 = _mm512_permutex_epi64(_B0, _MM_SHUFFLE(2, 1, 0, 3));
+            _B1 = _mm512_permutex_epi64(_B1, _MM_SHUFFLE(2, 1, 0, 3));
+            _C0 = _mm512_permutex_epi64(_C0, _MM_SHUFFLE(1, 0, 3, 2));
+            _C1 = _mm512_permutex_epi64(_C1, _MM_SHUFFLE(1, 0, 3, 2));
+            _D0 = _mm512_permutex_epi64(_D0, _MM_SHUFFLE(0, 3, 2, 1));
+            _D1 = _mm512_permutex_epi64(_D1, _MM_SHUFFLE(0, 3, 2, 1));
+        }
+
+        inline void _Swap_halves_avx512(__m512i& _Left, __m512i& _Right) noexcept {
+            // exchanges the upper half of _Left with the lower half of _Right
+            const __m512i _Lower = _mm512_shuffle_i64x2(_Left, _Right, _MM_SHUFFLE(1, 0, 1, 0));
+            const __m512i _Upper = _mm512_shuffle_i64x2(_Left, _Right, _MM_SHUFFLE(3, 2, 3, 2));
+            _Left                = _Lower;
+            _Right               = _Upper;
+        }
+
+        inline void _Swap_quarters_avx512(__m512i& _Left, __m512i& _Right) noexcept {
+            // gathers the pairs of words of four columns into the layout of two rows per register
+            const __m512i _Lower = _mm512_permutex2var_epi64(
+                _Left, _mm512_setr_epi64(0, 1, 8, 9, 2, 3, 10, 11), _Right);
+            const __m512i _Upper = _mm512_permutex2var_epi64(
+                _Left, _mm512_setr_epi64(4, 5, 12, 13, 6, 7, 14, 15), _Right);
+            _Left                = _Lower;
+            _Right               = _Upper;
+        }
+
+        inline void _Unswap_quarters_avx512(__m512i& _Left, __m512i& _Right) noexcept {
+            const __m512i _Lower = _mm512_permutex2var_epi64(
+                _Left, _mm512_setr_epi64(0, 1, 4, 5, 8, 9, 12, 13), _Right);
+            const __m512i _Upper = _mm512_permutex2var_epi64(
+                _Left, _mm512_setr_epi64(2, 3, 6, 7, 10, 11, 14, 15), _Right);
+            _Left                = _Lower;
+            _Right               = _Upper;
+        }
+
+        inline void _Compress_avx512(_Argon2_block& _Dest, const _Argon2_block& _Prev, const _Argon2_block& _Ref,
+            const bool _Xor_dest) noexcept {
+            __m512i _Rx[16];
+            __m512i _Zx[16];
+            for (size_t _Idx = 0; _Idx < 16; ++_Idx) {
+                _Rx[_Idx] = _mm512_xor_si512(_mm512_loadu_si512(_Prev._Words + _Idx * 8),
+                    _mm512_loadu_si512(_Ref._Words + _Idx * 8));
+                _Zx[_Idx] = _Rx[_Idx];
+            }
+
+            for (size_t _Row = 0; _Row < 2; ++_Row) { // 4 rows fill 8 consecutive registers
+                __m512i* const _Vx = _Zx + _Row * 8;
+                _Swap_halves_avx512(_Vx[0], _Vx[2]);
+                _Swap_halves_avx512(_Vx[1], _Vx[3]);
+                _Swap_halves_avx512(_Vx[4], _Vx[6]);
+                _Swap_halves_avx512(_Vx[5], _Vx[7]);
+                _Round_avx512(_Vx[0], _Vx[4], _Vx[2], _Vx[6], _Vx[1], _Vx[5], _Vx[3], _Vx[7]);
+                _Swap_halves_avx512(_Vx[0], _Vx[2]);
+                _Swap_halves_avx512(_Vx[1], _Vx[3]);
+                _Swap_halves_avx512(_Vx[4], _Vx[6]);
+                _Swap_halves_avx512(_Vx[5], _Vx[7]);
+            }
+
+            for (size_t _Column = 0; _Column < 2; ++_Column) { // 4 columns take every other register
+                __m512i* const _Vx = _Zx + _Column;
+                for (size_t _Idx = 0; _Idx < 16; _Idx += 4) {
+                    _Swap_quarters_avx512(_Vx[_Idx], _Vx[_Idx + 2]);
+                }
+
+                _Round_avx512(_Vx[0], _Vx[2], _Vx[4], _Vx[6], _Vx[8], _Vx[10], _Vx[12], _Vx[14]);
+                for (size_t _Idx = 0; _Idx < 16; _Idx += 4) {
+                    _Unswap_quarters_avx512(_Vx[_Idx], _Vx[_Idx + 2]);
+                }
+            }
+
+            for (size_t _Idx = 0; _Idx < 16; ++_Idx) {
+                __m512i _Value = _mm512_xor_si512(_Zx[_Idx], _Rx[_Idx]);
+                if (_Xor_dest) {
+                    _Value = _mm512_xor_si512(_Value, _mm512_loadu_si512(_Dest._Words + _Idx * 8));
+                }
+
+                _mm512_storeu_si512(_Dest._Words + _Idx * 8, _Value);
+            }
+        }
+
+        inline bool _Is_argon2_kernel_supported(const _Argon2_kernel _Kernel) noexcept {
+            const _Cpu_features& _Features = _Get_cpu_features();
+            switch (_Kernel) {
+            case _Argon2_kernel::_Generic:
+                return true;
+            case _Argon2_kernel::_Ssse3:
+                return _Features._Ssse3;
+            case _Argon2_kernel::_Avx2:
+                return _Features._Avx2;
+            case _Argon2_kernel::_Avx512:
+                return _Features._Avx512f;
+            default:
+                return false;
+            }
+        }
+
+        inline _Argon2_kernel _Best_argon2_kernel() noexcept {
+            static const _Argon2_kernel _Kernel = [] {
+                for (_Argon2_kernel _Candidate : {_Argon2_kernel::_Avx512, _Argon2_kernel::_Avx2,
+                    _Argon2_kernel::_Ssse3}) {
+                    if (_Is_argon2_kernel_supported(_Candidate)) {
+                        return _Candidate;
+                    }
+                }
+
+                return _Argon2_kernel::_Generic;
+            }();
+            return _Kernel;
+        }
+
+        inline _Argon2_compress_fn _Get_argon2_compress(const _Argon2_kernel _Kernel) noexcept {
+            // Note: The kernel must be supported, see _Is_argon2_kernel_supported().
+            switch (_Kernel) {
+            case _Argon2_kernel::_Ssse3:
+                return &_Compress_ssse3;
+            case _Argon2_kernel::_Avx2:
+                return &_Compress_avx2;
+            case _Argon2_kernel::_Avx512:
+                return &_Compress_avx512;
+            default:
+                return &_Compress_generic;
+            }
+        }
+    } // namespace efc_impl
+} // namespace mjx
+
+#endif // _EFC_IMPL_ARGON2_COMPRESS_HPP_
\ No newline at end of file
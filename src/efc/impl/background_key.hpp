@@ -0,0 +1,66 @@
+// background_key.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_IMPL_BACKGROUND_KEY_HPP_
+#define _EFC_IMPL_BACKGROUND_KEY_HPP_
+#include <efc/encryption_engine.hpp>
+#include <thread>
+
+namespace mjx {
+    namespace efc_impl {
+        class _Background_key { // derives a key on a separate thread while the caller prepares the files
+        public:
+            _Background_key() noexcept : _Mykey(), _Mythread() {}
+
+            ~_Background_key() noexcept {
+                _Wait();
+            }
+
+            _Background_key(const _Background_key&)            = delete;
+            _Background_key& operator=(const _Background_key&) = delete;
+
+            // calls _Func on a separate thread if _Async is true, otherwise on the calling thread
+            // Note: If the thread cannot be started, _Func is called on the calling thread as well.
+            //       Anything _Func refers to must outlive the object, or the call to _Wait().
+            template <class _Fn>
+            void _Start(_Fn _Func, const bool _Async) noexcept {
+                if (_Async) {
+                    try {
+                        _Mythread = ::std::thread([this, _Func]() noexcept { _Call(_Func); });
+                        return;
+                    } catch (...) { // failed to start the thread, derive the key on the calling thread
+                    }
+                }
+
+                _Call(_Func);
+            }
+
+            // waits for the key, which is invalid if the derivation failed
+            const key& _Wait() noexcept {
+                if (_Mythread.joinable()) {
+                    _Mythread.join();
+                }
+
+                return _Mykey;
+            }
+
+        private:
+            template <class _Fn>
+            void _Call(const _Fn& _Func) noexcept {
+                try {
+                    _Mykey = _Func();
+                } catch (...) {
+                    _Mykey.reset();
+                }
+            }
+
+            key _Mykey;
+            ::std::thread _Mythread;
+        };
+    } // namespace efc_impl
+} // namespace mjx
+
+#endif // _EFC_IMPL_BACKGROUND_KEY_HPP_
\ No newline at end of file
@@ -0,0 +1,86 @@
+// buffer_pool.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_IMPL_BUFFER_POOL_HPP_
+#define _EFC_IMPL_BUFFER_POOL_HPP_
+#include <cstddef>
+#include <efc/impl/secure_memory.hpp>
+#include <memory>
+#include <mjmem/pool_allocator.hpp>
+#include <mjmem/pool_resource.hpp>
+#include <mjstr/char_traits.hpp>
+#include <new>
+
+namespace mjx {
+    namespace efc_impl {
+        inline constexpr size_t _Page_size = 4096;
+
+        class _Buffer_pool { // equally-sized page-aligned buffers allocated from a single pool resource
+        public:
+            _Buffer_pool() noexcept : _Myres(), _Myal(), _Mybufs(), _Mycount(0), _Mysize(0) {}
+
+            ~_Buffer_pool() noexcept {
+                _Release();
+            }
+
+            _Buffer_pool(const _Buffer_pool&)            = delete;
+            _Buffer_pool& operator=(const _Buffer_pool&) = delete;
+
+            bool _Init(const size_t _Count, const size_t _Size) noexcept {
+                _Release();
+                try {
+                    // Note: every block may need up to _Page_size extra bytes to get aligned
+                    _Myres = pool_resource(_Count * (_Size + _Page_size));
+                    _Myal.reset(new pool_allocator(_Myres));
+                    _Mybufs.reset(new byte_t*[_Count]);
+                    _Mysize = _Size;
+                    for (; _Mycount < _Count; ++_Mycount) {
+                        _Mybufs[_Mycount] = static_cast<byte_t*>(_Myal->allocate_aligned(_Size, _Page_size));
+                    }
+
+                    return true;
+                } catch (...) {
+                    _Release();
+                    return false;
+                }
+            }
+
+            size_t _Count() const noexcept {
+                return _Mycount;
+            }
+
+            size_t _Size() const noexcept {
+                return _Mysize;
+            }
+
+            byte_t* _Get(const size_t _Idx) const noexcept {
+                return _Mybufs[_Idx];
+            }
+
+        private:
+            void _Release() noexcept {
+                for (size_t _Idx = 0; _Idx < _Mycount; ++_Idx) { // the buffers may hold plaintext
+                    _Wipe_memory(_Mybufs[_Idx], _Mysize);
+                    _Myal->deallocate(_Mybufs[_Idx], _Mysize);
+                }
+
+                _Mybufs.reset();
+                _Myal.reset();
+                _Myres.destroy();
+                _Mycount = 0;
+                _Mysize  = 0;
+            }
+
+            pool_resource _Myres;
+            ::std::unique_ptr<pool_allocator> _Myal;
+            ::std::unique_ptr<byte_t*[]> _Mybufs;
+            size_t _Mycount;
+            size_t _Mysize;
+        };
+    } // namespace efc_impl
+} // namespace mjx
+
+#endif // _EFC_IMPL_BUFFER_POOL_HPP_
\ No newline at end of file
@@ -0,0 +1,118 @@
+// chunk_prefetcher.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_IMPL_CHUNK_PREFETCHER_HPP_
+#define _EFC_IMPL_CHUNK_PREFETCHER_HPP_
+#include <condition_variable>
+#include <cstdint>
+#include <efc/chunk_cache.hpp>
+#include <efc/encryption_engine.hpp>
+#include <efc/impl/buffer_pool.hpp>
+#include <efc/impl/chunked_file_encryption_engine.hpp>
+#include <mjfs/file.hpp>
+#include <mutex>
+#include <thread>
+
+namespace mjx {
+    namespace efc_impl {
+        class _Chunk_prefetcher { // loads the chunks ahead of a sequential reader on a background thread
+        public:
+            _Chunk_prefetcher(chunk_cache& _Cache, const key_check& _Check, const file& _File, const key& _Key,
+                const iv& _Iv, const _Chunk_layout& _Layout, const uint64_t _Header_size, const bool _Aligned) noexcept
+                : _Mycache(_Cache), _Mycheck(_Check), _Myfile(_File), _Mykey(_Key), _Myiv(_Iv), _Mylayout(_Layout),
+                _Myheader_size(_Header_size), _Myaligned(_Aligned), _Myengine(), _Mybuf(), _Mymtx(), _Mycv(),
+                _Mythread(), _Mynext(0), _Mylast(0), _Mystop(false) {}
+
+            ~_Chunk_prefetcher() noexcept {
+                if (_Mythread.joinable()) {
+                    {
+                        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+                        _Mystop = true;
+                    }
+
+                    _Mycv.notify_one();
+                    _Mythread.join();
+                }
+            }
+
+            _Chunk_prefetcher(const _Chunk_prefetcher&)            = delete;
+            _Chunk_prefetcher& operator=(const _Chunk_prefetcher&) = delete;
+
+            bool _Start() noexcept {
+                if (!_Mybuf._Init(1, _Io_size_of(static_cast<size_t>(_Mylayout._Chunk_size)
+                    + _Mylayout._Tag_space, _Myaligned))) {
+                    return false;
+                }
+
+                try {
+                    _Mythread = ::std::thread(&_Chunk_prefetcher::_Work, this);
+                    return true;
+                } catch (...) {
+                    return false;
+                }
+            }
+
+            void _Request(const uint64_t _First, const uint64_t _Count) noexcept {
+                {
+                    ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+                    _Mynext = _First;
+                    _Mylast = _Count < _Mylayout._Count - _First ? _First + _Count : _Mylayout._Count;
+                }
+
+                _Mycv.notify_one();
+            }
+
+        private:
+            void _Work() noexcept {
+                for (;;) {
+                    uint64_t _Index;
+                    {
+                        ::std::unique_lock<::std::mutex> _Lock(_Mymtx);
+                        _Mycv.wait(_Lock, [this] { return _Mystop || _Mynext < _Mylast; });
+                        if (_Mystop) {
+                            return;
+                        }
+
+                        _Index = _Mynext++;
+                    }
+
+                    const chunk_cache::_Entry_key _Key = {_Myiv, _Mycheck, _Index};
+                    if (_Mycache._Contains(_Key)) {
+                        continue;
+                    }
+
+                    byte_t* const _Buf = _Mybuf._Get(0);
+                    if (!_Read_chunk(_Myfile, _Myheader_size, _Mylayout, _Index, _Myaligned, _Buf)
+                        || !_Open_chunk(_Myengine, _Mykey, _Myiv, _Mylayout, _Index, _Buf)) {
+                        continue; // the reader will report the error when it reaches the chunk
+                    }
+
+                    _Mycache._Insert(_Key, _Buf, _Mylayout._Plaintext_size_of(_Index));
+                    _Mycache._Count_prefetch();
+                }
+            }
+
+            chunk_cache& _Mycache;
+            const key_check& _Mycheck;
+            const file& _Myfile;
+            const key& _Mykey;
+            const iv& _Myiv;
+            _Chunk_layout _Mylayout;
+            uint64_t _Myheader_size;
+            bool _Myaligned;
+            encryption_engine _Myengine;
+            _Buffer_pool _Mybuf;
+            ::std::mutex _Mymtx;
+            ::std::condition_variable _Mycv;
+            ::std::thread _Mythread;
+            uint64_t _Mynext; // the next chunk to load
+            uint64_t _Mylast; // one past the last chunk to load
+            bool _Mystop;
+        };
+    } // namespace efc_impl
+} // namespace mjx
+
+#endif // _EFC_IMPL_CHUNK_PREFETCHER_HPP_
\ No newline at end of file
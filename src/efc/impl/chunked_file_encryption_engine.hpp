@@ -0,0 +1,144 @@
+// chunked_file_encryption_engine.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_IMPL_CHUNKED_FILE_ENCRYPTION_ENGINE_HPP_
+#define _EFC_IMPL_CHUNKED_FILE_ENCRYPTION_ENGINE_HPP_
+#include <atomic>
+#include <cstdint>
+#include <efc/chunked_file_encryption_engine.hpp>
+#include <efc/impl/file_io.hpp>
+
+namespace mjx {
+    namespace efc_impl {
+        inline constexpr size_t _Chunk_index_offset = 3; // the chunk index occupies bytes 3-10 of the IV
+        inline constexpr size_t _Final_flag_offset  = 11; // the final-chunk flag occupies the last byte of the IV
+
+        struct _Chunk_layout {
+            uint64_t _Count; // the number of chunks, at least one
+            uint64_t _Plaintext_size; // the total size of the plaintext
+            uint32_t _Chunk_size; // the size of the plaintext chunk
+            uint32_t _Tag_space; // the space taken by the tag of every chunk but the last one
+
+            // returns the plaintext size of the specified chunk
+            size_t _Plaintext_size_of(const uint64_t _Index) const noexcept {
+                return _Index < _Count - 1
+                    ? _Chunk_size : static_cast<size_t>(_Plaintext_size - _Index * _Chunk_size);
+            }
+
+            // returns the offset of the specified chunk within the plaintext
+            uint64_t _Plaintext_offset_of(const uint64_t _Index) const noexcept {
+                return _Index * _Chunk_size;
+            }
+
+            // returns the total size of the encrypted data
+            uint64_t _Encrypted_size() const noexcept {
+                return _Plaintext_size + (_Count - 1) * _Tag_space + authentication_tag::size;
+            }
+
+            // returns the offset of the specified chunk within the encrypted data
+            uint64_t _Encrypted_offset_of(const uint64_t _Index) const noexcept {
+                return _Index * (static_cast<uint64_t>(_Chunk_size) + _Tag_space);
+            }
+        };
+
+        // Note: In the aligned format, the tag of every chunk but the last one is padded to the sector size,
+        //       so that the chunks are aligned in both the plaintext and the encrypted file.
+        inline uint32_t _Tag_space_of(const uint32_t _Features) noexcept {
+            return (_Features & file_feature::aligned) != 0
+                ? static_cast<uint32_t>(_Sector_size) : static_cast<uint32_t>(authentication_tag::size);
+        }
+
+        inline _Chunk_layout _Layout_from_plaintext(
+            const uint64_t _Size, const uint32_t _Chunk_size, const uint32_t _Features) noexcept {
+            // an empty file is stored as a single empty final chunk
+            const uint64_t _Count = _Size == 0 ? 1 : (_Size + _Chunk_size - 1) / _Chunk_size;
+            return _Chunk_layout{_Count, _Size, _Chunk_size, _Tag_space_of(_Features)};
+        }
+
+        inline bool _Layout_from_encrypted(const uint64_t _Size, const uint32_t _Chunk_size,
+            const uint32_t _Features, _Chunk_layout& _Layout) noexcept {
+            const uint32_t _Tag_space   = _Tag_space_of(_Features);
+            const uint64_t _Stored_size = static_cast<uint64_t>(_Chunk_size) + _Tag_space;
+            const uint64_t _Count       = (_Size + _Stored_size - 1) / _Stored_size;
+            if (_Count == 0) {
+                return false;
+            }
+
+            const uint64_t _Last_size = _Size - (_Count - 1) * _Stored_size;
+            if (_Last_size < authentication_tag::size || _Last_size - authentication_tag::size > _Chunk_size) {
+                return false; // the last chunk cannot hold its tag or has been cut, the file has been truncated
+            }
+
+            _Layout = _Chunk_layout{_Count, (_Count - 1) * _Chunk_size + _Last_size - authentication_tag::size,
+                _Chunk_size, _Tag_space};
+            return true;
+        }
+
+        // returns the number of bytes to transfer in order to access _Size bytes
+        inline size_t _Io_size_of(const size_t _Size, const bool _Aligned) noexcept {
+            return _Aligned ? _Align_to_sector(_Size) : _Size;
+        }
+
+        // reads the specified chunk followed by its tag into _Buf
+        inline bool _Read_chunk(const file& _File, const uint64_t _Off, const _Chunk_layout& _Layout,
+            const uint64_t _Index, const bool _Aligned, byte_t* const _Buf) noexcept {
+            const size_t _Stored_size = _Layout._Plaintext_size_of(_Index) + authentication_tag::size;
+            return _Read_at_least(_File, _Off + _Layout._Encrypted_offset_of(_Index), _Buf,
+                _Io_size_of(_Stored_size, _Aligned), _Stored_size);
+        }
+
+        // decrypts in place and verifies the chunk read by _Read_chunk()
+        inline bool _Open_chunk(encryption_engine& _Engine, const key& _Key, const iv& _Iv,
+            const _Chunk_layout& _Layout, const uint64_t _Index, byte_t* const _Buf) noexcept {
+            const size_t _Size = _Layout._Plaintext_size_of(_Index);
+            authentication_tag _Tag;
+            _Tag.assign(_Buf + _Size);
+            return _Engine.setup_decryption(_Key, make_chunk_iv(_Iv, _Index, _Index == _Layout._Count - 1))
+                && _Engine.decrypt(_Buf, _Size, _Buf) && _Engine.complete(_Tag);
+        }
+
+        struct _Chunk_job {
+            const file& _Src;
+            const file& _Dest;
+            const key& _Key;
+            const iv& _Iv;
+            const _Chunk_layout& _Layout;
+            const uint64_t _Src_off; // the offset of the first chunk in the source file
+            const uint64_t _Dest_off; // the offset of the first chunk in the destination file
+            const bool _Aligned; // the reads and the writes must be aligned to the sector size
+            ::std::atomic<uint64_t> _Next; // the index of the next unclaimed chunk
+            ::std::atomic<bool> _Failed;
+
+            _Chunk_job(const file& _Src, const file& _Dest, const key& _Key, const iv& _Iv,
+                const _Chunk_layout& _Layout, const uint64_t _Src_off, const uint64_t _Dest_off,
+                const bool _Aligned) noexcept : _Src(_Src), _Dest(_Dest), _Key(_Key), _Iv(_Iv), _Layout(_Layout),
+                _Src_off(_Src_off), _Dest_off(_Dest_off), _Aligned(_Aligned), _Next(0), _Failed(false) {}
+
+            // returns the number of bytes to transfer in order to access _Size bytes
+            size_t _Io_size(const size_t _Size) const noexcept {
+                return _Io_size_of(_Size, _Aligned);
+            }
+
+            // checks if there are chunks left to claim
+            bool _Has_work() const noexcept {
+                return !_Failed.load(::std::memory_order_relaxed)
+                    && _Next.load(::std::memory_order_relaxed) < _Layout._Count;
+            }
+
+            // claims the next chunk, returns false if there are no more chunks or some worker failed
+            bool _Claim(uint64_t& _Index) noexcept {
+                if (_Failed.load(::std::memory_order_relaxed)) {
+                    return false;
+                }
+
+                _Index = _Next.fetch_add(1, ::std::memory_order_relaxed);
+                return _Index < _Layout._Count;
+            }
+        };
+    } // namespace efc_impl
+} // namespace mjx
+
+#endif // _EFC_IMPL_CHUNKED_FILE_ENCRYPTION_ENGINE_HPP_
\ No newline at end of file
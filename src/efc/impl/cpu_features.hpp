@@ -0,0 +1,49 @@
+// cpu_features.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_IMPL_CPU_FEATURES_HPP_
+#define _EFC_IMPL_CPU_FEATURES_HPP_
+#include <intrin.h>
+
+namespace mjx {
+    namespace efc_impl {
+        struct _Cpu_features {
+            bool _Ssse3   : 1;
+            bool _Pclmul  : 1;
+            bool _Avx2    : 1;
+            bool _Avx512f : 1;
+
+            _Cpu_features() noexcept : _Ssse3(false), _Pclmul(false), _Avx2(false), _Avx512f(false) {
+                int _Regs[4] = {0}; // EAX, EBX, ECX and EDX
+                ::__cpuid(_Regs, 0);
+                const int _Max_leaf = _Regs[0];
+                if (_Max_leaf < 1) { // leaf 1 not supported
+                    return;
+                }
+
+                ::__cpuid(_Regs, 1);
+                _Ssse3  = (_Regs[2] & (1 << 9)) != 0;
+                _Pclmul = (_Regs[2] & (1 << 1)) != 0;
+                if (_Max_leaf < 7 || (_Regs[2] & (1 << 27)) == 0) { // leaf 7 or OSXSAVE not supported
+                    return;
+                }
+
+                // Note: The wide registers can be used only if the OS saves them, which XCR0 reports.
+                const unsigned long long _Xcr0 = ::_xgetbv(0);
+                ::__cpuidex(_Regs, 7, 0);
+                _Avx2    = (_Regs[1] & (1 << 5)) != 0 && (_Xcr0 & 0x06) == 0x06; // XMM and YMM state
+                _Avx512f = (_Regs[1] & (1 << 16)) != 0 && (_Xcr0 & 0xE6) == 0xE6; // also opmask and ZMM state
+            }
+        };
+
+        inline const _Cpu_features& _Get_cpu_features() noexcept {
+            static const _Cpu_features _Features;
+            return _Features;
+        }
+    } // namespace efc_impl
+} // namespace mjx
+
+#endif // _EFC_IMPL_CPU_FEATURES_HPP_
\ No newline at end of file
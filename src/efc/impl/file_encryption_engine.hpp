@@ -6,11 +6,38 @@
 #pragma once
 #ifndef _EFC_IMPL_FILE_ENCRYPTION_ENGINE_HPP_
 #define _EFC_IMPL_FILE_ENCRYPTION_ENGINE_HPP_
+#include <cstdint>
+#include <cstring>
 #include <efc/file_encryption_engine.hpp>
 
 namespace mjx {
     namespace efc_impl {
         inline constexpr byte_t _Well_known_signature[file_signature::size] = {'E', 'F', 'C', '\0'};
+        inline constexpr size_t _Signature_prefix_size                      = 3; // 'E', 'F', 'C'
+        inline constexpr file_format _Latest_file_format                    = file_format::chunked;
+
+        // the on-disk sizes of the metadata, the signature is not included
+        inline constexpr size_t _Legacy_metadata_size  = authentication_tag::size + salt::size + iv::size;
+        inline constexpr size_t _Chunked_metadata_size = sizeof(uint32_t) * 2 + salt::size + iv::size;
+
+        // the size of the zero-padded header of the aligned chunked format, the signature is included
+        inline constexpr size_t _Aligned_metadata_size = 4096;
+        inline constexpr uint32_t _Supported_features  =
+            file_feature::aligned | file_feature::subkey | file_feature::kdf_params | file_feature::key_check;
+
+        // Note: The parameters of the key derivation are preceded by the identifier of the algorithm,
+        //       so that other algorithms, or other versions of Argon2, can be stored in the future.
+        inline constexpr uint32_t _No_kdf           = 0; // the key is used directly, the parameters are zeros
+        inline constexpr uint32_t _Argon2id_v13_kdf = 1; // Argon2id version 1.3
+        inline constexpr size_t _Kdf_params_size    = sizeof(uint32_t) * 4;
+
+        // returns the size of the chunked metadata without the padding, the signature is included
+        constexpr size_t _Packed_chunked_metadata_size(const uint32_t _Features) noexcept {
+            return file_signature::size + _Chunked_metadata_size
+                + ((_Features & file_feature::subkey) != 0 ? key_nonce::size : 0)
+                + ((_Features & file_feature::kdf_params) != 0 ? _Kdf_params_size : 0)
+                + ((_Features & file_feature::key_check) != 0 ? key_check::size : 0);
+        }
 
         class _Metadata_parser {
         public:
@@ -21,6 +48,12 @@ namespace mjx {
                 _Myraw += _Size;
             }
 
+            void _Parse_integer(uint32_t& _Value) noexcept { // integers are stored in little-endian order
+                _Value = static_cast<uint32_t>(_Myraw[0]) | (static_cast<uint32_t>(_Myraw[1]) << 8)
+                    | (static_cast<uint32_t>(_Myraw[2]) << 16) | (static_cast<uint32_t>(_Myraw[3]) << 24);
+                _Myraw += sizeof(uint32_t);
+            }
+
         private:
             const byte_t* _Myraw;
         };
@@ -35,6 +68,12 @@ namespace mjx {
                 _Myoff += _Size;
             }
 
+            void _Serialize_integer(const uint32_t _Value) noexcept { // integers are stored in little-endian order
+                const byte_t _Bytes[sizeof(uint32_t)] = {static_cast<byte_t>(_Value), static_cast<byte_t>(
+                    _Value >> 8), static_cast<byte_t>(_Value >> 16), static_cast<byte_t>(_Value >> 24)};
+                _Serialize(_Bytes, sizeof(uint32_t));
+            }
+
             byte_t* _Begin() noexcept {
                 _Myraw -= _Myoff; // go back to the beginning of the buffer
                 return _Myraw;
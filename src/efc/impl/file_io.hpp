@@ -0,0 +1,103 @@
+// file_io.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_IMPL_FILE_IO_HPP_
+#define _EFC_IMPL_FILE_IO_HPP_
+#include <cstdint>
+#include <efc/impl/tinywin.hpp>
+#include <mjfs/file.hpp>
+#include <mjstr/char_traits.hpp>
+
+namespace mjx {
+    namespace efc_impl {
+        // Note: Unbuffered I/O requires offsets, sizes and buffers aligned to the sector size.
+        //       4096 bytes covers both the legacy 512-byte and the advanced format sectors.
+        inline constexpr size_t _Sector_size          = 4096;
+        inline constexpr file_flag _No_buffering_flag = static_cast<file_flag>(0x2000'0000); // FILE_FLAG_NO_BUFFERING
+
+        constexpr size_t _Align_to_sector(const size_t _Size) noexcept {
+            return (_Size + _Sector_size - 1) & ~(_Sector_size - 1);
+        }
+
+        // binds the standard input or output (STD_INPUT_HANDLE or STD_OUTPUT_HANDLE) to the file
+        inline bool _Open_standard_stream(const DWORD _Id, file& _File) noexcept {
+            const HANDLE _Handle = ::GetStdHandle(_Id);
+            return _Handle != nullptr && _Handle != INVALID_HANDLE_VALUE && _File.set_handle(_Handle);
+        }
+
+        // reads exactly _Count bytes from the current position, pipes may return fewer bytes per read
+        inline bool _Read_exactly(const HANDLE _Handle, byte_t* const _Buf, const size_t _Count) noexcept {
+            size_t _Total = 0;
+            while (_Total < _Count) {
+                DWORD _Read = 0;
+                if (!::ReadFile(_Handle, _Buf + _Total, static_cast<DWORD>(_Count - _Total), &_Read, nullptr)
+                    || _Read == 0) { // failed or reached the end of the data
+                    return false;
+                }
+
+                _Total += _Read;
+            }
+
+            return true;
+        }
+
+        // writes all _Count bytes at the current position
+        inline bool _Write_all(const HANDLE _Handle, const byte_t* const _Data, const size_t _Count) noexcept {
+            size_t _Total = 0;
+            while (_Total < _Count) {
+                DWORD _Written = 0;
+                if (!::WriteFile(_Handle, _Data + _Total, static_cast<DWORD>(_Count - _Total), &_Written, nullptr)
+                    || _Written == 0) {
+                    return false;
+                }
+
+                _Total += _Written;
+            }
+
+            return true;
+        }
+
+        inline OVERLAPPED _Make_overlapped(const uint64_t _Off) noexcept {
+            OVERLAPPED _Overlapped = {0};
+            _Overlapped.Offset     = static_cast<DWORD>(_Off);
+            _Overlapped.OffsetHigh = static_cast<DWORD>(_Off >> 32);
+            return _Overlapped;
+        }
+
+        // Note: Positional reads and writes do not depend on the file pointer, so many threads
+        //       can share one synchronous file handle as long as they access different ranges.
+        inline bool _Read_at(
+            const file& _File, const uint64_t _Off, byte_t* const _Buf, const size_t _Count) noexcept {
+            OVERLAPPED _Overlapped = _Make_overlapped(_Off);
+            DWORD _Read            = 0;
+            return ::ReadFile(_File.native_handle(), _Buf, static_cast<DWORD>(_Count), &_Read, &_Overlapped) != 0
+                && _Read == _Count;
+        }
+
+        // reads up to _Count bytes, succeeds if at least _Min_count bytes have been read (stops at the end of the file)
+        inline bool _Read_at_least(const file& _File, const uint64_t _Off, byte_t* const _Buf, const size_t _Count,
+            const size_t _Min_count) noexcept {
+            OVERLAPPED _Overlapped = _Make_overlapped(_Off);
+            DWORD _Read            = 0;
+            if (!::ReadFile(_File.native_handle(), _Buf, static_cast<DWORD>(_Count), &_Read, &_Overlapped)) {
+                return _Min_count == 0 && ::GetLastError() == ERROR_HANDLE_EOF;
+            }
+
+            return _Read >= _Min_count;
+        }
+
+        inline bool _Write_at(
+            const file& _File, const uint64_t _Off, const byte_t* const _Data, const size_t _Count) noexcept {
+            OVERLAPPED _Overlapped = _Make_overlapped(_Off);
+            DWORD _Written         = 0;
+            return ::WriteFile(
+                _File.native_handle(), _Data, static_cast<DWORD>(_Count), &_Written, &_Overlapped) != 0
+                    && _Written == _Count;
+        }
+    } // namespace efc_impl
+} // namespace mjx
+
+#endif // _EFC_IMPL_FILE_IO_HPP_
\ No newline at end of file
@@ -0,0 +1,100 @@
+// latency_histogram.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_IMPL_LATENCY_HISTOGRAM_HPP_
+#define _EFC_IMPL_LATENCY_HISTOGRAM_HPP_
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace mjx {
+    namespace efc_impl {
+        // Note: Each power of two is split into 8 equal buckets, so a percentile is reported with at most
+        //       12.5% error, while 496 buckets cover every 64-bit value. Recording takes a single atomic
+        //       increment, so many threads can record at once without a lock.
+        class _Latency_histogram { // counts the latencies of the jobs, in microseconds
+        public:
+            static constexpr size_t _Sub_buckets  = 8;
+            static constexpr size_t _Bucket_count = (64 - 2) * _Sub_buckets;
+
+            _Latency_histogram() noexcept : _Mybuckets{}, _Mymax(0) {}
+
+            _Latency_histogram(const _Latency_histogram&)            = delete;
+            _Latency_histogram& operator=(const _Latency_histogram&) = delete;
+
+            void _Record(const uint64_t _Value) noexcept {
+                _Mybuckets[_Bucket_index(_Value)].fetch_add(1, ::std::memory_order_relaxed);
+                uint64_t _Max = _Mymax.load(::std::memory_order_relaxed);
+                while (_Value > _Max && !_Mymax.compare_exchange_weak(_Max, _Value, ::std::memory_order_relaxed)) {
+                }
+            }
+
+            uint64_t _Count() const noexcept {
+                uint64_t _Total = 0;
+                for (const ::std::atomic<uint64_t>& _Bucket : _Mybuckets) {
+                    _Total += _Bucket.load(::std::memory_order_relaxed);
+                }
+
+                return _Total;
+            }
+
+            uint64_t _Max() const noexcept {
+                return _Mymax.load(::std::memory_order_relaxed);
+            }
+
+            // returns the smallest latency that _Percent percent of the recorded ones do not exceed
+            uint64_t _Percentile(const uint32_t _Percent) const noexcept {
+                const uint64_t _Total = _Count();
+                if (_Total == 0) {
+                    return 0;
+                }
+
+                const uint64_t _Rank = (_Total * _Percent + 99) / 100; // rounded up, at least 1 if _Percent > 0
+                uint64_t _Seen       = 0;
+                for (size_t _Idx = 0; _Idx < _Bucket_count; ++_Idx) {
+                    _Seen += _Mybuckets[_Idx].load(::std::memory_order_relaxed);
+                    if (_Seen >= _Rank && _Seen != 0) {
+                        const uint64_t _Bound = _Bucket_bound(_Idx);
+                        return _Bound < _Max() ? _Bound : _Max(); // no recorded latency exceeds the maximum
+                    }
+                }
+
+                return _Max();
+            }
+
+        private:
+            static size_t _Bucket_index(const uint64_t _Value) noexcept {
+                if (_Value < _Sub_buckets) { // the first buckets hold a single value each
+                    return static_cast<size_t>(_Value);
+                }
+
+                size_t _Exp = 63;
+                while ((_Value >> _Exp) == 0) {
+                    --_Exp;
+                }
+
+                const size_t _Sub = static_cast<size_t>(_Value >> (_Exp - 3)) & (_Sub_buckets - 1);
+                return (_Exp - 2) * _Sub_buckets + _Sub;
+            }
+
+            // returns the largest value that falls into the bucket
+            static uint64_t _Bucket_bound(const size_t _Idx) noexcept {
+                if (_Idx < _Sub_buckets) {
+                    return _Idx;
+                }
+
+                const size_t _Exp     = _Idx / _Sub_buckets + 2;
+                const uint64_t _Lower = static_cast<uint64_t>(_Sub_buckets + _Idx % _Sub_buckets) << (_Exp - 3);
+                return _Lower + ((uint64_t{1} << (_Exp - 3)) - 1);
+            }
+
+            ::std::atomic<uint64_t> _Mybuckets[_Bucket_count];
+            ::std::atomic<uint64_t> _Mymax;
+        };
+    } // namespace efc_impl
+} // namespace mjx
+
+#endif // _EFC_IMPL_LATENCY_HISTOGRAM_HPP_
\ No newline at end of file
@@ -0,0 +1,76 @@
+// mapped_file.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_IMPL_MAPPED_FILE_HPP_
+#define _EFC_IMPL_MAPPED_FILE_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <efc/impl/tinywin.hpp>
+#include <mjfs/file.hpp>
+#include <mjstr/char_traits.hpp>
+
+namespace mjx {
+    namespace efc_impl {
+        class _Mapped_file { // view of the whole file mapped into the address space
+        public:
+            _Mapped_file() noexcept : _Mymapping(nullptr), _Myview(nullptr) {}
+
+            ~_Mapped_file() noexcept {
+                if (_Myview) {
+                    ::UnmapViewOfFile(_Myview);
+                }
+
+                if (_Mymapping) {
+                    ::CloseHandle(_Mymapping);
+                }
+            }
+
+            _Mapped_file(const _Mapped_file&)            = delete;
+            _Mapped_file& operator=(const _Mapped_file&) = delete;
+
+            // maps the first _Size bytes of the file, the writable view requires read and write access
+            bool _Map(const file& _File, const uint64_t _Size, const bool _Writable) noexcept {
+                if (_Size == 0 || _Size > static_cast<uint64_t>(SIZE_MAX)) { // must fit in the address space
+                    return false;
+                }
+
+                _Mymapping = ::CreateFileMappingW(_File.native_handle(), nullptr,
+                    _Writable ? PAGE_READWRITE : PAGE_READONLY, static_cast<DWORD>(_Size >> 32),
+                        static_cast<DWORD>(_Size), nullptr);
+                if (!_Mymapping) {
+                    return false;
+                }
+
+                _Myview = static_cast<byte_t*>(::MapViewOfFile(
+                    _Mymapping, _Writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, static_cast<SIZE_T>(_Size)));
+                return _Myview != nullptr;
+            }
+
+            byte_t* _Data() const noexcept {
+                return _Myview;
+            }
+
+            // asks the system to read the range ahead of the access, the sequential access hint
+            void _Prefetch(const size_t _Off, const size_t _Count) const noexcept {
+                WIN32_MEMORY_RANGE_ENTRY _Range;
+                _Range.VirtualAddress = _Myview + _Off;
+                _Range.NumberOfBytes  = _Count;
+                ::PrefetchVirtualMemory(::GetCurrentProcess(), 1, &_Range, 0); // only a hint, may fail
+            }
+
+            // starts writing the modified range back to the file
+            bool _Flush(const size_t _Off, const size_t _Count) const noexcept {
+                return ::FlushViewOfFile(_Myview + _Off, _Count) != 0;
+            }
+
+        private:
+            HANDLE _Mymapping;
+            byte_t* _Myview;
+        };
+    } // namespace efc_impl
+} // namespace mjx
+
+#endif // _EFC_IMPL_MAPPED_FILE_HPP_
\ No newline at end of file
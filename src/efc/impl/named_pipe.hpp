@@ -0,0 +1,338 @@
+// named_pipe.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_IMPL_NAMED_PIPE_HPP_
+#define _EFC_IMPL_NAMED_PIPE_HPP_
+#include <cstddef>
+#include <cstring>
+#include <efc/impl/tinywin.hpp>
+#include <memory>
+#include <mjstr/char_traits.hpp>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace mjx {
+    namespace efc_impl {
+        inline constexpr size_t _Max_pipe_name  = 288; // the prefix and the longest user name (UNLEN)
+        inline constexpr DWORD _Pipe_io_timeout = 5000; // in milliseconds
+
+        // appends the name of the current user to the prefix, so that every user has its own pipe
+        template <size_t _Size>
+        inline bool _Make_user_pipe_name(const wchar_t (&_Prefix)[_Size], wchar_t (&_Name)[_Max_pipe_name]) noexcept {
+            static_assert(_Size < _Max_pipe_name, "the prefix must leave room for the user name");
+            ::memcpy(_Name, _Prefix, sizeof(_Prefix));
+            DWORD _Name_size = static_cast<DWORD>(_Max_pipe_name - (_Size - 1));
+            return ::GetUserNameW(_Name + (_Size - 1), &_Name_size) != 0;
+        }
+
+        // builds the name of the pipe of the key agent
+        inline bool _Make_agent_pipe_name(wchar_t (&_Name)[_Max_pipe_name]) noexcept {
+            return _Make_user_pipe_name(L"\\\\.\\pipe\\efc-agent-", _Name);
+        }
+
+        class _Token_user { // the user account a process runs as
+        public:
+            _Token_user() noexcept : _Mybuf() {}
+
+            bool _Load(const HANDLE _Process) noexcept {
+                HANDLE _Token;
+                if (!::OpenProcessToken(_Process, TOKEN_QUERY, &_Token)) {
+                    return false;
+                }
+
+                DWORD _Size = 0;
+                ::GetTokenInformation(_Token, TokenUser, nullptr, 0, &_Size); // query the required size
+                if (_Size != 0) {
+                    _Mybuf.reset(new (::std::nothrow) byte_t[_Size]);
+                }
+
+                const bool _Loaded = _Mybuf && ::GetTokenInformation(_Token, TokenUser, _Mybuf.get(), _Size, &_Size);
+                ::CloseHandle(_Token);
+                return _Loaded;
+            }
+
+            PSID _Sid() const noexcept {
+                return reinterpret_cast<const TOKEN_USER*>(_Mybuf.get())->User.Sid;
+            }
+
+        private:
+            ::std::unique_ptr<byte_t[]> _Mybuf;
+        };
+
+        // checks if the process that created the pipe runs as the current user
+        // Note: Pipe names are global, so another user could create the pipe of the agent first.
+        inline bool _Is_pipe_server_trusted(const HANDLE _Pipe) noexcept {
+            ULONG _Pid;
+            if (!::GetNamedPipeServerProcessId(_Pipe, &_Pid)) {
+                return false;
+            }
+
+            const HANDLE _Process = ::OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, _Pid);
+            if (!_Process) {
+                return false;
+            }
+
+            _Token_user _Server;
+            _Token_user _Current;
+            const bool _Trusted = _Server._Load(_Process) && _Current._Load(::GetCurrentProcess())
+                && ::EqualSid(_Server._Sid(), _Current._Sid());
+            ::CloseHandle(_Process);
+            return _Trusted;
+        }
+
+        class _Pipe_security { // grants access to the pipe to the current user only
+        public:
+            _Pipe_security() noexcept : _Myuser(), _Myacl(), _Mydesc(), _Myattr() {}
+
+            bool _Init() noexcept {
+                if (!_Myuser._Load(::GetCurrentProcess())) {
+                    return false;
+                }
+
+                const DWORD _Acl_size = sizeof(ACL) + sizeof(ACCESS_ALLOWED_ACE) + ::GetLengthSid(_Myuser._Sid());
+                _Myacl.reset(new (::std::nothrow) byte_t[_Acl_size]);
+                if (!_Myacl) {
+                    return false;
+                }
+
+                // Note: GENERIC_WRITE includes FILE_CREATE_PIPE_INSTANCE, which the other instances require.
+                const PACL _Acl = reinterpret_cast<PACL>(_Myacl.get());
+                if (!::InitializeAcl(_Acl, _Acl_size, ACL_REVISION)
+                    || !::AddAccessAllowedAce(_Acl, ACL_REVISION, GENERIC_READ | GENERIC_WRITE, _Myuser._Sid())
+                    || !::InitializeSecurityDescriptor(&_Mydesc, SECURITY_DESCRIPTOR_REVISION)
+                    || !::SetSecurityDescriptorDacl(&_Mydesc, TRUE, _Acl, FALSE)) {
+                    return false;
+                }
+
+                _Myattr.nLength              = sizeof(SECURITY_ATTRIBUTES);
+                _Myattr.lpSecurityDescriptor = &_Mydesc;
+                _Myattr.bInheritHandle       = FALSE;
+                return true;
+            }
+
+            SECURITY_ATTRIBUTES* _Attributes() noexcept {
+                return &_Myattr;
+            }
+
+        private:
+            _Token_user _Myuser;
+            ::std::unique_ptr<byte_t[]> _Myacl;
+            SECURITY_DESCRIPTOR _Mydesc;
+            SECURITY_ATTRIBUTES _Myattr;
+        };
+
+        // waits for an overlapped operation, cancels it if _Stop_event is signaled or the timeout elapses
+        inline bool _Wait_for_pipe(const HANDLE _Pipe, OVERLAPPED& _Overlapped, const HANDLE _Stop_event,
+            const DWORD _Timeout, DWORD& _Transferred) noexcept {
+            const HANDLE _Events[] = {_Overlapped.hEvent, _Stop_event};
+            if (::WaitForMultipleObjects(2, _Events, FALSE, _Timeout) != WAIT_OBJECT_0) {
+                ::CancelIo(_Pipe);
+                ::GetOverlappedResult(_Pipe, &_Overlapped, &_Transferred, TRUE); // wait until it is cancelled
+                return false;
+            }
+
+            return ::GetOverlappedResult(_Pipe, &_Overlapped, &_Transferred, FALSE) != 0;
+        }
+
+        // waits for a client to connect to a pipe instance opened with FILE_FLAG_OVERLAPPED
+        inline bool _Accept_pipe_client(const HANDLE _Pipe, const HANDLE _Event, const HANDLE _Stop_event) noexcept {
+            OVERLAPPED _Overlapped = {0};
+            _Overlapped.hEvent     = _Event;
+            if (::ConnectNamedPipe(_Pipe, &_Overlapped)) {
+                return true;
+            }
+
+            DWORD _Transferred = 0;
+            switch (::GetLastError()) {
+            case ERROR_PIPE_CONNECTED: // the client connected before the call
+                return true;
+            case ERROR_IO_PENDING:
+                return _Wait_for_pipe(_Pipe, _Overlapped, _Stop_event, INFINITE, _Transferred);
+            default:
+                return false;
+            }
+        }
+
+        // reads or writes exactly _Count bytes through a pipe instance opened with FILE_FLAG_OVERLAPPED
+        inline bool _Transfer_pipe_data(const HANDLE _Pipe, const HANDLE _Event, const HANDLE _Stop_event,
+            byte_t* const _Buf, const size_t _Count, const bool _Write, const DWORD _Timeout) noexcept {
+            size_t _Total = 0;
+            while (_Total < _Count) {
+                OVERLAPPED _Overlapped = {0};
+                _Overlapped.hEvent     = _Event;
+                const DWORD _Size      = static_cast<DWORD>(_Count - _Total);
+                const BOOL _Result     = _Write ? ::WriteFile(_Pipe, _Buf + _Total, _Size, nullptr, &_Overlapped)
+                                                : ::ReadFile(_Pipe, _Buf + _Total, _Size, nullptr, &_Overlapped);
+                if (!_Result && ::GetLastError() != ERROR_IO_PENDING) {
+                    return false;
+                }
+
+                DWORD _Transferred = 0;
+                if (!_Wait_for_pipe(_Pipe, _Overlapped, _Stop_event, _Timeout, _Transferred) || _Transferred == 0) {
+                    return false;
+                }
+
+                _Total += _Transferred;
+            }
+
+            return true;
+        }
+
+        class _Pipe_connection { // a client connected to an instance of _Pipe_server
+        public:
+            _Pipe_connection(const HANDLE _Pipe, const HANDLE _Event, const HANDLE _Stop_event) noexcept
+                : _Mypipe(_Pipe), _Myevent(_Event), _Mystop_event(_Stop_event) {}
+
+            // reads exactly _Count bytes, fails if the client disconnects, the server stops or the timeout elapses
+            bool _Read(void* const _Buf, const size_t _Count, const DWORD _Timeout = _Pipe_io_timeout) noexcept {
+                return _Transfer_pipe_data(
+                    _Mypipe, _Myevent, _Mystop_event, static_cast<byte_t*>(_Buf), _Count, false, _Timeout);
+            }
+
+            // writes exactly _Count bytes, fails like _Read()
+            bool _Write(const void* const _Data, const size_t _Count) noexcept {
+                return _Transfer_pipe_data(_Mypipe, _Myevent, _Mystop_event,
+                    static_cast<byte_t*>(const_cast<void*>(_Data)), _Count, true, _Pipe_io_timeout);
+            }
+
+        private:
+            HANDLE _Mypipe;
+            HANDLE _Myevent;
+            HANDLE _Mystop_event;
+        };
+
+        class _Pipe_server { // serves the clients of a named pipe, each instance of the pipe on its own thread
+        public:
+            _Pipe_server() noexcept : _Mystop_event(::CreateEventW(nullptr, TRUE, FALSE, nullptr)), _Mythreads() {}
+
+            ~_Pipe_server() noexcept {
+                _Stop();
+                _Join();
+                if (_Mystop_event) {
+                    ::CloseHandle(_Mystop_event);
+                }
+            }
+
+            _Pipe_server(const _Pipe_server&)            = delete;
+            _Pipe_server& operator=(const _Pipe_server&) = delete;
+
+            bool _Is_valid() const noexcept {
+                return _Mystop_event != nullptr;
+            }
+
+            // creates the instances of the pipe, calls _Func with every client that connects to them
+            // Note: FILE_FLAG_FIRST_PIPE_INSTANCE makes the first instance fail if the pipe already exists,
+            //       so only one server of the user runs, and no other process can take over its name.
+            //       _Func returns true if it has written a response, which the client must read.
+            template <class _Fn>
+            bool _Start(const wchar_t* const _Name, const size_t _Instances, const DWORD _Buffer_size,
+                const _Fn& _Func) noexcept {
+                _Pipe_security _Security;
+                if (!_Is_valid() || !_Mythreads.empty() || !_Security._Init()) {
+                    return false;
+                }
+
+                ::ResetEvent(_Mystop_event);
+                for (size_t _Idx = 0; _Idx < _Instances; ++_Idx) {
+                    const DWORD _Flags = _Idx == 0 ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0;
+                    const HANDLE _Pipe = ::CreateNamedPipeW(_Name, PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | _Flags,
+                        PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                        static_cast<DWORD>(_Instances), _Buffer_size, _Buffer_size, 0, _Security._Attributes());
+                    if (_Pipe == INVALID_HANDLE_VALUE) {
+                        break;
+                    }
+
+                    try {
+                        _Mythreads.emplace_back([this, _Pipe, _Func]() noexcept { _Serve(_Pipe, _Func); });
+                    } catch (...) {
+                        ::CloseHandle(_Pipe);
+                        break;
+                    }
+                }
+
+                return !_Mythreads.empty();
+            }
+
+            // waits until the server is stopped or the timeout elapses, returns true if it has been stopped
+            bool _Wait(const DWORD _Timeout) const noexcept {
+                return ::WaitForSingleObject(_Mystop_event, _Timeout) != WAIT_TIMEOUT;
+            }
+
+            // makes the threads finish the current clients and exit, may be called from any thread
+            void _Stop() noexcept {
+                if (_Mystop_event) {
+                    ::SetEvent(_Mystop_event);
+                }
+            }
+
+            // waits for the threads, must be called by the thread that started the server
+            void _Join() noexcept {
+                for (::std::thread& _Thread : _Mythreads) {
+                    _Thread.join();
+                }
+
+                _Mythreads.clear();
+            }
+
+        private:
+            template <class _Fn>
+            void _Serve(const HANDLE _Pipe, const _Fn& _Func) noexcept {
+                const HANDLE _Event = ::CreateEventW(nullptr, TRUE, FALSE, nullptr);
+                if (_Event) {
+                    for (;;) {
+                        if (!_Accept_pipe_client(_Pipe, _Event, _Mystop_event)) {
+                            if (_Wait(0)) { // stopped
+                                break;
+                            }
+
+                            ::DisconnectNamedPipe(_Pipe); // the client has gone, wait for the next one
+                            continue;
+                        }
+
+                        _Pipe_connection _Connection(_Pipe, _Event, _Mystop_event);
+                        if (_Func(_Connection)) {
+                            ::FlushFileBuffers(_Pipe); // wait until the client reads the response
+                        }
+
+                        ::DisconnectNamedPipe(_Pipe);
+                    }
+
+                    ::CloseHandle(_Event);
+                }
+
+                ::CloseHandle(_Pipe);
+            }
+
+            HANDLE _Mystop_event;
+            ::std::vector<::std::thread> _Mythreads;
+        };
+
+        // connects to the server of the pipe, fails if it is not running or does not run as the current user
+        inline HANDLE _Connect_to_pipe(const wchar_t* const _Name, const DWORD _Busy_timeout) noexcept {
+            for (;;) {
+                // Note: SECURITY_IDENTIFICATION keeps the server from acting on behalf of the client.
+                const HANDLE _Pipe = ::CreateFileW(_Name, GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING,
+                    SECURITY_SQOS_PRESENT | SECURITY_IDENTIFICATION, nullptr);
+                if (_Pipe != INVALID_HANDLE_VALUE) {
+                    if (_Is_pipe_server_trusted(_Pipe)) {
+                        return _Pipe;
+                    }
+
+                    ::CloseHandle(_Pipe);
+                    return INVALID_HANDLE_VALUE;
+                }
+
+                // all instances are busy, wait for one of them or give up
+                if (::GetLastError() != ERROR_PIPE_BUSY || !::WaitNamedPipeW(_Name, _Busy_timeout)) {
+                    return INVALID_HANDLE_VALUE;
+                }
+            }
+        }
+    } // namespace efc_impl
+} // namespace mjx
+
+#endif // _EFC_IMPL_NAMED_PIPE_HPP_
\ No newline at end of file
@@ -0,0 +1,186 @@
+// overlapped_io.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_IMPL_OVERLAPPED_IO_HPP_
+#define _EFC_IMPL_OVERLAPPED_IO_HPP_
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <efc/impl/buffer_pool.hpp>
+#include <efc/impl/tinywin.hpp>
+#include <memory>
+#include <mjfs/file.hpp>
+#include <new>
+
+namespace mjx {
+    namespace efc_impl {
+        class _Overlapped_request { // one asynchronous read or write
+        public:
+            _Overlapped_request() noexcept : _Myov{0}, _Myhandle(nullptr), _Mypending(false) {}
+
+            ~_Overlapped_request() noexcept {
+                size_t _Transferred;
+                _Wait(_Transferred); // the buffer must not be released while the request is in flight
+                if (_Myov.hEvent) {
+                    ::CloseHandle(_Myov.hEvent);
+                }
+            }
+
+            _Overlapped_request(const _Overlapped_request&)            = delete;
+            _Overlapped_request& operator=(const _Overlapped_request&) = delete;
+
+            bool _Init() noexcept {
+                // Note: Every request needs its own event, the file handle is signaled by any completed request.
+                _Myov.hEvent = ::CreateEventW(nullptr, TRUE, FALSE, nullptr);
+                return _Myov.hEvent != nullptr;
+            }
+
+            bool _Read(const file& _File, const uint64_t _Off, byte_t* const _Buf, const size_t _Count) noexcept {
+                _Prepare(_File, _Off);
+                return _Submitted(::ReadFile(_Myhandle, _Buf, static_cast<DWORD>(_Count), nullptr, &_Myov));
+            }
+
+            bool _Write(
+                const file& _File, const uint64_t _Off, const byte_t* const _Data, const size_t _Count) noexcept {
+                _Prepare(_File, _Off);
+                return _Submitted(::WriteFile(_Myhandle, _Data, static_cast<DWORD>(_Count), nullptr, &_Myov));
+            }
+
+            // waits until the request is completed, does nothing if no request is in flight
+            bool _Wait(size_t& _Transferred) noexcept {
+                _Transferred = 0;
+                if (!_Mypending) {
+                    return true;
+                }
+
+                _Mypending    = false;
+                DWORD _Result = 0;
+                if (!::GetOverlappedResult(_Myhandle, &_Myov, &_Result, TRUE)) {
+                    return false;
+                }
+
+                _Transferred = static_cast<size_t>(_Result);
+                return true;
+            }
+
+        private:
+            void _Prepare(const file& _File, const uint64_t _Off) noexcept {
+                _Myov.Internal     = 0;
+                _Myov.InternalHigh = 0;
+                _Myov.Offset       = static_cast<DWORD>(_Off);
+                _Myov.OffsetHigh   = static_cast<DWORD>(_Off >> 32);
+                _Myhandle          = _File.native_handle();
+            }
+
+            bool _Submitted(const BOOL _Result) noexcept {
+                // Note: The request may complete immediately, its result is collected by _Wait() either way.
+                _Mypending = _Result != FALSE || ::GetLastError() == ERROR_IO_PENDING;
+                return _Mypending;
+            }
+
+            OVERLAPPED _Myov;
+            HANDLE _Myhandle;
+            bool _Mypending;
+        };
+
+        class _Overlapped_pipeline { // keeps several reads and writes in flight from a single thread
+        public:
+            _Overlapped_pipeline(const file& _Src, const uint64_t _Src_off, const uint64_t _Size, const file& _Dest,
+                const uint64_t _Dest_off) noexcept : _Mysrc(_Src), _Mydest(_Dest), _Mysrc_off(_Src_off),
+                _Mydest_off(_Dest_off), _Mysize(_Size), _Mypool(nullptr), _Myrequests(), _Mychunk_count(0) {}
+
+            bool _Init(const _Buffer_pool& _Pool) noexcept {
+                _Myrequests.reset(new (::std::nothrow) _Overlapped_request[_Pool._Count()]);
+                if (!_Myrequests) {
+                    return false;
+                }
+
+                for (size_t _Idx = 0; _Idx < _Pool._Count(); ++_Idx) {
+                    if (!_Myrequests[_Idx]._Init()) {
+                        return false;
+                    }
+                }
+
+                _Mypool        = &_Pool;
+                _Mychunk_count = static_cast<size_t>((_Mysize + _Pool._Size() - 1) / _Pool._Size());
+                return true;
+            }
+
+            // reads every chunk ahead, transforms it in place and writes it back without waiting for the write
+            template <class _Fn>
+            bool _Run(_Fn& _Func) noexcept {
+                const size_t _Depth = _Mypool->_Count();
+                for (size_t _Idx = 0; _Idx < (::std::min)(_Depth, _Mychunk_count); ++_Idx) {
+                    if (!_Submit_read(_Idx)) {
+                        return false;
+                    }
+                }
+
+                size_t _Transferred;
+                for (size_t _Idx = 0; _Idx < _Mychunk_count; ++_Idx) {
+                    _Overlapped_request& _Request = _Myrequests[_Idx % _Depth];
+                    byte_t* const _Buf            = _Mypool->_Get(_Idx % _Depth);
+                    const size_t _Size            = _Chunk_size(_Idx);
+                    if (!_Request._Wait(_Transferred) || _Transferred != _Size || !_Func(_Buf, _Size, _Buf)) {
+                        return false;
+                    }
+
+                    if (!_Request._Write(_Mydest, _Mydest_off + _Chunk_offset(_Idx), _Buf, _Size)) {
+                        return false;
+                    }
+
+                    // the previous chunk's write had the whole transformation to complete, reuse its buffer
+                    if (_Idx > 0 && _Idx - 1 + _Depth < _Mychunk_count) {
+                        const size_t _Prev = _Idx - 1;
+                        if (!_Wait_written(_Prev) || !_Submit_read(_Prev + _Depth)) {
+                            return false;
+                        }
+                    }
+                }
+
+                for (size_t _Idx = 0; _Idx < _Depth; ++_Idx) { // wait for the remaining writes
+                    if (!_Myrequests[_Idx]._Wait(_Transferred)) {
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+
+        private:
+            uint64_t _Chunk_offset(const size_t _Idx) const noexcept {
+                return static_cast<uint64_t>(_Idx) * _Mypool->_Size();
+            }
+
+            size_t _Chunk_size(const size_t _Idx) const noexcept {
+                return static_cast<size_t>((::std::min)(
+                    static_cast<uint64_t>(_Mypool->_Size()), _Mysize - _Chunk_offset(_Idx)));
+            }
+
+            bool _Submit_read(const size_t _Idx) noexcept {
+                const size_t _Slot = _Idx % _Mypool->_Count();
+                return _Myrequests[_Slot]._Read(
+                    _Mysrc, _Mysrc_off + _Chunk_offset(_Idx), _Mypool->_Get(_Slot), _Chunk_size(_Idx));
+            }
+
+            bool _Wait_written(const size_t _Idx) noexcept {
+                size_t _Written;
+                return _Myrequests[_Idx % _Mypool->_Count()]._Wait(_Written) && _Written == _Chunk_size(_Idx);
+            }
+
+            const file& _Mysrc;
+            const file& _Mydest;
+            uint64_t _Mysrc_off;
+            uint64_t _Mydest_off;
+            uint64_t _Mysize;
+            const _Buffer_pool* _Mypool;
+            ::std::unique_ptr<_Overlapped_request[]> _Myrequests;
+            size_t _Mychunk_count;
+        };
+    } // namespace efc_impl
+} // namespace mjx
+
+#endif // _EFC_IMPL_OVERLAPPED_IO_HPP_
\ No newline at end of file
@@ -0,0 +1,47 @@
+// parallel.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_IMPL_PARALLEL_HPP_
+#define _EFC_IMPL_PARALLEL_HPP_
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace mjx {
+    namespace efc_impl {
+        inline size_t _Default_thread_count() noexcept {
+            return (::std::max)(::std::thread::hardware_concurrency(), 1u);
+        }
+
+        template <class _Fn>
+        inline bool _Run_in_parallel(const size_t _Count, _Fn& _Func) noexcept {
+            // calls _Func(0) to _Func(_Count - 1) at once, _Func(0) is called on the calling thread
+            ::std::vector<::std::thread> _Workers;
+            bool _Started = true;
+            try {
+                _Workers.reserve(_Count - 1);
+                for (size_t _Idx = 1; _Idx < _Count; ++_Idx) {
+                    _Workers.emplace_back([&_Func, _Idx]() noexcept { _Func(_Idx); });
+                }
+            } catch (...) { // failed to start a worker, wait for the started ones
+                _Started = false;
+            }
+
+            if (_Started) {
+                _Func(0);
+            }
+
+            for (::std::thread& _Worker : _Workers) {
+                _Worker.join();
+            }
+
+            return _Started;
+        }
+    } // namespace efc_impl
+} // namespace mjx
+
+#endif // _EFC_IMPL_PARALLEL_HPP_
\ No newline at end of file
@@ -0,0 +1,324 @@
+// parallel_encryption_engine.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_IMPL_PARALLEL_ENCRYPTION_ENGINE_HPP_
+#define _EFC_IMPL_PARALLEL_ENCRYPTION_ENGINE_HPP_
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <efc/impl/cpu_features.hpp>
+#include <efc/impl/secure_memory.hpp>
+#include <efc/parallel_encryption_engine.hpp>
+#include <immintrin.h>
+#include <openssl/evp.h>
+
+namespace mjx {
+    namespace efc_impl {
+        inline constexpr size_t _Gcm_block_size   = 16;
+        inline constexpr size_t _Min_segment_size = 65536; // smaller segments are not worth a thread
+
+        // the largest plaintext GCM supports with a 96-bit IV, (2^32 - 2) blocks
+        inline constexpr uint64_t _Gcm_max_size = ((uint64_t{1} << 32) - 2) * _Gcm_block_size;
+
+        inline uint64_t _Load_big_endian(const byte_t* const _Bytes) noexcept {
+            uint64_t _Value = 0;
+            for (size_t _Idx = 0; _Idx < sizeof(uint64_t); ++_Idx) {
+                _Value = (_Value << 8) | _Bytes[_Idx];
+            }
+
+            return _Value;
+        }
+
+        inline void _Store_big_endian(byte_t* const _Bytes, uint64_t _Value) noexcept {
+            for (size_t _Idx = sizeof(uint64_t); _Idx > 0; --_Idx) {
+                _Bytes[_Idx - 1] = static_cast<byte_t>(_Value);
+                _Value         >>= 8;
+            }
+        }
+
+        // multiplies two elements of GF(2^128) bit by bit, used if PCLMULQDQ is not available
+        inline void _Gf_multiply_generic(byte_t* const _Left, const byte_t* const _Right) noexcept {
+            const uint64_t _Xhi = _Load_big_endian(_Left);
+            const uint64_t _Xlo = _Load_big_endian(_Left + 8);
+            uint64_t _Vhi       = _Load_big_endian(_Right);
+            uint64_t _Vlo       = _Load_big_endian(_Right + 8);
+            uint64_t _Zhi       = 0;
+            uint64_t _Zlo       = 0;
+            for (int _Bit = 0; _Bit < 128; ++_Bit) {
+                const uint64_t _Mask = 0 - ((_Bit < 64 ? _Xhi >> (63 - _Bit) : _Xlo >> (127 - _Bit)) & 1);
+                _Zhi                ^= _Vhi & _Mask;
+                _Zlo                ^= _Vlo & _Mask;
+                const uint64_t _Carry = 0 - (_Vlo & 1);
+                _Vlo                  = (_Vlo >> 1) | (_Vhi << 63);
+                _Vhi                  = (_Vhi >> 1) ^ (0xE100'0000'0000'0000 & _Carry);
+            }
+
+            _Store_big_endian(_Left, _Zhi);
+            _Store_big_endian(_Left + 8, _Zlo);
+        }
+
+        inline __m128i _Byte_swap(const __m128i _Value) noexcept {
+            return _mm_shuffle_epi8(_Value, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+        }
+
+        // multiplies two byte-reflected elements of GF(2^128) using PCLMULQDQ
+        inline __m128i _Gf_multiply_clmul(const __m128i _Left, const __m128i _Right) noexcept {
+            __m128i _Low        = _mm_clmulepi64_si128(_Left, _Right, 0x00);
+            const __m128i _Mid  = _mm_xor_si128(
+                _mm_clmulepi64_si128(_Left, _Right, 0x10), _mm_clmulepi64_si128(_Left, _Right, 0x01));
+            __m128i _High       = _mm_clmulepi64_si128(_Left, _Right, 0x11);
+            _Low                = _mm_xor_si128(_Low, _mm_slli_si128(_Mid, 8));
+            _High               = _mm_xor_si128(_High, _mm_srli_si128(_Mid, 8));
+
+            // shift the 256-bit product left by one bit, the operands are bit-reflected
+            __m128i _Carry_low  = _mm_srli_epi32(_Low, 31);
+            __m128i _Carry_high = _mm_srli_epi32(_High, 31);
+            _Low                = _mm_slli_epi32(_Low, 1);
+            _High               = _mm_slli_epi32(_High, 1);
+            const __m128i _Over = _mm_srli_si128(_Carry_low, 12);
+            _Carry_high         = _mm_slli_si128(_Carry_high, 4);
+            _Carry_low          = _mm_slli_si128(_Carry_low, 4);
+            _Low                = _mm_or_si128(_Low, _Carry_low);
+            _High               = _mm_or_si128(_mm_or_si128(_High, _Carry_high), _Over);
+
+            // reduce modulo x^128 + x^7 + x^2 + x + 1
+            __m128i _First      = _mm_xor_si128(_mm_xor_si128(
+                _mm_slli_epi32(_Low, 31), _mm_slli_epi32(_Low, 30)), _mm_slli_epi32(_Low, 25));
+            const __m128i _Rest = _mm_srli_si128(_First, 4);
+            _First              = _mm_slli_si128(_First, 12);
+            _Low                = _mm_xor_si128(_Low, _First);
+            __m128i _Second     = _mm_xor_si128(_mm_xor_si128(
+                _mm_srli_epi32(_Low, 1), _mm_srli_epi32(_Low, 2)), _mm_srli_epi32(_Low, 7));
+            _Second             = _mm_xor_si128(_Second, _Rest);
+            _Low                = _mm_xor_si128(_Low, _Second);
+            return _mm_xor_si128(_High, _Low);
+        }
+
+        inline void _Gf_multiply(byte_t* const _Left, const byte_t* const _Right) noexcept {
+            if (_Get_cpu_features()._Pclmul && _Get_cpu_features()._Ssse3) {
+                const __m128i _Product = _Gf_multiply_clmul(
+                    _Byte_swap(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_Left))),
+                    _Byte_swap(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_Right))));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(_Left), _Byte_swap(_Product));
+            } else {
+                _Gf_multiply_generic(_Left, _Right);
+            }
+        }
+
+        // raises the hash key to the specified power
+        inline void _Gf_power(byte_t* const _Result, const byte_t* const _Base, uint64_t _Exponent) noexcept {
+            byte_t _Square[_Gcm_block_size];
+            ::memcpy(_Square, _Base, _Gcm_block_size);
+            ::memset(_Result, 0, _Gcm_block_size);
+            _Result[0] = 0x80; // the multiplicative identity in the GCM bit order
+            for (; _Exponent != 0; _Exponent >>= 1) {
+                if (_Exponent & 1) {
+                    _Gf_multiply(_Result, _Square);
+                }
+
+                _Gf_multiply(_Square, _Square);
+            }
+
+            _Wipe_memory(_Square, _Gcm_block_size);
+        }
+
+        // updates GHASH with full blocks
+        inline void _Ghash_blocks(
+            byte_t* const _Digest, const byte_t* const _Hash_key, const byte_t* _Data, size_t _Blocks) noexcept {
+            if (_Get_cpu_features()._Pclmul && _Get_cpu_features()._Ssse3) {
+                const __m128i _Hkey = _Byte_swap(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_Hash_key)));
+                __m128i _Value      = _Byte_swap(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_Digest)));
+                for (; _Blocks > 0; --_Blocks, _Data += _Gcm_block_size) {
+                    _Value = _Gf_multiply_clmul(_mm_xor_si128(_Value,
+                        _Byte_swap(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_Data)))), _Hkey);
+                }
+
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(_Digest), _Byte_swap(_Value));
+            } else {
+                for (; _Blocks > 0; --_Blocks, _Data += _Gcm_block_size) {
+                    for (size_t _Idx = 0; _Idx < _Gcm_block_size; ++_Idx) {
+                        _Digest[_Idx] ^= _Data[_Idx];
+                    }
+
+                    _Gf_multiply_generic(_Digest, _Hash_key);
+                }
+            }
+        }
+
+        struct _Gcm_context { // state shared by all segments of one message
+            byte_t _Hash_key[_Gcm_block_size]; // H = E(K, 0^128)
+            byte_t _Tag_mask[_Gcm_block_size]; // E(K, J0)
+            byte_t _Counter[_Gcm_block_size]; // J0 = IV || 0^31 || 1
+
+            _Gcm_context() noexcept : _Hash_key{0}, _Tag_mask{0}, _Counter{0} {}
+
+            ~_Gcm_context() noexcept {
+                _Wipe_memory(_Hash_key, _Gcm_block_size);
+                _Wipe_memory(_Tag_mask, _Gcm_block_size);
+            }
+
+            _Gcm_context(const _Gcm_context&)            = delete;
+            _Gcm_context& operator=(const _Gcm_context&) = delete;
+
+            bool _Setup(const key& _Key, const iv& _Iv) noexcept {
+                ::memcpy(_Counter, _Iv.data(), iv::size);
+                ::memset(_Counter + iv::size, 0, _Gcm_block_size - iv::size);
+                _Counter[_Gcm_block_size - 1] = 1;
+
+                byte_t _Blocks[_Gcm_block_size * 2] = {0}; // 0^128 followed by J0
+                ::memcpy(_Blocks + _Gcm_block_size, _Counter, _Gcm_block_size);
+                EVP_CIPHER_CTX* const _Ctx = ::EVP_CIPHER_CTX_new();
+                int _Unused                = 0; // number of encrypted bytes (unused)
+                const bool _Succeeded      = _Ctx != nullptr
+                    && ::EVP_EncryptInit_ex(_Ctx, ::EVP_aes_256_ecb(), nullptr, _Key.data(), nullptr) != 0
+                    && ::EVP_CIPHER_CTX_set_padding(_Ctx, 0) != 0
+                    && ::EVP_EncryptUpdate(_Ctx, _Blocks, &_Unused, _Blocks, sizeof(_Blocks)) != 0;
+                ::EVP_CIPHER_CTX_free(_Ctx);
+                if (_Succeeded) {
+                    ::memcpy(_Hash_key, _Blocks, _Gcm_block_size);
+                    ::memcpy(_Tag_mask, _Blocks + _Gcm_block_size, _Gcm_block_size);
+                }
+
+                _Wipe_memory(_Blocks, sizeof(_Blocks));
+                return _Succeeded;
+            }
+
+            // folds the partial GHASH of a segment followed by _Blocks_after blocks into _Digest
+            void _Combine(
+                byte_t* const _Digest, const byte_t* const _Partial, const uint64_t _Blocks_after) const noexcept {
+                byte_t _Term[_Gcm_block_size];
+                _Gf_power(_Term, _Hash_key, _Blocks_after);
+                _Gf_multiply(_Term, _Partial);
+                for (size_t _Idx = 0; _Idx < _Gcm_block_size; ++_Idx) {
+                    _Digest[_Idx] ^= _Term[_Idx];
+                }
+
+                _Wipe_memory(_Term, _Gcm_block_size);
+            }
+
+            // combines the partial GHASH of equally sized segments and computes the authentication tag
+            void _Finish(const byte_t* const _Digests, const size_t _Segments,
+                const uint64_t _Segment_size, const uint64_t _Size, authentication_tag& _Tag) const noexcept {
+                const uint64_t _Blocks          = (_Size + _Gcm_block_size - 1) / _Gcm_block_size;
+                byte_t _Digest[_Gcm_block_size] = {0};
+                for (size_t _Idx = 0; _Idx < _Segments; ++_Idx) { // fold the partial results in the message order
+                    const uint64_t _End = (::std::min)((_Idx + 1) * _Segment_size, _Size);
+                    _Combine(_Digest, _Digests + _Idx * _Gcm_block_size,
+                        _Blocks - (_End + _Gcm_block_size - 1) / _Gcm_block_size);
+                }
+
+                _Finish(_Digest, _Size, _Tag);
+                _Wipe_memory(_Digest, _Gcm_block_size);
+            }
+
+            // hashes the length block and masks the final GHASH value
+            void _Finish(byte_t* const _Digest, const uint64_t _Size, authentication_tag& _Tag) const noexcept {
+                byte_t _Lengths[_Gcm_block_size] = {0}; // no additional authenticated data
+                _Store_big_endian(_Lengths + 8, _Size * 8);
+                _Ghash_blocks(_Digest, _Hash_key, _Lengths, 1);
+                for (size_t _Idx = 0; _Idx < _Gcm_block_size; ++_Idx) {
+                    _Digest[_Idx] ^= _Tag_mask[_Idx];
+                }
+
+                _Tag.assign(_Digest);
+            }
+        };
+
+        class _Gcm_segment { // encrypts and hashes a contiguous block-aligned part of the message
+        public:
+            _Gcm_segment() noexcept
+                : _Myctx(::EVP_CIPHER_CTX_new()), _Myhash_key(nullptr), _Mydigest{0}, _Myclosed(false) {}
+
+            ~_Gcm_segment() noexcept {
+                if (_Myctx) {
+                    ::EVP_CIPHER_CTX_free(_Myctx);
+                    _Myctx = nullptr;
+                }
+
+                _Wipe_memory(_Mydigest, _Gcm_block_size);
+            }
+
+            _Gcm_segment(const _Gcm_segment&)            = delete;
+            _Gcm_segment& operator=(const _Gcm_segment&) = delete;
+
+            // prepares the segment that starts at the specified block of the message
+            bool _Setup(const key& _Key, const _Gcm_context& _Ctx, const uint64_t _First_block) noexcept {
+                if (!_Myctx) {
+                    return false;
+                }
+
+                // the first block of the message uses the counter J0 + 1, the counter is 32 bits wide
+                byte_t _Counter[_Gcm_block_size];
+                ::memcpy(_Counter, _Ctx._Counter, _Gcm_block_size);
+                const uint32_t _Value = ((static_cast<uint32_t>(_Counter[12]) << 24)
+                    | (static_cast<uint32_t>(_Counter[13]) << 16) | (static_cast<uint32_t>(_Counter[14]) << 8)
+                    | static_cast<uint32_t>(_Counter[15])) + 1 + static_cast<uint32_t>(_First_block);
+                _Counter[12] = static_cast<byte_t>(_Value >> 24);
+                _Counter[13] = static_cast<byte_t>(_Value >> 16);
+                _Counter[14] = static_cast<byte_t>(_Value >> 8);
+                _Counter[15] = static_cast<byte_t>(_Value);
+                _Myhash_key  = _Ctx._Hash_key;
+                _Myclosed    = false;
+                ::memset(_Mydigest, 0, _Gcm_block_size);
+                return ::EVP_EncryptInit_ex(_Myctx, ::EVP_aes_256_ctr(), nullptr, _Key.data(), _Counter) != 0;
+            }
+
+            // encrypts the data, only the last call may pass a size that is not a multiple of the block size
+            bool _Encrypt(const byte_t* const _Bytes, const size_t _Count, byte_t* const _Buf) noexcept {
+                if (_Myclosed) { // a partial block has already been processed
+                    return false;
+                }
+
+                if (!_Apply_keystream(_Bytes, _Count, _Buf)) {
+                    return false;
+                }
+
+                _Hash(_Buf, _Count);
+                return true;
+            }
+
+            // decrypts the data, only the last call may pass a size that is not a multiple of the block size
+            bool _Decrypt(const byte_t* const _Bytes, const size_t _Count, byte_t* const _Buf) noexcept {
+                if (_Myclosed) { // a partial block has already been processed
+                    return false;
+                }
+
+                _Hash(_Bytes, _Count); // hash the ciphertext first, _Bytes and _Buf may refer to the same memory
+                return _Apply_keystream(_Bytes, _Count, _Buf);
+            }
+
+            // returns the partial GHASH of the segment
+            const byte_t* _Digest() const noexcept {
+                return _Mydigest;
+            }
+
+        private:
+            bool _Apply_keystream(const byte_t* const _Bytes, const size_t _Count, byte_t* const _Buf) noexcept {
+                int _Unused = 0; // number of encrypted bytes (unused)
+                return ::EVP_EncryptUpdate(_Myctx, _Buf, &_Unused, _Bytes, static_cast<int>(_Count)) != 0;
+            }
+
+            void _Hash(const byte_t* const _Bytes, const size_t _Count) noexcept {
+                const size_t _Full = _Count / _Gcm_block_size;
+                const size_t _Rest = _Count % _Gcm_block_size;
+                _Ghash_blocks(_Mydigest, _Myhash_key, _Bytes, _Full);
+                if (_Rest != 0) { // pad the last block with zeros
+                    byte_t _Last[_Gcm_block_size] = {0};
+                    ::memcpy(_Last, _Bytes + _Full * _Gcm_block_size, _Rest);
+                    _Ghash_blocks(_Mydigest, _Myhash_key, _Last, 1);
+                    _Myclosed = true;
+                }
+            }
+
+            EVP_CIPHER_CTX* _Myctx;
+            const byte_t* _Myhash_key;
+            byte_t _Mydigest[_Gcm_block_size];
+            bool _Myclosed;
+        };
+    } // namespace efc_impl
+} // namespace mjx
+
+#endif // _EFC_IMPL_PARALLEL_ENCRYPTION_ENGINE_HPP_
\ No newline at end of file
@@ -0,0 +1,210 @@
+// pipeline.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_IMPL_PIPELINE_HPP_
+#define _EFC_IMPL_PIPELINE_HPP_
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <efc/impl/buffer_pool.hpp>
+#include <memory>
+#include <mjfs/file_stream.hpp>
+#include <mutex>
+#include <new>
+#include <thread>
+
+namespace mjx {
+    namespace efc_impl {
+        // Note: Locking a mutex throws only if the system fails to lock it, which leaves the pipeline
+        //       in an unknown state. The queue is used only by noexcept functions, which would terminate
+        //       the program anyway, so _Push(), _Pop() and _Abort() are deliberately noexcept as well.
+        class _Slot_queue { // blocking ring of buffer slot indices, large enough to hold every slot
+        public:
+            _Slot_queue() noexcept : _Myring(), _Mycapacity(0), _Myfirst(0), _Mysize(0), _Myaborted(false) {}
+
+            bool _Init(const size_t _Capacity) noexcept {
+                _Myring.reset(new (::std::nothrow) size_t[_Capacity]);
+                _Mycapacity = _Capacity;
+                return _Myring != nullptr;
+            }
+
+            void _Push(const size_t _Slot) noexcept {
+                {
+                    ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+                    _Myring[(_Myfirst + _Mysize) % _Mycapacity] = _Slot;
+                    ++_Mysize;
+                }
+
+                _Mycv.notify_one();
+            }
+
+            // waits for the next slot, returns false if the pipeline has been aborted
+            bool _Pop(size_t& _Slot) noexcept {
+                ::std::unique_lock<::std::mutex> _Lock(_Mymtx);
+                _Mycv.wait(_Lock, [this] { return _Mysize > 0 || _Myaborted; });
+                if (_Myaborted) {
+                    return false;
+                }
+
+                _Slot    = _Myring[_Myfirst];
+                _Myfirst = (_Myfirst + 1) % _Mycapacity;
+                --_Mysize;
+                return true;
+            }
+
+            void _Abort() noexcept {
+                {
+                    ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+                    _Myaborted = true;
+                }
+
+                _Mycv.notify_all();
+            }
+
+        private:
+            ::std::mutex _Mymtx;
+            ::std::condition_variable _Mycv;
+            ::std::unique_ptr<size_t[]> _Myring;
+            size_t _Mycapacity;
+            size_t _Myfirst;
+            size_t _Mysize;
+            bool _Myaborted;
+        };
+
+        struct _Pipeline_slot {
+            byte_t* _Data = nullptr; // transformed in place
+            size_t _Size  = 0;
+            bool _Last   = false; // set for the slot that holds the end of the data
+        };
+
+        class _Pipeline { // overlaps reading, transforming and writing of the data
+        public:
+            _Pipeline(file_stream& _Src, file_stream& _Dest) noexcept
+                : _Mysrc(_Src), _Mydest(_Dest), _Mybuf_size(0), _Myslots() {}
+
+            // assigns one buffer from the pool to each slot
+            bool _Init(const _Buffer_pool& _Pool) noexcept {
+                const size_t _Depth = _Pool._Count();
+                _Myslots.reset(new (::std::nothrow) _Pipeline_slot[_Depth]);
+                if (!_Myslots || !_Myfree._Init(_Depth) || !_Myfilled._Init(_Depth) || !_Myprocessed._Init(_Depth)) {
+                    return false;
+                }
+
+                for (size_t _Idx = 0; _Idx < _Depth; ++_Idx) {
+                    _Myslots[_Idx]._Data = _Pool._Get(_Idx);
+                    _Myfree._Push(_Idx); // every slot is free at the beginning
+                }
+
+                _Mybuf_size = _Pool._Size();
+                return true;
+            }
+
+            // runs the reader and the writer on their own threads, _Func transforms the data
+            template <class _Fn>
+            bool _Run(_Fn&& _Func) noexcept {
+                bool _Succeeded = false;
+                try {
+                    ::std::thread _Reader(&_Pipeline::_Read, this);
+                    ::std::thread _Writer;
+                    try {
+                        _Writer = ::std::thread(&_Pipeline::_Write, this);
+                    } catch (...) {
+                        _Abort();
+                        _Reader.join();
+                        return false;
+                    }
+
+                    _Succeeded = _Transform(_Func);
+                    _Reader.join();
+                    _Writer.join();
+                } catch (...) {
+                    return false;
+                }
+
+                return _Succeeded && !_Myfailed;
+            }
+
+        private:
+            void _Abort() noexcept {
+                _Myfailed = true;
+                _Myfree._Abort();
+                _Myfilled._Abort();
+                _Myprocessed._Abort();
+            }
+
+            void _Read() noexcept {
+                size_t _Slot;
+                for (;;) {
+                    if (!_Myfree._Pop(_Slot)) { // the pipeline has been aborted
+                        return;
+                    }
+
+                    _Pipeline_slot& _Current = _Myslots[_Slot];
+                    _Current._Size           = _Mysrc.read(_Current._Data, _Mybuf_size);
+                    _Current._Last           = _Current._Size < _Mybuf_size; // no more data
+                    _Myfilled._Push(_Slot);
+                    if (_Current._Last) {
+                        return;
+                    }
+                }
+            }
+
+            template <class _Fn>
+            bool _Transform(_Fn& _Func) noexcept {
+                size_t _Slot;
+                for (;;) {
+                    if (!_Myfilled._Pop(_Slot)) { // the pipeline has been aborted
+                        return false;
+                    }
+
+                    _Pipeline_slot& _Current = _Myslots[_Slot];
+                    if (_Current._Size > 0 && !_Func(_Current._Data, _Current._Size, _Current._Data)) {
+                        _Abort();
+                        return false;
+                    }
+
+                    const bool _Last = _Current._Last;
+                    _Myprocessed._Push(_Slot);
+                    if (_Last) {
+                        return true;
+                    }
+                }
+            }
+
+            void _Write() noexcept {
+                size_t _Slot;
+                for (;;) {
+                    if (!_Myprocessed._Pop(_Slot)) { // the pipeline has been aborted
+                        return;
+                    }
+
+                    _Pipeline_slot& _Current = _Myslots[_Slot];
+                    if (_Current._Size > 0 && !_Mydest.write(_Current._Data, _Current._Size)) {
+                        _Abort();
+                        return;
+                    }
+
+                    if (_Current._Last) {
+                        return;
+                    }
+
+                    _Myfree._Push(_Slot); // recycle the slot
+                }
+            }
+
+            file_stream& _Mysrc;
+            file_stream& _Mydest;
+            size_t _Mybuf_size;
+            ::std::unique_ptr<_Pipeline_slot[]> _Myslots;
+            _Slot_queue _Myfree;
+            _Slot_queue _Myfilled;
+            _Slot_queue _Myprocessed;
+            ::std::atomic<bool> _Myfailed{false};
+        };
+    } // namespace efc_impl
+} // namespace mjx
+
+#endif // _EFC_IMPL_PIPELINE_HPP_
\ No newline at end of file
@@ -6,22 +6,34 @@
 #pragma once
 #ifndef _EFC_IMPL_PROGRAM_HPP_
 #define _EFC_IMPL_PROGRAM_HPP_
+#include <cstdint>
+#include <efc/impl/file_io.hpp>
 #include <efc/program.hpp>
+#include <mjfs/file.hpp>
 #include <mjfs/status.hpp>
 #include <type_traits>
 
 namespace mjx {
     namespace efc_impl {
         struct _Parser_context{
-            bool _Path_found      : 3;
-            bool _Operation_found : 3;
-            bool _Password_found  : 2;
+            bool _Path_found        : 3;
+            bool _Operation_found   : 3;
+            bool _Password_found    : 2;
+            bool _Raw_key_found     : 1;
+            bool _Format_found      : 1;
+            bool _Direct_io_found   : 1;
+            bool _Stdin_found       : 1;
+            bool _Stdout_found      : 1;
+            bool _Recursive_found   : 1;
+            bool _Kdf_params_found  : 1;
+            bool _Target_time_found : 1;
+            bool _No_agent_found    : 1;
+            bool _Agent_ttl_found   : 1;
 
-            _Parser_context() noexcept : _Path_found(false), _Operation_found(false), _Password_found(false) {}
-
-            bool _Parse_completed() const noexcept {
-                return _Path_found && _Operation_found && _Password_found;
-            }
+            _Parser_context() noexcept : _Path_found(false), _Operation_found(false), _Password_found(false),
+                _Raw_key_found(false), _Format_found(false), _Direct_io_found(false), _Stdin_found(false),
+                _Stdout_found(false), _Recursive_found(false), _Kdf_params_found(false), _Target_time_found(false),
+                _No_agent_found(false), _Agent_ttl_found(false) {}
         };
 
         struct _Parser_data {
@@ -53,6 +65,12 @@ namespace mjx {
                 _Data._Options.operation = operation::encryption;
             } else if (_Data._Arg == L"--decrypt") {
                 _Data._Options.operation = operation::decryption;
+            } else if (_Data._Arg == L"--calibrate") {
+                _Data._Options.operation = operation::calibration;
+            } else if (_Data._Arg == L"--agent") {
+                _Data._Options.operation = operation::agent;
+            } else if (_Data._Arg == L"--serve") {
+                _Data._Options.operation = operation::service;
             } else {
                 return false;
             }
@@ -70,6 +88,191 @@ namespace mjx {
             _Ctx._Password_found = true;
             return true;
         }
+
+        inline bool _Parse_format(_Parser_context& _Ctx, _Parser_data& _Data) noexcept {
+            if (_Data._Arg != L"--legacy") {
+                return false;
+            }
+
+            _Data._Options.format = file_format::legacy;
+            _Ctx._Format_found    = true;
+            return true;
+        }
+
+        inline bool _Parse_direct_io(_Parser_context& _Ctx, _Parser_data& _Data) noexcept {
+            if (_Data._Arg != L"--direct") {
+                return false;
+            }
+
+            _Data._Options.direct_io = true;
+            _Ctx._Direct_io_found    = true;
+            return true;
+        }
+
+        inline bool _Parse_standard_stream(_Parser_context& _Ctx, _Parser_data& _Data) noexcept {
+            if (_Data._Arg == L"--stdin") {
+                _Data._Options.use_stdin = true;
+                _Ctx._Stdin_found        = true;
+            } else if (_Data._Arg == L"--stdout") {
+                _Data._Options.use_stdout = true;
+                _Ctx._Stdout_found        = true;
+            } else {
+                return false;
+            }
+
+            return true;
+        }
+
+        inline bool _Parse_recursive(_Parser_context& _Ctx, _Parser_data& _Data) noexcept {
+            if (_Data._Arg != L"--recursive") {
+                return false;
+            }
+
+            _Data._Options.recursive = true;
+            _Ctx._Recursive_found    = true;
+            return true;
+        }
+
+        inline bool _Parse_integer(const unicode_string_view _Str, uint32_t& _Value) noexcept {
+            // parses a decimal integer, fails if it is empty, contains other characters or exceeds UINT32_MAX
+            if (_Str.empty()) {
+                return false;
+            }
+
+            uint64_t _Result = 0;
+            for (const wchar_t _Ch : _Str) {
+                if (_Ch < L'0' || _Ch > L'9') {
+                    return false;
+                }
+
+                _Result = _Result * 10 + (_Ch - L'0');
+                if (_Result > UINT32_MAX) {
+                    return false;
+                }
+            }
+
+            _Value = static_cast<uint32_t>(_Result);
+            return true;
+        }
+
+        inline bool _Load_raw_key_from_file(const unicode_string_view _Path, key& _Key) {
+            file _File(path{_Path}, file_access::read, file_share::read);
+            if (!_File.is_open() || _File.size() != key::size) { // the file must contain nothing but the key
+                return false;
+            }
+
+            return _Read_exactly(_File.native_handle(), _Key.data(), key::size);
+        }
+
+        inline bool _Load_raw_key_from_handle(const uint32_t _Fd, key& _Key) noexcept {
+            // Note: 0 refers to the standard input, any other value to a handle inherited from the parent
+            //       process, usually the read end of a pipe. Only the key is read from the standard input,
+            //       so it can be followed by the data to encrypt if --stdin is specified as well.
+            if (_Fd == 0) {
+                const HANDLE _Handle = ::GetStdHandle(STD_INPUT_HANDLE);
+                return _Handle != nullptr && _Handle != INVALID_HANDLE_VALUE
+                    && _Read_exactly(_Handle, _Key.data(), key::size);
+            }
+
+            const HANDLE _Handle = reinterpret_cast<HANDLE>(static_cast<uintptr_t>(_Fd));
+            const DWORD _Type    = ::GetFileType(_Handle);
+            if (_Type != FILE_TYPE_DISK && _Type != FILE_TYPE_PIPE) { // not a file or a pipe, leave it untouched
+                return false;
+            }
+
+            const bool _Loaded = _Read_exactly(_Handle, _Key.data(), key::size);
+            ::CloseHandle(_Handle); // the handle is not needed anymore
+            return _Loaded;
+        }
+
+        inline bool _Parse_raw_key(_Parser_context& _Ctx, _Parser_data& _Data) {
+            // expects --key-file=<path> or --key-fd=<handle>, both must provide the raw 32-byte key
+            const unicode_string_view _Value = _Data._Arg.substr(_Data._Arg.find(L'=') + 1);
+            bool _Loaded;
+            uint32_t _Fd;
+            if (_Data._Arg.starts_with(L"--key-file=")) {
+                _Loaded = _Load_raw_key_from_file(_Value, _Data._Options.raw_key);
+            } else if (_Data._Arg.starts_with(L"--key-fd=")) {
+                _Loaded = _Parse_integer(_Value, _Fd) && _Load_raw_key_from_handle(_Fd, _Data._Options.raw_key);
+            } else {
+                return false;
+            }
+
+            if (!_Loaded || !_Data._Options.raw_key.valid()) { // an all-zero key is rejected as well
+                _Data._Options.raw_key.reset();
+                return false;
+            }
+
+            _Ctx._Raw_key_found = true;
+            return true;
+        }
+
+        inline bool _Parse_kdf_params(_Parser_context& _Ctx, _Parser_data& _Data) noexcept {
+            // expects --kdf=<memory>,<iterations>,<lanes>, the format printed by --calibrate
+            if (!_Data._Arg.starts_with(L"--kdf=")) {
+                return false;
+            }
+
+            unicode_string_view _Rest = _Data._Arg.substr(_Data._Arg.find(L'=') + 1);
+            uint32_t _Values[3];
+            for (size_t _Idx = 0; _Idx < 3; ++_Idx) {
+                const size_t _Comma = _Idx < 2 ? _Rest.find(L',') : _Rest.size();
+                if (_Comma == unicode_string_view::npos || !_Parse_integer(_Rest.substr(0, _Comma), _Values[_Idx])) {
+                    return false;
+                }
+
+                _Rest = _Idx < 2 ? _Rest.substr(_Comma + 1) : unicode_string_view{};
+            }
+
+            const key_derivation_params _Params = {_Values[0], _Values[1], _Values[2]};
+            if (!is_valid_key_derivation_params(_Params)) {
+                return false;
+            }
+
+            _Data._Options.kdf_params = _Params;
+            _Ctx._Kdf_params_found    = true;
+            return true;
+        }
+
+        inline bool _Parse_target_time(_Parser_context& _Ctx, _Parser_data& _Data) noexcept {
+            if (!_Data._Arg.starts_with(L"--target-time=")) {
+                return false;
+            }
+
+            uint32_t _Time;
+            if (!_Parse_integer(_Data._Arg.substr(_Data._Arg.find(L'=') + 1), _Time) || _Time == 0) {
+                return false;
+            }
+
+            _Data._Options.target_time = _Time;
+            _Ctx._Target_time_found    = true;
+            return true;
+        }
+
+        inline bool _Parse_no_agent(_Parser_context& _Ctx, _Parser_data& _Data) noexcept {
+            if (_Data._Arg != L"--no-agent") {
+                return false;
+            }
+
+            _Data._Options.use_agent = false;
+            _Ctx._No_agent_found     = true;
+            return true;
+        }
+
+        inline bool _Parse_agent_ttl(_Parser_context& _Ctx, _Parser_data& _Data) noexcept {
+            if (!_Data._Arg.starts_with(L"--ttl=")) {
+                return false;
+            }
+
+            uint32_t _Ttl;
+            if (!_Parse_integer(_Data._Arg.substr(_Data._Arg.find(L'=') + 1), _Ttl) || _Ttl == 0) {
+                return false;
+            }
+
+            _Data._Options.agent_ttl = _Ttl;
+            _Ctx._Agent_ttl_found    = true;
+            return true;
+        }
     } // namespace efc_impl
 } // namespace mjx
 
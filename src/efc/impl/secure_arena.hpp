@@ -0,0 +1,142 @@
+// secure_arena.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_IMPL_SECURE_ARENA_HPP_
+#define _EFC_IMPL_SECURE_ARENA_HPP_
+#include <cstddef>
+#include <efc/impl/secure_memory.hpp>
+#include <efc/impl/tinywin.hpp>
+#include <mjstr/char_traits.hpp>
+
+namespace mjx {
+    namespace efc_impl {
+        inline bool _Enable_lock_memory_privilege() noexcept { // required by large pages
+            HANDLE _Token;
+            if (!::OpenProcessToken(::GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &_Token)) {
+                return false;
+            }
+
+            TOKEN_PRIVILEGES _Privileges;
+            _Privileges.PrivilegeCount           = 1;
+            _Privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+            bool _Enabled                        = false;
+            if (::LookupPrivilegeValueW(nullptr, SE_LOCK_MEMORY_NAME, &_Privileges.Privileges[0].Luid)) {
+                // Note: AdjustTokenPrivileges() also succeeds if the privilege has not been assigned to the user,
+                //       in which case the last error is ERROR_NOT_ALL_ASSIGNED.
+                _Enabled = ::AdjustTokenPrivileges(_Token, FALSE, &_Privileges, 0, nullptr, nullptr) != 0
+                        && ::GetLastError() == ERROR_SUCCESS;
+            }
+
+            ::CloseHandle(_Token);
+            return _Enabled;
+        }
+
+        inline bool _Lock_pages(void* const _Ptr, const size_t _Size) noexcept {
+            if (::VirtualLock(_Ptr, _Size)) {
+                return true;
+            }
+
+            if (::GetLastError() != ERROR_WORKING_SET_QUOTA) {
+                return false;
+            }
+
+            // the locked pages must fit in the minimum working set, grow it and try again
+            const HANDLE _Process = ::GetCurrentProcess();
+            SIZE_T _Min_size;
+            SIZE_T _Max_size;
+            if (!::GetProcessWorkingSetSize(_Process, &_Min_size, &_Max_size)
+                || !::SetProcessWorkingSetSize(_Process, _Min_size + _Size, _Max_size + _Size)) {
+                return false;
+            }
+
+            return ::VirtualLock(_Ptr, _Size) != 0;
+        }
+
+        class _Secure_arena { // memory that is kept out of the page file and wiped before it is released
+        public:
+            _Secure_arena() noexcept : _Mydata(nullptr), _Mysize(0), _Mylarge_pages(false), _Mylocked(false) {}
+
+            ~_Secure_arena() noexcept {
+                _Release();
+            }
+
+            _Secure_arena(const _Secure_arena&)            = delete;
+            _Secure_arena& operator=(const _Secure_arena&) = delete;
+
+            // allocates at least _Size bytes, preferably backed by large pages if requested
+            bool _Allocate(const size_t _Size, const bool _Large_pages) noexcept {
+                _Release();
+                if (_Size == 0) {
+                    return false;
+                }
+
+                if (_Large_pages && _Enable_lock_memory_privilege()) {
+                    const size_t _Page_size = ::GetLargePageMinimum();
+                    if (_Page_size != 0) { // large pages supported, the size must be their multiple
+                        const size_t _Rounded_size = (_Size + _Page_size - 1) / _Page_size * _Page_size;
+                        _Mydata                    = static_cast<byte_t*>(::VirtualAlloc(
+                            nullptr, _Rounded_size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE));
+                        if (_Mydata) {
+                            _Mysize        = _Rounded_size;
+                            _Mylarge_pages = true;
+                            _Mylocked      = true; // large pages are never paged out
+                            return true;
+                        }
+                    }
+                }
+
+                _Mydata =
+                    static_cast<byte_t*>(::VirtualAlloc(nullptr, _Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+                if (!_Mydata) {
+                    return false;
+                }
+
+                _Mysize   = _Size;
+                _Mylocked = _Lock_pages(_Mydata, _Size); // not fatal, the memory is still usable
+                return true;
+            }
+
+            byte_t* _Data() const noexcept {
+                return _Mydata;
+            }
+
+            size_t _Size() const noexcept {
+                return _Mysize;
+            }
+
+            bool _Uses_large_pages() const noexcept {
+                return _Mylarge_pages;
+            }
+
+            bool _Is_locked() const noexcept {
+                return _Mylocked;
+            }
+
+        private:
+            void _Release() noexcept {
+                if (_Mydata) {
+                    _Wipe_memory(_Mydata, _Mysize);
+                    if (_Mylocked && !_Mylarge_pages) {
+                        ::VirtualUnlock(_Mydata, _Mysize);
+                    }
+
+                    ::VirtualFree(_Mydata, 0, MEM_RELEASE);
+                    _Mydata        = nullptr;
+                    _Mysize        = 0;
+                    _Mylarge_pages = false;
+                    _Mylocked      = false;
+                }
+            }
+
+            byte_t* _Mydata;
+            size_t _Mysize;
+            bool _Mylarge_pages;
+            bool _Mylocked;
+        };
+    } // namespace efc_impl
+} // namespace mjx
+
+#endif // _EFC_IMPL_SECURE_ARENA_HPP_
\ No newline at end of file
@@ -9,6 +9,7 @@
 #include <cstddef>
 #include <cstring>
 #include <efc/impl/tinywin.hpp>
+#include <mjstr/char_traits.hpp>
 
 namespace mjx {
     namespace efc_impl {
@@ -24,6 +25,19 @@ namespace mjx {
             ::memcpy(_Dest, _Src, _Size);
             _Wipe_memory(_Src, _Size);
         }
+
+        inline bool _Compare_sensitive_data(
+            const void* const _Left, const void* const _Right, const size_t _Size) noexcept {
+            // Note: Every byte is compared, so that the time does not reveal the position of the first mismatch.
+            const volatile byte_t* const _Left_bytes  = static_cast<const volatile byte_t*>(_Left);
+            const volatile byte_t* const _Right_bytes = static_cast<const volatile byte_t*>(_Right);
+            byte_t _Diff                              = 0;
+            for (size_t _Idx = 0; _Idx < _Size; ++_Idx) {
+                _Diff |= static_cast<byte_t>(_Left_bytes[_Idx] ^ _Right_bytes[_Idx]);
+            }
+
+            return _Diff == 0;
+        }
     } // namespace efc_impl
 } // namespace mjx
 
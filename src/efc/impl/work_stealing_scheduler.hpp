@@ -0,0 +1,58 @@
+// work_stealing_scheduler.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_IMPL_WORK_STEALING_SCHEDULER_HPP_
+#define _EFC_IMPL_WORK_STEALING_SCHEDULER_HPP_
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <efc/work_stealing_scheduler.hpp>
+#include <mutex>
+
+namespace mjx {
+    namespace efc_impl {
+        struct _Worker_queue { // tasks of one worker, the owner uses the back, thieves use the front
+            ::std::mutex _Mtx;
+            ::std::deque<work_stealing_scheduler::task> _Tasks;
+            ::std::atomic<uint64_t> _Executed{0};
+            ::std::atomic<uint64_t> _Stolen{0};
+            ::std::atomic<uint64_t> _Failed_steals{0};
+            ::std::atomic<uint64_t> _Max_size{0};
+
+            void _Push(work_stealing_scheduler::task&& _Task) {
+                ::std::lock_guard<::std::mutex> _Guard(_Mtx);
+                _Tasks.push_back(::std::move(_Task));
+                if (_Tasks.size() > _Max_size.load(::std::memory_order_relaxed)) {
+                    _Max_size.store(_Tasks.size(), ::std::memory_order_relaxed);
+                }
+            }
+
+            bool _Pop_back(work_stealing_scheduler::task& _Task) noexcept { // the most recently pushed task
+                ::std::lock_guard<::std::mutex> _Guard(_Mtx);
+                if (_Tasks.empty()) {
+                    return false;
+                }
+
+                _Task = ::std::move(_Tasks.back());
+                _Tasks.pop_back();
+                return true;
+            }
+
+            bool _Pop_front(work_stealing_scheduler::task& _Task) noexcept { // the oldest task
+                ::std::lock_guard<::std::mutex> _Guard(_Mtx);
+                if (_Tasks.empty()) {
+                    return false;
+                }
+
+                _Task = ::std::move(_Tasks.front());
+                _Tasks.pop_front();
+                return true;
+            }
+        };
+    } // namespace efc_impl
+} // namespace mjx
+
+#endif // _EFC_IMPL_WORK_STEALING_SCHEDULER_HPP_
\ No newline at end of file
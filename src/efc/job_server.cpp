@@ -0,0 +1,248 @@
+// job_server.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <chrono>
+#include <condition_variable>
+#include <efc/impl/file_io.hpp>
+#include <efc/impl/latency_histogram.hpp>
+#include <efc/impl/named_pipe.hpp>
+#include <efc/job_server.hpp>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace mjx {
+    namespace efc_impl {
+        inline constexpr uint32_t _Job_protocol_version = 1;
+        inline constexpr uint32_t _Stats_request        = 0x100; // the type of a request for the statistics
+        inline constexpr uint32_t _Max_job_path         = 32767; // the longest path Windows supports
+        inline constexpr DWORD _Job_busy_timeout        = 30000; // in milliseconds
+
+        // Note: All fields are little-endian. The request header is followed by the path of the file,
+        //       _Path_length UTF-16 code units without the terminating null character.
+        struct _Job_request {
+            uint32_t _Version;
+            uint32_t _Type; // job_type or _Stats_request
+            uint32_t _Path_length;
+        };
+
+        struct _Job_response {
+            uint32_t _Status;
+            uint32_t _Reserved; // keeps the following fields aligned
+            uint64_t _Bytes;
+            uint64_t _Queue_time;
+            uint64_t _Run_time;
+        };
+
+        struct _Stats_response {
+            uint64_t _Completed;
+            uint64_t _Failed;
+            uint64_t _P50;
+            uint64_t _P99;
+            uint64_t _Max;
+        };
+
+        inline uint64_t _Elapsed_microseconds(const ::std::chrono::steady_clock::time_point _Start,
+            const ::std::chrono::steady_clock::time_point _End) noexcept {
+            return static_cast<uint64_t>(
+                ::std::chrono::duration_cast<::std::chrono::microseconds>(_End - _Start).count());
+        }
+
+        inline bool _Is_job_type(const uint32_t _Type) noexcept {
+            return _Type >= static_cast<uint32_t>(job_type::encryption)
+                && _Type <= static_cast<uint32_t>(job_type::verification);
+        }
+
+        inline bool _Make_job_server_pipe_name(wchar_t (&_Name)[_Max_pipe_name]) noexcept {
+            return _Make_user_pipe_name(L"\\\\.\\pipe\\efc-serve-", _Name);
+        }
+    } // namespace efc_impl
+
+    job_server::job_server(work_stealing_scheduler& _Scheduler, handler _Handler, const size_t _Clients) noexcept
+        : _Myscheduler(_Scheduler), _Myhandler(::std::move(_Handler)), _Myclients(_Clients),
+        _Myserver(new (::std::nothrow) efc_impl::_Pipe_server),
+        _Mylatency(new (::std::nothrow) efc_impl::_Latency_histogram), _Mycompleted(0), _Myfailed(0) {}
+
+    job_server::~job_server() noexcept {}
+
+    bool job_server::is_valid() const noexcept {
+        return _Myserver && _Myserver->_Is_valid() && _Mylatency && _Myhandler && _Myclients != 0
+            && _Myscheduler.is_running();
+    }
+
+    bool job_server::run() noexcept {
+        wchar_t _Name[efc_impl::_Max_pipe_name];
+        if (!is_valid() || !efc_impl::_Make_job_server_pipe_name(_Name)) {
+            return false;
+        }
+
+        const bool _Started = _Myserver->_Start(_Name, _Myclients, sizeof(efc_impl::_Job_response),
+            [this](efc_impl::_Pipe_connection& _Connection) noexcept {
+                return _Serve(_Connection);
+            });
+        if (_Started) {
+            _Myserver->_Wait(INFINITE);
+        }
+
+        _Myserver->_Stop(); // stop the started threads if not all instances have been created
+        _Myserver->_Join();
+        return _Started;
+    }
+
+    void job_server::stop() noexcept {
+        if (_Myserver) {
+            _Myserver->_Stop();
+        }
+    }
+
+    job_server_stats job_server::stats() const noexcept {
+        job_server_stats _Stats;
+        if (_Mylatency) {
+            _Stats.completed = _Mycompleted.load(::std::memory_order_relaxed);
+            _Stats.failed    = _Myfailed.load(::std::memory_order_relaxed);
+            _Stats.p50       = _Mylatency->_Percentile(50);
+            _Stats.p99       = _Mylatency->_Percentile(99);
+            _Stats.max       = _Mylatency->_Max();
+        }
+
+        return _Stats;
+    }
+
+    bool job_server::_Serve(efc_impl::_Pipe_connection& _Connection) noexcept {
+        efc_impl::_Job_request _Request;
+        if (!_Connection._Read(&_Request, sizeof(_Request))) {
+            return false;
+        }
+
+        if (_Request._Version == efc_impl::_Job_protocol_version && _Request._Type == efc_impl::_Stats_request) {
+            const job_server_stats& _Stats            = stats();
+            const efc_impl::_Stats_response _Response = {
+                _Stats.completed, _Stats.failed, _Stats.p50, _Stats.p99, _Stats.max};
+            return _Connection._Write(&_Response, sizeof(_Response));
+        }
+
+        job_result _Result;
+        _Result.status = rejected;
+        if (_Request._Version == efc_impl::_Job_protocol_version && efc_impl::_Is_job_type(_Request._Type)
+            && _Request._Path_length != 0 && _Request._Path_length <= efc_impl::_Max_job_path) {
+            try {
+                ::std::vector<wchar_t> _Buf(_Request._Path_length);
+                if (!_Connection._Read(_Buf.data(), _Buf.size() * sizeof(wchar_t))) {
+                    return false;
+                }
+
+                _Result = _Run_job(static_cast<job_type>(_Request._Type),
+                    path{unicode_string_view{_Buf.data(), _Buf.size()}});
+            } catch (...) { // failed to allocate the path, reject the job
+                _Result.status = rejected;
+            }
+        }
+
+        (_Result.status == 0 ? _Mycompleted : _Myfailed).fetch_add(1, ::std::memory_order_relaxed);
+
+        const efc_impl::_Job_response _Response = {
+            _Result.status, 0, _Result.bytes, _Result.queue_time, _Result.run_time};
+        return _Connection._Write(&_Response, sizeof(_Response));
+    }
+
+    job_result job_server::_Run_job(const job_type _Type, const path& _Path) noexcept {
+        // Note: The job runs on a worker of the scheduler, so a large file shares its chunks with the idle
+        //       workers. This thread only waits for the job, which never outlives the call.
+        using _Clock                      = ::std::chrono::steady_clock;
+        const _Clock::time_point _Arrival = _Clock::now();
+        job_result _Result;
+        _Result.status = rejected;
+        ::std::mutex _Mtx;
+        ::std::condition_variable _Cv;
+        bool _Done         = false;
+        const bool _Queued = _Myscheduler.submit([&]() noexcept {
+            const _Clock::time_point _Start = _Clock::now();
+            uint64_t _Bytes                 = 0;
+            uint32_t _Status;
+            try {
+                _Status = _Myhandler(_Type, _Path, _Bytes);
+            } catch (...) {
+                _Status = rejected;
+            }
+
+            const _Clock::time_point _End = _Clock::now();
+            ::std::lock_guard<::std::mutex> _Guard(_Mtx);
+            _Result.status     = _Status;
+            _Result.bytes      = _Bytes;
+            _Result.queue_time = efc_impl::_Elapsed_microseconds(_Arrival, _Start);
+            _Result.run_time   = efc_impl::_Elapsed_microseconds(_Start, _End);
+            _Done              = true;
+            _Cv.notify_one(); // notified under the lock, so the waiter cannot destroy it earlier
+        });
+        if (!_Queued) {
+            return _Result;
+        }
+
+        ::std::unique_lock<::std::mutex> _Lock(_Mtx);
+        _Cv.wait(_Lock, [&_Done] { return _Done; });
+        _Mylatency->_Record(_Result.queue_time + _Result.run_time);
+        return _Result;
+    }
+
+    namespace efc_impl {
+        // sends the request followed by the path, if any, and reads the fixed-size response
+        inline bool _Send_job_request(const _Job_request& _Request, const wchar_t* const _Path,
+            void* const _Response, const size_t _Response_size) noexcept {
+            wchar_t _Name[_Max_pipe_name];
+            if (!_Make_job_server_pipe_name(_Name)) {
+                return false;
+            }
+
+            const HANDLE _Pipe = _Connect_to_pipe(_Name, _Job_busy_timeout);
+            if (_Pipe == INVALID_HANDLE_VALUE) {
+                return false;
+            }
+
+            // Note: The response arrives once the job is done, which may take long for large files.
+            const bool _Succeeded =
+                _Write_all(_Pipe, reinterpret_cast<const byte_t*>(&_Request), sizeof(_Job_request))
+                && (_Request._Path_length == 0 || _Write_all(_Pipe, reinterpret_cast<const byte_t*>(_Path),
+                    _Request._Path_length * sizeof(wchar_t)))
+                && _Read_exactly(_Pipe, static_cast<byte_t*>(_Response), _Response_size);
+            ::CloseHandle(_Pipe);
+            return _Succeeded;
+        }
+    } // namespace efc_impl
+
+    bool submit_job(const job_type _Type, const path& _Path, job_result& _Result) noexcept {
+        const path::string_type& _Str = _Path.native();
+        if (_Str.empty() || _Str.size() > efc_impl::_Max_job_path) {
+            return false;
+        }
+
+        const efc_impl::_Job_request _Request = {
+            efc_impl::_Job_protocol_version, static_cast<uint32_t>(_Type), static_cast<uint32_t>(_Str.size())};
+        efc_impl::_Job_response _Response;
+        if (!efc_impl::_Send_job_request(_Request, _Str.c_str(), &_Response, sizeof(_Response))) {
+            return false;
+        }
+
+        _Result.status     = _Response._Status;
+        _Result.bytes      = _Response._Bytes;
+        _Result.queue_time = _Response._Queue_time;
+        _Result.run_time   = _Response._Run_time;
+        return true;
+    }
+
+    bool query_job_server_stats(job_server_stats& _Stats) noexcept {
+        const efc_impl::_Job_request _Request = {efc_impl::_Job_protocol_version, efc_impl::_Stats_request, 0};
+        efc_impl::_Stats_response _Response;
+        if (!efc_impl::_Send_job_request(_Request, nullptr, &_Response, sizeof(_Response))) {
+            return false;
+        }
+
+        _Stats.completed = _Response._Completed;
+        _Stats.failed    = _Response._Failed;
+        _Stats.p50       = _Response._P50;
+        _Stats.p99       = _Response._P99;
+        _Stats.max       = _Response._Max;
+        return true;
+    }
+} // namespace mjx
\ No newline at end of file
@@ -0,0 +1,101 @@
+// job_server.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_JOB_SERVER_HPP_
+#define _EFC_JOB_SERVER_HPP_
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <efc/work_stealing_scheduler.hpp>
+#include <functional>
+#include <memory>
+#include <mjfs/path.hpp>
+
+namespace mjx {
+    namespace efc_impl {
+        class _Latency_histogram;
+        class _Pipe_connection;
+        class _Pipe_server;
+    } // namespace efc_impl
+
+    enum class job_type : uint32_t {
+        encryption   = 1,
+        decryption   = 2,
+        verification = 3 // decrypts the file without writing the plaintext
+    };
+
+    struct job_result {
+        uint32_t status     = 0; // 0 on success, otherwise the error returned by the handler
+        uint64_t bytes      = 0; // the size of the processed file
+        uint64_t queue_time = 0; // the time the job waited for a worker, in microseconds
+        uint64_t run_time   = 0; // the time the job took, in microseconds
+    };
+
+    struct job_server_stats { // the latencies include only the jobs that have run, rejected ones are not timed
+        uint64_t completed = 0; // the number of jobs that succeeded
+        uint64_t failed    = 0; // the number of jobs that failed or have been rejected
+        uint64_t p50       = 0; // the median latency from arrival to completion, in microseconds
+        uint64_t p99       = 0; // the latency that 99% of the jobs do not exceed, in microseconds
+        uint64_t max       = 0; // the largest latency, in microseconds
+    };
+
+    // Note: The server is a process that runs the jobs of other processes of the same user, so that
+    //       the cipher, the workers and the keys are set up once rather than for every file.
+    //       A client connects to a named pipe that only the user can open, sends the type of the job
+    //       and the path of the file, and receives the result once the job is done. Each connection
+    //       is served by its own thread, which queues the job on the scheduler and waits for it.
+    class job_server {
+    public:
+        // runs the job and stores the size of the processed file, returns 0 on success
+        using handler = ::std::function<uint32_t(job_type, const path&, uint64_t&)>;
+
+        static constexpr uint32_t rejected           = UINT32_MAX; // the status of a malformed request
+        static constexpr size_t default_client_count = 16;
+
+        // the scheduler must outlive the server, _Clients is the number of jobs accepted at once
+        job_server(work_stealing_scheduler& _Scheduler, handler _Handler,
+            const size_t _Clients = default_client_count) noexcept;
+        ~job_server() noexcept;
+
+        job_server(const job_server&)            = delete;
+        job_server& operator=(const job_server&) = delete;
+
+        // checks if the server has been set up
+        bool is_valid() const noexcept;
+
+        // serves the jobs until stop() is called, fails if another server of the user is running
+        bool run() noexcept;
+
+        // makes run() return once the jobs in progress are done, may be called from any thread
+        void stop() noexcept;
+
+        // returns the statistics of the jobs served so far
+        job_server_stats stats() const noexcept;
+
+    private:
+        // serves a single client, returns true if a response has been written
+        bool _Serve(efc_impl::_Pipe_connection& _Connection) noexcept;
+
+        // queues the job on the scheduler and waits for it
+        job_result _Run_job(const job_type _Type, const path& _Path) noexcept;
+
+        work_stealing_scheduler& _Myscheduler;
+        handler _Myhandler;
+        size_t _Myclients;
+        ::std::unique_ptr<efc_impl::_Pipe_server> _Myserver;
+        ::std::unique_ptr<efc_impl::_Latency_histogram> _Mylatency; // of the jobs that have run
+        ::std::atomic<uint64_t> _Mycompleted;
+        ::std::atomic<uint64_t> _Myfailed;
+    };
+
+    // runs the job on the server of the current user, returns false if it is not running
+    bool submit_job(const job_type _Type, const path& _Path, job_result& _Result) noexcept;
+
+    // returns the statistics of the server of the current user, fails if it is not running
+    bool query_job_server_stats(job_server_stats& _Stats) noexcept;
+} // namespace mjx
+
+#endif // _EFC_JOB_SERVER_HPP_
\ No newline at end of file
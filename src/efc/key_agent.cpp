@@ -0,0 +1,384 @@
+// key_agent.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <botan/mac.h>
+#include <chrono>
+#include <cstring>
+#include <efc/impl/file_io.hpp>
+#include <efc/impl/named_pipe.hpp>
+#include <efc/impl/random.hpp>
+#include <efc/impl/secure_arena.hpp>
+#include <efc/impl/secure_memory.hpp>
+#include <efc/key_agent.hpp>
+#include <new>
+
+namespace mjx {
+    namespace efc_impl {
+        inline constexpr uint32_t _Agent_protocol_version = 1;
+        inline constexpr size_t _Agent_pipe_instances     = 4; // the number of clients served at once
+        inline constexpr DWORD _Agent_busy_timeout        = 5000; // in milliseconds
+        inline constexpr DWORD _Agent_purge_interval      = 1000; // in milliseconds
+
+        enum class _Agent_request_type : uint32_t {
+            _Key       = 1,
+            _Batch_key = 2
+        };
+
+        enum class _Agent_status : uint32_t {
+            _Success = 0,
+            _Failure = 1
+        };
+
+        struct _Agent_request {
+            uint32_t _Version;
+            _Agent_request_type _Type;
+            uint32_t _Password_length;
+            wchar_t _Password[secure_password::max_length + 1];
+            byte_t _Salt[salt::size]; // ignored by batch key requests
+            uint32_t _Memory;
+            uint32_t _Iterations;
+            uint32_t _Lanes;
+        };
+
+        struct _Agent_response {
+            _Agent_status _Status;
+            byte_t _Salt[salt::size];
+            byte_t _Key[key::size];
+        };
+
+        struct _Agent_entry {
+            byte_t _Id[key::size]; // the keyed hash of the request
+            byte_t _Salt[salt::size];
+            byte_t _Key[key::size];
+            int64_t _Expires; // in seconds of the steady clock
+            bool _Used;
+        };
+
+        inline int64_t _Agent_clock() noexcept {
+            return ::std::chrono::duration_cast<::std::chrono::seconds>(
+                ::std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        inline bool _Is_entry_alive(const _Agent_entry& _Entry, const int64_t _Now) noexcept {
+            return _Entry._Used && _Entry._Expires > _Now;
+        }
+
+        // computes the identifier of the entry that holds the key requested with the specified type,
+        // the salt is a null pointer for the master key of a batch
+        inline bool _Make_entry_id(const key& _Secret, const _Agent_request_type _Type, const _Agent_request& _Request,
+            const byte_t* const _Salt, byte_t* const _Id) noexcept {
+            try {
+                const uint32_t _Fields[] = {static_cast<uint32_t>(_Type), _Request._Password_length,
+                    _Request._Memory, _Request._Iterations, _Request._Lanes};
+                const auto _Hmac = ::Botan::MessageAuthenticationCode::create_or_throw("HMAC(SHA-256)");
+                _Hmac->set_key(_Secret.data(), key::size);
+                _Hmac->update(reinterpret_cast<const uint8_t*>(_Fields), sizeof(_Fields));
+                _Hmac->update(reinterpret_cast<const uint8_t*>(_Request._Password),
+                    _Request._Password_length * sizeof(wchar_t));
+                if (_Salt) {
+                    _Hmac->update(_Salt, salt::size);
+                }
+
+                _Hmac->final(_Id);
+                return true;
+            } catch (...) {
+                return false;
+            }
+        }
+
+        inline key_derivation_params _Request_params(const _Agent_request& _Request) noexcept {
+            return key_derivation_params{_Request._Memory, _Request._Iterations, _Request._Lanes};
+        }
+    } // namespace efc_impl
+
+    key_agent::key_agent(const uint32_t _Ttl) noexcept
+        : _Myarena(new (::std::nothrow) efc_impl::_Secure_arena), _Myentries(nullptr), _Myttl(_Ttl), _Mysecret(),
+        _Mycontext(efc_impl::_Agent_pipe_instances), _Myserver(new (::std::nothrow) efc_impl::_Pipe_server),
+        _Mymtx() {
+        if (_Myarena && _Myarena->_Allocate(max_keys * sizeof(efc_impl::_Agent_entry), false)
+            && efc_impl::_Random_bytes(_Mysecret.data(), key::size)) {
+            // Note: The memory returned by VirtualAlloc() is zeroed, so none of the entries is used.
+            _Myentries = reinterpret_cast<efc_impl::_Agent_entry*>(_Myarena->_Data());
+        }
+    }
+
+    key_agent::~key_agent() noexcept {}
+
+    bool key_agent::is_valid() const noexcept {
+        return _Myentries != nullptr && _Myserver && _Myserver->_Is_valid() && _Mycontext.is_valid();
+    }
+
+    uint32_t key_agent::ttl() const noexcept {
+        return _Myttl;
+    }
+
+    size_t key_agent::key_count() const noexcept {
+        if (!_Myentries) {
+            return 0;
+        }
+
+        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+        const int64_t _Now = efc_impl::_Agent_clock();
+        size_t _Count      = 0;
+        for (size_t _Idx = 0; _Idx < max_keys; ++_Idx) {
+            if (efc_impl::_Is_entry_alive(_Myentries[_Idx], _Now)) {
+                ++_Count;
+            }
+        }
+
+        return _Count;
+    }
+
+    bool key_agent::run() noexcept {
+        if (!is_valid()) {
+            return false;
+        }
+
+        wchar_t _Name[efc_impl::_Max_pipe_name];
+        if (!efc_impl::_Make_agent_pipe_name(_Name)) {
+            return false;
+        }
+
+        const bool _Started = _Myserver->_Start(_Name, efc_impl::_Agent_pipe_instances,
+            sizeof(efc_impl::_Agent_request), [this](efc_impl::_Pipe_connection& _Connection) noexcept {
+                return _Serve(_Connection);
+            });
+        if (_Started) {
+            while (!_Myserver->_Wait(efc_impl::_Agent_purge_interval)) {
+                ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+                _Purge();
+            }
+        }
+
+        _Myserver->_Stop(); // stop the started threads if not all instances have been created
+        _Myserver->_Join();
+        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+        efc_impl::_Wipe_memory(_Myentries, max_keys * sizeof(efc_impl::_Agent_entry));
+        return _Started;
+    }
+
+    void key_agent::stop() noexcept {
+        if (_Myserver) {
+            _Myserver->_Stop();
+        }
+    }
+
+    bool key_agent::_Serve(efc_impl::_Pipe_connection& _Connection) noexcept {
+        efc_impl::_Agent_request _Request;
+        efc_impl::_Agent_response _Response;
+        bool _Responded = false;
+        if (_Connection._Read(&_Request, sizeof(_Request))) {
+            if (!_Handle(_Request, _Response)) {
+                ::memset(&_Response, 0, sizeof(_Response));
+                _Response._Status = efc_impl::_Agent_status::_Failure;
+            }
+
+            _Responded = _Connection._Write(&_Response, sizeof(_Response));
+        }
+
+        efc_impl::_Wipe_memory(&_Request, sizeof(_Request));
+        efc_impl::_Wipe_memory(&_Response, sizeof(_Response));
+        return _Responded;
+    }
+
+    bool key_agent::_Handle(
+        const efc_impl::_Agent_request& _Request, efc_impl::_Agent_response& _Response) noexcept {
+        if (_Request._Version != efc_impl::_Agent_protocol_version
+            || _Request._Password_length > secure_password::max_length
+            || !is_valid_key_derivation_params(efc_impl::_Request_params(_Request))) {
+            return false;
+        }
+
+        salt _Salt;
+        key _Key;
+        if (_Request._Type == efc_impl::_Agent_request_type::_Key) {
+            _Salt.assign(_Request._Salt);
+            if (!_Find_or_derive(_Request, _Salt, _Key)) {
+                return false;
+            }
+        } else if (_Request._Type == efc_impl::_Agent_request_type::_Batch_key) {
+            // Note: The master key of a batch is also held as the key of its salt, so that the decryption
+            //       of the files finds it with a key request.
+            byte_t _Id[key::size];
+            if (!efc_impl::_Make_entry_id(
+                _Mysecret, efc_impl::_Agent_request_type::_Batch_key, _Request, nullptr, _Id)) {
+                return false;
+            }
+
+            {
+                ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+                const efc_impl::_Agent_entry* const _Entry = _Find(_Id);
+                if (_Entry) {
+                    _Salt.assign(_Entry->_Salt);
+                    _Key.assign(_Entry->_Key);
+                }
+            }
+
+            if (!_Key.valid()) { // no batch yet, or it has expired
+                _Salt = generate_salt();
+                if (!_Salt.valid() || !_Find_or_derive(_Request, _Salt, _Key)) {
+                    return false;
+                }
+
+                ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+                _Insert(_Id, _Salt, _Key);
+            }
+        } else {
+            return false;
+        }
+
+        _Response._Status = efc_impl::_Agent_status::_Success;
+        ::memcpy(_Response._Salt, _Salt.data(), salt::size);
+        ::memcpy(_Response._Key, _Key.data(), key::size);
+        return true;
+    }
+
+    bool key_agent::_Find_or_derive(const efc_impl::_Agent_request& _Request, const salt& _Salt, key& _Key) noexcept {
+        byte_t _Id[key::size];
+        if (!efc_impl::_Make_entry_id(_Mysecret, efc_impl::_Agent_request_type::_Key, _Request, _Salt.data(), _Id)) {
+            return false;
+        }
+
+        {
+            ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+            const efc_impl::_Agent_entry* const _Entry = _Find(_Id);
+            if (_Entry) {
+                _Key.assign(_Entry->_Key);
+                return true;
+            }
+        }
+
+        // Note: The mutex is not held during the derivation, so the other clients are served meanwhile.
+        _Key = _Mycontext.derive_key(unicode_string_view{_Request._Password, _Request._Password_length}, _Salt,
+            efc_impl::_Request_params(_Request));
+        if (!_Key.valid()) {
+            return false;
+        }
+
+        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+        _Insert(_Id, _Salt, _Key);
+        return true;
+    }
+
+    efc_impl::_Agent_entry* key_agent::_Find(const byte_t* const _Id) noexcept {
+        const int64_t _Now = efc_impl::_Agent_clock();
+        for (size_t _Idx = 0; _Idx < max_keys; ++_Idx) {
+            efc_impl::_Agent_entry& _Entry = _Myentries[_Idx];
+            if (efc_impl::_Is_entry_alive(_Entry, _Now) && ::memcmp(_Entry._Id, _Id, key::size) == 0) {
+                return &_Entry;
+            }
+        }
+
+        return nullptr;
+    }
+
+    void key_agent::_Insert(const byte_t* const _Id, const salt& _Salt, const key& _Key) noexcept {
+        efc_impl::_Agent_entry* _Entry = _Find(_Id); // another client may have derived the same key meanwhile
+        if (!_Entry) {
+            _Entry = _Myentries;
+            for (size_t _Idx = 0; _Idx < max_keys; ++_Idx) {
+                efc_impl::_Agent_entry& _Candidate = _Myentries[_Idx];
+                if (!_Candidate._Used) { // a free entry, take it
+                    _Entry = &_Candidate;
+                    break;
+                }
+
+                if (_Candidate._Expires < _Entry->_Expires) {
+                    _Entry = &_Candidate;
+                }
+            }
+        }
+
+        ::memcpy(_Entry->_Id, _Id, key::size);
+        ::memcpy(_Entry->_Salt, _Salt.data(), salt::size);
+        ::memcpy(_Entry->_Key, _Key.data(), key::size);
+        _Entry->_Expires = efc_impl::_Agent_clock() + _Myttl;
+        _Entry->_Used    = true;
+    }
+
+    void key_agent::_Purge() noexcept {
+        const int64_t _Now = efc_impl::_Agent_clock();
+        for (size_t _Idx = 0; _Idx < max_keys; ++_Idx) {
+            efc_impl::_Agent_entry& _Entry = _Myentries[_Idx];
+            if (_Entry._Used && _Entry._Expires <= _Now) {
+                efc_impl::_Wipe_memory(&_Entry, sizeof(efc_impl::_Agent_entry));
+            }
+        }
+    }
+
+    namespace efc_impl {
+        // connects to the agent of the current user, fails if it is not running or does not run as the user
+        inline HANDLE _Connect_to_agent() noexcept {
+            wchar_t _Name[_Max_pipe_name];
+            return _Make_agent_pipe_name(_Name) ? _Connect_to_pipe(_Name, _Agent_busy_timeout) : INVALID_HANDLE_VALUE;
+        }
+
+        inline bool _Send_agent_request(_Agent_request& _Request, _Agent_response& _Response) noexcept {
+            const HANDLE _Pipe = _Connect_to_agent();
+            bool _Succeeded    = false;
+            if (_Pipe != INVALID_HANDLE_VALUE) {
+                _Succeeded = _Write_all(_Pipe, reinterpret_cast<const byte_t*>(&_Request), sizeof(_Agent_request))
+                    && _Read_exactly(_Pipe, reinterpret_cast<byte_t*>(&_Response), sizeof(_Agent_response))
+                    && _Response._Status == _Agent_status::_Success;
+                ::CloseHandle(_Pipe);
+            }
+
+            _Wipe_memory(&_Request, sizeof(_Agent_request)); // the request contains the password
+            return _Succeeded;
+        }
+
+        inline void _Make_agent_request(const _Agent_request_type _Type, const secure_password& _Password,
+            const key_derivation_params& _Params, _Agent_request& _Request) noexcept {
+            ::memset(&_Request, 0, sizeof(_Agent_request));
+            _Request._Version         = _Agent_protocol_version;
+            _Request._Type            = _Type;
+            _Request._Password_length = static_cast<uint32_t>(_Password.length());
+            _Request._Memory          = _Params.memory;
+            _Request._Iterations      = _Params.iterations;
+            _Request._Lanes           = _Params.lanes;
+            _Copy_sensitive_data(_Request._Password, _Password.data(), _Password.length() * sizeof(wchar_t));
+        }
+    } // namespace efc_impl
+
+    bool is_key_agent_running() noexcept {
+        const HANDLE _Pipe = efc_impl::_Connect_to_agent();
+        if (_Pipe == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+
+        ::CloseHandle(_Pipe); // the agent drops the connection without a request
+        return true;
+    }
+
+    bool request_agent_key(const secure_password& _Password, const salt& _Salt, const key_derivation_params& _Params,
+        key& _Key) noexcept {
+        efc_impl::_Agent_request _Request;
+        efc_impl::_Agent_response _Response;
+        efc_impl::_Make_agent_request(efc_impl::_Agent_request_type::_Key, _Password, _Params, _Request);
+        ::memcpy(_Request._Salt, _Salt.data(), salt::size);
+        const bool _Succeeded = efc_impl::_Send_agent_request(_Request, _Response);
+        if (_Succeeded) {
+            _Key.assign(_Response._Key);
+        }
+
+        efc_impl::_Wipe_memory(&_Response, sizeof(_Response));
+        return _Succeeded;
+    }
+
+    bool request_agent_batch_key(const secure_password& _Password, const key_derivation_params& _Params,
+        salt& _Salt, key& _Key) noexcept {
+        efc_impl::_Agent_request _Request;
+        efc_impl::_Agent_response _Response;
+        efc_impl::_Make_agent_request(efc_impl::_Agent_request_type::_Batch_key, _Password, _Params, _Request);
+        const bool _Succeeded = efc_impl::_Send_agent_request(_Request, _Response);
+        if (_Succeeded) {
+            _Salt.assign(_Response._Salt);
+            _Key.assign(_Response._Key);
+        }
+
+        efc_impl::_Wipe_memory(&_Response, sizeof(_Response));
+        return _Succeeded;
+    }
+} // namespace mjx
\ No newline at end of file
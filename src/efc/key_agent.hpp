@@ -0,0 +1,99 @@
+// key_agent.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_KEY_AGENT_HPP_
+#define _EFC_KEY_AGENT_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <efc/key_derivation.hpp>
+#include <memory>
+#include <mutex>
+
+namespace mjx {
+    namespace efc_impl {
+        class _Pipe_connection;
+        class _Pipe_server;
+        class _Secure_arena;
+        struct _Agent_entry;
+        struct _Agent_request;
+        struct _Agent_response;
+    } // namespace efc_impl
+
+    // Note: The agent is a process that keeps the keys derived from passwords, so that other processes
+    //       of the same user do not derive them again. It listens on a named pipe that only the user
+    //       can open, and the clients verify that the pipe has been created by the same user.
+    //       A client sends the password, the salt and the parameters, the agent derives the key
+    //       if it does not hold it yet. The keys are held in locked memory and wiped once they expire.
+    //       They are indexed by a keyed hash of the request, so the passwords are never stored.
+    class key_agent {
+    public:
+        static constexpr uint32_t default_ttl = 300; // five minutes
+        static constexpr size_t max_keys      = 1024;
+
+        // _Ttl is the number of seconds a key is held for after it has been derived
+        explicit key_agent(const uint32_t _Ttl = default_ttl) noexcept;
+        ~key_agent() noexcept;
+
+        key_agent(const key_agent&)            = delete;
+        key_agent& operator=(const key_agent&) = delete;
+
+        // checks if the memory of the keys has been allocated
+        bool is_valid() const noexcept;
+
+        // returns the number of seconds a key is held for
+        uint32_t ttl() const noexcept;
+
+        // returns the number of keys held at the moment
+        size_t key_count() const noexcept;
+
+        // serves the requests until stop() is called, fails if another agent of the user is running
+        bool run() noexcept;
+
+        // makes run() return, may be called from any thread
+        void stop() noexcept;
+
+    private:
+        // serves a single client, returns true if a response has been written
+        bool _Serve(efc_impl::_Pipe_connection& _Connection) noexcept;
+
+        // handles a single request, returns false if it is malformed
+        bool _Handle(const efc_impl::_Agent_request& _Request, efc_impl::_Agent_response& _Response) noexcept;
+
+        // returns the key derived with the specified request, derives it if it is not held yet
+        bool _Find_or_derive(const efc_impl::_Agent_request& _Request, const salt& _Salt, key& _Key) noexcept;
+
+        // returns the held entry with the specified identifier, the mutex must be locked
+        efc_impl::_Agent_entry* _Find(const byte_t* const _Id) noexcept;
+
+        // holds the key, replaces the entry that expires first if all of them are in use
+        void _Insert(const byte_t* const _Id, const salt& _Salt, const key& _Key) noexcept;
+
+        // wipes the expired keys, the mutex must be locked
+        void _Purge() noexcept;
+
+        ::std::unique_ptr<efc_impl::_Secure_arena> _Myarena;
+        efc_impl::_Agent_entry* _Myentries; // max_keys entries in the locked memory
+        uint32_t _Myttl;
+        key _Mysecret; // the key of the hashes that index the entries, random for every agent
+        key_derivation_context _Mycontext;
+        ::std::unique_ptr<efc_impl::_Pipe_server> _Myserver;
+        mutable ::std::mutex _Mymtx;
+    };
+
+    // checks if an agent of the current user is running
+    bool is_key_agent_running() noexcept;
+
+    // asks the agent for the key derived from the password, returns false if no agent is running
+    bool request_agent_key(const secure_password& _Password, const salt& _Salt, const key_derivation_params& _Params,
+        key& _Key) noexcept;
+
+    // asks the agent for the master key of a batch encryption, which it reuses until the key expires
+    // Note: The files encrypted with the master key must derive their own keys from it, see derive_subkey().
+    bool request_agent_batch_key(const secure_password& _Password, const key_derivation_params& _Params,
+        salt& _Salt, key& _Key) noexcept;
+} // namespace mjx
+
+#endif // _EFC_KEY_AGENT_HPP_
\ No newline at end of file
@@ -3,12 +3,18 @@
 // Copyright (c) Mateusz Jandura. All rights reserved.
 // SPDX-License-Identifier: Apache-2.0
 
-#include <botan/argon2.h>
+#include <botan/hkdf.h>
+#include <botan/mac.h>
+#include <chrono>
 #include <cwchar>
+#include <efc/impl/argon2.hpp>
+#include <efc/impl/parallel.hpp>
 #include <efc/impl/random.hpp>
+#include <efc/impl/secure_arena.hpp>
 #include <efc/impl/secure_memory.hpp>
 #include <efc/key_derivation.hpp>
 #include <mjstr/conversion.hpp>
+#include <new>
 #include <type_traits>
 #include <utility>
 
@@ -18,40 +24,156 @@ namespace mjx {
         return efc_impl::_Random_bytes(_Salt.data(), salt::size) ? _Salt : salt{};
     }
 
-    key derive_key(const unicode_string_view _Password, const salt& _Salt) noexcept {
-        static constexpr uint8_t _Variant      = 2; // Argon2 variant (Argon2id)
-        static constexpr size_t _Parallelism   = 1; // number of threads
-        static constexpr size_t _Memory_amount = 16384; // memory amount in Kb
-        static constexpr size_t _Iterations    = 8; // number of iterations
-        const utf8_string& _Utf8_password      = ::mjx::to_utf8_string(_Password);
+    key_nonce generate_key_nonce() noexcept {
+        key_nonce _Nonce;
+        return efc_impl::_Random_bytes(_Nonce.data(), key_nonce::size) ? _Nonce : key_nonce{};
+    }
+
+    bool is_valid_key_derivation_params(const key_derivation_params& _Params) noexcept {
+        // Note: The limits keep a crafted header from requesting excessive memory or time.
+        static constexpr uint32_t _Max_memory     = 4194304; // 4 GiB
+        static constexpr uint32_t _Max_iterations = 1024;
+        static constexpr uint32_t _Max_lanes      = 64;
+        return _Params.lanes >= 1 && _Params.lanes <= _Max_lanes && _Params.iterations >= 1
+            && _Params.iterations <= _Max_iterations && _Params.memory >= 8 * _Params.lanes
+            && _Params.memory <= _Max_memory;
+    }
+
+    size_t key_derivation_memory(const key_derivation_params& _Params) noexcept {
+        if (!is_valid_key_derivation_params(_Params)) { // no memory would be allocated
+            return 0;
+        }
+
+        efc_impl::_Argon2_input _Input;
+        _Input._Memory = _Params.memory;
+        _Input._Lanes  = _Params.lanes;
+        return efc_impl::_Argon2_context::_Block_count(_Input) * sizeof(efc_impl::_Argon2_block);
+    }
+
+    namespace efc_impl {
+        inline key _Derive_key(const unicode_string_view _Password, const salt& _Salt,
+            const key_derivation_params& _Params, _Argon2_block* const _Memory, const size_t _Max_threads) noexcept {
+            // Note: Allocates the memory of Argon2id if _Memory is a null pointer.
+            const utf8_string& _Utf8_password = ::mjx::to_utf8_string(_Password);
+            _Argon2_input _Input;
+            _Input._Password      = reinterpret_cast<const byte_t*>(_Utf8_password.c_str());
+            _Input._Password_size = _Utf8_password.size();
+            _Input._Salt          = _Salt.data();
+            _Input._Salt_size     = salt::size;
+            _Input._Memory        = _Params.memory;
+            _Input._Iterations    = _Params.iterations;
+            _Input._Lanes         = _Params.lanes;
+            key _Key;
+            const bool _Succeeded = _Memory
+                                  ? _Argon2id_with_memory(_Key.data(), key::size, _Input, _Memory, _Max_threads)
+                                  : _Argon2id(_Key.data(), key::size, _Input, _Max_threads);
+            return _Succeeded ? _Key : key{};
+        }
+    } // namespace efc_impl
+
+    key derive_key(
+        const unicode_string_view _Password, const salt& _Salt, const key_derivation_params& _Params) noexcept {
+        if (!is_valid_key_derivation_params(_Params)) {
+            return key{};
+        }
+
+        return efc_impl::_Derive_key(_Password, _Salt, _Params, nullptr, 0);
+    }
+
+    namespace efc_impl {
+        inline double _Measure_key_derivation(const key_derivation_params& _Params, const salt& _Salt) noexcept {
+            // returns the duration of a single derivation in milliseconds, or a negative value on failure
+            using _Clock                    = ::std::chrono::steady_clock;
+            const _Clock::time_point _Start = _Clock::now();
+            const key& _Key                 = ::mjx::derive_key(unicode_string_view{}, _Salt, _Params);
+            const double _Elapsed = ::std::chrono::duration<double, ::std::milli>(_Clock::now() - _Start).count();
+            return _Key.valid() ? _Elapsed : -1.0;
+        }
+    } // namespace efc_impl
+
+    key_derivation_params calibrate_key_derivation(const uint32_t _Target_time, const uint32_t _Max_memory) noexcept {
+        static constexpr uint32_t _Max_lanes      = 8; // more lanes hardly help, the passes are memory-bound
+        static constexpr uint32_t _Max_iterations = 1024;
+        key_derivation_params _Params;
+        _Params.lanes      = (::std::min)(static_cast<uint32_t>(efc_impl::_Default_thread_count()), _Max_lanes);
+        _Params.memory     = default_key_derivation_params.memory;
+        _Params.iterations = 1;
+        const salt& _Salt  = generate_salt();
+        double _Pass_time  = efc_impl::_Measure_key_derivation(_Params, _Salt);
+        if (_Pass_time < 0.0) { // not even the default memory can be allocated
+            return default_key_derivation_params;
+        }
+
+        while (_Params.memory <= _Max_memory / 2 && _Pass_time * 2 <= _Target_time) {
+            _Params.memory *= 2;
+            const double _Time = efc_impl::_Measure_key_derivation(_Params, _Salt);
+            if (_Time < 0.0) { // the memory cannot be allocated, keep the previous amount
+                _Params.memory /= 2;
+                break;
+            }
+
+            _Pass_time = _Time;
+        }
+
+        // Note: The time of a single pass includes the fixed costs, so the passes slightly undershoot the target.
+        const double _Passes = _Pass_time > 0.0 ? _Target_time / _Pass_time : _Max_iterations;
+        _Params.iterations   = static_cast<uint32_t>(
+            (::std::max)(1.0, (::std::min)(_Passes, static_cast<double>(_Max_iterations))));
+        return _Params;
+    }
+
+    key derive_subkey(const key& _Master_key, const key_nonce& _Nonce) noexcept {
+        // Note: HKDF-SHA256 with the master key as the input keying material and the nonce as the salt,
+        //       the label binds the subkey to its purpose.
+        static constexpr char _Label[] = "EFC file key";
         key _Key;
         try {
-            ::Botan::argon2(_Key.data(), key::size, _Utf8_password.c_str(), _Utf8_password.size(), _Salt.data(),
-                salt::size, nullptr, 0, nullptr, 0, _Variant, _Parallelism, _Memory_amount, _Iterations);
+            ::Botan::HKDF _Hkdf(::Botan::MessageAuthenticationCode::create_or_throw("HMAC(SHA-256)").release());
+            _Hkdf.kdf(_Key.data(), key::size, _Master_key.data(), key::size, _Nonce.data(), key_nonce::size,
+                reinterpret_cast<const uint8_t*>(_Label), sizeof(_Label) - 1);
             return _Key;
         } catch (...) {
             return key{};
         }
     }
 
+    key_check compute_key_check(const key& _Key) noexcept {
+        static constexpr char _Label[] = "EFC key check";
+        key_check _Check;
+        try {
+            const auto _Hmac = ::Botan::MessageAuthenticationCode::create_or_throw("HMAC(SHA-256)");
+            _Hmac->set_key(_Key.data(), key::size);
+            _Hmac->update(reinterpret_cast<const uint8_t*>(_Label), sizeof(_Label) - 1);
+            _Hmac->final(_Check.data());
+            return _Check;
+        } catch (...) {
+            return key_check{};
+        }
+    }
+
+    bool verify_key_check(const key& _Key, const key_check& _Check) noexcept {
+        const key_check& _Expected = compute_key_check(_Key);
+        return _Expected.valid() && efc_impl::_Compare_sensitive_data(_Expected.data(), _Check.data(), key_check::size);
+    }
+
     secure_password::secure_password() noexcept : _Mydata{0}, _Mylen(0) {}
 
     secure_password::secure_password(const secure_password& _Other) noexcept : _Mydata{0}, _Mylen(_Other._Mylen) {
-        efc_impl::_Copy_sensitive_data(_Mydata, _Other._Mydata, _Mylen + 1);
+        efc_impl::_Copy_sensitive_data(_Mydata, _Other._Mydata, (_Mylen + 1) * sizeof(wchar_t));
     }
 
     secure_password::secure_password(secure_password&& _Other) noexcept : _Mydata{0}, _Mylen(_Other._Mylen) {
-        efc_impl::_Move_sensitive_data(_Mydata, _Other._Mydata, _Mylen + 1);
+        efc_impl::_Move_sensitive_data(_Mydata, _Other._Mydata, (_Mylen + 1) * sizeof(wchar_t));
         _Other._Mylen = 0;
     }
 
     secure_password::~secure_password() noexcept {
-        efc_impl::_Wipe_memory(_Mydata, max_length + 1);
+        efc_impl::_Wipe_memory(_Mydata, sizeof(_Mydata));
     }
 
     secure_password& secure_password::operator=(const secure_password& _Other) noexcept {
         if (this != ::std::addressof(_Other)) {
-            efc_impl::_Copy_sensitive_data(_Mydata, _Other._Mydata, _Other._Mylen + 1);
+            efc_impl::_Copy_sensitive_data(_Mydata, _Other._Mydata, (_Other._Mylen + 1) * sizeof(wchar_t));
             _Mylen = _Other._Mylen;
         }
 
@@ -60,7 +182,7 @@ namespace mjx {
 
     secure_password& secure_password::operator=(secure_password&& _Other) noexcept {
         if (this != ::std::addressof(_Other)) {
-            efc_impl::_Move_sensitive_data(_Mydata, _Other._Mydata, _Other._Mylen + 1);
+            efc_impl::_Move_sensitive_data(_Mydata, _Other._Mydata, (_Other._Mylen + 1) * sizeof(wchar_t));
             _Mylen        = _Other._Mylen;
             _Other._Mylen = 0;
         }
@@ -93,4 +215,83 @@ namespace mjx {
         ::wmemcpy(_Mydata, _New_password.data(), _Length);
         _Mylen = _Length;
     }
+
+    key_derivation_context::key_derivation_context(
+        const size_t _Slots, const key_derivation_params& _Params, const bool _Large_pages) noexcept
+        : _Myarena(new (::std::nothrow) efc_impl::_Secure_arena), _Myslot_size(key_derivation_memory(_Params)),
+        _Myfree_slots(), _Myslot_count(0), _Mymtx(), _Mycv() {
+        if (!_Myarena || _Slots == 0 || !is_valid_key_derivation_params(_Params)) {
+            _Myarena.reset();
+            return;
+        }
+
+        try {
+            _Myfree_slots.reserve(_Slots);
+            for (size_t _Idx = _Slots; _Idx > 0; --_Idx) { // the first slot is taken first
+                _Myfree_slots.push_back(_Idx - 1);
+            }
+        } catch (...) {
+            _Myarena.reset();
+            return;
+        }
+
+        if (!_Myarena->_Allocate(_Slots * _Myslot_size, _Large_pages)) {
+            _Myarena.reset();
+            _Myfree_slots.clear();
+            return;
+        }
+
+        _Myslot_count = _Slots;
+    }
+
+    key_derivation_context::~key_derivation_context() noexcept {}
+
+    bool key_derivation_context::is_valid() const noexcept {
+        return _Myarena != nullptr;
+    }
+
+    size_t key_derivation_context::slot_count() const noexcept {
+        return _Myslot_count;
+    }
+
+    size_t key_derivation_context::slot_size() const noexcept {
+        return _Myslot_size;
+    }
+
+    bool key_derivation_context::uses_large_pages() const noexcept {
+        return _Myarena && _Myarena->_Uses_large_pages();
+    }
+
+    bool key_derivation_context::is_locked() const noexcept {
+        return _Myarena && _Myarena->_Is_locked();
+    }
+
+    key key_derivation_context::derive_key(const unicode_string_view _Password, const salt& _Salt,
+        const key_derivation_params& _Params, const size_t _Max_threads) noexcept {
+        if (!is_valid_key_derivation_params(_Params)) {
+            return key{};
+        }
+
+        if (!is_valid() || key_derivation_memory(_Params) > _Myslot_size) { // the slots are too small
+            return efc_impl::_Derive_key(_Password, _Salt, _Params, nullptr, _Max_threads);
+        }
+
+        size_t _Slot;
+        {
+            ::std::unique_lock<::std::mutex> _Lock(_Mymtx);
+            _Mycv.wait(_Lock, [this] { return !_Myfree_slots.empty(); });
+            _Slot = _Myfree_slots.back();
+            _Myfree_slots.pop_back();
+        }
+
+        const key& _Key = efc_impl::_Derive_key(_Password, _Salt, _Params,
+            reinterpret_cast<efc_impl::_Argon2_block*>(_Myarena->_Data() + _Slot * _Myslot_size), _Max_threads);
+        {
+            ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+            _Myfree_slots.push_back(_Slot); // never exceeds the reserved capacity
+        }
+
+        _Mycv.notify_one();
+        return _Key;
+    }
 } // namespace mjx
\ No newline at end of file
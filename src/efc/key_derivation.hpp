@@ -6,15 +6,73 @@
 #pragma once
 #ifndef _EFC_KEY_DERIVATION_HPP_
 #define _EFC_KEY_DERIVATION_HPP_
+#include <condition_variable>
+#include <cstdint>
 #include <efc/encryption_engine.hpp>
 #include <efc/secure_buffer.hpp>
+#include <memory>
 #include <mjstr/string_view.hpp>
+#include <mutex>
+#include <vector>
 
 namespace mjx {
-    using salt = secure_buffer<16>;
+    namespace efc_impl {
+        class _Secure_arena;
+    } // namespace efc_impl
+
+    using salt      = secure_buffer<16>;
+    using key_nonce = secure_buffer<16>; // the per-file input of derive_subkey()
+    using key_check = secure_buffer<32>; // the value returned by compute_key_check()
+
+    enum class key_derivation_function : unsigned char {
+        argon2id, // Argon2id version 1.3 with key_derivation_params
+        none // the key is specified directly rather than derived from a password
+    };
+
+    struct key_derivation_params { // the parameters of Argon2id
+        uint32_t memory     = 16384; // memory amount in KiB
+        uint32_t iterations = 8; // number of passes over the memory
+        uint32_t lanes      = 1; // number of lanes, computed by separate threads
+    };
+
+    // the parameters of the files that do not store their own
+    inline constexpr key_derivation_params legacy_key_derivation_params = {16384, 8, 1};
+
+    // the parameters stored in the new files, the same memory and passes split into 4 lanes
+    inline constexpr key_derivation_params default_key_derivation_params = {16384, 8, 4};
+
+    // checks if the parameters are within the supported limits
+    bool is_valid_key_derivation_params(const key_derivation_params& _Params) noexcept;
+
+    // returns the memory allocated by derive_key() with the specified parameters, in bytes, 0 if they are invalid
+    size_t key_derivation_memory(const key_derivation_params& _Params) noexcept;
+
+    // the largest memory amount chosen by calibrate_key_derivation() by default, in KiB (1 GiB)
+    inline constexpr uint32_t default_calibration_max_memory = 1048576;
+
+    // measures Argon2id on this machine and returns the parameters whose derivation takes about _Target_time
+    // Note: The lanes match the hardware threads. The memory is doubled, starting at the memory of
+    //       the default parameters and up to _Max_memory, while a single pass fits in _Target_time.
+    //       The remaining time is filled with passes. The parameters are never weaker than a single pass
+    //       over the memory of the default parameters, even if that takes longer than _Target_time.
+    key_derivation_params calibrate_key_derivation(
+        const uint32_t _Target_time, const uint32_t _Max_memory = default_calibration_max_memory) noexcept;
 
     salt generate_salt() noexcept;
-    key derive_key(const unicode_string_view _Password, const salt& _Salt) noexcept;
+    key_nonce generate_key_nonce() noexcept;
+    key derive_key(const unicode_string_view _Password, const salt& _Salt,
+        const key_derivation_params& _Params = legacy_key_derivation_params) noexcept;
+
+    // derives the key of a single file from a key returned by derive_key(), costs a few hashes
+    key derive_subkey(const key& _Master_key, const key_nonce& _Nonce) noexcept;
+
+    // returns a value that identifies the key, stored in the header to reject a wrong password at once
+    // Note: The value is HMAC-SHA256 of a fixed label under the key. It reveals nothing about the key,
+    //       but a different key cannot produce it, so the value also commits the file to its key.
+    key_check compute_key_check(const key& _Key) noexcept;
+
+    // checks if the key produces the specified check value, the comparison takes constant time
+    bool verify_key_check(const key& _Key, const key_check& _Check) noexcept;
 
     class secure_password { // stores fixed-size Unicode string with secure memory semantics
     public:
@@ -48,6 +106,51 @@ namespace mjx {
         wchar_t _Mydata[max_length + 1];
         size_t _Mylen;
     };
+
+    class key_derivation_context { // reuses the memory of Argon2id across derivations
+    public:
+        // Note: Allocates the memory of _Slots derivations with the specified parameters once, so that
+        //       up to _Slots derivations run at once without allocating. The memory is locked if possible,
+        //       so that it is never written to the page file, and wiped after every derivation.
+        //       Large pages are used if requested and the user holds the "Lock pages in memory" right.
+        explicit key_derivation_context(const size_t _Slots = 1,
+            const key_derivation_params& _Params = default_key_derivation_params,
+            const bool _Large_pages = false) noexcept;
+        ~key_derivation_context() noexcept;
+
+        key_derivation_context(const key_derivation_context&)            = delete;
+        key_derivation_context& operator=(const key_derivation_context&) = delete;
+
+        // checks if the memory has been allocated
+        bool is_valid() const noexcept;
+
+        // returns the number of derivations that may run at once
+        size_t slot_count() const noexcept;
+
+        // returns the memory available to a single derivation, in bytes
+        size_t slot_size() const noexcept;
+
+        // checks if the memory is backed by large pages
+        bool uses_large_pages() const noexcept;
+
+        // checks if the memory is locked
+        bool is_locked() const noexcept;
+
+        // derives the key like derive_key(), waits for a free slot if all of them are in use
+        // Note: A derivation that needs more memory than a slot allocates its own, like derive_key().
+        //       At most _Max_threads threads fill the memory, 0 means one per lane up to the number of cores.
+        key derive_key(const unicode_string_view _Password, const salt& _Salt,
+            const key_derivation_params& _Params = legacy_key_derivation_params,
+            const size_t _Max_threads = 0) noexcept;
+
+    private:
+        ::std::unique_ptr<efc_impl::_Secure_arena> _Myarena;
+        size_t _Myslot_size;
+        ::std::vector<size_t> _Myfree_slots;
+        size_t _Myslot_count;
+        ::std::mutex _Mymtx;
+        ::std::condition_variable _Mycv; // signaled when a slot is released
+    };
 } // namespace mjx
 
 #endif // _EFC_KEY_DERIVATION_HPP_
\ No newline at end of file
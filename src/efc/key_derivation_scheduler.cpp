@@ -0,0 +1,144 @@
+// key_derivation_scheduler.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <algorithm>
+#include <efc/impl/parallel.hpp>
+#include <efc/key_derivation_scheduler.hpp>
+#include <utility>
+
+namespace mjx {
+    namespace efc_impl {
+        inline size_t _Context_slot_count(const size_t _Threads, const size_t _Memory_budget) noexcept {
+            const size_t _Fitting = _Memory_budget / key_derivation_memory(default_key_derivation_params);
+            return (::std::min)(_Threads, (::std::max)(_Fitting, size_t{1}));
+        }
+
+        inline size_t _Fill_thread_count(const size_t _Threads) noexcept {
+            // Note: Every lane may be filled by its own thread, so the cores are split among the threads
+            //       of the scheduler, otherwise each of them would start as many threads as there are lanes.
+            return (::std::max)(_Default_thread_count() / _Threads, size_t{1});
+        }
+    } // namespace efc_impl
+
+    key_derivation_scheduler::key_derivation_scheduler(const size_t _Threads, const size_t _Memory_budget) noexcept
+        : _Myqueue(), _Mythreads(), _Mycount(_Threads != 0 ? _Threads : efc_impl::_Default_thread_count()),
+        _Mybudget(_Memory_budget), _Mycontext(efc_impl::_Context_slot_count(_Mycount, _Mybudget)), _Myused(0),
+        _Mypeak(0), _Mypending(0), _Mymtx(), _Mywork_cv(), _Mydone_cv(), _Mystop(false) {
+        try {
+            _Mythreads.reserve(_Mycount);
+            for (size_t _Idx = 0; _Idx < _Mycount; ++_Idx) {
+                _Mythreads.emplace_back(&key_derivation_scheduler::_Work, this);
+            }
+        } catch (...) { // failed to start a thread, stop the started ones
+            {
+                ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+                _Mystop = true;
+            }
+
+            _Mywork_cv.notify_all();
+            for (::std::thread& _Thread : _Mythreads) {
+                _Thread.join();
+            }
+
+            _Mythreads.clear();
+        }
+    }
+
+    key_derivation_scheduler::~key_derivation_scheduler() noexcept {
+        if (is_running()) {
+            wait();
+            {
+                ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+                _Mystop = true;
+            }
+
+            _Mywork_cv.notify_all();
+            for (::std::thread& _Thread : _Mythreads) {
+                _Thread.join();
+            }
+        }
+    }
+
+    bool key_derivation_scheduler::is_running() const noexcept {
+        return !_Mythreads.empty();
+    }
+
+    size_t key_derivation_scheduler::thread_count() const noexcept {
+        return _Mycount;
+    }
+
+    size_t key_derivation_scheduler::memory_budget() const noexcept {
+        return _Mybudget;
+    }
+
+    size_t key_derivation_scheduler::pending() const noexcept {
+        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+        return _Mypending;
+    }
+
+    size_t key_derivation_scheduler::peak_memory_usage() const noexcept {
+        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+        return _Mypeak;
+    }
+
+    bool key_derivation_scheduler::submit(const secure_password& _Password, const salt& _Salt,
+        const key_derivation_params& _Params, callback&& _Callback) noexcept {
+        if (!is_running() || !_Callback || !is_valid_key_derivation_params(_Params)) {
+            return false;
+        }
+
+        try {
+            ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+            _Myqueue.push_back(_Request{_Password, _Salt, _Params, ::std::move(_Callback)});
+            ++_Mypending;
+        } catch (...) {
+            return false;
+        }
+
+        _Mywork_cv.notify_one();
+        return true;
+    }
+
+    void key_derivation_scheduler::wait(const size_t _Max_pending) noexcept {
+        ::std::unique_lock<::std::mutex> _Lock(_Mymtx);
+        _Mydone_cv.wait(_Lock, [this, _Max_pending] {
+            return _Mypending <= _Max_pending;
+        });
+    }
+
+    void key_derivation_scheduler::_Work() noexcept {
+        ::std::unique_lock<::std::mutex> _Lock(_Mymtx);
+        for (;;) {
+            _Mywork_cv.wait(_Lock, [this] {
+                return _Mystop || (!_Myqueue.empty()
+                    && (_Myused == 0 || _Myused + key_derivation_memory(_Myqueue.front()._Params) <= _Mybudget));
+            });
+            if (_Mystop) {
+                return;
+            }
+
+            _Request _Req = ::std::move(_Myqueue.front());
+            _Myqueue.pop_front();
+            const size_t _Memory = key_derivation_memory(_Req._Params);
+            _Myused += _Memory;
+            _Mypeak  = (::std::max)(_Mypeak, _Myused);
+            _Lock.unlock();
+            const key& _Key = _Mycontext.derive_key(_Req._Password.as_view(), _Req._Salt, _Req._Params,
+                efc_impl::_Fill_thread_count(_Mycount));
+            _Lock.lock();
+            _Myused -= _Memory; // the memory has been released by now
+            _Lock.unlock();
+            _Mywork_cv.notify_one(); // the released memory may let another derivation start
+            try {
+                _Req._Callback(_Key);
+            } catch (...) { // the callback is responsible for its own errors
+            }
+
+            _Lock.lock();
+            --_Mypending;
+            _Mydone_cv.notify_all();
+        }
+    }
+} // namespace mjx
\ No newline at end of file
@@ -0,0 +1,90 @@
+// key_derivation_scheduler.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_KEY_DERIVATION_SCHEDULER_HPP_
+#define _EFC_KEY_DERIVATION_SCHEDULER_HPP_
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <efc/key_derivation.hpp>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mjx {
+    class key_derivation_scheduler { // runs many password-based key derivations at once
+    public:
+        // receives the derived key, which is invalid if the derivation failed
+        using callback = ::std::function<void(const key&)>;
+
+        // the default limit of the memory used by the derivations running at once (256 MiB)
+        static constexpr size_t default_memory_budget = 268435456;
+
+        // Note: Every derivation allocates the memory given by key_derivation_memory(), so a derivation
+        //       starts only if it fits within _Memory_budget together with the running ones.
+        //       A single derivation always runs, even if it alone exceeds the budget.
+        //       The derivations reuse the memory of a key_derivation_context, which holds as many
+        //       derivations with the default parameters as there are threads and the budget allows.
+        //       Uses as many threads as there are hardware threads if _Threads is 0. The hardware threads
+        //       are split among the derivations, so that the running ones do not oversubscribe the cores.
+        explicit key_derivation_scheduler(
+            const size_t _Threads = 0, const size_t _Memory_budget = default_memory_budget) noexcept;
+        ~key_derivation_scheduler() noexcept;
+
+        key_derivation_scheduler(const key_derivation_scheduler&)            = delete;
+        key_derivation_scheduler& operator=(const key_derivation_scheduler&) = delete;
+
+        // checks if the threads have been started
+        bool is_running() const noexcept;
+
+        // returns the number of threads
+        size_t thread_count() const noexcept;
+
+        // returns the memory budget
+        size_t memory_budget() const noexcept;
+
+        // returns the number of submitted derivations whose callbacks have not returned yet
+        size_t pending() const noexcept;
+
+        // returns the largest amount of memory used by the derivations running at once
+        size_t peak_memory_usage() const noexcept;
+
+        // queues the derivation, the callback is called on one of the threads once the key is derived,
+        // fails if the parameters are invalid, see is_valid_key_derivation_params()
+        bool submit(const secure_password& _Password, const salt& _Salt, const key_derivation_params& _Params,
+            callback&& _Callback) noexcept;
+
+        // waits until at most _Max_pending derivations have not finished yet, must not be called by a callback
+        void wait(const size_t _Max_pending = 0) noexcept;
+
+    private:
+        struct _Request {
+            secure_password _Password;
+            salt _Salt;
+            key_derivation_params _Params;
+            callback _Callback;
+        };
+
+        // takes the derivations from the queue as long as they fit within the budget
+        void _Work() noexcept;
+
+        ::std::deque<_Request> _Myqueue;
+        ::std::vector<::std::thread> _Mythreads;
+        size_t _Mycount;
+        size_t _Mybudget;
+        key_derivation_context _Mycontext;
+        size_t _Myused; // the memory used by the running derivations
+        size_t _Mypeak;
+        size_t _Mypending;
+        mutable ::std::mutex _Mymtx;
+        ::std::condition_variable _Mywork_cv; // signaled when a derivation is queued or finished
+        ::std::condition_variable _Mydone_cv; // signaled when a callback returns
+        bool _Mystop;
+    };
+} // namespace mjx
+
+#endif // _EFC_KEY_DERIVATION_SCHEDULER_HPP_
\ No newline at end of file
@@ -0,0 +1,108 @@
+// parallel_encryption_engine.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <algorithm>
+#include <atomic>
+#include <efc/impl/parallel.hpp>
+#include <efc/impl/parallel_encryption_engine.hpp>
+#include <efc/impl/secure_memory.hpp>
+#include <efc/parallel_encryption_engine.hpp>
+#include <memory>
+#include <new>
+#include <openssl/crypto.h>
+
+namespace mjx {
+    namespace efc_impl {
+        struct _Segment_job {
+            const key& _Key;
+            const _Gcm_context& _Ctx;
+            const byte_t* _Bytes;
+            byte_t* _Buf;
+            size_t _Count;
+            size_t _Segment_size; // a multiple of the block size
+            byte_t* _Digests; // the partial GHASH of each segment
+            bool _Encrypt;
+            ::std::atomic<bool> _Failed;
+
+            _Segment_job(const key& _Key, const _Gcm_context& _Ctx, const byte_t* const _Bytes, byte_t* const _Buf,
+                const size_t _Count, const size_t _Segment_size, byte_t* const _Digests, const bool _Encrypt) noexcept
+                : _Key(_Key), _Ctx(_Ctx), _Bytes(_Bytes), _Buf(_Buf), _Count(_Count),
+                _Segment_size(_Segment_size), _Digests(_Digests), _Encrypt(_Encrypt), _Failed(false) {}
+        };
+
+        inline void _Process_segment(_Segment_job& _Job, const size_t _Index) noexcept {
+            const size_t _Off  = _Index * _Job._Segment_size;
+            const size_t _Size = (::std::min)(_Job._Segment_size, _Job._Count - _Off);
+            _Gcm_segment _Segment;
+            bool _Succeeded = _Segment._Setup(_Job._Key, _Job._Ctx, _Off / _Gcm_block_size);
+            if (_Succeeded) {
+                _Succeeded = _Job._Encrypt ? _Segment._Encrypt(_Job._Bytes + _Off, _Size, _Job._Buf + _Off)
+                                           : _Segment._Decrypt(_Job._Bytes + _Off, _Size, _Job._Buf + _Off);
+            }
+
+            if (_Succeeded) {
+                ::memcpy(_Job._Digests + _Index * _Gcm_block_size, _Segment._Digest(), _Gcm_block_size);
+            } else {
+                _Job._Failed = true;
+            }
+        }
+
+        inline bool _Process_segments(const key& _Key, const iv& _Iv, const byte_t* const _Bytes,
+            const size_t _Count, byte_t* const _Buf, const size_t _Threads, const bool _Encrypt,
+            authentication_tag& _Tag) noexcept {
+            if (static_cast<uint64_t>(_Count) > _Gcm_max_size) { // the message is too long for a single IV
+                return false;
+            }
+
+            _Gcm_context _Ctx;
+            if (!_Ctx._Setup(_Key, _Iv)) {
+                return false;
+            }
+
+            const size_t _Blocks   = (_Count + _Gcm_block_size - 1) / _Gcm_block_size;
+            const size_t _Segments = (::std::max)(
+                (::std::min)(_Threads, _Count / _Min_segment_size), static_cast<size_t>(1));
+            const size_t _Segment_size = (_Blocks + _Segments - 1) / _Segments * _Gcm_block_size;
+            ::std::unique_ptr<byte_t[]> _Digests(new (::std::nothrow) byte_t[_Segments * _Gcm_block_size]);
+            if (!_Digests) {
+                return false;
+            }
+
+            _Segment_job _Job(_Key, _Ctx, _Bytes, _Buf, _Count, _Segment_size, _Digests.get(), _Encrypt);
+            auto _Func = [&_Job](const size_t _Index) noexcept {
+                _Process_segment(_Job, _Index);
+            };
+            if (!_Run_in_parallel(_Segments, _Func) || _Job._Failed) {
+                return false;
+            }
+
+            _Ctx._Finish(_Digests.get(), _Segments, _Segment_size, _Count, _Tag);
+            _Wipe_memory(_Digests.get(), _Segments * _Gcm_block_size);
+            return true;
+        }
+    } // namespace efc_impl
+
+    parallel_encryption_engine::parallel_encryption_engine(const size_t _Threads) noexcept
+        : _Mythreads(_Threads != 0 ? _Threads : efc_impl::_Default_thread_count()) {}
+
+    parallel_encryption_engine::~parallel_encryption_engine() noexcept {}
+
+    bool parallel_encryption_engine::encrypt(const key& _Key, const iv& _Iv, const byte_t* const _Bytes,
+        const size_t _Count, byte_t* const _Buf, authentication_tag& _Tag) noexcept {
+        return efc_impl::_Process_segments(_Key, _Iv, _Bytes, _Count, _Buf, _Mythreads, true, _Tag);
+    }
+
+    bool parallel_encryption_engine::decrypt(const key& _Key, const iv& _Iv, const byte_t* const _Bytes,
+        const size_t _Count, byte_t* const _Buf, const authentication_tag& _Tag) noexcept {
+        authentication_tag _Computed_tag;
+        if (!efc_impl::_Process_segments(_Key, _Iv, _Bytes, _Count, _Buf, _Mythreads, false, _Computed_tag)
+            || ::CRYPTO_memcmp(_Computed_tag.data(), _Tag.data(), authentication_tag::size) != 0) {
+            efc_impl::_Wipe_memory(_Buf, _Count); // never release unauthenticated plaintext
+            return false;
+        }
+
+        return true;
+    }
+} // namespace mjx
\ No newline at end of file
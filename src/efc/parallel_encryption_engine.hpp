@@ -0,0 +1,38 @@
+// parallel_encryption_engine.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_PARALLEL_ENCRYPTION_ENGINE_HPP_
+#define _EFC_PARALLEL_ENCRYPTION_ENGINE_HPP_
+#include <efc/encryption_engine.hpp>
+
+namespace mjx {
+    // Note: The parallel engine produces exactly the same ciphertext and authentication tag as
+    //       the encryption_engine. The data is split into block-aligned segments, each segment
+    //       is encrypted in CTR mode starting from its own counter and hashed on its own.
+    //       The partial GHASH results are then combined using the powers of the hash key.
+    class parallel_encryption_engine { // multi-threaded AES-256-GCM engine
+    public:
+        // uses as many threads as there are hardware threads if _Threads is 0
+        explicit parallel_encryption_engine(const size_t _Threads = 0) noexcept;
+        ~parallel_encryption_engine() noexcept;
+
+        parallel_encryption_engine(const parallel_encryption_engine&)            = delete;
+        parallel_encryption_engine& operator=(const parallel_encryption_engine&) = delete;
+
+        // encrypts a byte sequence and computes its authentication tag
+        bool encrypt(const key& _Key, const iv& _Iv, const byte_t* const _Bytes,
+            const size_t _Count, byte_t* const _Buf, authentication_tag& _Tag) noexcept;
+
+        // decrypts a byte sequence and verifies its authentication tag
+        bool decrypt(const key& _Key, const iv& _Iv, const byte_t* const _Bytes,
+            const size_t _Count, byte_t* const _Buf, const authentication_tag& _Tag) noexcept;
+
+    private:
+        size_t _Mythreads;
+    };
+} // namespace mjx
+
+#endif // _EFC_PARALLEL_ENCRYPTION_ENGINE_HPP_
\ No newline at end of file
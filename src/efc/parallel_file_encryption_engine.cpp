@@ -0,0 +1,153 @@
+// parallel_file_encryption_engine.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <algorithm>
+#include <atomic>
+#include <efc/impl/buffer_pool.hpp>
+#include <efc/impl/file_io.hpp>
+#include <efc/impl/parallel.hpp>
+#include <efc/impl/parallel_encryption_engine.hpp>
+#include <efc/parallel_file_encryption_engine.hpp>
+#include <memory>
+#include <new>
+#include <openssl/crypto.h>
+
+namespace mjx {
+    namespace efc_impl {
+        inline constexpr size_t _Segment_buffer_size = 1048576; // 1 MiB, a multiple of the block size
+
+        struct _File_segment_job {
+            const file& _Src;
+            const file& _Dest;
+            const key& _Key;
+            const _Gcm_context& _Ctx;
+            const uint64_t _Src_off; // the offset of the data in the source file
+            const uint64_t _Dest_off; // the offset of the data in the destination file
+            const uint64_t _Size; // the total size of the data
+            const uint64_t _Segment_size; // a multiple of the block size
+            byte_t* const _Digests; // the partial GHASH of each segment
+            const bool _Encrypt;
+            ::std::atomic<bool> _Failed;
+
+            _File_segment_job(const file& _Src, const file& _Dest, const key& _Key, const _Gcm_context& _Ctx,
+                const uint64_t _Src_off, const uint64_t _Dest_off, const uint64_t _Size,
+                const uint64_t _Segment_size, byte_t* const _Digests, const bool _Encrypt) noexcept
+                : _Src(_Src), _Dest(_Dest), _Key(_Key), _Ctx(_Ctx), _Src_off(_Src_off), _Dest_off(_Dest_off),
+                _Size(_Size), _Segment_size(_Segment_size), _Digests(_Digests), _Encrypt(_Encrypt), _Failed(false) {}
+        };
+
+        inline bool _Process_file_segment(_File_segment_job& _Job, const size_t _Index) noexcept {
+            const uint64_t _First = (::std::min)(_Index * _Job._Segment_size, _Job._Size);
+            const uint64_t _Last  = (::std::min)(_First + _Job._Segment_size, _Job._Size);
+            _Buffer_pool _Pool; // holds the plaintext, wiped once the segment is done or has failed
+            _Gcm_segment _Segment;
+            if (!_Pool._Init(1, _Segment_buffer_size)
+                || !_Segment._Setup(_Job._Key, _Job._Ctx, _First / _Gcm_block_size)) {
+                return false;
+            }
+
+            byte_t* const _Buf = _Pool._Get(0);
+
+            for (uint64_t _Off = _First; _Off < _Last; _Off += _Segment_buffer_size) {
+                if (_Job._Failed.load(::std::memory_order_relaxed)) { // some other segment failed, stop
+                    return false;
+                }
+
+                const size_t _Count = static_cast<size_t>((::std::min)(
+                    static_cast<uint64_t>(_Segment_buffer_size), _Last - _Off));
+                if (!_Read_at(_Job._Src, _Job._Src_off + _Off, _Buf, _Count)) {
+                    return false;
+                }
+
+                if (!(_Job._Encrypt ? _Segment._Encrypt(_Buf, _Count, _Buf) : _Segment._Decrypt(_Buf, _Count, _Buf))) {
+                    return false;
+                }
+
+                if (!_Write_at(_Job._Dest, _Job._Dest_off + _Off, _Buf, _Count)) {
+                    return false;
+                }
+            }
+
+            ::memcpy(_Job._Digests + _Index * _Gcm_block_size, _Segment._Digest(), _Gcm_block_size);
+            return true;
+        }
+
+        inline bool _Process_file_segments(const file& _Src, const file& _Dest, const key& _Key, const iv& _Iv,
+            const uint64_t _Src_off, const uint64_t _Dest_off, const uint64_t _Size, const size_t _Threads,
+            const bool _Encrypt, authentication_tag& _Tag) noexcept {
+            if (_Size > _Gcm_max_size) { // the file is too large for a single IV
+                return false;
+            }
+
+            _Gcm_context _Ctx;
+            if (!_Ctx._Setup(_Key, _Iv)) {
+                return false;
+            }
+
+            const uint64_t _Blocks       = (_Size + _Gcm_block_size - 1) / _Gcm_block_size;
+            const size_t _Segments       = static_cast<size_t>((::std::max)((::std::min)(
+                static_cast<uint64_t>(_Threads), _Size / _Min_segment_size), uint64_t{1}));
+            const uint64_t _Segment_size = (_Blocks + _Segments - 1) / _Segments * _Gcm_block_size;
+            ::std::unique_ptr<byte_t[]> _Digests(new (::std::nothrow) byte_t[_Segments * _Gcm_block_size]);
+            if (!_Digests) {
+                return false;
+            }
+
+            _File_segment_job _Job(
+                _Src, _Dest, _Key, _Ctx, _Src_off, _Dest_off, _Size, _Segment_size, _Digests.get(), _Encrypt);
+            auto _Func = [&_Job](const size_t _Index) noexcept {
+                if (!_Process_file_segment(_Job, _Index)) {
+                    _Job._Failed = true;
+                }
+            };
+            if (!_Run_in_parallel(_Segments, _Func) || _Job._Failed) {
+                return false;
+            }
+
+            _Ctx._Finish(_Digests.get(), _Segments, _Segment_size, _Size, _Tag);
+            _Wipe_memory(_Digests.get(), _Segments * _Gcm_block_size);
+            return true;
+        }
+    } // namespace efc_impl
+
+    parallel_file_encryption_engine::parallel_file_encryption_engine(
+        file& _Src_file, file& _Dest_file, const size_t _Threads) noexcept
+        : _Mysrc(_Src_file), _Mydest(_Dest_file),
+        _Mythreads(_Threads != 0 ? _Threads : efc_impl::_Default_thread_count()) {}
+
+    parallel_file_encryption_engine::~parallel_file_encryption_engine() noexcept {}
+
+    bool parallel_file_encryption_engine::encrypt(const key& _Key, file_metadata& _Meta) noexcept {
+        if (_Meta.signature.format() != file_format::legacy) {
+            return false;
+        }
+
+        const uint64_t _Header_size = metadata_size(_Meta);
+        const uint64_t _Size        = _Mysrc.size();
+        if (!_Mydest.resize(_Header_size + _Size)) { // preallocate the destination file
+            return false;
+        }
+
+        return efc_impl::_Process_file_segments(
+            _Mysrc, _Mydest, _Key, _Meta.iv, 0, _Header_size, _Size, _Mythreads, true, _Meta.tag);
+    }
+
+    bool parallel_file_encryption_engine::decrypt(const key& _Key, const file_metadata& _Meta) noexcept {
+        if (_Meta.signature.format() != file_format::legacy) {
+            return false;
+        }
+
+        const uint64_t _Header_size = metadata_size(_Meta);
+        const uint64_t _Src_size    = _Mysrc.size();
+        if (_Src_size < _Header_size || !_Mydest.resize(_Src_size - _Header_size)) {
+            return false;
+        }
+
+        authentication_tag _Tag;
+        return efc_impl::_Process_file_segments(_Mysrc, _Mydest, _Key, _Meta.iv, _Header_size, 0,
+            _Src_size - _Header_size, _Mythreads, false, _Tag)
+                && ::CRYPTO_memcmp(_Tag.data(), _Meta.tag.data(), authentication_tag::size) == 0;
+    }
+} // namespace mjx
\ No newline at end of file
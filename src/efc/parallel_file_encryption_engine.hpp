@@ -0,0 +1,38 @@
+// parallel_file_encryption_engine.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_PARALLEL_FILE_ENCRYPTION_ENGINE_HPP_
+#define _EFC_PARALLEL_FILE_ENCRYPTION_ENGINE_HPP_
+#include <efc/encryption_engine.hpp>
+#include <efc/file_encryption_engine.hpp>
+#include <mjfs/file.hpp>
+
+namespace mjx {
+    class parallel_file_encryption_engine { // multi-threaded engine for the legacy format
+    public:
+        // uses as many threads as there are hardware threads if _Threads is 0
+        parallel_file_encryption_engine(file& _Src_file, file& _Dest_file, const size_t _Threads = 0) noexcept;
+        ~parallel_file_encryption_engine() noexcept;
+
+        parallel_file_encryption_engine(const parallel_file_encryption_engine&)            = delete;
+        parallel_file_encryption_engine& operator=(const parallel_file_encryption_engine&) = delete;
+
+        // encrypts the file and stores the authentication tag in the metadata,
+        // the encrypted data is written right after the metadata
+        bool encrypt(const key& _Key, file_metadata& _Meta) noexcept;
+
+        // decrypts the file and verifies the authentication tag stored in the metadata,
+        // the encrypted data is read right after the metadata
+        bool decrypt(const key& _Key, const file_metadata& _Meta) noexcept;
+
+    private:
+        file& _Mysrc;
+        file& _Mydest;
+        size_t _Mythreads;
+    };
+} // namespace mjx
+
+#endif // _EFC_PARALLEL_FILE_ENCRYPTION_ENGINE_HPP_
\ No newline at end of file
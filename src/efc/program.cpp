@@ -5,15 +5,20 @@
 
 #include <efc/impl/program.hpp>
 #include <efc/impl/secure_memory.hpp>
+#include <efc/key_agent.hpp>
 #include <efc/program.hpp>
 
 namespace mjx {
-    program_options::program_options() noexcept : path_to_file(), operation(operation::none), password() {}
+    program_options::program_options() noexcept
+        : path_to_file(), operation(operation::none), password(), raw_key(), format(file_format::chunked),
+        direct_io(false), use_stdin(false), use_stdout(false), recursive(false),
+        kdf_params(default_key_derivation_params), target_time(default_target_time), use_agent(true),
+        agent_ttl(key_agent::default_ttl) {}
 
     void parse_program_args(int _Count, wchar_t** _Args, program_options& _Options) {
         efc_impl::_Parser_context _Ctx;
         efc_impl::_Parser_data _Data(_Options);
-        for (; _Count > 0 && !_Ctx._Parse_completed(); --_Count, ++_Args) {
+        for (; _Count > 0; --_Count, ++_Args) {
             _Data._Arg = *_Args;
             if (!_Ctx._Path_found) { // search for a path
                 if (efc_impl::_Parse_path(_Ctx, _Data)) {
@@ -28,7 +33,61 @@ namespace mjx {
             }
             
             if (!_Ctx._Password_found) { // search for a password
-                efc_impl::_Parse_password(_Ctx, _Data);
+                if (efc_impl::_Parse_password(_Ctx, _Data)) {
+                    continue;
+                }
+            }
+
+            if (!_Ctx._Raw_key_found) { // search for a raw key (optional)
+                if (efc_impl::_Parse_raw_key(_Ctx, _Data)) {
+                    continue;
+                }
+            }
+
+            if (!_Ctx._Format_found) { // search for a format (optional)
+                if (efc_impl::_Parse_format(_Ctx, _Data)) {
+                    continue;
+                }
+            }
+
+            if (!_Ctx._Direct_io_found) { // search for the direct I/O switch (optional)
+                if (efc_impl::_Parse_direct_io(_Ctx, _Data)) {
+                    continue;
+                }
+            }
+
+            if (!_Ctx._Stdin_found || !_Ctx._Stdout_found) { // search for the standard streams (optional)
+                if (efc_impl::_Parse_standard_stream(_Ctx, _Data)) {
+                    continue;
+                }
+            }
+
+            if (!_Ctx._Recursive_found) { // search for the recursive switch (optional)
+                if (efc_impl::_Parse_recursive(_Ctx, _Data)) {
+                    continue;
+                }
+            }
+
+            if (!_Ctx._Kdf_params_found) { // search for the key derivation parameters (optional)
+                if (efc_impl::_Parse_kdf_params(_Ctx, _Data)) {
+                    continue;
+                }
+            }
+
+            if (!_Ctx._Target_time_found) { // search for the calibration target (optional)
+                if (efc_impl::_Parse_target_time(_Ctx, _Data)) {
+                    continue;
+                }
+            }
+
+            if (!_Ctx._No_agent_found) { // search for the switch that bypasses the key agent (optional)
+                if (efc_impl::_Parse_no_agent(_Ctx, _Data)) {
+                    continue;
+                }
+            }
+
+            if (!_Ctx._Agent_ttl_found) { // search for the lifetime of the agent keys (optional)
+                efc_impl::_Parse_agent_ttl(_Ctx, _Data);
             }
         }
     }
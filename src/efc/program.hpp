@@ -6,7 +6,9 @@
 #pragma once
 #ifndef _EFC_PROGRAM_HPP_
 #define _EFC_PROGRAM_HPP_
+#include <cstdint>
 #include <efc/encryption_engine.hpp>
+#include <efc/file_encryption_engine.hpp>
 #include <efc/key_derivation.hpp>
 #include <mjfs/path.hpp>
 
@@ -15,13 +17,28 @@ namespace mjx {
         none,
         help,
         encryption,
-        decryption
+        decryption,
+        calibration,
+        agent,
+        service
     };
 
     struct program_options {
+        static constexpr uint32_t default_target_time = 1000; // one second
+
         path path_to_file;
         operation operation;
         secure_password password;
+        key raw_key; // used instead of the password if valid, loaded by --key-file or --key-fd
+        file_format format;
+        bool direct_io; // bypass the system cache, used only by the chunked format
+        bool use_stdin; // read the input from the standard input instead of the file
+        bool use_stdout; // write the output to the standard output instead of a new file
+        bool recursive; // process every file in the directory and its subdirectories
+        key_derivation_params kdf_params; // the parameters stored in the encrypted files
+        uint32_t target_time; // the duration of the key derivation chosen by the calibration, in milliseconds
+        bool use_agent; // ask the key agent for the keys if it is running
+        uint32_t agent_ttl; // the number of seconds the key agent holds a key for
 
         program_options() noexcept;
     };
@@ -0,0 +1,132 @@
+// stream_encryption_engine.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <cstring>
+#include <efc/chunked_file_encryption_engine.hpp>
+#include <efc/impl/buffer_pool.hpp>
+#include <efc/impl/chunked_file_encryption_engine.hpp>
+#include <efc/stream_encryption_engine.hpp>
+#include <utility>
+
+namespace mjx {
+    namespace efc_impl {
+        // reads until _Count bytes are read or the stream ends, pipes may return fewer bytes per read
+        inline size_t _Read_full(file_stream& _Stream, byte_t* const _Buf, const size_t _Count) noexcept {
+            size_t _Total = 0;
+            while (_Total < _Count) {
+                const size_t _Read = _Stream.read(_Buf + _Total, _Count - _Total);
+                if (_Read == 0) { // the end of the stream
+                    break;
+                }
+
+                _Total += _Read;
+            }
+
+            return _Total;
+        }
+
+        inline bool _Is_streamable(const file_metadata& _Meta) noexcept {
+            return _Meta.signature.format() == file_format::chunked
+                && chunked_file_encryption_engine::is_valid_chunk_size(_Meta.chunk_size, _Meta.features);
+        }
+    } // namespace efc_impl
+
+    stream_encryption_engine::stream_encryption_engine(file_stream& _Src_stream, file_stream& _Dest_stream) noexcept
+        : _Mysrc(_Src_stream), _Mydest(_Dest_stream) {}
+
+    stream_encryption_engine::~stream_encryption_engine() noexcept {}
+
+    bool stream_encryption_engine::encrypt(const key& _Key, const file_metadata& _Meta) noexcept {
+        if (!efc_impl::_Is_streamable(_Meta)) {
+            return false;
+        }
+
+        const size_t _Chunk_size = _Meta.chunk_size;
+        const size_t _Tag_space  = efc_impl::_Tag_space_of(_Meta.features);
+        efc_impl::_Buffer_pool _Pool;
+        if (!_Pool._Init(2, _Chunk_size + _Tag_space)) {
+            return false;
+        }
+
+        byte_t* _Buf  = _Pool._Get(0);
+        byte_t* _Next = _Pool._Get(1);
+        size_t _Size  = efc_impl::_Read_full(_Mysrc, _Buf, _Chunk_size);
+        encryption_engine _Engine;
+        authentication_tag _Tag;
+        for (uint64_t _Index = 0;; ++_Index) {
+            // Note: A short chunk can only be the last one. A full chunk is the last one
+            //       if nothing follows it, which is known only after reading ahead.
+            const size_t _Next_size = _Size == _Chunk_size ? efc_impl::_Read_full(_Mysrc, _Next, _Chunk_size) : 0;
+            const bool _Final       = _Next_size == 0;
+            if (!_Engine.setup_encryption(_Key, make_chunk_iv(_Meta.iv, _Index, _Final))
+                || !_Engine.encrypt(_Buf, _Size, _Buf) || !_Engine.complete(_Tag)) {
+                return false;
+            }
+
+            ::memcpy(_Buf + _Size, _Tag.data(), authentication_tag::size); // append the tag
+            const size_t _Stored_size = _Final ? _Size + authentication_tag::size : _Chunk_size + _Tag_space;
+            ::memset(_Buf + _Size + authentication_tag::size, 0, _Stored_size - _Size - authentication_tag::size);
+            if (!_Mydest.write(_Buf, _Stored_size)) {
+                return false;
+            }
+
+            if (_Final) {
+                break;
+            }
+
+            ::std::swap(_Buf, _Next);
+            _Size = _Next_size;
+        }
+
+        return _Mydest.flush();
+    }
+
+    bool stream_encryption_engine::decrypt(const key& _Key, const file_metadata& _Meta) noexcept {
+        if (!efc_impl::_Is_streamable(_Meta)) {
+            return false;
+        }
+
+        const size_t _Chunk_size  = _Meta.chunk_size;
+        const size_t _Tag_space   = efc_impl::_Tag_space_of(_Meta.features);
+        const size_t _Stored_size = _Chunk_size + _Tag_space; // the size of every chunk but the last one
+        efc_impl::_Buffer_pool _Pool;
+        if (!_Pool._Init(2, _Stored_size)) {
+            return false;
+        }
+
+        byte_t* _Buf  = _Pool._Get(0);
+        byte_t* _Next = _Pool._Get(1);
+        size_t _Size  = efc_impl::_Read_full(_Mysrc, _Buf, _Stored_size);
+        encryption_engine _Engine;
+        authentication_tag _Tag;
+        for (uint64_t _Index = 0;; ++_Index) {
+            const size_t _Next_size = _Size == _Stored_size ? efc_impl::_Read_full(_Mysrc, _Next, _Stored_size) : 0;
+            const bool _Final       = _Next_size == 0;
+            if (_Final && (_Size < authentication_tag::size || _Size - authentication_tag::size > _Chunk_size)) {
+                return false; // the stream has been truncated
+            }
+
+            const size_t _Plaintext_size = _Final ? _Size - authentication_tag::size : _Chunk_size;
+            _Tag.assign(_Buf + _Plaintext_size);
+            if (!_Engine.setup_decryption(_Key, make_chunk_iv(_Meta.iv, _Index, _Final))
+                || !_Engine.decrypt(_Buf, _Plaintext_size, _Buf) || !_Engine.complete(_Tag)) {
+                return false; // the chunk has been modified or the key is invalid
+            }
+
+            if (!_Mydest.write(_Buf, _Plaintext_size)) {
+                return false;
+            }
+
+            if (_Final) {
+                break;
+            }
+
+            ::std::swap(_Buf, _Next);
+            _Size = _Next_size;
+        }
+
+        return _Mydest.flush();
+    }
+} // namespace mjx
\ No newline at end of file
@@ -0,0 +1,40 @@
+// stream_encryption_engine.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_STREAM_ENCRYPTION_ENGINE_HPP_
+#define _EFC_STREAM_ENCRYPTION_ENGINE_HPP_
+#include <efc/encryption_engine.hpp>
+#include <efc/file_encryption_engine.hpp>
+#include <mjfs/file_stream.hpp>
+
+namespace mjx {
+    // Note: The chunked format can be written and read in a single pass, since every chunk carries
+    //       its own tag and the last chunk is marked in its nonce. The engine never seeks, so it works
+    //       with pipes and other non-seekable streams. It holds at most two chunks in memory,
+    //       the one being processed and the one read ahead to tell whether the former is the last one.
+    class stream_encryption_engine { // single-threaded, single-pass engine for the chunked format
+    public:
+        stream_encryption_engine(file_stream& _Src_stream, file_stream& _Dest_stream) noexcept;
+        ~stream_encryption_engine() noexcept;
+
+        stream_encryption_engine(const stream_encryption_engine&)            = delete;
+        stream_encryption_engine& operator=(const stream_encryption_engine&) = delete;
+
+        // encrypts the stream until its end, the metadata must have already been written
+        bool encrypt(const key& _Key, const file_metadata& _Meta) noexcept;
+
+        // decrypts the stream until its end, the metadata must have already been read
+        // Note: Every chunk is verified before it is written, but if a later chunk fails verification,
+        //       the chunks written so far remain in the destination stream.
+        bool decrypt(const key& _Key, const file_metadata& _Meta) noexcept;
+
+    private:
+        file_stream& _Mysrc;
+        file_stream& _Mydest;
+    };
+} // namespace mjx
+
+#endif // _EFC_STREAM_ENCRYPTION_ENGINE_HPP_
\ No newline at end of file
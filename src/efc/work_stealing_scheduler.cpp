@@ -0,0 +1,175 @@
+// work_stealing_scheduler.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <efc/impl/parallel.hpp>
+#include <efc/impl/work_stealing_scheduler.hpp>
+#include <efc/work_stealing_scheduler.hpp>
+#include <new>
+
+namespace mjx {
+    namespace efc_impl {
+        struct _Current_worker { // identifies the worker that runs on the calling thread
+            const work_stealing_scheduler* _Scheduler = nullptr;
+            size_t _Index                             = 0;
+        };
+
+        inline thread_local _Current_worker _This_worker;
+    } // namespace efc_impl
+
+    work_stealing_scheduler::work_stealing_scheduler(const size_t _Threads) noexcept
+        : _Myqueues(), _Mythreads(), _Mycount(_Threads != 0 ? _Threads : efc_impl::_Default_thread_count()),
+        _Mymtx(), _Mywork_cv(), _Mydone_cv(), _Myqueued(0), _Mypending(0), _Mywaiters(0), _Mynext_queue(0),
+        _Mystop(false) {
+        _Myqueues.reset(new (::std::nothrow) efc_impl::_Worker_queue[_Mycount]);
+        if (!_Myqueues) {
+            return;
+        }
+
+        try {
+            _Mythreads.reserve(_Mycount);
+            for (size_t _Idx = 0; _Idx < _Mycount; ++_Idx) {
+                _Mythreads.emplace_back(&work_stealing_scheduler::_Work, this, _Idx);
+            }
+        } catch (...) { // failed to start a worker, stop the started ones
+            {
+                ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+                _Mystop = true;
+            }
+
+            _Mywork_cv.notify_all();
+            for (::std::thread& _Thread : _Mythreads) {
+                _Thread.join();
+            }
+
+            _Mythreads.clear();
+        }
+    }
+
+    work_stealing_scheduler::~work_stealing_scheduler() noexcept {
+        if (is_running()) {
+            wait();
+            {
+                ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+                _Mystop = true;
+            }
+
+            _Mywork_cv.notify_all();
+            for (::std::thread& _Thread : _Mythreads) {
+                _Thread.join();
+            }
+        }
+    }
+
+    bool work_stealing_scheduler::is_running() const noexcept {
+        return !_Mythreads.empty();
+    }
+
+    size_t work_stealing_scheduler::worker_count() const noexcept {
+        return _Mycount;
+    }
+
+    size_t work_stealing_scheduler::pending() const noexcept {
+        return _Mypending.load();
+    }
+
+    bool work_stealing_scheduler::submit(task&& _Task) noexcept {
+        if (!is_running() || !_Task) {
+            return false;
+        }
+
+        const size_t _Queue = efc_impl::_This_worker._Scheduler == this ? efc_impl::_This_worker._Index
+            : _Mynext_queue.fetch_add(1, ::std::memory_order_relaxed) % _Mycount;
+        _Mypending.fetch_add(1);
+        try {
+            _Myqueues[_Queue]._Push(::std::move(_Task));
+        } catch (...) {
+            _Mypending.fetch_sub(1);
+            return false;
+        }
+
+        _Myqueued.fetch_add(1, ::std::memory_order_release);
+        {
+            ::std::lock_guard<::std::mutex> _Guard(_Mymtx); // don't let a worker miss the notification
+        }
+
+        _Mywork_cv.notify_one();
+        return true;
+    }
+
+    void work_stealing_scheduler::wait(const size_t _Max_pending) noexcept {
+        // Note: The counters of pending tasks and waiters use sequentially consistent operations,
+        //       so that either the worker sees the waiter or the waiter sees the finished task.
+        if (_Mypending.load() <= _Max_pending) {
+            return;
+        }
+
+        ::std::unique_lock<::std::mutex> _Lock(_Mymtx);
+        _Mywaiters.fetch_add(1);
+        _Mydone_cv.wait(_Lock, [this, _Max_pending] {
+            return _Mypending.load() <= _Max_pending;
+        });
+        _Mywaiters.fetch_sub(1);
+    }
+
+    worker_stats work_stealing_scheduler::stats(const size_t _Worker) const noexcept {
+        if (!_Myqueues || _Worker >= _Mycount) {
+            return worker_stats{};
+        }
+
+        const efc_impl::_Worker_queue& _Queue = _Myqueues[_Worker];
+        worker_stats _Stats;
+        _Stats.executed       = _Queue._Executed.load(::std::memory_order_relaxed);
+        _Stats.stolen         = _Queue._Stolen.load(::std::memory_order_relaxed);
+        _Stats.failed_steals  = _Queue._Failed_steals.load(::std::memory_order_relaxed);
+        _Stats.max_queue_size = _Queue._Max_size.load(::std::memory_order_relaxed);
+        return _Stats;
+    }
+
+    bool work_stealing_scheduler::_Steal(const size_t _Worker, task& _Task) noexcept {
+        for (size_t _Off = 1; _Off < _Mycount; ++_Off) { // start with the next worker to spread the steals
+            if (_Myqueues[(_Worker + _Off) % _Mycount]._Pop_front(_Task)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void work_stealing_scheduler::_Work(const size_t _Worker) noexcept {
+        efc_impl::_This_worker          = efc_impl::_Current_worker{this, _Worker};
+        efc_impl::_Worker_queue& _Queue = _Myqueues[_Worker];
+        task _Task;
+        for (;;) {
+            bool _Found = _Queue._Pop_back(_Task);
+            if (!_Found) {
+                _Found = _Steal(_Worker, _Task);
+                (_Found ? _Queue._Stolen : _Queue._Failed_steals).fetch_add(1, ::std::memory_order_relaxed);
+            }
+
+            if (_Found) {
+                _Myqueued.fetch_sub(1, ::std::memory_order_acq_rel);
+                try {
+                    _Task();
+                } catch (...) { // a failing task must not stop the worker
+                }
+
+                _Task = nullptr; // release the captured state before the task is reported as finished
+                _Queue._Executed.fetch_add(1, ::std::memory_order_relaxed);
+                if (_Mypending.fetch_sub(1) == 1 || _Mywaiters.load() != 0) {
+                    ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+                    _Mydone_cv.notify_all();
+                }
+
+                continue;
+            }
+
+            ::std::unique_lock<::std::mutex> _Lock(_Mymtx);
+            _Mywork_cv.wait(_Lock, [this] { return _Mystop || _Myqueued.load(::std::memory_order_acquire) != 0; });
+            if (_Mystop) {
+                return;
+            }
+        }
+    }
+} // namespace mjx
\ No newline at end of file
@@ -0,0 +1,84 @@
+// work_stealing_scheduler.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_WORK_STEALING_SCHEDULER_HPP_
+#define _EFC_WORK_STEALING_SCHEDULER_HPP_
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mjx {
+    namespace efc_impl {
+        struct _Worker_queue;
+    } // namespace efc_impl
+
+    struct worker_stats {
+        uint64_t executed       = 0; // the number of tasks executed by the worker
+        uint64_t stolen         = 0; // the number of tasks the worker took from the queues of other workers
+        uint64_t failed_steals  = 0; // the number of times the worker found every queue empty
+        uint64_t max_queue_size = 0; // the largest number of tasks waiting in the queue of the worker
+    };
+
+    class work_stealing_scheduler { // fixed pool of workers, each with its own queue of tasks
+    public:
+        using task = ::std::function<void()>;
+
+        // Note: A task submitted by a worker is queued on that worker, which takes its own tasks
+        //       in the reverse order. Idle workers steal the oldest tasks of the busy ones, so a task
+        //       that splits its work into subtasks is shared by all the idle workers.
+        //       Uses as many workers as there are hardware threads if _Threads is 0.
+        explicit work_stealing_scheduler(const size_t _Threads = 0) noexcept;
+        ~work_stealing_scheduler() noexcept;
+
+        work_stealing_scheduler(const work_stealing_scheduler&)            = delete;
+        work_stealing_scheduler& operator=(const work_stealing_scheduler&) = delete;
+
+        // checks if the workers have been started
+        bool is_running() const noexcept;
+
+        // returns the number of workers
+        size_t worker_count() const noexcept;
+
+        // returns the number of submitted tasks that have not finished yet
+        size_t pending() const noexcept;
+
+        // queues the task, tasks submitted from outside the workers are distributed in turn
+        bool submit(task&& _Task) noexcept;
+
+        // waits until at most _Max_pending submitted tasks have not finished yet, must not be called by a task
+        void wait(const size_t _Max_pending = 0) noexcept;
+
+        // returns the statistics of the specified worker
+        worker_stats stats(const size_t _Worker) const noexcept;
+
+    private:
+        // executes the tasks of the worker and steals the tasks of other workers
+        void _Work(const size_t _Worker) noexcept;
+
+        // takes a task from the queue of another worker
+        bool _Steal(const size_t _Worker, task& _Task) noexcept;
+
+        ::std::unique_ptr<efc_impl::_Worker_queue[]> _Myqueues;
+        ::std::vector<::std::thread> _Mythreads;
+        size_t _Mycount;
+        mutable ::std::mutex _Mymtx;
+        ::std::condition_variable _Mywork_cv; // signaled when a task is queued or the workers should stop
+        ::std::condition_variable _Mydone_cv; // signaled when a task finishes and someone waits
+        ::std::atomic<size_t> _Myqueued; // the number of tasks waiting in the queues
+        ::std::atomic<size_t> _Mypending; // the number of tasks that have not finished yet
+        ::std::atomic<size_t> _Mywaiters;
+        ::std::atomic<size_t> _Mynext_queue; // the queue of the next task submitted from outside
+        bool _Mystop;
+    };
+} // namespace mjx
+
+#endif // _EFC_WORK_STEALING_SCHEDULER_HPP_
\ No newline at end of file
@@ -3,8 +3,22 @@
 // Copyright (c) Mateusz Jandura. All rights reserved.
 // SPDX-License-Identifier: Apache-2.0
 
+#include <unit/app.hpp>
+#include <unit/background_key.hpp>
+#include <unit/chunk_cache.hpp>
+#include <unit/chunked_file_encryption_engine.hpp>
+#include <unit/encrypted_file_reader.hpp>
 #include <unit/encryption_engine.hpp>
+#include <unit/file_encryption_engine.hpp>
+#include <unit/file_metadata.hpp>
+#include <unit/job_server.hpp>
+#include <unit/key_agent.hpp>
 #include <unit/key_derivation.hpp>
+#include <unit/key_derivation_scheduler.hpp>
+#include <unit/parallel_encryption_engine.hpp>
+#include <unit/program.hpp>
+#include <unit/stream_encryption_engine.hpp>
+#include <unit/work_stealing_scheduler.hpp>
 
 int main() {
     ::testing::InitGoogleTest();
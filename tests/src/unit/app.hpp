@@ -0,0 +1,124 @@
+// app.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_TEST_UNIT_APP_HPP_
+#define _EFC_TEST_UNIT_APP_HPP_
+#include <efc/impl/app.hpp>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <mjfs/path.hpp>
+#include <utils/chunked_file.hpp>
+#include <utils/test_directory.hpp>
+#include <utils/test_file.hpp>
+#include <vector>
+
+namespace mjx {
+    namespace test {
+        struct _Tree_file {
+            const wchar_t* _Name; // relative to the root of the tree
+            size_t _Size;
+        };
+
+        // the files are spread over nested directories, one of them spans several chunks
+        constexpr _Tree_file _Tree_files[] = {
+            {L"root.bin", 1000},
+            {L"one\\first.bin", file_encryption_options::default_chunk_size + 100},
+            {L"one\\two\\second.bin", 1},
+            {L"one\\two\\empty.bin", 0}
+        };
+
+        inline void _Set_recursive_options(
+            program_options& _Options, const path& _Root, const operation _Operation, const key& _Key) {
+            _Options.path_to_file = _Root;
+            _Options.operation    = _Operation;
+            _Options.raw_key      = _Key; // nothing to derive, so the test does not depend on the key derivation
+            _Options.recursive    = true;
+            _Options.use_agent    = false;
+        }
+
+        // creates the tree with random files and directories that must be skipped, returns the content of the files
+        inline bool _Make_test_tree(_Test_directory& _Dir, ::std::vector<byte_string>& _Data) {
+            if (_Dir._Path().empty() || !_Dir._Create_directory(L"one") || !_Dir._Create_directory(L"one\\two")
+                || !_Dir._Create_directory(L"one\\empty") || !_Dir._Create_directory(L"one\\dir.efc")) {
+                return false;
+            }
+
+            for (const _Tree_file& _File : _Tree_files) {
+                _Data.push_back(_Random_data(_File._Size));
+                if (_Data.back().size() != _File._Size || !_Dir._Store_file(_File._Name, _Data.back())) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        TEST(app, recursive) {
+            const key& _Key = _Make_test_key();
+            ASSERT_TRUE(_Key.valid());
+            _Test_directory _Dir;
+            ::std::vector<byte_string> _Data;
+            ASSERT_TRUE(_Make_test_tree(_Dir, _Data));
+
+            // the directories are not regular files, so neither of them is processed
+            program_options _Encryption;
+            _Set_recursive_options(_Encryption, _Dir._Path(), operation::encryption, _Key);
+            ASSERT_EQ(_Perform_recursive(_Encryption), _App_error::_Success);
+            EXPECT_FALSE(_Dir._Exists(L"one\\empty.efc"));
+            EXPECT_FALSE(_Dir._Exists(L"one\\dir.efc.efc"));
+            for (const _Tree_file& _File : _Tree_files) {
+                EXPECT_TRUE(_Dir._Exists(_Add_internal_extension(_File._Name)));
+                ASSERT_TRUE(_Dir._Delete_file(_File._Name)); // restored by the decryption
+            }
+
+            program_options _Decryption;
+            _Set_recursive_options(_Decryption, _Dir._Path(), operation::decryption, _Key);
+            ASSERT_EQ(_Perform_recursive(_Decryption), _App_error::_Success);
+            EXPECT_FALSE(_Dir._Exists(L"one\\dir"));
+            for (size_t _Idx = 0; _Idx < ::std::size(_Tree_files); ++_Idx) {
+                byte_string _Decrypted;
+                ASSERT_TRUE(_Dir._Load_file(_Tree_files[_Idx]._Name, _Decrypted));
+                EXPECT_EQ(_Decrypted, _Data[_Idx]);
+            }
+        }
+
+        TEST(app, recursive_failures) {
+            const key& _Key = _Make_test_key();
+            ASSERT_TRUE(_Key.valid());
+            _Test_directory _Dir;
+            ::std::vector<byte_string> _Data;
+            ASSERT_TRUE(_Make_test_tree(_Dir, _Data));
+
+            // the encrypted file of the first file already exists, the other files are encrypted anyway
+            const byte_string& _Existing = _Random_data(100);
+            ASSERT_TRUE(_Dir._Store_file(_Add_internal_extension(_Tree_files[0]._Name), _Existing));
+            program_options _Encryption;
+            _Set_recursive_options(_Encryption, _Dir._Path(), operation::encryption, _Key);
+            EXPECT_EQ(_Perform_recursive(_Encryption), _App_error::_Batch_failed);
+            byte_string _Unchanged;
+            ASSERT_TRUE(_Dir._Load_file(_Add_internal_extension(_Tree_files[0]._Name), _Unchanged));
+            EXPECT_EQ(_Unchanged, _Existing);
+            for (size_t _Idx = 1; _Idx < ::std::size(_Tree_files); ++_Idx) {
+                EXPECT_TRUE(_Dir._Exists(_Add_internal_extension(_Tree_files[_Idx]._Name)));
+                ASSERT_TRUE(_Dir._Delete_file(_Tree_files[_Idx]._Name));
+            }
+
+            // the existing file is not encrypted, nothing is decrypted from it, the other files are decrypted
+            ASSERT_TRUE(_Dir._Delete_file(_Tree_files[0]._Name));
+            program_options _Decryption;
+            _Set_recursive_options(_Decryption, _Dir._Path(), operation::decryption, _Key);
+            EXPECT_EQ(_Perform_recursive(_Decryption), _App_error::_Batch_failed);
+            EXPECT_FALSE(_Dir._Exists(_Tree_files[0]._Name));
+            for (size_t _Idx = 1; _Idx < ::std::size(_Tree_files); ++_Idx) {
+                byte_string _Decrypted;
+                ASSERT_TRUE(_Dir._Load_file(_Tree_files[_Idx]._Name, _Decrypted));
+                EXPECT_EQ(_Decrypted, _Data[_Idx]);
+            }
+        }
+    } // namespace test
+} // namespace mjx
+
+#endif // _EFC_TEST_UNIT_APP_HPP_
\ No newline at end of file
@@ -0,0 +1,77 @@
+// background_key.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_TEST_UNIT_BACKGROUND_KEY_HPP_
+#define _EFC_TEST_UNIT_BACKGROUND_KEY_HPP_
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <efc/impl/background_key.hpp>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <thread>
+#include <utils/chunked_file.hpp>
+
+namespace mjx {
+    namespace test {
+        inline void _Expect_same_key(const key& _Left, const key& _Right) {
+            ASSERT_TRUE(_Left.valid());
+            EXPECT_EQ(::memcmp(_Left.data(), _Right.data(), key::size), 0);
+        }
+
+        TEST(background_key, async) {
+            const key& _Key = _Make_test_key();
+            ASSERT_TRUE(_Key.valid());
+            ::std::thread::id _Caller;
+            efc_impl::_Background_key _Bkey;
+            _Bkey._Start([&] {
+                _Caller = ::std::this_thread::get_id();
+                return _Key;
+            }, true);
+            _Expect_same_key(_Bkey._Wait(), _Key);
+            EXPECT_NE(_Caller, ::std::this_thread::get_id()); // derived on a separate thread
+            _Expect_same_key(_Bkey._Wait(), _Key); // waiting again returns the same key
+        }
+
+        TEST(background_key, sync) {
+            const key& _Key = _Make_test_key();
+            ASSERT_TRUE(_Key.valid());
+            ::std::thread::id _Caller;
+            efc_impl::_Background_key _Bkey;
+            _Bkey._Start([&] {
+                _Caller = ::std::this_thread::get_id();
+                return _Key;
+            }, false);
+            EXPECT_EQ(_Caller, ::std::this_thread::get_id()); // derived before _Start() returns
+            _Expect_same_key(_Bkey._Wait(), _Key);
+        }
+
+        TEST(background_key, exception) {
+            for (const bool _Async : {false, true}) {
+                efc_impl::_Background_key _Bkey;
+                _Bkey._Start([]() -> key { throw ::std::runtime_error("derivation failed"); }, _Async);
+                EXPECT_FALSE(_Bkey._Wait().valid());
+            }
+        }
+
+        TEST(background_key, destroy_without_wait) {
+            // the destructor must wait for the thread, _Func refers to a local variable
+            ::std::atomic<bool> _Called{false};
+            {
+                efc_impl::_Background_key _Bkey;
+                _Bkey._Start([&] {
+                    ::std::this_thread::sleep_for(::std::chrono::milliseconds(50));
+                    _Called.store(true);
+                    return _Make_test_key();
+                }, true);
+            }
+
+            EXPECT_TRUE(_Called.load());
+        }
+    } // namespace test
+} // namespace mjx
+
+#endif // _EFC_TEST_UNIT_BACKGROUND_KEY_HPP_
\ No newline at end of file
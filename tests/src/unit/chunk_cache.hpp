@@ -0,0 +1,153 @@
+// chunk_cache.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_TEST_UNIT_CHUNK_CACHE_HPP_
+#define _EFC_TEST_UNIT_CHUNK_CACHE_HPP_
+#include <chrono>
+#include <cstring>
+#include <efc/chunk_cache.hpp>
+#include <efc/encrypted_file_reader.hpp>
+#include <gtest/gtest.h>
+#include <thread>
+#include <utils/chunked_file.hpp>
+
+namespace mjx {
+    namespace test {
+        constexpr size_t _Cache_test_size = 3 * _Test_chunk_size + 100; // four chunks, the last one is partial
+
+        // reads a part of the specified chunk and checks it against the plaintext
+        inline bool _Read_cached_chunk(
+            encrypted_file_reader& _Reader, const byte_string& _Plaintext, const uint64_t _Index) {
+            const uint64_t _Off = _Index * _Test_chunk_size + 10;
+            byte_t _Buf[64];
+            if (!_Reader.read_at(_Off, _Buf, sizeof(_Buf))) {
+                return false;
+            }
+
+            EXPECT_EQ(::memcmp(_Buf, _Plaintext.c_str() + _Off, sizeof(_Buf)), 0);
+            return true;
+        }
+
+        // waits until the cache has loaded the specified number of chunks ahead of the readers
+        inline bool _Wait_for_prefetches(const chunk_cache& _Cache, const uint64_t _Count) {
+            for (int _Attempt = 0; _Attempt < 500; ++_Attempt) {
+                if (_Cache.prefetches() >= _Count) {
+                    return true;
+                }
+
+                ::std::this_thread::sleep_for(::std::chrono::milliseconds(10));
+            }
+
+            return false;
+        }
+
+        TEST(chunk_cache, hits_and_misses) {
+            const byte_string& _Plaintext = _Random_data(_Cache_test_size);
+            const key& _Key               = _Make_test_key();
+            const file_metadata& _Meta    = _Make_chunked_metadata();
+            _Test_file _Encrypted;
+            ASSERT_TRUE(_Encrypt_chunked(_Plaintext, _Key, _Meta, _Encrypted));
+            chunk_cache _Cache(1024 * 1024, 0);
+            encrypted_file_reader _Reader(_Encrypted._Get(), _Key, _Meta, &_Cache);
+            ASSERT_TRUE(_Reader.is_open());
+            EXPECT_TRUE(_Read_cached_chunk(_Reader, _Plaintext, 0));
+            EXPECT_EQ(_Cache.misses(), 1);
+            EXPECT_EQ(_Cache.hits(), 0);
+            EXPECT_EQ(_Cache.size(), _Test_chunk_size);
+            EXPECT_TRUE(_Read_cached_chunk(_Reader, _Plaintext, 0));
+            EXPECT_TRUE(_Read_cached_chunk(_Reader, _Plaintext, 0));
+            EXPECT_EQ(_Cache.misses(), 1);
+            EXPECT_EQ(_Cache.hits(), 2);
+            EXPECT_TRUE(_Read_cached_chunk(_Reader, _Plaintext, 2));
+            EXPECT_EQ(_Cache.misses(), 2);
+            EXPECT_EQ(_Cache.size(), 2 * _Test_chunk_size);
+            EXPECT_EQ(_Cache.prefetches(), 0); // readahead is disabled
+        }
+
+        TEST(chunk_cache, eviction) {
+            const byte_string& _Plaintext = _Random_data(_Cache_test_size);
+            const key& _Key               = _Make_test_key();
+            const file_metadata& _Meta    = _Make_chunked_metadata();
+            _Test_file _Encrypted;
+            ASSERT_TRUE(_Encrypt_chunked(_Plaintext, _Key, _Meta, _Encrypted));
+            chunk_cache _Cache(2 * _Test_chunk_size, 0); // fits two full chunks
+            encrypted_file_reader _Reader(_Encrypted._Get(), _Key, _Meta, &_Cache);
+            ASSERT_TRUE(_Reader.is_open());
+            for (uint64_t _Index = 0; _Index < 3; ++_Index) {
+                EXPECT_TRUE(_Read_cached_chunk(_Reader, _Plaintext, _Index));
+                EXPECT_LE(_Cache.size(), _Cache.capacity());
+            }
+
+            EXPECT_EQ(_Cache.size(), 2 * _Test_chunk_size);
+            EXPECT_TRUE(_Read_cached_chunk(_Reader, _Plaintext, 2)); // still cached
+            EXPECT_EQ(_Cache.hits(), 1);
+            EXPECT_TRUE(_Read_cached_chunk(_Reader, _Plaintext, 0)); // evicted as the least recently used
+            EXPECT_EQ(_Cache.misses(), 4);
+            EXPECT_TRUE(_Read_cached_chunk(_Reader, _Plaintext, 2)); // chunk 1 has been evicted instead
+            EXPECT_EQ(_Cache.hits(), 2);
+        }
+
+        TEST(chunk_cache, readahead) {
+            const byte_string& _Plaintext = _Random_data(_Cache_test_size);
+            const key& _Key               = _Make_test_key();
+            const file_metadata& _Meta    = _Make_chunked_metadata();
+            _Test_file _Encrypted;
+            ASSERT_TRUE(_Encrypt_chunked(_Plaintext, _Key, _Meta, _Encrypted));
+            chunk_cache _Cache(1024 * 1024, 2);
+            encrypted_file_reader _Reader(_Encrypted._Get(), _Key, _Meta, &_Cache);
+            ASSERT_TRUE(_Reader.is_open());
+            EXPECT_TRUE(_Read_cached_chunk(_Reader, _Plaintext, 0)); // loads chunks 1 and 2 ahead
+            ASSERT_TRUE(_Wait_for_prefetches(_Cache, 2));
+            EXPECT_GT(_Cache.prefetches(), 0);
+            EXPECT_TRUE(_Read_cached_chunk(_Reader, _Plaintext, 1));
+            EXPECT_TRUE(_Read_cached_chunk(_Reader, _Plaintext, 2));
+            EXPECT_GE(_Cache.hits(), 2);
+            EXPECT_EQ(_Cache.misses(), 1);
+        }
+
+        TEST(chunk_cache, clear) {
+            const byte_string& _Plaintext = _Random_data(_Cache_test_size);
+            const key& _Key               = _Make_test_key();
+            const file_metadata& _Meta    = _Make_chunked_metadata();
+            _Test_file _Encrypted;
+            ASSERT_TRUE(_Encrypt_chunked(_Plaintext, _Key, _Meta, _Encrypted));
+            chunk_cache _Cache(1024 * 1024, 0);
+            encrypted_file_reader _Reader(_Encrypted._Get(), _Key, _Meta, &_Cache);
+            ASSERT_TRUE(_Reader.is_open());
+            EXPECT_TRUE(_Read_cached_chunk(_Reader, _Plaintext, 0));
+            EXPECT_TRUE(_Read_cached_chunk(_Reader, _Plaintext, 1));
+            EXPECT_EQ(_Cache.size(), 2 * _Test_chunk_size);
+            _Cache.clear();
+            EXPECT_EQ(_Cache.size(), 0);
+            EXPECT_TRUE(_Read_cached_chunk(_Reader, _Plaintext, 0)); // decrypted again
+            EXPECT_EQ(_Cache.misses(), 3);
+            EXPECT_EQ(_Cache.hits(), 0);
+        }
+
+        TEST(chunk_cache, shared_entries) {
+            const byte_string& _Plaintext = _Random_data(_Cache_test_size);
+            const key& _Key               = _Make_test_key();
+            const file_metadata& _Meta    = _Make_chunked_metadata();
+            _Test_file _Encrypted;
+            ASSERT_TRUE(_Encrypt_chunked(_Plaintext, _Key, _Meta, _Encrypted));
+            chunk_cache _Cache(1024 * 1024, 0);
+            {
+                encrypted_file_reader _Reader(_Encrypted._Get(), _Key, _Meta, &_Cache);
+                EXPECT_TRUE(_Read_cached_chunk(_Reader, _Plaintext, 0));
+            }
+
+            EXPECT_EQ(_Cache.size(), _Test_chunk_size); // the chunk outlives its reader
+            encrypted_file_reader _Same_key(_Encrypted._Get(), _Key, _Meta, &_Cache);
+            EXPECT_TRUE(_Read_cached_chunk(_Same_key, _Plaintext, 0));
+            EXPECT_EQ(_Cache.hits(), 1);
+            encrypted_file_reader _Other_key(_Encrypted._Get(), _Make_test_key(), _Meta, &_Cache);
+            EXPECT_FALSE(_Read_cached_chunk(_Other_key, _Plaintext, 0)); // never served the cached chunk
+            EXPECT_EQ(_Cache.hits(), 1);
+        }
+    } // namespace test
+} // namespace mjx
+
+#endif // _EFC_TEST_UNIT_CHUNK_CACHE_HPP_
\ No newline at end of file
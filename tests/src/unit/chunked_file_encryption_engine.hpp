@@ -0,0 +1,162 @@
+// chunked_file_encryption_engine.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_TEST_UNIT_CHUNKED_FILE_ENCRYPTION_ENGINE_HPP_
+#define _EFC_TEST_UNIT_CHUNKED_FILE_ENCRYPTION_ENGINE_HPP_
+#include <cstring>
+#include <efc/chunked_file_encryption_engine.hpp>
+#include <efc/work_stealing_scheduler.hpp>
+#include <gtest/gtest.h>
+#include <utils/chunked_file.hpp>
+
+namespace mjx {
+    namespace test {
+        inline iv _Make_iv(const char* const _Bytes) noexcept {
+            iv _Iv;
+            _Iv.assign(reinterpret_cast<const byte_t*>(_Bytes));
+            return _Iv;
+        }
+
+        inline void _Run_chunk_iv_test(
+            const iv& _Iv, const uint64_t _Index, const bool _Final, const char* const _Expected_iv) noexcept {
+            const iv& _Chunk_iv = make_chunk_iv(_Iv, _Index, _Final);
+            EXPECT_EQ(::memcmp(_Chunk_iv.data(), _Expected_iv, iv::size), 0);
+        }
+
+        TEST(chunked_file_encryption_engine, chunk_iv) {
+            const iv& _Iv = _Make_iv("\xA1\xB2\xC3\xD4\xE5\xF6\x07\x18\x29\x3A\x4B\x5C");
+            _Run_chunk_iv_test(_Iv, 0, false, "\xA1\xB2\xC3\xD4\xE5\xF6\x07\x18\x29\x3A\x4B\x5C");
+            _Run_chunk_iv_test(_Iv, 0, true, "\xA1\xB2\xC3\xD4\xE5\xF6\x07\x18\x29\x3A\x4B\x5D");
+            _Run_chunk_iv_test(_Iv, 1, false, "\xA1\xB2\xC3\xD4\xE5\xF6\x07\x18\x29\x3A\x4A\x5C");
+            _Run_chunk_iv_test(_Iv, 1, true, "\xA1\xB2\xC3\xD4\xE5\xF6\x07\x18\x29\x3A\x4A\x5D");
+            _Run_chunk_iv_test(_Iv, 0x0102, false, "\xA1\xB2\xC3\xD4\xE5\xF6\x07\x18\x29\x3B\x49\x5C");
+            _Run_chunk_iv_test(
+                _Iv, 0xFFFFFFFFFFFFFFFF, true, "\xA1\xB2\xC3\x2B\x1A\x09\xF8\xE7\xD6\xC5\xB4\x5D");
+        }
+
+        TEST(chunked_file_encryption_engine, chunk_size) {
+            EXPECT_FALSE(chunked_file_encryption_engine::is_valid_chunk_size(0));
+            EXPECT_FALSE(chunked_file_encryption_engine::is_valid_chunk_size(4095));
+            EXPECT_TRUE(chunked_file_encryption_engine::is_valid_chunk_size(4096));
+            EXPECT_TRUE(chunked_file_encryption_engine::is_valid_chunk_size(
+                chunked_file_encryption_engine::default_chunk_size));
+            EXPECT_TRUE(chunked_file_encryption_engine::is_valid_chunk_size(67108864));
+            EXPECT_FALSE(chunked_file_encryption_engine::is_valid_chunk_size(67108865));
+            EXPECT_TRUE(chunked_file_encryption_engine::is_valid_chunk_size(8192, file_feature::aligned));
+            EXPECT_FALSE(chunked_file_encryption_engine::is_valid_chunk_size(8193, file_feature::aligned));
+            EXPECT_TRUE(chunked_file_encryption_engine::is_valid_chunk_size(8193));
+        }
+
+        TEST(chunked_file_encryption_engine, metadata_size) {
+            EXPECT_EQ(metadata_size(construct_metadata(file_format::legacy)), 48);
+            EXPECT_EQ(metadata_size(construct_metadata(file_format::chunked)), 40);
+            EXPECT_EQ(metadata_size(construct_metadata(file_format::chunked, file_feature::aligned)), 4096);
+            EXPECT_EQ(metadata_size(construct_metadata(file_format::legacy, file_feature::aligned)), 48);
+            EXPECT_EQ(metadata_size(construct_metadata(file_format::chunked, file_feature::subkey)), 56);
+            EXPECT_EQ(metadata_size(
+                construct_metadata(file_format::chunked, file_feature::aligned | file_feature::subkey)), 4096);
+            EXPECT_EQ(metadata_size(construct_metadata(file_format::chunked, file_feature::kdf_params)), 56);
+            EXPECT_EQ(metadata_size(
+                construct_metadata(file_format::chunked, file_feature::subkey | file_feature::kdf_params)), 72);
+            EXPECT_EQ(metadata_size(construct_metadata(file_format::chunked, file_feature::key_check)), 72);
+            EXPECT_EQ(metadata_size(
+                construct_metadata(file_format::chunked, file_feature::kdf_params | file_feature::key_check)), 88);
+        }
+
+        inline void _Run_chunked_round_trip_test(const size_t _Size) {
+            const byte_string& _Plaintext = _Random_data(_Size);
+            const key& _Key               = _Make_test_key();
+            const file_metadata& _Meta    = _Make_chunked_metadata();
+            _Test_file _Encrypted;
+            ASSERT_TRUE(_Encrypt_chunked(_Plaintext, _Key, _Meta, _Encrypted));
+            const uint64_t _Chunks = _Size == 0 ? 1 : (_Size + _Test_chunk_size - 1) / _Test_chunk_size;
+            EXPECT_EQ(_Encrypted._Get().size(), metadata_size(_Meta) + _Size + _Chunks * authentication_tag::size);
+            byte_string _Decrypted;
+            ASSERT_TRUE(_Decrypt_chunked(_Encrypted, _Key, _Meta, _Decrypted));
+            EXPECT_EQ(_Decrypted, _Plaintext);
+        }
+
+        TEST(chunked_file_encryption_engine, round_trip) {
+            _Run_chunked_round_trip_test(0);
+            _Run_chunked_round_trip_test(1);
+            _Run_chunked_round_trip_test(_Test_chunk_size);
+            _Run_chunked_round_trip_test(_Test_chunk_size + 1);
+            _Run_chunked_round_trip_test(5 * _Test_chunk_size + 100);
+        }
+
+        TEST(chunked_file_encryption_engine, modified_file) {
+            const byte_string& _Plaintext = _Random_data(3 * _Test_chunk_size + 100);
+            const key& _Key               = _Make_test_key();
+            const file_metadata& _Meta    = _Make_chunked_metadata();
+            const size_t _Header_size     = metadata_size(_Meta);
+            const size_t _Stored_size     = _Test_chunk_size + authentication_tag::size;
+            _Test_file _Encrypted;
+            byte_string _Original;
+            byte_string _Decrypted;
+            ASSERT_TRUE(_Encrypt_chunked(_Plaintext, _Key, _Meta, _Encrypted));
+            ASSERT_TRUE(_Encrypted._Load(_Original));
+
+            // a flipped byte of the ciphertext
+            byte_string _Modified = _Original;
+            _Modified[_Header_size + _Stored_size + 10] ^= 0x01;
+            ASSERT_TRUE(_Encrypted._Store(_Modified));
+            EXPECT_FALSE(_Decrypt_chunked(_Encrypted, _Key, _Meta, _Decrypted));
+
+            // the final chunk removed, the previous one is not marked as the final one
+            _Modified = _Original;
+            _Modified.resize(_Header_size + 3 * _Stored_size);
+            ASSERT_TRUE(_Encrypted._Store(_Modified));
+            EXPECT_FALSE(_Decrypt_chunked(_Encrypted, _Key, _Meta, _Decrypted));
+
+            // the first two chunks swapped
+            _Modified = _Original;
+            for (size_t _Idx = 0; _Idx < _Stored_size; ++_Idx) {
+                const byte_t _First                           = _Modified[_Header_size + _Idx];
+                _Modified[_Header_size + _Idx]                = _Modified[_Header_size + _Stored_size + _Idx];
+                _Modified[_Header_size + _Stored_size + _Idx] = _First;
+            }
+
+            ASSERT_TRUE(_Encrypted._Store(_Modified));
+            EXPECT_FALSE(_Decrypt_chunked(_Encrypted, _Key, _Meta, _Decrypted));
+
+            // the original file still decrypts
+            ASSERT_TRUE(_Encrypted._Store(_Original));
+            ASSERT_TRUE(_Decrypt_chunked(_Encrypted, _Key, _Meta, _Decrypted));
+            EXPECT_EQ(_Decrypted, _Plaintext);
+        }
+
+        TEST(chunked_file_encryption_engine, scheduled) {
+            // the chunks are shared with the workers of the scheduler, the job waits for all of them
+            work_stealing_scheduler _Scheduler(4);
+            ASSERT_TRUE(_Scheduler.is_running());
+            const key& _Key            = _Make_test_key();
+            const file_metadata& _Meta = _Make_chunked_metadata();
+            for (const size_t _Size : {size_t{0}, size_t{1}, 7 * size_t{_Test_chunk_size} + 100}) {
+                for (int _Repeat = 0; _Repeat < 8; ++_Repeat) {
+                    const byte_string& _Plaintext = _Random_data(_Size);
+                    _Test_file _Src;
+                    _Test_file _Encrypted;
+                    _Test_file _Dest;
+                    ASSERT_TRUE(_Src._Store(_Plaintext));
+                    ASSERT_TRUE(_Encrypted._Open().is_open());
+                    chunked_file_encryption_engine _Encryptor(_Src._Get(), _Encrypted._Get(), _Scheduler);
+                    ASSERT_TRUE(_Encryptor.encrypt(_Key, _Meta));
+                    byte_string _Decrypted;
+                    ASSERT_TRUE(_Decrypt_chunked(_Encrypted, _Key, _Meta, _Decrypted));
+                    EXPECT_EQ(_Decrypted, _Plaintext);
+                    ASSERT_TRUE(_Encrypted._Open().is_open());
+                    ASSERT_TRUE(_Dest._Open().is_open());
+                    chunked_file_encryption_engine _Decryptor(_Encrypted._Get(), _Dest._Get(), _Scheduler);
+                    ASSERT_TRUE(_Decryptor.decrypt(_Key, _Meta));
+                    ASSERT_TRUE(_Dest._Load(_Decrypted));
+                    EXPECT_EQ(_Decrypted, _Plaintext);
+                }
+            }
+        }
+    } // namespace test
+} // namespace mjx
+
+#endif // _EFC_TEST_UNIT_CHUNKED_FILE_ENCRYPTION_ENGINE_HPP_
\ No newline at end of file
@@ -0,0 +1,92 @@
+// encrypted_file_reader.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_TEST_UNIT_ENCRYPTED_FILE_READER_HPP_
+#define _EFC_TEST_UNIT_ENCRYPTED_FILE_READER_HPP_
+#include <cstring>
+#include <efc/encrypted_file_reader.hpp>
+#include <gtest/gtest.h>
+#include <utils/chunked_file.hpp>
+
+namespace mjx {
+    namespace test {
+        constexpr size_t _Reader_test_size = 3 * _Test_chunk_size + 100; // the last chunk is partial
+
+        // checks that the specified range reads the same bytes as the plaintext
+        inline bool _Read_range(encrypted_file_reader& _Reader, const byte_string& _Plaintext,
+            const uint64_t _Off, const size_t _Count) {
+            byte_string _Buf(_Count, '\0');
+            if (!_Reader.read_at(_Off, _Buf.data(), _Count)) {
+                return false;
+            }
+
+            EXPECT_EQ(::memcmp(_Buf.c_str(), _Plaintext.c_str() + _Off, _Count), 0);
+            return true;
+        }
+
+        TEST(encrypted_file_reader, read_ranges) {
+            const byte_string& _Plaintext = _Random_data(_Reader_test_size);
+            const key& _Key               = _Make_test_key();
+            const file_metadata& _Meta    = _Make_chunked_metadata();
+            _Test_file _Encrypted;
+            ASSERT_TRUE(_Encrypt_chunked(_Plaintext, _Key, _Meta, _Encrypted));
+            encrypted_file_reader _Reader(_Encrypted._Get(), _Key, _Meta);
+            ASSERT_TRUE(_Reader.is_open());
+            EXPECT_EQ(_Reader.size(), _Reader_test_size);
+            EXPECT_TRUE(_Read_range(_Reader, _Plaintext, 0, _Reader_test_size)); // the whole file
+            EXPECT_TRUE(_Read_range(_Reader, _Plaintext, _Test_chunk_size - 50, 100)); // across a chunk boundary
+            EXPECT_TRUE(_Read_range(_Reader, _Plaintext, 10, 2 * _Test_chunk_size)); // across two boundaries
+            EXPECT_TRUE(_Read_range(_Reader, _Plaintext, 3 * _Test_chunk_size + 10, 50)); // inside the last chunk
+            EXPECT_TRUE(_Read_range(_Reader, _Plaintext, 3 * _Test_chunk_size + 10, 90)); // up to the end
+            EXPECT_TRUE(_Read_range(_Reader, _Plaintext, _Reader_test_size, 0));
+        }
+
+        TEST(encrypted_file_reader, read_past_end) {
+            const key& _Key            = _Make_test_key();
+            const file_metadata& _Meta = _Make_chunked_metadata();
+            _Test_file _Encrypted;
+            ASSERT_TRUE(_Encrypt_chunked(_Random_data(_Reader_test_size), _Key, _Meta, _Encrypted));
+            encrypted_file_reader _Reader(_Encrypted._Get(), _Key, _Meta);
+            ASSERT_TRUE(_Reader.is_open());
+            byte_t _Buf[16];
+            EXPECT_FALSE(_Reader.read_at(_Reader_test_size - 10, _Buf, 11));
+            EXPECT_FALSE(_Reader.read_at(_Reader_test_size, _Buf, 1));
+            EXPECT_FALSE(_Reader.read_at(_Reader_test_size + 1, _Buf, 0));
+            EXPECT_FALSE(_Reader.read_at(static_cast<uint64_t>(-1), _Buf, 16));
+        }
+
+        TEST(encrypted_file_reader, modified_chunk) {
+            const byte_string& _Plaintext = _Random_data(_Reader_test_size);
+            const key& _Key               = _Make_test_key();
+            const file_metadata& _Meta    = _Make_chunked_metadata();
+            _Test_file _Encrypted;
+            byte_string _Modified;
+            ASSERT_TRUE(_Encrypt_chunked(_Plaintext, _Key, _Meta, _Encrypted));
+            ASSERT_TRUE(_Encrypted._Load(_Modified));
+            _Modified[metadata_size(_Meta) + _Test_chunk_size + authentication_tag::size + 10] ^= 0x01; // chunk 1
+            ASSERT_TRUE(_Encrypted._Store(_Modified));
+            encrypted_file_reader _Reader(_Encrypted._Get(), _Key, _Meta);
+            ASSERT_TRUE(_Reader.is_open());
+            byte_t _Buf[16];
+            EXPECT_FALSE(_Reader.read_at(_Test_chunk_size + 100, _Buf, 16));
+            EXPECT_FALSE(_Reader.read_at(_Test_chunk_size - 8, _Buf, 16)); // partly in the modified chunk
+            EXPECT_TRUE(_Read_range(_Reader, _Plaintext, 0, _Test_chunk_size));
+            EXPECT_TRUE(_Read_range(_Reader, _Plaintext, 2 * _Test_chunk_size, _Test_chunk_size + 100));
+        }
+
+        TEST(encrypted_file_reader, wrong_key) {
+            const byte_string& _Plaintext = _Random_data(_Reader_test_size);
+            const file_metadata& _Meta    = _Make_chunked_metadata();
+            _Test_file _Encrypted;
+            ASSERT_TRUE(_Encrypt_chunked(_Plaintext, _Make_test_key(), _Meta, _Encrypted));
+            encrypted_file_reader _Reader(_Encrypted._Get(), _Make_test_key(), _Meta);
+            byte_t _Buf[16];
+            EXPECT_FALSE(_Reader.read_at(0, _Buf, 16)); // no chunk can be verified
+        }
+    } // namespace test
+} // namespace mjx
+
+#endif // _EFC_TEST_UNIT_ENCRYPTED_FILE_READER_HPP_
\ No newline at end of file
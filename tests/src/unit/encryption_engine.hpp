@@ -6,9 +6,12 @@
 #pragma once
 #ifndef _EFC_TEST_UNIT_ENCRYPTION_ENGINE_HPP_
 #define _EFC_TEST_UNIT_ENCRYPTION_ENGINE_HPP_
+#include <cstring>
 #include <efc/encryption_engine.hpp>
+#include <efc/encryption_engine_pool.hpp>
 #include <efc/impl/random.hpp>
 #include <gtest/gtest.h>
+#include <memory>
 #include <mjstr/string.hpp>
 #include <mjstr/string_view.hpp>
 
@@ -40,6 +43,15 @@ namespace mjx {
             return true;
         }
 
+        inline byte_string _Seal_text(encryption_engine& _Engine, const key& _Key, const iv& _Iv,
+            const utf8_string_view _Text, authentication_tag& _Tag) {
+            byte_string _Buf(_Text.size(), '\0');
+            EXPECT_TRUE(_Engine.setup_encryption(_Key, _Iv));
+            EXPECT_TRUE(_Engine.encrypt(reinterpret_cast<const byte_t*>(_Text.data()), _Text.size(), _Buf.data()));
+            EXPECT_TRUE(_Engine.complete(_Tag));
+            return _Buf;
+        }
+
         TEST(encryption_engine, empty_text) {
             _Run_encryption_engine_test("");
             _Run_encryption_engine_test("");
@@ -130,6 +142,171 @@ namespace mjx {
                 "and bustle of everyday life."
             );
         }
+
+        TEST(encryption_engine, reused_key) {
+            // a reused engine must produce the same output as a new one, whether the key changes or not
+            const utf8_string_view _Text = "The quick brown fox jumps over the lazy dog.";
+            const key& _Key1             = _Generate_key();
+            const key& _Key2             = _Generate_key();
+            const iv& _Iv1               = generate_iv();
+            const iv& _Iv2               = generate_iv();
+            encryption_engine _Engine;
+            const key* const _Keys[] = {&_Key1, &_Key1, &_Key2, &_Key2, &_Key1};
+            const iv* const _Ivs[]   = {&_Iv1, &_Iv2, &_Iv2, &_Iv1, &_Iv1};
+            for (size_t _Idx = 0; _Idx < 5; ++_Idx) {
+                encryption_engine _New_engine;
+                authentication_tag _Tag;
+                authentication_tag _Expected_tag;
+                EXPECT_EQ(_Seal_text(_Engine, *_Keys[_Idx], *_Ivs[_Idx], _Text, _Tag),
+                    _Seal_text(_New_engine, *_Keys[_Idx], *_Ivs[_Idx], _Text, _Expected_tag));
+                EXPECT_EQ(::memcmp(_Tag.data(), _Expected_tag.data(), authentication_tag::size), 0);
+            }
+        }
+
+        TEST(encryption_engine, reused_after_failure) {
+            // the engine must be usable again after a tag mismatch or an abandoned operation
+            const utf8_string_view _Text = "Pack my box with five dozen liquor jugs.";
+            const key& _Key              = _Generate_key();
+            const iv& _Iv                = generate_iv();
+            encryption_engine _Engine;
+            authentication_tag _Tag;
+            const byte_string& _Enc_buf = _Seal_text(_Engine, _Key, _Iv, _Text, _Tag);
+            authentication_tag _Bad_tag = _Tag;
+            _Bad_tag.data()[0] ^= 0x01;
+            utf8_string _Dec_buf(_Text.size(), '\0');
+            EXPECT_TRUE(_Engine.setup_decryption(_Key, _Iv));
+            EXPECT_TRUE(_Engine.decrypt(
+                _Enc_buf.c_str(), _Enc_buf.size(), reinterpret_cast<byte_t*>(_Dec_buf.data())));
+            EXPECT_FALSE(_Engine.complete(_Bad_tag));
+            EXPECT_TRUE(_Engine.setup_encryption(_Key, _Iv));
+            _Engine.cancel();
+            EXPECT_TRUE(_Engine.setup_decryption(_Key, _Iv));
+            EXPECT_TRUE(_Engine.decrypt(
+                _Enc_buf.c_str(), _Enc_buf.size(), reinterpret_cast<byte_t*>(_Dec_buf.data())));
+            EXPECT_TRUE(_Engine.complete(_Tag));
+            EXPECT_EQ(_Dec_buf, _Text);
+        }
+
+        TEST(encryption_engine, cleared_key) {
+            // the engine must set the key again after it has been wiped, also in the middle of an operation
+            const utf8_string_view _Text = "Sphinx of black quartz, judge my vow.";
+            const key& _Key              = _Generate_key();
+            const iv& _Iv                = generate_iv();
+            encryption_engine _Engine;
+            encryption_engine _New_engine;
+            authentication_tag _Tag;
+            authentication_tag _Expected_tag;
+            const byte_string& _Expected = _Seal_text(_New_engine, _Key, _Iv, _Text, _Expected_tag);
+            _Seal_text(_Engine, _Key, _Iv, _Text, _Tag);
+            _Engine.clear_key();
+            EXPECT_EQ(_Seal_text(_Engine, _Key, _Iv, _Text, _Tag), _Expected);
+            EXPECT_EQ(::memcmp(_Tag.data(), _Expected_tag.data(), authentication_tag::size), 0);
+            EXPECT_TRUE(_Engine.setup_encryption(_Key, _Iv));
+            _Engine.clear_key();
+            byte_string _Buf(_Text.size(), '\0');
+            EXPECT_FALSE(_Engine.encrypt(reinterpret_cast<const byte_t*>(_Text.data()), _Text.size(),
+                _Buf.data())); // no longer initialized
+            EXPECT_EQ(_Seal_text(_Engine, _Key, _Iv, _Text, _Tag), _Expected);
+            EXPECT_EQ(::memcmp(_Tag.data(), _Expected_tag.data(), authentication_tag::size), 0);
+        }
+
+        inline void _Fill_batch(batch_record* const _Records, const size_t _Count, const size_t _Key_count,
+            const size_t _Size, byte_string& _Input, byte_string& _Output) {
+            _Input.assign(_Count * _Size, '\0');
+            _Output.assign(_Count * _Size, '\0');
+            EXPECT_TRUE(efc_impl::_Random_bytes(_Input.data(), _Input.size()));
+            for (size_t _Idx = 0; _Idx < _Count; ++_Idx) { // the keys are interleaved on purpose
+                _Records[_Idx].key_id = (_Idx * 7) % _Key_count;
+                _Records[_Idx].iv     = generate_iv();
+                _Records[_Idx].input  = _Input.c_str() + _Idx * _Size;
+                _Records[_Idx].size   = _Size;
+                _Records[_Idx].output = _Output.data() + _Idx * _Size;
+            }
+        }
+
+        inline void _Run_batch_test(const size_t _Count, const size_t _Size, const size_t _Threads) {
+            const key _Keys[] = {_Generate_key(), _Generate_key(), _Generate_key()};
+            ::std::unique_ptr<batch_record[]> _Records(new batch_record[_Count]);
+            byte_string _Input;
+            byte_string _Output;
+            _Fill_batch(_Records.get(), _Count, 3, _Size, _Input, _Output);
+            encryption_engine _Engine;
+            ASSERT_TRUE(_Engine.seal_batch(_Keys, 3, _Records.get(), _Count, _Threads));
+            for (size_t _Idx = 0; _Idx < _Count; ++_Idx) { // every record must be sealed as if it was on its own
+                const batch_record& _Record = _Records[_Idx];
+                encryption_engine _Single_engine;
+                authentication_tag _Tag;
+                byte_string _Expected(_Size, '\0');
+                EXPECT_FALSE(_Record.failed);
+                EXPECT_TRUE(_Single_engine.setup_encryption(_Keys[_Record.key_id], _Record.iv));
+                EXPECT_TRUE(_Single_engine.encrypt(_Record.input, _Size, _Expected.data()));
+                EXPECT_TRUE(_Single_engine.complete(_Tag));
+                EXPECT_EQ(::memcmp(_Record.output, _Expected.c_str(), _Size), 0);
+                EXPECT_EQ(::memcmp(_Record.tag.data(), _Tag.data(), authentication_tag::size), 0);
+            }
+
+            byte_string _Decrypted(_Count * _Size, '\0');
+            for (size_t _Idx = 0; _Idx < _Count; ++_Idx) {
+                _Records[_Idx].input  = _Records[_Idx].output;
+                _Records[_Idx].output = _Decrypted.data() + _Idx * _Size;
+            }
+
+            _Records[1].tag.data()[0] ^= 0x01; // only this record must fail
+            EXPECT_FALSE(_Engine.open_batch(_Keys, 3, _Records.get(), _Count, _Threads));
+            for (size_t _Idx = 0; _Idx < _Count; ++_Idx) {
+                const bool _Tampered = _Idx == 1;
+                EXPECT_EQ(_Records[_Idx].failed, _Tampered);
+                if (!_Tampered) {
+                    EXPECT_EQ(::memcmp(_Records[_Idx].output, _Input.c_str() + _Idx * _Size, _Size), 0);
+                } else { // the unverified plaintext must be wiped
+                    EXPECT_EQ(_Records[_Idx].output[0], 0);
+                }
+            }
+        }
+
+        TEST(encryption_engine, small_batch) {
+            _Run_batch_test(64, 100, 1);
+        }
+
+        TEST(encryption_engine, parallel_batch) {
+            _Run_batch_test(1024, 1024, 4); // large enough to be split among the threads
+        }
+
+        TEST(encryption_engine, batch_with_invalid_key) {
+            const key _Key = _Generate_key();
+            batch_record _Records[2];
+            byte_string _Input;
+            byte_string _Output;
+            _Fill_batch(_Records, 2, 1, 32, _Input, _Output);
+            _Records[1].key_id = 1; // there is only one key
+            encryption_engine _Engine;
+            EXPECT_FALSE(_Engine.seal_batch(&_Key, 1, _Records, 2));
+            EXPECT_FALSE(_Records[0].failed);
+            EXPECT_TRUE(_Records[1].failed);
+        }
+
+        TEST(encryption_engine_pool, acquire_and_release) {
+            encryption_engine_pool _Pool(1);
+            const key& _Key = _Generate_key();
+            const iv& _Iv   = generate_iv();
+            {
+                pooled_encryption_engine _First  = _Pool.acquire();
+                pooled_encryption_engine _Second = _Pool.acquire();
+                ASSERT_TRUE(_First.valid());
+                ASSERT_TRUE(_Second.valid());
+                EXPECT_NE(&_First.get(), &_Second.get());
+                EXPECT_TRUE(_First->setup_encryption(_Key, _Iv)); // released in the middle of the encryption
+            }
+
+            EXPECT_EQ(_Pool.idle_count(), 1); // the other engine has been destroyed
+            pooled_encryption_engine _Engine = _Pool.acquire();
+            EXPECT_EQ(_Pool.idle_count(), 0);
+            authentication_tag _Tag;
+            _Seal_text(_Engine.get(), _Key, _Iv, "Jackdaws love my big sphinx of quartz.", _Tag);
+            _Engine.release();
+            EXPECT_FALSE(_Engine.valid());
+            EXPECT_EQ(_Pool.idle_count(), 1);
+        }
     } // namespace test
 } // namespace mjx
 
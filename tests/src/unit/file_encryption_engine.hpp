@@ -0,0 +1,122 @@
+// file_encryption_engine.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_TEST_UNIT_FILE_ENCRYPTION_ENGINE_HPP_
+#define _EFC_TEST_UNIT_FILE_ENCRYPTION_ENGINE_HPP_
+#include <cstring>
+#include <efc/encryption_engine.hpp>
+#include <efc/file_encryption_engine.hpp>
+#include <efc/impl/random.hpp>
+#include <gtest/gtest.h>
+#include <utils/test_file.hpp>
+
+namespace mjx {
+    namespace test {
+        struct _File_engine_result {
+            byte_string _Ciphertext;
+            authentication_tag _Tag;
+        };
+
+        struct _File_engine_setup {
+            file_encryption_options _Options;
+            file_flag _Flags         = file_flag::none; // the flags of all the files
+            file_access _Dest_access = file_access::read | file_access::write; // the access to the ciphertext
+        };
+
+        // encrypts _Plaintext with _Setup, then checks that the same setup decrypts it back
+        inline bool _Run_file_engine(const byte_string& _Plaintext, const key& _Key, const iv& _Iv,
+            const _File_engine_setup& _Setup, _File_engine_result& _Result) {
+            constexpr file_access _Access = file_access::read | file_access::write;
+            _Test_file _Src;
+            _Test_file _Dest;
+            _Test_file _Decrypted;
+            if (!_Src._Store(_Plaintext) || !_Src._Open(_Access, _Setup._Flags).is_open()
+                || !_Dest._Open(_Setup._Dest_access, _Setup._Flags).is_open()) {
+                return false;
+            }
+
+            encryption_engine _Engine;
+            {
+                file_encryption_engine _FEng(_Src._Get(), _Dest._Get(), _Engine, _Setup._Options);
+                if (!_FEng.encrypt(_Key, _Iv, _Result._Tag) || !_Dest._Load(_Result._Ciphertext)) {
+                    return false;
+                }
+            }
+
+            if (!_Dest._Open(_Access, _Setup._Flags).is_open() || !_Decrypted._Open(_Access, _Setup._Flags).is_open()) {
+                return false;
+            }
+
+            authentication_tag _Tag = _Result._Tag;
+            byte_string _Decrypted_data;
+            file_encryption_engine _FEng(_Dest._Get(), _Decrypted._Get(), _Engine, _Setup._Options);
+            if (!_FEng.decrypt(_Key, _Iv, _Tag) || !_Decrypted._Load(_Decrypted_data)) {
+                return false;
+            }
+
+            EXPECT_EQ(_Decrypted_data, _Plaintext);
+            return true;
+        }
+
+        // checks that _Setup produces the same ciphertext and tag as the stream mode
+        inline void _Run_file_engine_test(const _File_engine_setup& _Setup) {
+            key _Key;
+            ASSERT_TRUE(efc_impl::_Random_bytes(_Key.data(), key::size));
+            const iv& _Iv         = generate_iv();
+            const size_t _Sizes[] = {0, 3 * file_encryption_options::min_chunk_size + 123};
+            for (const size_t _Size : _Sizes) {
+                const byte_string& _Plaintext = _Random_data(_Size);
+                file_encryption_options _Stream_options;
+                _Stream_options.chunk_size = file_encryption_options::min_chunk_size;
+                _File_engine_result _Expected;
+                _File_engine_result _Result;
+                ASSERT_TRUE(_Run_file_engine(_Plaintext, _Key, _Iv, _File_engine_setup{_Stream_options}, _Expected));
+                ASSERT_TRUE(_Run_file_engine(_Plaintext, _Key, _Iv, _Setup, _Result));
+                EXPECT_EQ(_Result._Ciphertext, _Expected._Ciphertext);
+                EXPECT_EQ(::memcmp(_Result._Tag.data(), _Expected._Tag.data(), authentication_tag::size), 0);
+            }
+        }
+
+        inline _File_engine_setup _Make_file_engine_setup(const file_io_mode _Mode, const size_t _Depth,
+            const bool _Pipelined, const file_flag _Flags = file_flag::none) noexcept {
+            _File_engine_setup _Setup;
+            _Setup._Options.chunk_size     = file_encryption_options::min_chunk_size;
+            _Setup._Options.io_mode        = _Mode;
+            _Setup._Options.pipeline_depth = _Depth;
+            _Setup._Options.pipelined      = _Pipelined;
+            _Setup._Flags                  = _Flags;
+            return _Setup;
+        }
+
+        TEST(file_encryption_engine, pipelined) {
+            _Run_file_engine_test(_Make_file_engine_setup(file_io_mode::stream, 1, true));
+            _Run_file_engine_test(_Make_file_engine_setup(file_io_mode::stream, 4, true));
+        }
+
+        TEST(file_encryption_engine, overlapped) {
+            _Run_file_engine_test(_Make_file_engine_setup(file_io_mode::overlapped, 1, false, file_flag::overlapped));
+            _Run_file_engine_test(_Make_file_engine_setup(file_io_mode::overlapped, 4, false, file_flag::overlapped));
+        }
+
+        TEST(file_encryption_engine, overlapped_synchronous) {
+            // the files are opened without file_flag::overlapped, every request completes before the next one
+            _Run_file_engine_test(_Make_file_engine_setup(file_io_mode::overlapped, 4, false));
+        }
+
+        TEST(file_encryption_engine, mapped) {
+            _Run_file_engine_test(_Make_file_engine_setup(file_io_mode::mapped, 4, false));
+        }
+
+        TEST(file_encryption_engine, mapped_fallback) {
+            // a writable view requires read access, so the destination falls back to the streams
+            _File_engine_setup _Setup = _Make_file_engine_setup(file_io_mode::mapped, 4, false);
+            _Setup._Dest_access       = file_access::write;
+            _Run_file_engine_test(_Setup);
+        }
+    } // namespace test
+} // namespace mjx
+
+#endif // _EFC_TEST_UNIT_FILE_ENCRYPTION_ENGINE_HPP_
\ No newline at end of file
@@ -0,0 +1,192 @@
+// file_metadata.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_TEST_UNIT_FILE_METADATA_HPP_
+#define _EFC_TEST_UNIT_FILE_METADATA_HPP_
+#include <cstring>
+#include <efc/file_encryption_engine.hpp>
+#include <efc/impl/random.hpp>
+#include <gtest/gtest.h>
+#include <mjfs/file_stream.hpp>
+#include <utils/test_file.hpp>
+
+namespace mjx {
+    namespace test {
+        constexpr byte_t _Metadata_end_marker = 0xA5; // follows the metadata, must not be consumed by it
+
+        // returns the bytes written by store_metadata()
+        inline byte_string _Store_test_metadata(const file_metadata& _Meta) {
+            _Test_file _File;
+            byte_string _Data;
+            file_stream _Stream(_File._Open());
+            EXPECT_TRUE(store_metadata(_Stream, _Meta));
+            EXPECT_TRUE(_Stream.flush());
+            EXPECT_TRUE(_File._Load(_Data));
+            return _Data;
+        }
+
+        // loads the metadata from _Data followed by the end marker, checks that the marker is left unread
+        inline file_metadata _Load_test_metadata(const byte_string& _Data) {
+            _Test_file _File;
+            byte_string _Stored = _Data;
+            _Stored.append(1, _Metadata_end_marker);
+            EXPECT_TRUE(_File._Store(_Stored));
+            file_stream _Stream(_File._Open());
+            const file_metadata& _Meta = load_metadata(_Stream);
+            if (_Meta.signature.is_recognized()) {
+                byte_t _Next = 0;
+                EXPECT_EQ(_Stream.read(&_Next, 1), 1);
+                EXPECT_EQ(_Next, _Metadata_end_marker);
+            }
+
+            return _Meta;
+        }
+
+        inline void _Set_metadata_integer(byte_string& _Data, const size_t _Off, const uint32_t _Value) {
+            for (size_t _Idx = 0; _Idx < sizeof(uint32_t); ++_Idx) { // integers are stored in little-endian order
+                _Data[_Off + _Idx] = static_cast<byte_t>(_Value >> (_Idx * 8));
+            }
+        }
+
+        inline void _Expect_same_bytes(const byte_t* const _Left, const byte_t* const _Right, const size_t _Size) {
+            EXPECT_EQ(::memcmp(_Left, _Right, _Size), 0);
+        }
+
+        inline void _Expect_same_metadata(const file_metadata& _Left, const file_metadata& _Right) {
+            ASSERT_TRUE(_Left.signature.is_recognized());
+            _Expect_same_bytes(_Left.signature.data, _Right.signature.data, file_signature::size);
+            _Expect_same_bytes(_Left.salt.data(), _Right.salt.data(), salt::size);
+            _Expect_same_bytes(_Left.iv.data(), _Right.iv.data(), iv::size);
+            if (_Left.signature.format() == file_format::legacy) {
+                _Expect_same_bytes(_Left.tag.data(), _Right.tag.data(), authentication_tag::size);
+                return;
+            }
+
+            EXPECT_EQ(_Left.features, _Right.features);
+            EXPECT_EQ(_Left.chunk_size, _Right.chunk_size);
+            if ((_Left.features & file_feature::subkey) != 0) {
+                _Expect_same_bytes(_Left.key_nonce.data(), _Right.key_nonce.data(), key_nonce::size);
+            }
+
+            if ((_Left.features & file_feature::kdf_params) != 0) {
+                EXPECT_EQ(_Left.kdf, _Right.kdf);
+                EXPECT_EQ(_Left.kdf_params.memory, _Right.kdf_params.memory);
+                EXPECT_EQ(_Left.kdf_params.iterations, _Right.kdf_params.iterations);
+                EXPECT_EQ(_Left.kdf_params.lanes, _Right.kdf_params.lanes);
+            }
+
+            if ((_Left.features & file_feature::key_check) != 0) {
+                _Expect_same_bytes(_Left.key_check.data(), _Right.key_check.data(), key_check::size);
+            }
+        }
+
+        inline file_metadata _Make_test_metadata(const file_format _Format, const uint32_t _Features) {
+            file_metadata _Meta = construct_metadata(_Format, _Features);
+            EXPECT_TRUE(efc_impl::_Random_bytes(_Meta.tag.data(), authentication_tag::size));
+            EXPECT_TRUE(efc_impl::_Random_bytes(_Meta.key_check.data(), key_check::size));
+            return _Meta;
+        }
+
+        TEST(file_metadata, legacy) {
+            const file_metadata& _Meta = _Make_test_metadata(file_format::legacy, 0);
+            const byte_string& _Data   = _Store_test_metadata(_Meta);
+            EXPECT_EQ(_Data.size(), 48);
+            _Expect_same_metadata(_Load_test_metadata(_Data), _Meta);
+        }
+
+        TEST(file_metadata, chunked_features) {
+            constexpr uint32_t _All_features =
+                file_feature::aligned | file_feature::subkey | file_feature::kdf_params | file_feature::key_check;
+            for (uint32_t _Features = 0; _Features <= _All_features; ++_Features) {
+                const file_metadata& _Meta = _Make_test_metadata(file_format::chunked, _Features);
+                const byte_string& _Data   = _Store_test_metadata(_Meta);
+                EXPECT_EQ(_Data.size(), metadata_size(_Meta));
+                _Expect_same_metadata(_Load_test_metadata(_Data), _Meta);
+            }
+        }
+
+        TEST(file_metadata, no_kdf) {
+            file_metadata _Meta = _Make_test_metadata(file_format::chunked, file_feature::kdf_params);
+            _Meta.kdf           = key_derivation_function::none;
+            _Meta.kdf_params    = key_derivation_params{0, 0, 0};
+
+            const byte_string& _Data = _Store_test_metadata(_Meta);
+            for (size_t _Off = 40; _Off < 56; ++_Off) { // the identifier and the parameters are zeros
+                EXPECT_EQ(_Data[_Off], 0);
+            }
+
+            _Expect_same_metadata(_Load_test_metadata(_Data), _Meta);
+        }
+
+        TEST(file_metadata, aligned_padding) {
+            const file_metadata& _Meta = _Make_test_metadata(
+                file_format::chunked, file_feature::aligned | file_feature::kdf_params | file_feature::key_check);
+            const byte_string& _Data = _Store_test_metadata(_Meta);
+            ASSERT_EQ(_Data.size(), 4096);
+            for (size_t _Off = 88; _Off < _Data.size(); ++_Off) { // the packed header takes 88 bytes
+                EXPECT_EQ(_Data[_Off], 0);
+            }
+        }
+
+        TEST(file_metadata, malformed) {
+            // the offsets of the fields of a chunked header with file_feature::kdf_params
+            constexpr size_t _Format_off     = 3; // the last byte of the signature
+            constexpr size_t _Features_off   = 4;
+            constexpr size_t _Chunk_size_off = 8;
+            constexpr size_t _Kdf_off        = 40;
+            constexpr size_t _Memory_off     = 44;
+            constexpr size_t _Lanes_off      = 52;
+            const file_metadata& _Meta       = _Make_test_metadata(file_format::chunked, file_feature::kdf_params);
+            const byte_string& _Data         = _Store_test_metadata(_Meta);
+            byte_string _Malformed;
+
+            // unknown format
+            _Malformed              = _Data;
+            _Malformed[_Format_off] = 2;
+            EXPECT_FALSE(_Load_test_metadata(_Malformed).signature.is_recognized());
+
+            // unsupported feature
+            _Malformed = _Data;
+            _Set_metadata_integer(_Malformed, _Features_off, file_feature::kdf_params | 0x0000'0010);
+            EXPECT_FALSE(_Load_test_metadata(_Malformed).signature.is_recognized());
+
+            // invalid chunk size
+            _Malformed = _Data;
+            _Set_metadata_integer(_Malformed, _Chunk_size_off, 1000);
+            EXPECT_FALSE(_Load_test_metadata(_Malformed).signature.is_recognized());
+
+            // unknown key derivation function
+            _Malformed = _Data;
+            _Set_metadata_integer(_Malformed, _Kdf_off, 2);
+            EXPECT_FALSE(_Load_test_metadata(_Malformed).signature.is_recognized());
+
+            // invalid parameters of the key derivation
+            _Malformed = _Data;
+            _Set_metadata_integer(_Malformed, _Lanes_off, 0);
+            EXPECT_FALSE(_Load_test_metadata(_Malformed).signature.is_recognized());
+
+            // no key derivation, but non-zero parameters
+            _Malformed = _Data;
+            _Set_metadata_integer(_Malformed, _Kdf_off, 0);
+            EXPECT_FALSE(_Load_test_metadata(_Malformed).signature.is_recognized());
+            _Set_metadata_integer(_Malformed, _Memory_off, 0);
+            EXPECT_FALSE(_Load_test_metadata(_Malformed).signature.is_recognized()); // the rest is not zero
+
+            // truncated headers
+            for (const uint32_t _Features : {0u, file_feature::subkey | file_feature::kdf_params
+                | file_feature::key_check, file_feature::aligned}) {
+                const byte_string& _Full = _Store_test_metadata(_Make_test_metadata(file_format::chunked, _Features));
+                const byte_string _Truncated(_Full.c_str(), _Full.size() - 1);
+                _Test_file _File;
+                ASSERT_TRUE(_File._Store(_Truncated));
+                file_stream _Stream(_File._Open());
+                EXPECT_FALSE(load_metadata(_Stream).signature.is_recognized());
+            }
+        }
+    } // namespace test
+} // namespace mjx
+
+#endif // _EFC_TEST_UNIT_FILE_METADATA_HPP_
\ No newline at end of file
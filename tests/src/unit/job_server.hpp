@@ -0,0 +1,71 @@
+// job_server.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_TEST_UNIT_JOB_SERVER_HPP_
+#define _EFC_TEST_UNIT_JOB_SERVER_HPP_
+#include <chrono>
+#include <efc/impl/latency_histogram.hpp>
+#include <efc/job_server.hpp>
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace mjx {
+    namespace test {
+        TEST(job_server, latency_percentiles) {
+            efc_impl::_Latency_histogram _Hist;
+            EXPECT_EQ(_Hist._Percentile(50), 0);
+            for (uint64_t _Value = 1; _Value <= 1000; ++_Value) {
+                _Hist._Record(_Value);
+            }
+
+            // every percentile is rounded up to the end of its bucket, at most 12.5% above the exact value
+            EXPECT_EQ(_Hist._Count(), 1000);
+            EXPECT_EQ(_Hist._Max(), 1000);
+            EXPECT_GE(_Hist._Percentile(50), 500);
+            EXPECT_LE(_Hist._Percentile(50), 563);
+            EXPECT_GE(_Hist._Percentile(99), 990);
+            EXPECT_LE(_Hist._Percentile(99), 1000); // never above the maximum
+            EXPECT_EQ(_Hist._Percentile(100), 1000);
+        }
+
+        TEST(job_server, submit_jobs) {
+            job_server_stats _Stats;
+            if (query_job_server_stats(_Stats)) { // the pipe is shared by all processes of the user
+                GTEST_SKIP();
+            }
+
+            work_stealing_scheduler _Scheduler(2);
+            job_server _Server(_Scheduler, [](const job_type _Type, const path& _Path, uint64_t& _Bytes) {
+                _Bytes = _Path.native().size();
+                return _Type == job_type::verification ? 7u : 0u; // verification fails with a custom error
+            });
+            ASSERT_TRUE(_Server.is_valid());
+            ::std::thread _Thread([&_Server] { _Server.run(); });
+            for (int _Attempt = 0; _Attempt < 100 && !query_job_server_stats(_Stats); ++_Attempt) {
+                ::std::this_thread::sleep_for(::std::chrono::milliseconds(10));
+            }
+
+            job_result _Result;
+            EXPECT_TRUE(submit_job(job_type::encryption, path{L"C:\\Dir\\File.txt"}, _Result));
+            EXPECT_EQ(_Result.status, 0);
+            EXPECT_EQ(_Result.bytes, 15);
+            EXPECT_TRUE(submit_job(job_type::verification, path{L"C:\\Dir\\File.txt.efc"}, _Result));
+            EXPECT_EQ(_Result.status, 7);
+            EXPECT_TRUE(submit_job(static_cast<job_type>(42), path{L"C:\\Dir\\File.txt"}, _Result));
+            EXPECT_EQ(_Result.status, job_server::rejected);
+            ASSERT_TRUE(query_job_server_stats(_Stats));
+            EXPECT_EQ(_Stats.completed, 1);
+            EXPECT_EQ(_Stats.failed, 2);
+            EXPECT_LE(_Stats.p50, _Stats.p99);
+            EXPECT_LE(_Stats.p99, _Stats.max);
+            _Server.stop();
+            _Thread.join();
+            EXPECT_FALSE(submit_job(job_type::encryption, path{L"C:\\Dir\\File.txt"}, _Result));
+        }
+    } // namespace test
+} // namespace mjx
+
+#endif // _EFC_TEST_UNIT_JOB_SERVER_HPP_
\ No newline at end of file
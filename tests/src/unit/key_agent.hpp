@@ -0,0 +1,95 @@
+// key_agent.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_TEST_UNIT_KEY_AGENT_HPP_
+#define _EFC_TEST_UNIT_KEY_AGENT_HPP_
+#include <chrono>
+#include <cstring>
+#include <efc/key_agent.hpp>
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace mjx {
+    namespace test {
+        class _Agent_runner { // runs the agent on a separate thread until destroyed
+        public:
+            explicit _Agent_runner(key_agent& _Agent) : _Myagent(_Agent), _Mythread([&_Agent] { _Agent.run(); }) {
+                for (int _Attempt = 0; _Attempt < 100 && !is_key_agent_running(); ++_Attempt) {
+                    ::std::this_thread::sleep_for(::std::chrono::milliseconds(10));
+                }
+            }
+
+            ~_Agent_runner() noexcept {
+                _Myagent.stop();
+                _Mythread.join();
+            }
+
+        private:
+            key_agent& _Myagent;
+            ::std::thread _Mythread;
+        };
+
+        TEST(key_agent, same_keys) {
+            if (is_key_agent_running()) { // the pipe is shared by all processes of the user
+                GTEST_SKIP();
+            }
+
+            secure_password _Password;
+            _Password.assign(L"9c&Hq!vT0p@Lw2Zk");
+            const salt& _Salt = generate_salt();
+            key _Key;
+            key _Cached_key;
+            key_agent _Agent;
+            ASSERT_TRUE(_Agent.is_valid());
+            {
+                _Agent_runner _Runner(_Agent);
+                ASSERT_TRUE(request_agent_key(_Password, _Salt, legacy_key_derivation_params, _Key));
+                ASSERT_TRUE(request_agent_key(_Password, _Salt, legacy_key_derivation_params, _Cached_key));
+                EXPECT_EQ(_Agent.key_count(), 1); // the second request is served from the held key
+            }
+
+            const key& _Expected = derive_key(_Password.as_view(), _Salt, legacy_key_derivation_params);
+            EXPECT_EQ(::memcmp(_Key.data(), _Expected.data(), key::size), 0);
+            EXPECT_EQ(::memcmp(_Cached_key.data(), _Expected.data(), key::size), 0);
+            EXPECT_EQ(_Agent.key_count(), 0); // wiped once the agent stops
+            EXPECT_FALSE(request_agent_key(_Password, _Salt, legacy_key_derivation_params, _Key));
+        }
+
+        TEST(key_agent, batch_key) {
+            if (is_key_agent_running()) {
+                GTEST_SKIP();
+            }
+
+            secure_password _Password;
+            _Password.assign(L"9c&Hq!vT0p@Lw2Zk");
+            salt _First_salt;
+            salt _Second_salt;
+            key _First_key;
+            key _Second_key;
+            key _Key;
+            key_agent _Agent;
+            ASSERT_TRUE(_Agent.is_valid());
+            {
+                _Agent_runner _Runner(_Agent);
+                ASSERT_TRUE(request_agent_batch_key(
+                    _Password, default_key_derivation_params, _First_salt, _First_key));
+                ASSERT_TRUE(request_agent_batch_key(
+                    _Password, default_key_derivation_params, _Second_salt, _Second_key));
+                ASSERT_TRUE(request_agent_key(_Password, _First_salt, default_key_derivation_params, _Key));
+                EXPECT_EQ(_Agent.key_count(), 2); // the master key is held for both kinds of requests
+            }
+
+            // the batch reuses its salt, and the master key is the key of that salt
+            const key& _Expected = derive_key(_Password.as_view(), _First_salt, default_key_derivation_params);
+            EXPECT_EQ(::memcmp(_First_salt.data(), _Second_salt.data(), salt::size), 0);
+            EXPECT_EQ(::memcmp(_First_key.data(), _Expected.data(), key::size), 0);
+            EXPECT_EQ(::memcmp(_Second_key.data(), _Expected.data(), key::size), 0);
+            EXPECT_EQ(::memcmp(_Key.data(), _Expected.data(), key::size), 0);
+        }
+    } // namespace test
+} // namespace mjx
+
+#endif // _EFC_TEST_UNIT_KEY_AGENT_HPP_
\ No newline at end of file
@@ -6,17 +6,44 @@
 #pragma once
 #ifndef _EFC_TEST_UNIT_KEY_DERIVATION_HPP_
 #define _EFC_TEST_UNIT_KEY_DERIVATION_HPP_
+#include <efc/impl/argon2.hpp>
+#include <efc/impl/random.hpp>
 #include <efc/key_derivation.hpp>
 #include <gtest/gtest.h>
+#include <thread>
+#include <vector>
 
 namespace mjx {
     namespace test {
+        inline constexpr efc_impl::_Argon2_kernel _Argon2_kernels[] = {efc_impl::_Argon2_kernel::_Generic,
+            efc_impl::_Argon2_kernel::_Ssse3, efc_impl::_Argon2_kernel::_Avx2, efc_impl::_Argon2_kernel::_Avx512};
+
         inline void _Run_key_derivation_test(
             const unicode_string_view _Password, const salt& _Salt, const char* const _Expected_key) noexcept {
             const key& _Key = derive_key(_Password, _Salt);
             EXPECT_EQ(::memcmp(_Key.data(), _Expected_key, key::size), 0);
         }
 
+        inline void _Run_subkey_derivation_test(
+            const char* const _Master_key, const char* const _Nonce, const char* const _Expected_key) noexcept {
+            key _Key;
+            key_nonce _Key_nonce;
+            _Key.assign(reinterpret_cast<const byte_t*>(_Master_key));
+            _Key_nonce.assign(reinterpret_cast<const byte_t*>(_Nonce));
+            _Key = derive_subkey(_Key, _Key_nonce);
+            EXPECT_EQ(::memcmp(_Key.data(), _Expected_key, key::size), 0);
+        }
+
+        inline void _Run_key_check_test(const char* const _Key_bytes, const char* const _Expected_check) noexcept {
+            key _Key;
+            _Key.assign(reinterpret_cast<const byte_t*>(_Key_bytes));
+            const key_check& _Check = compute_key_check(_Key);
+            EXPECT_EQ(::memcmp(_Check.data(), _Expected_check, key_check::size), 0);
+            EXPECT_TRUE(verify_key_check(_Key, _Check));
+            _Key.data()[key::size - 1] ^= 0x01; // any other key must be rejected
+            EXPECT_FALSE(verify_key_check(_Key, _Check));
+        }
+
         inline salt _Make_salt(const char* const _Bytes) noexcept {
             salt _Salt;
             _Salt.assign(reinterpret_cast<const byte_t*>(_Bytes));
@@ -211,6 +238,173 @@ namespace mjx {
                 "\x2C\xBB\x60\xE0\x0D\x33\x98\x22\x68\xEA\x1A\x17\xA2\x1E\x33\x49"
             );
         }
+
+        TEST(key_derivation, subkey) {
+            _Run_subkey_derivation_test(
+                "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+                "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00",
+                "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00",
+                "\x14\x3D\xEA\x83\xE0\x20\x2A\xD3\xE0\x3C\xAA\x8A\x67\x76\x2F\xC3"
+                "\x33\xC4\x33\xFD\xE9\xA5\xE2\x32\xAB\xD6\x2C\x45\xA9\x6E\x9F\xE2"
+            );
+            _Run_subkey_derivation_test(
+                "\x00\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0A\x0B\x0C\x0D\x0E\x0F"
+                "\x10\x11\x12\x13\x14\x15\x16\x17\x18\x19\x1A\x1B\x1C\x1D\x1E\x1F",
+                "\xA0\xA1\xA2\xA3\xA4\xA5\xA6\xA7\xA8\xA9\xAA\xAB\xAC\xAD\xAE\xAF",
+                "\x91\xC8\xCA\xC9\xE9\xD0\xB0\xC9\x8C\x1D\x51\x0E\x86\xD6\x1E\x41"
+                "\x95\x56\xA6\x72\xE6\x69\xA3\x30\xE3\x4B\x61\xE4\x74\xBA\x06\x43"
+            );
+            _Run_subkey_derivation_test(
+                "\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF"
+                "\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF",
+                "\x00\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0A\x0B\x0C\x0D\x0E\x0F",
+                "\x18\xBC\xE7\xD8\xC0\x26\x0F\xAF\xF3\x53\xE9\xDB\xE7\x1C\x9C\xE4"
+                "\x13\x7A\x44\x7A\xBB\xDF\x9F\x2E\x61\xFE\xA4\x09\x5C\x5F\xC7\x67"
+            );
+        }
+
+        TEST(key_derivation, key_check) {
+            _Run_key_check_test(
+                "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+                "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00",
+                "\x13\xCF\x01\x9E\x9A\x96\xAD\xB2\x0B\xF4\x3D\xD2\x16\xE8\x55\x8F"
+                "\x14\xCA\xE7\xEF\xF2\xF9\x89\x44\xC5\x42\xEB\x47\x70\xD0\x6C\x89"
+            );
+            _Run_key_check_test(
+                "\x00\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0A\x0B\x0C\x0D\x0E\x0F"
+                "\x10\x11\x12\x13\x14\x15\x16\x17\x18\x19\x1A\x1B\x1C\x1D\x1E\x1F",
+                "\xC6\xFB\xF8\x28\xFD\xD4\x6B\x81\xFB\x07\x16\x39\xE2\xAC\xB2\x94"
+                "\x17\x5B\x09\xEF\x93\xF5\xCE\xA8\xAA\xF3\xFF\x7D\xCA\x5C\xAF\xC6"
+            );
+            _Run_key_check_test(
+                "\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF"
+                "\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF",
+                "\x05\x6D\x5B\xFB\x3C\xD1\xF2\xE0\x86\x76\x2E\x37\xFB\xE6\xA2\x15"
+                "\x05\xF1\xBC\x3B\xC5\x67\xCC\x14\xF7\x70\x9A\x5D\x14\xA8\x5D\xBB"
+            );
+        }
+
+        TEST(key_derivation, argon2id_lanes) {
+            // the Argon2id test vector from RFC 9106, with 4 lanes computed by 1 to 4 threads
+            byte_t _Password[32];
+            byte_t _Salt[16];
+            byte_t _Secret[8];
+            byte_t _Data[12];
+            ::memset(_Password, 0x01, sizeof(_Password));
+            ::memset(_Salt, 0x02, sizeof(_Salt));
+            ::memset(_Secret, 0x03, sizeof(_Secret));
+            ::memset(_Data, 0x04, sizeof(_Data));
+            efc_impl::_Argon2_input _Input;
+            _Input._Password      = _Password;
+            _Input._Password_size = sizeof(_Password);
+            _Input._Salt          = _Salt;
+            _Input._Salt_size     = sizeof(_Salt);
+            _Input._Secret        = _Secret;
+            _Input._Secret_size   = sizeof(_Secret);
+            _Input._Data          = _Data;
+            _Input._Data_size     = sizeof(_Data);
+            _Input._Memory        = 32;
+            _Input._Iterations    = 3;
+            _Input._Lanes         = 4;
+            for (size_t _Threads = 1; _Threads <= 4; ++_Threads) {
+                for (const efc_impl::_Argon2_kernel _Kernel : _Argon2_kernels) {
+                    if (!efc_impl::_Is_argon2_kernel_supported(_Kernel)) {
+                        continue;
+                    }
+
+                    byte_t _Tag[32];
+                    EXPECT_TRUE(efc_impl::_Argon2id(_Tag, sizeof(_Tag), _Input, _Threads, _Kernel));
+                    EXPECT_EQ(::memcmp(_Tag,
+                        "\x0D\x64\x0D\xF5\x8D\x78\x76\x6C\x08\xC0\x37\xA3\x4A\x8B\x53\xC9"
+                        "\xD0\x1E\xF0\x45\x2D\x75\xB6\x5E\xB5\x25\x20\xE9\x6B\x01\xE6\x59", sizeof(_Tag)), 0);
+                }
+            }
+        }
+
+        TEST(key_derivation, argon2_kernels) {
+            // every kernel supported by the CPU must produce the same blocks as the generic one
+            efc_impl::_Argon2_block _Prev;
+            efc_impl::_Argon2_block _Ref;
+            efc_impl::_Argon2_block _Old;
+            ASSERT_TRUE(efc_impl::_Random_bytes(reinterpret_cast<byte_t*>(&_Prev), sizeof(_Prev)));
+            ASSERT_TRUE(efc_impl::_Random_bytes(reinterpret_cast<byte_t*>(&_Ref), sizeof(_Ref)));
+            ASSERT_TRUE(efc_impl::_Random_bytes(reinterpret_cast<byte_t*>(&_Old), sizeof(_Old)));
+            for (const bool _Xor_dest : {false, true}) {
+                efc_impl::_Argon2_block _Expected = _Old;
+                efc_impl::_Compress_generic(_Expected, _Prev, _Ref, _Xor_dest);
+                for (const efc_impl::_Argon2_kernel _Kernel : _Argon2_kernels) {
+                    if (!efc_impl::_Is_argon2_kernel_supported(_Kernel)) {
+                        continue;
+                    }
+
+                    efc_impl::_Argon2_block _Block = _Old;
+                    efc_impl::_Get_argon2_compress(_Kernel)(_Block, _Prev, _Ref, _Xor_dest);
+                    EXPECT_EQ(::memcmp(&_Block, &_Expected, sizeof(_Block)), 0);
+                    _Block = _Ref; // the destination may also be the reference block
+                    efc_impl::_Get_argon2_compress(_Kernel)(_Block, _Prev, _Block, false);
+                    efc_impl::_Argon2_block _Aliased = _Ref;
+                    efc_impl::_Compress_generic(_Aliased, _Prev, _Aliased, false);
+                    EXPECT_EQ(::memcmp(&_Block, &_Aliased, sizeof(_Block)), 0);
+                }
+            }
+        }
+
+        TEST(key_derivation, context) {
+            // the keys derived in the reused memory must match the ones derived by derive_key()
+            key_derivation_context _Context(2);
+            ASSERT_TRUE(_Context.is_valid());
+            EXPECT_EQ(_Context.slot_count(), 2);
+            EXPECT_EQ(_Context.slot_size(), key_derivation_memory(default_key_derivation_params));
+            const salt& _Salt    = generate_salt();
+            const key& _Expected = derive_key(L"ZD43MB$q|.iyUg4A", _Salt, default_key_derivation_params);
+            key _Keys[4]; // more derivations than slots, some of them wait
+            ::std::vector<::std::thread> _Threads;
+            for (key& _Key : _Keys) {
+                _Threads.emplace_back([&_Context, &_Salt, &_Key] {
+                    _Key = _Context.derive_key(L"ZD43MB$q|.iyUg4A", _Salt, default_key_derivation_params);
+                });
+            }
+
+            for (::std::thread& _Thread : _Threads) {
+                _Thread.join();
+            }
+
+            for (const key& _Key : _Keys) {
+                EXPECT_EQ(::memcmp(_Key.data(), _Expected.data(), key::size), 0);
+            }
+
+            // a derivation that needs more memory than a slot allocates its own
+            const key_derivation_params _Params = {32768, 1, 1};
+            EXPECT_EQ(::memcmp(_Context.derive_key(L"ZD43MB$q|.iyUg4A", _Salt, _Params).data(),
+                derive_key(L"ZD43MB$q|.iyUg4A", _Salt, _Params).data(), key::size), 0);
+        }
+
+        TEST(key_derivation, calibration) {
+            // a target shorter than a single pass keeps the default memory and a single pass
+            const key_derivation_params& _Fast = calibrate_key_derivation(1);
+            EXPECT_TRUE(is_valid_key_derivation_params(_Fast));
+            EXPECT_EQ(_Fast.memory, default_key_derivation_params.memory);
+            EXPECT_EQ(_Fast.iterations, 1);
+
+            // a long target is limited by the maximum memory, the remaining time is filled with passes
+            const key_derivation_params& _Slow = calibrate_key_derivation(60000, 65536);
+            EXPECT_TRUE(is_valid_key_derivation_params(_Slow));
+            EXPECT_EQ(_Slow.memory, 65536);
+            EXPECT_GT(_Slow.iterations, 1);
+        }
+
+        TEST(key_derivation, params) {
+            EXPECT_TRUE(is_valid_key_derivation_params(legacy_key_derivation_params));
+            EXPECT_TRUE(is_valid_key_derivation_params(default_key_derivation_params));
+            EXPECT_FALSE(is_valid_key_derivation_params(key_derivation_params{16384, 8, 0}));
+            EXPECT_FALSE(is_valid_key_derivation_params(key_derivation_params{16384, 0, 1}));
+            EXPECT_FALSE(is_valid_key_derivation_params(key_derivation_params{31, 8, 4}));
+            EXPECT_FALSE(is_valid_key_derivation_params(key_derivation_params{4194305, 8, 1}));
+            EXPECT_EQ(key_derivation_memory(legacy_key_derivation_params), 16777216);
+            EXPECT_EQ(key_derivation_memory(key_derivation_params{16383, 1, 4}), 16760832); // rounded down
+            EXPECT_EQ(key_derivation_memory(key_derivation_params{0, 0, 0}), 0);
+            EXPECT_EQ(key_derivation_memory(key_derivation_params{16384, 8, 0}), 0);
+        }
     } // namespace test
 } // namespace mjx
 
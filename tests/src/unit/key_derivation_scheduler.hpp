@@ -0,0 +1,70 @@
+// key_derivation_scheduler.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_TEST_UNIT_KEY_DERIVATION_SCHEDULER_HPP_
+#define _EFC_TEST_UNIT_KEY_DERIVATION_SCHEDULER_HPP_
+#include <cstring>
+#include <efc/key_derivation_scheduler.hpp>
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace mjx {
+    namespace test {
+        inline void _Run_scheduled_derivation_test(const size_t _Threads, const size_t _Memory_budget) {
+            constexpr size_t _Count = 8;
+            secure_password _Password;
+            _Password.assign(L"ZD43MB$q|.iyUg4A");
+            ::std::vector<salt> _Salts(_Count);
+            ::std::vector<key> _Keys(_Count);
+            for (salt& _Salt : _Salts) {
+                _Salt = generate_salt();
+            }
+
+            key_derivation_scheduler _Kdf(_Threads, _Memory_budget);
+            ASSERT_TRUE(_Kdf.is_running());
+            for (size_t _Idx = 0; _Idx < _Count; ++_Idx) {
+                EXPECT_TRUE(_Kdf.submit(_Password, _Salts[_Idx], legacy_key_derivation_params,
+                    [&_Keys, _Idx](const key& _Key) {
+                        _Keys[_Idx] = _Key; // every callback writes its own key
+                    }));
+            }
+
+            _Kdf.wait();
+            EXPECT_EQ(_Kdf.pending(), 0);
+            EXPECT_LE(_Kdf.peak_memory_usage(),
+                (::std::max)(_Memory_budget, key_derivation_memory(legacy_key_derivation_params)));
+            for (size_t _Idx = 0; _Idx < _Count; ++_Idx) {
+                const key& _Expected = derive_key(_Password.as_view(), _Salts[_Idx]);
+                EXPECT_EQ(::memcmp(_Keys[_Idx].data(), _Expected.data(), key::size), 0);
+            }
+        }
+
+        TEST(key_derivation_scheduler, same_keys) {
+            _Run_scheduled_derivation_test(4, key_derivation_scheduler::default_memory_budget);
+        }
+
+        TEST(key_derivation_scheduler, memory_budget) {
+            _Run_scheduled_derivation_test(4, key_derivation_memory(legacy_key_derivation_params) * 2);
+            _Run_scheduled_derivation_test(4, 0); // a single derivation always runs
+        }
+
+        TEST(key_derivation_scheduler, invalid_params) {
+            secure_password _Password;
+            _Password.assign(L"ZD43MB$q|.iyUg4A");
+            key_derivation_scheduler _Kdf(1, key_derivation_scheduler::default_memory_budget);
+            ASSERT_TRUE(_Kdf.is_running());
+            EXPECT_FALSE(_Kdf.submit(_Password, generate_salt(), key_derivation_params{0, 0, 0}, [](const key&) {
+                ADD_FAILURE() << "the derivation must not run";
+            }));
+            EXPECT_FALSE(_Kdf.submit(_Password, generate_salt(), key_derivation_params{16384, 8, 0}, [](const key&) {
+                ADD_FAILURE() << "the derivation must not run";
+            }));
+            EXPECT_EQ(_Kdf.pending(), 0);
+        }
+    } // namespace test
+} // namespace mjx
+
+#endif // _EFC_TEST_UNIT_KEY_DERIVATION_SCHEDULER_HPP_
\ No newline at end of file
@@ -0,0 +1,81 @@
+// parallel_encryption_engine.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_TEST_UNIT_PARALLEL_ENCRYPTION_ENGINE_HPP_
+#define _EFC_TEST_UNIT_PARALLEL_ENCRYPTION_ENGINE_HPP_
+#include <cstring>
+#include <efc/encryption_engine.hpp>
+#include <efc/impl/random.hpp>
+#include <efc/parallel_encryption_engine.hpp>
+#include <gtest/gtest.h>
+#include <mjstr/string.hpp>
+
+namespace mjx {
+    namespace test {
+        inline bool _Run_parallel_encryption_engine_test(const size_t _Size, const size_t _Threads) {
+            byte_string _Text(_Size, '\0');
+            key _Key;
+            if (!efc_impl::_Random_bytes(_Text.data(), _Size) || !efc_impl::_Random_bytes(_Key.data(), key::size)) {
+                return false;
+            }
+
+            // encrypt the text using the sequential engine, the parallel engine must produce the same output
+            const iv& _Iv = generate_iv();
+            authentication_tag _Expected_tag;
+            byte_string _Expected(_Size, '\0');
+            encryption_engine _Engine;
+            if (!_Engine.setup_encryption(_Key, _Iv) || !_Engine.encrypt(_Text.c_str(), _Size, _Expected.data())
+                || !_Engine.complete(_Expected_tag)) {
+                return false;
+            }
+
+            authentication_tag _Tag;
+            byte_string _Enc_buf(_Size, '\0');
+            parallel_encryption_engine _Parallel_engine(_Threads);
+            if (!_Parallel_engine.encrypt(_Key, _Iv, _Text.c_str(), _Size, _Enc_buf.data(), _Tag)) {
+                return false;
+            }
+
+            EXPECT_EQ(_Enc_buf, _Expected);
+            EXPECT_EQ(::memcmp(_Tag.data(), _Expected_tag.data(), authentication_tag::size), 0);
+
+            byte_string _Dec_buf(_Size, '\0');
+            if (!_Parallel_engine.decrypt(_Key, _Iv, _Enc_buf.c_str(), _Size, _Dec_buf.data(), _Tag)) {
+                return false;
+            }
+
+            EXPECT_EQ(_Dec_buf, _Text);
+            if (_Size > 0) { // a modified ciphertext must be rejected
+                _Enc_buf[_Size / 2] ^= 0x01;
+                EXPECT_FALSE(
+                    _Parallel_engine.decrypt(_Key, _Iv, _Enc_buf.c_str(), _Size, _Dec_buf.data(), _Tag));
+            }
+
+            return true;
+        }
+
+        TEST(parallel_encryption_engine, short_text) {
+            EXPECT_TRUE(_Run_parallel_encryption_engine_test(0, 4));
+            EXPECT_TRUE(_Run_parallel_encryption_engine_test(1, 4));
+            EXPECT_TRUE(_Run_parallel_encryption_engine_test(15, 4));
+            EXPECT_TRUE(_Run_parallel_encryption_engine_test(16, 4));
+            EXPECT_TRUE(_Run_parallel_encryption_engine_test(17, 4));
+            EXPECT_TRUE(_Run_parallel_encryption_engine_test(4096, 4));
+        }
+
+        TEST(parallel_encryption_engine, long_text) {
+            EXPECT_TRUE(_Run_parallel_encryption_engine_test(65536, 2));
+            EXPECT_TRUE(_Run_parallel_encryption_engine_test(131072, 2));
+            EXPECT_TRUE(_Run_parallel_encryption_engine_test(131073, 2));
+            EXPECT_TRUE(_Run_parallel_encryption_engine_test(1048576, 3));
+            EXPECT_TRUE(_Run_parallel_encryption_engine_test(1048575, 7));
+            EXPECT_TRUE(_Run_parallel_encryption_engine_test(4194319, 8));
+            EXPECT_TRUE(_Run_parallel_encryption_engine_test(10000001, 16));
+        }
+    } // namespace test
+} // namespace mjx
+
+#endif // _EFC_TEST_UNIT_PARALLEL_ENCRYPTION_ENGINE_HPP_
\ No newline at end of file
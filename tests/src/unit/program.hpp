@@ -0,0 +1,171 @@
+// program.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_TEST_UNIT_PROGRAM_HPP_
+#define _EFC_TEST_UNIT_PROGRAM_HPP_
+#include <cstdint>
+#include <cstring>
+#include <efc/impl/program.hpp>
+#include <efc/impl/tinywin.hpp>
+#include <efc/program.hpp>
+#include <gtest/gtest.h>
+#include <mjstr/string.hpp>
+#include <string>
+#include <utils/test_file.hpp>
+
+namespace mjx {
+    namespace test {
+        // parses a single raw key argument, the options keep the loaded key
+        inline bool _Parse_test_raw_key(const unicode_string& _Arg, program_options& _Options) {
+            efc_impl::_Parser_context _Ctx;
+            efc_impl::_Parser_data _Data(_Options);
+            _Data._Arg         = _Arg;
+            const bool _Parsed = efc_impl::_Parse_raw_key(_Ctx, _Data);
+            EXPECT_EQ(static_cast<bool>(_Ctx._Raw_key_found), _Parsed);
+            return _Parsed;
+        }
+
+        inline unicode_string _Make_key_fd_arg(const HANDLE _Handle) {
+            const uint32_t _Fd = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(_Handle));
+            return unicode_string{L"--key-fd="} + ::std::to_wstring(_Fd).c_str();
+        }
+
+        // returns the read end of a pipe that yields the specified data and then ends
+        inline HANDLE _Make_key_pipe(const byte_string& _Data) noexcept {
+            HANDLE _Read;
+            HANDLE _Write;
+            if (!::CreatePipe(&_Read, &_Write, nullptr, 0)) {
+                return nullptr;
+            }
+
+            DWORD _Written      = 0;
+            const bool _Success =
+                ::WriteFile(_Write, _Data.c_str(), static_cast<DWORD>(_Data.size()), &_Written, nullptr) != FALSE
+                    && _Written == _Data.size();
+            ::CloseHandle(_Write); // the reader sees the end of the data
+            if (!_Success) {
+                ::CloseHandle(_Read);
+                return nullptr;
+            }
+
+            return _Read;
+        }
+
+        TEST(program, raw_key_file) {
+            const byte_string& _Raw = _Random_data(key::size);
+            ASSERT_EQ(_Raw.size(), key::size);
+            _Test_file _File;
+            ASSERT_TRUE(_File._Store(_Raw));
+            _File._Get().close(); // the parser opens the file on its own
+
+            program_options _Options;
+            ASSERT_TRUE(_Parse_test_raw_key(unicode_string{L"--key-file="} + _File._Path(), _Options));
+            ASSERT_TRUE(_Options.raw_key.valid());
+            EXPECT_EQ(::memcmp(_Options.raw_key.data(), _Raw.c_str(), key::size), 0);
+        }
+
+        TEST(program, raw_key_file_wrong_size) {
+            // the file must contain exactly one key, anything shorter or longer is rejected
+            for (const size_t _Size : {size_t{0}, key::size / 2, key::size - 1, key::size + 1, key::size * 2}) {
+                _Test_file _File;
+                ASSERT_TRUE(_File._Store(_Random_data(_Size)));
+                _File._Get().close();
+
+                program_options _Options;
+                EXPECT_FALSE(_Parse_test_raw_key(unicode_string{L"--key-file="} + _File._Path(), _Options));
+                EXPECT_FALSE(_Options.raw_key.valid());
+            }
+        }
+
+        TEST(program, raw_key_file_zero) {
+            _Test_file _File;
+            ASSERT_TRUE(_File._Store(byte_string(key::size, '\0'))); // an all-zero key is never used
+            _File._Get().close();
+
+            program_options _Options;
+            EXPECT_FALSE(_Parse_test_raw_key(unicode_string{L"--key-file="} + _File._Path(), _Options));
+            EXPECT_FALSE(_Options.raw_key.valid());
+        }
+
+        TEST(program, raw_key_file_missing) {
+            program_options _Options;
+            EXPECT_FALSE(_Parse_test_raw_key(L"--key-file=", _Options));
+            EXPECT_FALSE(_Parse_test_raw_key(L"--key-file=efc_missing_key_file.bin", _Options));
+            EXPECT_FALSE(_Options.raw_key.valid());
+        }
+
+        TEST(program, raw_key_fd) {
+            const byte_string& _Raw = _Random_data(key::size);
+            ASSERT_EQ(_Raw.size(), key::size);
+            const HANDLE _Pipe = _Make_key_pipe(_Raw);
+            ASSERT_NE(_Pipe, nullptr);
+
+            program_options _Options;
+            ASSERT_TRUE(_Parse_test_raw_key(_Make_key_fd_arg(_Pipe), _Options)); // closes the pipe
+            ASSERT_TRUE(_Options.raw_key.valid());
+            EXPECT_EQ(::memcmp(_Options.raw_key.data(), _Raw.c_str(), key::size), 0);
+        }
+
+        TEST(program, raw_key_fd_short_read) {
+            // the pipe ends before the whole key has been read
+            const HANDLE _Pipe = _Make_key_pipe(_Random_data(key::size / 2));
+            ASSERT_NE(_Pipe, nullptr);
+
+            program_options _Options;
+            EXPECT_FALSE(_Parse_test_raw_key(_Make_key_fd_arg(_Pipe), _Options));
+            EXPECT_FALSE(_Options.raw_key.valid());
+        }
+
+        TEST(program, raw_key_fd_malformed) {
+            program_options _Options;
+            for (const wchar_t* const _Arg : {L"--key-fd=", L"--key-fd=abc", L"--key-fd=12x", L"--key-fd=-1",
+                L"--key-fd= 3", L"--key-fd=4294967296"}) {
+                EXPECT_FALSE(_Parse_test_raw_key(_Arg, _Options));
+                EXPECT_FALSE(_Options.raw_key.valid());
+            }
+        }
+
+        TEST(program, raw_key_fd_invalid_handle) {
+            // an event is neither a file nor a pipe, it must be left open
+            const HANDLE _Event = ::CreateEventW(nullptr, TRUE, FALSE, nullptr);
+            ASSERT_NE(_Event, nullptr);
+
+            program_options _Options;
+            EXPECT_FALSE(_Parse_test_raw_key(_Make_key_fd_arg(_Event), _Options));
+            EXPECT_FALSE(_Options.raw_key.valid());
+            EXPECT_TRUE(::CloseHandle(_Event));
+        }
+
+        TEST(program, no_kdf) {
+            // a valid raw key replaces the password, so no key derivation function is used
+            const byte_string& _Raw = _Random_data(key::size);
+            ASSERT_EQ(_Raw.size(), key::size);
+            _Test_file _File;
+            ASSERT_TRUE(_File._Store(_Raw));
+            _File._Get().close();
+
+            unicode_string _Operation = L"--encrypt";
+            unicode_string _Password  = L"--password=ignored";
+            unicode_string _Key_file  = unicode_string{L"--key-file="} + _File._Path();
+            wchar_t* _Args[]          = {_Operation.data(), _Password.data(), _Key_file.data()};
+            program_options _Options;
+            parse_program_args(3, _Args, _Options);
+            EXPECT_EQ(_Options.operation, operation::encryption);
+            ASSERT_TRUE(_Options.raw_key.valid());
+            EXPECT_EQ(::memcmp(_Options.raw_key.data(), _Raw.c_str(), key::size), 0);
+
+            // an unusable key file leaves the password in charge
+            ASSERT_TRUE(_File._Store(_Random_data(key::size - 1)));
+            _File._Get().close();
+            program_options _Fallback;
+            parse_program_args(3, _Args, _Fallback);
+            EXPECT_FALSE(_Fallback.raw_key.valid());
+            EXPECT_FALSE(_Fallback.password.empty());
+        }
+    } // namespace test
+} // namespace mjx
+
+#endif // _EFC_TEST_UNIT_PROGRAM_HPP_
\ No newline at end of file
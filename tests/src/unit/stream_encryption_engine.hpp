@@ -0,0 +1,111 @@
+// stream_encryption_engine.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_TEST_UNIT_STREAM_ENCRYPTION_ENGINE_HPP_
+#define _EFC_TEST_UNIT_STREAM_ENCRYPTION_ENGINE_HPP_
+#include <efc/stream_encryption_engine.hpp>
+#include <gtest/gtest.h>
+#include <mjfs/file_stream.hpp>
+#include <utils/chunked_file.hpp>
+#include <utils/test_pipe.hpp>
+
+namespace mjx {
+    namespace test {
+        // encrypts or decrypts _Input from one pipe into another, returns the output in _Output
+        inline bool _Run_stream_engine(
+            const byte_string& _Input, const key& _Key, const file_metadata& _Meta, const bool _Encrypt,
+            byte_string& _Output) {
+            _Pipe_source _Src(_Input);
+            _Pipe_sink _Dest;
+            if (!_Src._Get().is_open() || !_Dest._Get().is_open()) {
+                return false;
+            }
+
+            file_stream _Src_stream(_Src._Get());
+            file_stream _Dest_stream(_Dest._Get());
+            stream_encryption_engine _Engine(_Src_stream, _Dest_stream);
+            const bool _Result = _Encrypt ? _Engine.encrypt(_Key, _Meta) : _Engine.decrypt(_Key, _Meta);
+            _Output            = _Dest._Finish();
+            return _Result;
+        }
+
+        inline void _Run_stream_round_trip_test(const size_t _Size) {
+            const byte_string& _Plaintext = _Random_data(_Size);
+            const key& _Key               = _Make_test_key();
+            const file_metadata& _Meta    = _Make_chunked_metadata();
+            byte_string _Ciphertext;
+            byte_string _Decrypted;
+            ASSERT_TRUE(_Run_stream_engine(_Plaintext, _Key, _Meta, true, _Ciphertext));
+            const size_t _Chunks = _Size == 0 ? 1 : (_Size + _Test_chunk_size - 1) / _Test_chunk_size;
+            EXPECT_EQ(_Ciphertext.size(), _Size + _Chunks * authentication_tag::size);
+            ASSERT_TRUE(_Run_stream_engine(_Ciphertext, _Key, _Meta, false, _Decrypted));
+            EXPECT_EQ(_Decrypted, _Plaintext);
+        }
+
+        TEST(stream_encryption_engine, round_trip) {
+            _Run_stream_round_trip_test(0);
+            _Run_stream_round_trip_test(1);
+            _Run_stream_round_trip_test(_Test_chunk_size);
+            _Run_stream_round_trip_test(_Test_chunk_size + 1);
+            _Run_stream_round_trip_test(5 * _Test_chunk_size + 100);
+        }
+
+        TEST(stream_encryption_engine, matches_chunked_engine) {
+            const byte_string& _Plaintext = _Random_data(3 * _Test_chunk_size + 100);
+            const key& _Key               = _Make_test_key();
+            const file_metadata& _Meta    = _Make_chunked_metadata();
+            const size_t _Header_size     = metadata_size(_Meta);
+
+            // the streamed chunks decrypt with the chunked engine
+            byte_string _Streamed;
+            ASSERT_TRUE(_Run_stream_engine(_Plaintext, _Key, _Meta, true, _Streamed));
+            byte_string _Stored(_Header_size, '\0'); // the engines do not write the metadata
+            _Stored.append(_Streamed);
+            _Test_file _Streamed_file;
+            byte_string _Decrypted;
+            ASSERT_TRUE(_Streamed_file._Store(_Stored));
+            ASSERT_TRUE(_Decrypt_chunked(_Streamed_file, _Key, _Meta, _Decrypted));
+            EXPECT_EQ(_Decrypted, _Plaintext);
+
+            // the chunks written by the chunked engine decrypt from a stream
+            _Test_file _Encrypted;
+            byte_string _Encrypted_data;
+            ASSERT_TRUE(_Encrypt_chunked(_Plaintext, _Key, _Meta, _Encrypted));
+            ASSERT_TRUE(_Encrypted._Load(_Encrypted_data));
+            ASSERT_EQ(_Encrypted_data.size(), _Header_size + _Streamed.size());
+            const byte_string _Chunks(_Encrypted_data.c_str() + _Header_size, _Streamed.size());
+            EXPECT_EQ(_Chunks, _Streamed); // the same key, IV and plaintext give the same chunks
+            ASSERT_TRUE(_Run_stream_engine(_Chunks, _Key, _Meta, false, _Decrypted));
+            EXPECT_EQ(_Decrypted, _Plaintext);
+        }
+
+        TEST(stream_encryption_engine, modified_stream) {
+            const byte_string& _Plaintext = _Random_data(3 * _Test_chunk_size + 100);
+            const key& _Key               = _Make_test_key();
+            const file_metadata& _Meta    = _Make_chunked_metadata();
+            const size_t _Stored_size     = _Test_chunk_size + authentication_tag::size;
+            byte_string _Ciphertext;
+            byte_string _Decrypted;
+            ASSERT_TRUE(_Run_stream_engine(_Plaintext, _Key, _Meta, true, _Ciphertext));
+
+            // a modified byte in the second chunk
+            byte_string _Modified = _Ciphertext;
+            _Modified[_Stored_size + 10] ^= 0x01;
+            EXPECT_FALSE(_Run_stream_engine(_Modified, _Key, _Meta, false, _Decrypted));
+            EXPECT_EQ(_Decrypted.size(), _Test_chunk_size); // only the first chunk has been written
+
+            // the final chunk removed
+            const byte_string _Truncated(_Ciphertext.c_str(), 3 * _Stored_size);
+            EXPECT_FALSE(_Run_stream_engine(_Truncated, _Key, _Meta, false, _Decrypted));
+
+            // a different key
+            EXPECT_FALSE(_Run_stream_engine(_Ciphertext, _Make_test_key(), _Meta, false, _Decrypted));
+            EXPECT_TRUE(_Decrypted.empty());
+        }
+    } // namespace test
+} // namespace mjx
+
+#endif // _EFC_TEST_UNIT_STREAM_ENCRYPTION_ENGINE_HPP_
\ No newline at end of file
@@ -0,0 +1,89 @@
+// work_stealing_scheduler.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_TEST_UNIT_WORK_STEALING_SCHEDULER_HPP_
+#define _EFC_TEST_UNIT_WORK_STEALING_SCHEDULER_HPP_
+#include <atomic>
+#include <chrono>
+#include <efc/work_stealing_scheduler.hpp>
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace mjx {
+    namespace test {
+        inline uint64_t _Total_executed(const work_stealing_scheduler& _Scheduler) noexcept {
+            uint64_t _Total = 0;
+            for (size_t _Idx = 0; _Idx < _Scheduler.worker_count(); ++_Idx) {
+                _Total += _Scheduler.stats(_Idx).executed;
+            }
+
+            return _Total;
+        }
+
+        TEST(work_stealing_scheduler, every_task) {
+            constexpr size_t _Count = 10000;
+            ::std::atomic<size_t> _Done(0);
+            work_stealing_scheduler _Scheduler(4);
+            ASSERT_TRUE(_Scheduler.is_running());
+            for (size_t _Idx = 0; _Idx < _Count; ++_Idx) {
+                EXPECT_TRUE(_Scheduler.submit([&_Done] { _Done.fetch_add(1); }));
+            }
+
+            _Scheduler.wait();
+            EXPECT_EQ(_Done.load(), _Count);
+            EXPECT_EQ(_Scheduler.pending(), 0);
+            EXPECT_EQ(_Total_executed(_Scheduler), _Count);
+        }
+
+        TEST(work_stealing_scheduler, stolen_subtasks) {
+            // a single task splits its work into subtasks, which are queued on its worker,
+            // so the other workers can get them only by stealing
+            constexpr size_t _Count = 256;
+            ::std::atomic<size_t> _Done(0);
+            work_stealing_scheduler _Scheduler(4);
+            ASSERT_TRUE(_Scheduler.is_running());
+            EXPECT_TRUE(_Scheduler.submit([&_Scheduler, &_Done] {
+                for (size_t _Idx = 0; _Idx < _Count; ++_Idx) {
+                    _Scheduler.submit([&_Done] {
+                        ::std::this_thread::sleep_for(::std::chrono::microseconds(200));
+                        _Done.fetch_add(1);
+                    });
+                }
+            }));
+
+            _Scheduler.wait();
+            EXPECT_EQ(_Done.load(), _Count);
+            EXPECT_EQ(_Total_executed(_Scheduler), _Count + 1);
+            uint64_t _Stolen = 0;
+            for (size_t _Idx = 0; _Idx < _Scheduler.worker_count(); ++_Idx) {
+                _Stolen += _Scheduler.stats(_Idx).stolen;
+            }
+
+            EXPECT_GT(_Stolen, 0);
+        }
+
+        TEST(work_stealing_scheduler, bounded_wait) {
+            ::std::atomic<bool> _Release(false);
+            work_stealing_scheduler _Scheduler(2);
+            ASSERT_TRUE(_Scheduler.is_running());
+            for (size_t _Idx = 0; _Idx < 8; ++_Idx) {
+                _Scheduler.submit([&_Release] {
+                    while (!_Release.load()) {
+                        ::std::this_thread::yield();
+                    }
+                });
+            }
+
+            _Scheduler.wait(8); // returns at once, at most 8 tasks are pending
+            EXPECT_EQ(_Scheduler.pending(), 8);
+            _Release.store(true);
+            _Scheduler.wait();
+            EXPECT_EQ(_Scheduler.pending(), 0);
+        }
+    } // namespace test
+} // namespace mjx
+
+#endif // _EFC_TEST_UNIT_WORK_STEALING_SCHEDULER_HPP_
\ No newline at end of file
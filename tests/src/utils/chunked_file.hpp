@@ -0,0 +1,55 @@
+// chunked_file.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_TEST_UTILS_CHUNKED_FILE_HPP_
+#define _EFC_TEST_UTILS_CHUNKED_FILE_HPP_
+#include <efc/chunked_file_encryption_engine.hpp>
+#include <efc/impl/random.hpp>
+#include <mjstr/string.hpp>
+#include <utils/test_file.hpp>
+
+namespace mjx {
+    namespace test {
+        constexpr uint32_t _Test_chunk_size = chunked_file_encryption_engine::min_chunk_size;
+
+        inline key _Make_test_key() noexcept {
+            key _Key;
+            return efc_impl::_Random_bytes(_Key.data(), key::size) ? _Key : key{};
+        }
+
+        inline file_metadata _Make_chunked_metadata() noexcept {
+            file_metadata _Meta = construct_metadata(file_format::chunked);
+            _Meta.chunk_size    = _Test_chunk_size;
+            return _Meta;
+        }
+
+        // encrypts _Plaintext into _Encrypted, the header is left zeroed
+        inline bool _Encrypt_chunked(
+            const byte_string& _Plaintext, const key& _Key, const file_metadata& _Meta, _Test_file& _Encrypted) {
+            _Test_file _Src;
+            if (!_Src._Store(_Plaintext) || !_Encrypted._Open().is_open()) {
+                return false;
+            }
+
+            chunked_file_encryption_engine _Engine(_Src._Get(), _Encrypted._Get(), 2);
+            return _Engine.encrypt(_Key, _Meta);
+        }
+
+        // decrypts _Encrypted into _Plaintext
+        inline bool _Decrypt_chunked(
+            _Test_file& _Encrypted, const key& _Key, const file_metadata& _Meta, byte_string& _Plaintext) {
+            _Test_file _Dest;
+            if (!_Encrypted._Open().is_open() || !_Dest._Open().is_open()) {
+                return false;
+            }
+
+            chunked_file_encryption_engine _Engine(_Encrypted._Get(), _Dest._Get(), 2);
+            return _Engine.decrypt(_Key, _Meta) && _Dest._Load(_Plaintext);
+        }
+    } // namespace test
+} // namespace mjx
+
+#endif // _EFC_TEST_UTILS_CHUNKED_FILE_HPP_
\ No newline at end of file
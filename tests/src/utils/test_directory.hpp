@@ -0,0 +1,108 @@
+// test_directory.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_TEST_UTILS_TEST_DIRECTORY_HPP_
+#define _EFC_TEST_UTILS_TEST_DIRECTORY_HPP_
+#include <efc/impl/file_io.hpp>
+#include <efc/impl/tinywin.hpp>
+#include <mjfs/directory.hpp>
+#include <mjfs/file.hpp>
+#include <mjfs/path.hpp>
+#include <mjfs/status.hpp>
+#include <mjstr/string.hpp>
+#include <vector>
+
+namespace mjx {
+    namespace test {
+        class _Test_directory { // a directory in the temporary directory, deleted with its content
+        public:
+            _Test_directory() : _Mypath() {
+                // the unique name is reserved by an empty file, which is replaced by the directory
+                wchar_t _Dir[MAX_PATH + 1];
+                wchar_t _Name[MAX_PATH + 1];
+                if (::GetTempPathW(MAX_PATH + 1, _Dir) != 0 && ::GetTempFileNameW(_Dir, L"efc", 0, _Name) != 0
+                    && ::DeleteFileW(_Name) && ::mjx::create_directory(path{_Name})) {
+                    _Mypath = _Name;
+                }
+            }
+
+            ~_Test_directory() noexcept {
+                try {
+                    _Remove();
+                } catch (...) { // the directory is left behind
+                }
+            }
+
+            _Test_directory(const _Test_directory&)            = delete;
+            _Test_directory& operator=(const _Test_directory&) = delete;
+
+            // returns the path to the directory, which is empty if it could not be created
+            const path& _Path() const noexcept {
+                return _Mypath;
+            }
+
+            // creates a subdirectory, _Name is relative to the directory
+            bool _Create_directory(const path& _Name) {
+                return ::mjx::create_directory(_Mypath / _Name);
+            }
+
+            // creates a file with the specified content, _Name is relative to the directory
+            bool _Store_file(const path& _Name, const byte_string& _Data) {
+                file _File;
+                return ::mjx::create_file(_Mypath / _Name, &_File)
+                    && (_Data.empty() || efc_impl::_Write_at(_File, 0, _Data.c_str(), _Data.size()));
+            }
+
+            // reads the whole file, _Name is relative to the directory
+            bool _Load_file(const path& _Name, byte_string& _Data) {
+                file _File(_Mypath / _Name, file_access::read, file_share::read);
+                if (!_File.is_open()) {
+                    return false;
+                }
+
+                _Data.assign(static_cast<size_t>(_File.size()), '\0');
+                return _Data.empty() || efc_impl::_Read_at(_File, 0, _Data.data(), _Data.size());
+            }
+
+            // checks if the file exists, _Name is relative to the directory
+            bool _Exists(const path& _Name) const {
+                return ::mjx::exists(_Mypath / _Name);
+            }
+
+            // deletes the file, _Name is relative to the directory
+            bool _Delete_file(const path& _Name) {
+                return ::mjx::delete_file(_Mypath / _Name);
+            }
+
+        private:
+            void _Remove() {
+                if (_Mypath.empty()) {
+                    return;
+                }
+
+                // the entries are listed before their content, so they are removed in the reverse order
+                ::std::vector<directory_entry> _Entries;
+                for (const directory_entry& _Entry : recursive_directory_iterator(_Mypath)) {
+                    _Entries.push_back(_Entry);
+                }
+
+                for (auto _Iter = _Entries.rbegin(); _Iter != _Entries.rend(); ++_Iter) {
+                    if (_Iter->is_directory()) {
+                        ::mjx::remove_directory(_Iter->absolute_path());
+                    } else {
+                        ::mjx::delete_file(_Iter->absolute_path());
+                    }
+                }
+
+                ::mjx::remove_directory(_Mypath);
+            }
+
+            path _Mypath;
+        };
+    } // namespace test
+} // namespace mjx
+
+#endif // _EFC_TEST_UTILS_TEST_DIRECTORY_HPP_
\ No newline at end of file
@@ -0,0 +1,100 @@
+// test_file.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_TEST_UTILS_TEST_FILE_HPP_
+#define _EFC_TEST_UTILS_TEST_FILE_HPP_
+#include <cstdint>
+#include <efc/impl/file_io.hpp>
+#include <efc/impl/random.hpp>
+#include <efc/impl/tinywin.hpp>
+#include <mjfs/file.hpp>
+#include <mjstr/string.hpp>
+
+namespace mjx {
+    namespace test {
+        inline byte_string _Random_data(const size_t _Size) {
+            byte_string _Data(_Size, '\0');
+            if (_Size > 0 && !efc_impl::_Random_bytes(_Data.data(), _Size)) {
+                _Data.clear();
+            }
+
+            return _Data;
+        }
+
+        class _Test_file { // a file in the temporary directory, deleted with the object
+        public:
+            _Test_file() noexcept : _Myname(), _Myfile() {
+                wchar_t _Dir[MAX_PATH + 1];
+                if (::GetTempPathW(MAX_PATH + 1, _Dir) == 0 || ::GetTempFileNameW(_Dir, L"efc", 0, _Myname) == 0) {
+                    _Myname[0] = L'\0';
+                }
+            }
+
+            ~_Test_file() noexcept {
+                _Myfile.close();
+                if (_Myname[0] != L'\0') {
+                    ::DeleteFileW(_Myname);
+                }
+            }
+
+            _Test_file(const _Test_file&)            = delete;
+            _Test_file& operator=(const _Test_file&) = delete;
+
+            // reopens the file, the previous handle is closed
+            file& _Open(const file_access _Access = file_access::read | file_access::write,
+                const file_flag _Flags = file_flag::none) noexcept {
+                _Myfile.close();
+                const HANDLE _Handle = ::CreateFileW(_Myname, static_cast<DWORD>(_Access),
+                    FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+                        FILE_ATTRIBUTE_NORMAL | static_cast<DWORD>(_Flags), nullptr);
+                if (_Handle != INVALID_HANDLE_VALUE) {
+                    _Myfile.set_handle(_Handle);
+                }
+
+                return _Myfile;
+            }
+
+            // returns the path to the file
+            const wchar_t* _Path() const noexcept {
+                return _Myname;
+            }
+
+            // returns the most recently opened handle
+            file& _Get() noexcept {
+                return _Myfile;
+            }
+
+            // replaces the content of the file, the file remains open for reading and writing
+            bool _Store(const byte_string& _Data) noexcept {
+                file& _File = _Open();
+                return _File.is_open() && _File.resize(0)
+                    && (_Data.empty() || efc_impl::_Write_at(_File, 0, _Data.c_str(), _Data.size()));
+            }
+
+            // reads the whole file, the file remains open for reading and writing
+            bool _Load(byte_string& _Data) noexcept {
+                file& _File = _Open();
+                if (!_File.is_open()) {
+                    return false;
+                }
+
+                try {
+                    _Data.assign(static_cast<size_t>(_File.size()), '\0');
+                } catch (...) {
+                    return false;
+                }
+
+                return _Data.empty() || efc_impl::_Read_at(_File, 0, _Data.data(), _Data.size());
+            }
+
+        private:
+            wchar_t _Myname[MAX_PATH + 1];
+            file _Myfile;
+        };
+    } // namespace test
+} // namespace mjx
+
+#endif // _EFC_TEST_UTILS_TEST_FILE_HPP_
\ No newline at end of file
@@ -0,0 +1,130 @@
+// test_pipe.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _EFC_TEST_UTILS_TEST_PIPE_HPP_
+#define _EFC_TEST_UTILS_TEST_PIPE_HPP_
+#include <efc/impl/tinywin.hpp>
+#include <mjfs/file.hpp>
+#include <mjstr/string.hpp>
+#include <thread>
+
+namespace mjx {
+    namespace test {
+        // Note: Anonymous pipes cannot seek and may return fewer bytes per read than requested,
+        //       so they stand in for the standard streams. One end is served by a background thread,
+        //       the other one is wrapped in a file for the tested code.
+        class _Pipe_source { // a pipe that yields the specified data and then ends
+        public:
+            explicit _Pipe_source(const byte_string& _Data)
+                : _Mydata(_Data), _Myfile(), _Mywrite(nullptr), _Mythread() {
+                HANDLE _Read;
+                if (!::CreatePipe(&_Read, &_Mywrite, nullptr, 0)) {
+                    return;
+                }
+
+                _Myfile.set_handle(_Read);
+                _Mythread = ::std::thread(&_Pipe_source::_Feed, this);
+            }
+
+            ~_Pipe_source() noexcept {
+                _Myfile.close(); // unblocks the background thread if the data has not been read
+                if (_Mythread.joinable()) {
+                    _Mythread.join();
+                }
+            }
+
+            _Pipe_source(const _Pipe_source&)            = delete;
+            _Pipe_source& operator=(const _Pipe_source&) = delete;
+
+            // returns the read end of the pipe
+            file& _Get() noexcept {
+                return _Myfile;
+            }
+
+        private:
+            void _Feed() noexcept {
+                size_t _Total = 0;
+                while (_Total < _Mydata.size()) {
+                    DWORD _Written = 0;
+                    if (!::WriteFile(_Mywrite, _Mydata.c_str() + _Total,
+                        static_cast<DWORD>(_Mydata.size() - _Total), &_Written, nullptr)) {
+                        break; // the read end has been closed
+                    }
+
+                    _Total += _Written;
+                }
+
+                ::CloseHandle(_Mywrite); // the reader sees the end of the data
+            }
+
+            byte_string _Mydata;
+            file _Myfile;
+            HANDLE _Mywrite;
+            ::std::thread _Mythread;
+        };
+
+        class _Pipe_sink { // a pipe that collects everything written to it
+        public:
+            _Pipe_sink() : _Mydata(), _Myfile(), _Myread(nullptr), _Mythread() {
+                HANDLE _Write;
+                if (!::CreatePipe(&_Myread, &_Write, nullptr, 0)) {
+                    return;
+                }
+
+                _Myfile.set_handle(_Write);
+                _Mythread = ::std::thread(&_Pipe_sink::_Drain, this);
+            }
+
+            ~_Pipe_sink() noexcept {
+                _Finish();
+            }
+
+            _Pipe_sink(const _Pipe_sink&)            = delete;
+            _Pipe_sink& operator=(const _Pipe_sink&) = delete;
+
+            // returns the write end of the pipe
+            file& _Get() noexcept {
+                return _Myfile;
+            }
+
+            // closes the write end and returns everything written to the pipe
+            const byte_string& _Finish() noexcept {
+                _Myfile.close();
+                if (_Mythread.joinable()) {
+                    _Mythread.join();
+                }
+
+                return _Mydata;
+            }
+
+        private:
+            void _Drain() noexcept {
+                byte_t _Buf[4096];
+                for (;;) {
+                    DWORD _Read = 0;
+                    if (!::ReadFile(_Myread, _Buf, sizeof(_Buf), &_Read, nullptr) || _Read == 0) {
+                        break; // the write end has been closed
+                    }
+
+                    try {
+                        _Mydata.append(_Buf, _Read);
+                    } catch (...) {
+                        break;
+                    }
+                }
+
+                ::CloseHandle(_Myread);
+            }
+
+            byte_string _Mydata;
+            file _Myfile;
+            HANDLE _Myread;
+            ::std::thread _Mythread;
+        };
+    } // namespace test
+} // namespace mjx
+
+#endif // _EFC_TEST_UTILS_TEST_PIPE_HPP_
\ No newline at end of file